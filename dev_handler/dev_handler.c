@@ -3,10 +3,19 @@
  * acts as the interface between the devices and shared memory
  */
 
-#include <termios.h>  // for POSIX terminal control definitions in serialport_open()
+#include <stdatomic.h>    // for the link statistics shared by the sender and receiver threads
+#include <sys/epoll.h>    // for epoll_create1(), epoll_ctl(), epoll_wait() in event loop mode
+#include <sys/eventfd.h>  // for eventfd() in event loop mode
+#include <sys/inotify.h>  // for inotify_init1(), inotify_add_watch() in poll_connected_devices()
+#include <sys/ioctl.h>    // for ioctl() in publish_link_stats()
+#include <sys/poll.h>     // for poll() in poll_connected_devices()
+#include <sys/stat.h>     // for stat() in communicate()
+#include <sys/timerfd.h>  // for timerfd_create(), timerfd_settime() in event loop mode
+#include <termios.h>      // for POSIX terminal control definitions in serialport_open() and set_baud_rate()
 
 #include <dev_handler_message.h>
 #include <logger.h>
+#include <realtime.h>
 #include <runtime_util.h>
 #include <shm_wrapper.h>
 
@@ -16,7 +25,7 @@
  * a file with path "/dev/ttyACM0". A second device connected will appear as
  * "/dev/ttyACM1".
  * Virtual devices (not Arduinos) on the other hand are UNIX sockets that appear as
- * "/var/ttyACM0"
+ * "/var/ttyACM0", or pseudoterminals (opened like a serial port) linked to from there
  * In the code, the number is referred to as "port_num"
  * Depending on whether a device is an Arduino ("lowcar") or a virtual device,
  * dev handler has to open a connection with it differently.
@@ -26,31 +35,138 @@
 #define LOWCAR_FILE_PATH "/dev/ttyACM"
 #define VIRTUAL_FILE_PATH "ttyACM"  // will be created in the home directory
 #define LOWCAR_USB_FILE_PATH "/dev/ttyUSB"
+#define LOWCAR_DIR "/dev"  // directory that LOWCAR_FILE_PATH and LOWCAR_USB_FILE_PATH ports appear in
+
+/**
+ * New ports are noticed through inotify watches on LOWCAR_DIR and the home directory as soon as they appear.
+ * The ports are still scanned every SCAN_INTERVAL milliseconds in case an event is missed
+ * (or every POLL_INTERVAL if inotify isn't available).
+ */
+#define SCAN_INTERVAL 2000
+#define INOTIFY_BUF_SIZE 4096          // Bytes of inotify events read at once
+#define SOCKET_CONNECT_TRIES 10        // Times to try connecting to a virtual device socket that isn't listening yet
+#define SOCKET_CONNECT_RETRY_WAIT 10000  // Microseconds between tries to connect to a virtual device socket
+
+// Subscriptions: each device is told to send only the params that executor or net handler read (see update_subscription())
+#define SUBSCRIBE_INTERVAL 250  // Milliseconds between updates of each device's subscription
+#define INTEREST_TIMEOUT 5000   // Milliseconds that a device stays subscribed to a param after it was last read
+#define LINK_BUSY 80            // Percent of a serial link's capacity used above which subscribed periods are doubled
+#define LINK_IDLE 35            // Percent of a serial link's capacity used below which they are halved again
+#define MAX_THROTTLE 6          // Most times that subscribed periods are doubled
+#define BITS_PER_BYTE 10        // Bits sent over a serial link per byte (8-N-1: a start bit, 8 data bits, and a stop bit)
+
+#define LINK_STATS_INTERVAL 1000  // Milliseconds between updates of each device's link statistics in shared memory (see publish_link_stats())
+
+#define RX_BUF_SIZE 1024  // Bytes buffered per device by receive_message(); must be well over the longest message (DELIMITER_SIZE + COBS_LENGTH_SIZE + UINT8_MAX)
+
+/**
+ * By default, each device gets its own three threads (see communicate()).
+ * Started as "dev_handler epoll [num_workers]", dev handler instead hands every device to one of
+ * NUM_WORKERS worker threads, each running a single epoll event loop over all of its devices
+ * (see event_loop()). The messages sent and the handling of received messages are the same in both modes.
+ */
+#define MAX_WORKERS 4                 // Maximum number of worker threads in event loop mode
+#define EVENT_TICK 50                 // Milliseconds between checks for due DEVICE_PINGs, timeouts, and disconnects in event loop mode
+#define MAX_EVENTS (MAX_DEVICES + 2)  // Maximum number of events handled per epoll_wait()
+#define TX_QUEUE_SIZE 1024            // Bytes queued per device in event loop mode while its file descriptor is full; must be at least MAX_COBS_MSG_LENGTH
+
+_Static_assert(TX_QUEUE_SIZE >= MAX_COBS_MSG_LENGTH, "the rest of a partly sent message must fit in the send queue");
 
 // **************************** PRIVATE STRUCT ****************************** //
 
+typedef struct worker worker_t;
+
+// Steps of negotiating HIGH_BAUD_RATE with a device on a serial port (see request_baud())
+typedef enum {
+    BAUD_DONE,       // Not negotiating; the serial port is at BAUD_RATE
+    BAUD_REQUESTED,  // Sent a SET_BAUD; waiting for the device to echo it
+    BAUD_SWITCHED    // Switched to the echoed rate; waiting for a valid message at it
+} baud_state_t;
+
 /* A struct shared between SENDER, RECEIVER, and RELAYER threads communicating
  * with the same device.
  * Contains information about each thread, how to communicate with the device,
  * and information about the device itself
  * The RELAYER thread is responsible for using this struct to properly clean up
  * when the device disconnects or times out
+ * In event loop mode, the WORKER that handles the device uses it instead of the three threads
  */
-typedef struct {
+typedef struct relay {
     pthread_t sender;                 // Thread to build and send outgoing messages
     pthread_t receiver;               // Thread to receive and process all incoming messages
     pthread_t relayer;                // Thread to get ACKNOWLEDGEMENT and monitor disconnect/timeout
     bool is_virtual;                  // True iff the device is a virtual device. Otherwise, an actual Arduino.
     bool is_usb;                      // True iff the device is an actual Arduino recognized as ttyacm
+    bool is_serial;                   // True iff FILE_DESCRIPTOR is a serial port (an Arduino, or a virtual device on a pseudoterminal)
     uint8_t port_num;                 // The device is a file with path "<port_prefix><port_num>/"
     int file_descriptor;              // Obtained from opening port. Used to close port.
     int shm_dev_idx;                  // The unique index assigned to the device by shm_wrapper for shared memory operations on device_connect()
     dev_id_t dev_id;                  // set by relayer once ACKNOWLEDGEMENT is received
-    uint64_t last_received_msg_time;  // set by receiver: Timestamp of the most recent message from the device
-    pthread_mutex_t relay_lock;       // Mutex on relay->last_received_msg_time
+    checksum_t checksum;              // set by relayer once ACKNOWLEDGEMENT is received: Checksum of the messages after it
+    pthread_mutex_t relay_lock;       // Mutex on the baud rate negotiation
+    _Atomic baud_state_t baud_state;  // Step of negotiating HIGH_BAUD_RATE (read without RELAY_LOCK only to check for BAUD_SWITCHED)
+    uint32_t baud_rate;               // Baud rate that the serial port is set to
+    uint64_t baud_deadline;           // Timestamp by which the current step of negotiating HIGH_BAUD_RATE must be done
     pthread_cond_t start_cond;        // Conditional variable for relayer to broadcast to sender and receiver to start work
+    uint16_t rx_start;                // Index of the first byte in RX_BUF that isn't part of a handled message
+    uint16_t rx_len;                  // Number of bytes in RX_BUF
+    uint32_t rx_skipped;              // Number of bytes skipped since the last delimiter (warned about once the next delimiter is found)
+    uint8_t rx_buf[RX_BUF_SIZE];      // Bytes read from the device in bulk, split into messages by next_message()
+    // Link statistics, counted by the threads that send and receive and published by publish_link_stats()
+    _Atomic uint64_t bytes_in;          // Number of bytes read from the device
+    _Atomic uint64_t reads;             // Number of read() calls on the device's file descriptor
+    _Atomic uint64_t bytes_out;         // Number of bytes sent to the device
+    _Atomic uint64_t frames_in;         // Number of valid messages received from the device
+    _Atomic uint64_t frames_out;        // Number of messages sent to the device
+    _Atomic uint32_t decode_errors;     // Number of messages dropped because they were cut short, had a bad length, or couldn't be parsed
+    _Atomic uint32_t checksum_errors;   // Number of messages dropped because their checksum didn't match
+    _Atomic uint64_t resync_bytes;      // Number of received bytes skipped to find the next delimiter
+    _Atomic uint32_t handshake_rtt_us;  // Microseconds the device took to answer the DEVICE_PING before its ACKNOWLEDGEMENT, or its last SET_BAUD
+    _Atomic uint32_t tx_drops;          // Number of messages not sent because the send queue was full (event loop mode only)
+    uint64_t request_time;              // micros() when the DEVICE_PING before the ACKNOWLEDGEMENT, or the SET_BAUD, was sent
+    uint64_t last_stats_time;           // Timestamp of the last update of the link statistics in shared memory
+    dev_link_stats_t link_stats;        // Link statistics last written to shared memory
+    // Liveness of the link in each direction, kept without RELAY_LOCK so that handling a message doesn't lock
+    _Atomic uint64_t last_received_msg_time;  // set by handle_message(): Timestamp of the most recent valid message from the device
+    _Atomic uint64_t last_sent_msg_time;      // set by send_message(): Timestamp of the most recent message sent to the device
+    // Subscription of the device, maintained by update_subscription()
+    uint64_t last_subscribe_time;                  // Timestamp of the last subscription update
+    uint64_t sub_bytes_in;                         // BYTES_IN at the last subscription update
+    uint64_t read_times[NUM_READERS][MAX_PARAMS];  // Timestamp of the last subscription update at which each reader had read each param
+    uint16_t net_read_period;                      // Milliseconds between net handler's reads of the device
+    uint8_t throttle;                              // Number of times subscribed periods are doubled because the serial link is busy
+    bool subscribed;                               // True iff a SUBSCRIBE was sent
+    bitmap_t sub_params;                           // Params of the last SUBSCRIBE sent
+    uint16_t sub_periods[MAX_PARAMS];              // Periods of the params of the last SUBSCRIBE sent
+    // Scratch space for sending, so that the steady-state send path doesn't allocate
+    message_t tx_msg;                      // Message that outgoing DEVICE_PINGs and DEVICE_WRITEs are built in
+    uint8_t tx_payload[MAX_PAYLOAD_SIZE];  // Payload of TX_MSG
+    uint8_t tx_buf[MAX_COBS_MSG_LENGTH];   // Buffer that send_message() encodes outgoing messages into
+    // Used only in event loop mode
+    worker_t* worker;                 // Worker whose event loop handles the device (NULL when using threads)
+    struct relay* next;               // Next device in the worker's list of pending or watched devices
+    bool watched;                     // True iff the device's file descriptor is in the worker's epoll instance
+    uint64_t verify_deadline;         // Timestamp by which the device must send an ACKNOWLEDGEMENT
+    uint64_t last_checked_time;       // Timestamp of the most recent check for a disconnect or timeout
+    uint16_t tx_queued;               // Number of bytes in TX_QUEUE
+    uint8_t tx_queue[TX_QUEUE_SIZE];  // Encoded bytes that the file descriptor wasn't ready for, sent on EPOLLOUT before any new message
 } relay_t;
 
+/* A thread that communicates with many devices from one epoll event loop (event loop mode only)
+ * The epoll instance watches the file descriptor of each device, a timer, and an eventfd for wakeups
+ */
+struct worker {
+    pthread_t thread;      // Thread running the event loop
+    int epoll_fd;          // epoll instance watching TIMER_FD, WAKE_FD, and the file descriptors of DEVICES
+    int timer_fd;          // timerfd that expires every EVENT_TICK milliseconds
+    int wake_fd;           // eventfd written when commands are written to shared memory or devices are handed over
+    pthread_mutex_t lock;  // Mutex on PENDING and NUM_DEVICES
+    relay_t* pending;      // Devices handed over by communicate() that the event loop hasn't picked up yet
+    int num_devices;       // Number of pending and watched devices, used to spread new devices over the workers
+    relay_t* devices;      // Devices handled by the event loop
+    relay_t* dead;         // Devices cleaned up while handling the current batch of events, freed after it
+};
+
 // ************************** FUNCTION DECLARATIONS ************************* //
 
 // Main functions
@@ -59,42 +175,71 @@ void stop();
 void poll_connected_devices();
 
 // Polling Utility
-int get_new_devices(uint32_t* lowcar_bitmap, uint32_t* virtual_bitmap, uint32_t* lowcar_usb_bitmap);
+int get_new_devices(bitmap_t* lowcar_bitmap, bitmap_t* virtual_bitmap, bitmap_t* lowcar_usb_bitmap);
+bool claim_port(bool is_virtual, bool is_usb, int port_num);
+int watch_ports(int* virtual_watch);
+void connect_new_ports(char* events, ssize_t len, int virtual_watch);
 
 // Threads for communicating with devices
 void communicate(bool is_virtual, bool is_usb, uint8_t port_num);
 void* relayer(void* relay_cast);
+void reject_device(relay_t* relay);
+int connect_device(relay_t* relay);
+int check_device(relay_t* relay);
 void relay_clean_up(relay_t* relay);
 void* sender(void* relay_cast);
 void* receiver(void* relay_cast);
 
+// Event loop mode
+void start_workers(int n);
+void* event_loop(void* worker_cast);
+void* command_waker(void* args);
+
 // Device communication
 int send_message(relay_t* relay, message_t* msg);
 int receive_message(relay_t* relay, message_t* msg);
+ssize_t read_available(relay_t* relay);
+int next_message(relay_t* relay, message_t* msg);
+int send_verify_request(relay_t* relay);
 int verify_device(relay_t* relay);
+int accept_ack(relay_t* relay, message_t* ack);
+void send_ping(relay_t* relay);
+void send_commands(relay_t* relay, param_val_t* params);
+int handle_message(relay_t* relay, message_t* msg, param_val_t* vals);
+void request_baud(relay_t* relay);
+void switch_baud(relay_t* relay, message_t* echo);
+void check_baud(relay_t* relay);
+void update_subscription(relay_t* relay);
+void publish_link_stats(relay_t* relay);
 
 // Serial port or socket opening and closing
 int connect_socket(const char* socket_name);
 int serialport_open(const char* port_name);
+int set_baud_rate(int fd, uint32_t baud_rate);
 int serialport_close(int fd);
 
 // Utility
 void cleanup_handler(void* args);
 void construct_port_name(char* port_name, bool is_virtual, bool is_usb, int port_num);
-void get_used_ports_bitmap(uint32_t** used_ports, bool is_virtual, bool is_usb);
+void get_used_ports_bitmap(bitmap_t** used_ports, bool is_virtual, bool is_usb);
+uint64_t micros();
 
 // **************************** GLOBAL VARIABLES **************************** //
 
 // Bitmap indicating whether port "<port_prefix>*" is being monitored by dev handler, where * is the *-th bit
 // Bits are turned on in get_new_devices() and turned off on disconnect/timeout in relay_clean_up()
-uint32_t used_lowcar_ports = 0;
-uint32_t used_virtual_ports = 0;
-uint32_t used_lowcar_usb_ports = 0;
+bitmap_t used_lowcar_ports = 0;
+bitmap_t used_virtual_ports = 0;
+bitmap_t used_lowcar_usb_ports = 0;
 pthread_mutex_t used_ports_lock;  // poll_connected_devices() and relay_clean_up() shouldn't access used_ports at the same time
 
 // String to hold the home directory path (for looking for virtual device sockets)
 const char* home_dir;
 
+// Workers of event loop mode; NUM_WORKERS is 0 when using three threads per device
+worker_t workers[MAX_WORKERS];
+int num_workers = 0;
+
 #define MAX_PORT_NAME_SIZE 64
 
 // ***************************** MAIN FUNCTIONS ***************************** //
@@ -105,6 +250,8 @@ void init() {
     logger_init(DEV_HANDLER);
     // Init shared memory
     shm_init();
+    // Apply the real-time profile, if it's on (after shm_init() so that shared memory is prefaulted)
+    realtime_init(DEV_HANDLER);
     // Initialize lock on global variable USED_PORTS
     if (pthread_mutex_init(&used_ports_lock, NULL) != 0) {
         log_printf(FATAL, "init: Couldn't init USED_PORTS_LOCK");
@@ -116,12 +263,10 @@ void init() {
 void stop() {
     log_printf(INFO, "Interrupt received, terminating dev_handler\n");
     // For each tracked device, disconnect from shared memory
-    uint32_t connected_devs = 0;
+    bitmap_t connected_devs = 0;
     get_catalog(&connected_devs);
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        if ((1 << i) & connected_devs) {
-            device_disconnect(i);
-        }
+    for (bitmap_t rest = connected_devs; rest != 0;) {
+        device_disconnect(bitmap_pop(&rest));
     }
     // Destroy locks
     pthread_mutex_destroy(&used_ports_lock);
@@ -132,37 +277,44 @@ void stop() {
  * Detects when devices are connected
  * On Arduino device connect,
  * connect to shared memory and spawn three threads to communicate with the device
+ * New ports are connected to as soon as inotify reports them, and all ports are scanned every SCAN_INTERVAL
  */
 void poll_connected_devices() {
     // Poll for newly connected devices and open threads for them
     log_printf(DEBUG, "Polling now for devices.\n");
-    uint32_t new_lowcar_devs;
-    uint32_t new_virtual_devs;
-    uint32_t new_lowcar_usb_devs;
+    int virtual_watch = -1;
+    int inotify_fd = watch_ports(&virtual_watch);
+    struct pollfd inotify_poll = {.fd = inotify_fd, .events = POLLIN};  // poll() just sleeps if INOTIFY_FD is -1
+    int scan_interval = (inotify_fd == -1) ? POLL_INTERVAL / 1000 : SCAN_INTERVAL;
+    char events[INOTIFY_BUF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    uint64_t next_scan, now;
+    bitmap_t new_lowcar_devs;
+    bitmap_t new_virtual_devs;
+    bitmap_t new_lowcar_usb_devs;
     while (1) {
         new_lowcar_devs = 0;
         new_virtual_devs = 0;
         new_lowcar_usb_devs = 0;
         if (get_new_devices(&new_lowcar_devs, &new_virtual_devs, &new_lowcar_usb_devs) > 0) {
             // If bit i of either bitmap is on, then it's a new device
-            for (int i = 0; (new_lowcar_devs >> i) > 0 && i < MAX_DEVICES; i++) {
-                if (new_lowcar_devs & (1 << i)) {
-                    communicate(false, false, i);
-                }
+            for (bitmap_t rest = new_lowcar_devs; rest != 0;) {
+                communicate(false, false, bitmap_pop(&rest));
             }
-            for (int i = 0; (new_lowcar_usb_devs >> i) > 0 && i < MAX_DEVICES; i++) {
-                if (new_lowcar_usb_devs & (1 << i)) {
-                    communicate(false, true, i);
-                }
+            for (bitmap_t rest = new_lowcar_usb_devs; rest != 0;) {
+                communicate(false, true, bitmap_pop(&rest));
             }
-            for (int i = 0; (new_virtual_devs >> i) > 0 && i < MAX_DEVICES; i++) {
-                if (new_virtual_devs & (1 << i)) {
-                    communicate(true, false, i);
-                }
+            for (bitmap_t rest = new_virtual_devs; rest != 0;) {
+                communicate(true, false, bitmap_pop(&rest));
+            }
+        }
+        // Save CPU usage by scanning for new devices only every so often, and in between wait for new ports
+        next_scan = millis() + scan_interval;
+        while ((now = millis()) < next_scan) {
+            if (poll(&inotify_poll, 1, next_scan - now) > 0 && (len = read(inotify_fd, events, INOTIFY_BUF_SIZE)) > 0) {
+                connect_new_ports(events, len, virtual_watch);
             }
         }
-        // Save CPU usage by checking for new devices only every so often (defined in runtime_util.h)
-        usleep(POLL_INTERVAL);
     }
 }
 
@@ -176,26 +328,14 @@ void poll_connected_devices() {
  * Returns:
  *    the number of new devices found
  */
-static int get_new_devices_helper(bool is_virtual, bool is_usb, uint32_t* found_devices) {
+static int get_new_devices_helper(bool is_virtual, bool is_usb, bitmap_t* found_devices) {
     int num_devices_found = 0;
-    uint32_t* used_ports = NULL;
-    get_used_ports_bitmap(&used_ports, is_virtual, is_usb);
-    char device_path[MAX_PORT_NAME_SIZE];
     for (int i = 0; i < MAX_DEVICES; i++) {
-        pthread_mutex_lock(&used_ports_lock);
-        // Check if i-th bit of USED_PORTS is zero (indicating device wasn't connected in previous function call)
-        if (!(*used_ports & (1 << i))) {
-            construct_port_name(device_path, is_virtual, is_usb, i);
-            // If that port currently connected (file exists), it's a new device
-            if (access(device_path, F_OK) != -1) {
-                // Turn bit on
-                *found_devices |= (1 << i);
-                // Mark that we've taken care of this device
-                *used_ports |= (1 << i);
-                num_devices_found++;
-            }
+        if (claim_port(is_virtual, is_usb, i)) {
+            // Turn bit on
+            *found_devices |= BITMAP_BIT(i);
+            num_devices_found++;
         }
-        pthread_mutex_unlock(&used_ports_lock);
     }
     return num_devices_found;
 }
@@ -209,7 +349,7 @@ static int get_new_devices_helper(bool is_virtual, bool is_usb, uint32_t* found_
  * Returns:
  *    the number of devices that were found
  */
-int get_new_devices(uint32_t* lowcar_bitmap, uint32_t* virtual_bitmap, uint32_t* lowcar_usb_bitmap) {
+int get_new_devices(bitmap_t* lowcar_bitmap, bitmap_t* virtual_bitmap, bitmap_t* lowcar_usb_bitmap) {
     uint8_t num_devices_found = 0;
     num_devices_found += get_new_devices_helper(false, false, lowcar_bitmap);
     num_devices_found += get_new_devices_helper(true, false, virtual_bitmap);
@@ -217,6 +357,97 @@ int get_new_devices(uint32_t* lowcar_bitmap, uint32_t* virtual_bitmap, uint32_t*
     return num_devices_found;
 }
 
+/**
+ * Marks a port as used if a device is connected at it that isn't being monitored yet
+ * Arguments:
+ *    is_virtual: Whether the port is for a virtual device
+ *    is_usb: Whether the port is for an Arduino recognized as ttyUSB
+ *    port_num: The port number
+ * Returns:
+ *    true iff the port has a new device, which the caller must call communicate() on
+ */
+bool claim_port(bool is_virtual, bool is_usb, int port_num) {
+    bool claimed = false;
+    bitmap_t* used_ports = NULL;
+    get_used_ports_bitmap(&used_ports, is_virtual, is_usb);
+    char device_path[MAX_PORT_NAME_SIZE];
+    pthread_mutex_lock(&used_ports_lock);
+    // Check if the port's bit of USED_PORTS is zero (indicating device wasn't connected before)
+    if (!(*used_ports & BITMAP_BIT(port_num))) {
+        construct_port_name(device_path, is_virtual, is_usb, port_num);
+        // If that port currently connected (file exists), it's a new device
+        if (access(device_path, F_OK) != -1) {
+            // Mark that we've taken care of this device
+            *used_ports |= BITMAP_BIT(port_num);
+            claimed = true;
+        }
+    }
+    pthread_mutex_unlock(&used_ports_lock);
+    return claimed;
+}
+
+/**
+ * Starts watching LOWCAR_DIR and the home directory for new ports
+ * Arguments:
+ *    virtual_watch: Set to the watch descriptor of the home directory, to tell its events apart
+ * Returns:
+ *    An inotify file descriptor that becomes readable when a file is created in either directory, or
+ *    -1 if inotify isn't available, in which case ports have to be scanned for
+ */
+int watch_ports(int* virtual_watch) {
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd == -1) {
+        log_printf(WARN, "watch_ports: Couldn't init inotify, scanning for devices instead--%s", strerror(errno));
+        return -1;
+    }
+    // IN_ATTRIB catches serial ports whose permissions are fixed up by udev after they are created
+    if (inotify_add_watch(fd, LOWCAR_DIR, IN_CREATE | IN_ATTRIB) == -1 || (*virtual_watch = inotify_add_watch(fd, home_dir, IN_CREATE)) == -1) {
+        log_printf(WARN, "watch_ports: Couldn't watch for new ports, scanning for devices instead--%s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Calls communicate() on each new port named in a batch of inotify events
+ * Arguments:
+ *    events: The inotify events read from the file descriptor returned by watch_ports()
+ *    len: The number of bytes in EVENTS
+ *    virtual_watch: The watch descriptor of the home directory, set by watch_ports()
+ */
+void connect_new_ports(char* events, ssize_t len, int virtual_watch) {
+    struct inotify_event* event;
+    char device_path[MAX_PORT_NAME_SIZE];
+    int port_num;
+    int name_len;  // Number of characters of DEVICE_PATH matched, to make sure the whole path is a port name
+    for (char* ptr = events; ptr < events + len; ptr += sizeof(struct inotify_event) + event->len) {
+        event = (struct inotify_event*) ptr;
+        if (event->len == 0) {
+            continue;
+        }
+        bool is_virtual = (event->wd == virtual_watch);
+        bool is_usb = false;
+        name_len = 0;
+        if (is_virtual) {
+            sscanf(event->name, VIRTUAL_FILE_PATH "%d%n", &port_num, &name_len);
+        } else {
+            snprintf(device_path, MAX_PORT_NAME_SIZE, "%s/%s", LOWCAR_DIR, event->name);
+            if (sscanf(device_path, LOWCAR_USB_FILE_PATH "%d%n", &port_num, &name_len) == 1) {
+                is_usb = true;
+            } else {
+                sscanf(device_path, LOWCAR_FILE_PATH "%d%n", &port_num, &name_len);
+            }
+        }
+        if (name_len == 0 || (is_virtual ? event->name : device_path)[name_len] != '\0' || port_num < 0 || port_num >= MAX_DEVICES) {
+            continue;  // Not a port
+        }
+        if (claim_port(is_virtual, is_usb, port_num)) {
+            communicate(is_virtual, is_usb, port_num);
+        }
+    }
+}
+
 // ******************************** THREADS ********************************* //
 
 /**
@@ -225,6 +456,7 @@ int get_new_devices(uint32_t* lowcar_bitmap, uint32_t* virtual_bitmap, uint32_t*
  *  relayer: Verifies device is lowcar and cancels threads when device disconnects/timesout
  *  sender: Sends data to write to device and periodically sends DEVICE_PING
  *  receiver: Receives parameter data from the lowcar device and processes logs
+ * In event loop mode, the device is instead handed to the worker with the fewest devices
  * Arguments:
  *    is_virtual: Whether the device is virtual
  *    port_num: The port number of the new device to connect to
@@ -242,7 +474,10 @@ void communicate(bool is_virtual, bool is_usb, uint8_t port_num) {
     char port_name[MAX_PORT_NAME_SIZE];  // Template size + 2 indices for port_number
     construct_port_name(port_name, is_virtual, is_usb, port_num);
 
-    if (relay->is_virtual) {  // Bind to socket
+    // A virtual device is a socket, unless it's a pseudoterminal, which is opened like an Arduino's serial port
+    struct stat port_stat;
+    relay->is_serial = !is_virtual || (stat(port_name, &port_stat) == 0 && S_ISCHR(port_stat.st_mode));
+    if (!relay->is_serial) {  // Bind to socket
         relay->file_descriptor = connect_socket(port_name);
         if (relay->file_descriptor == -1) {
             log_printf(ERROR, "communicate: Couldn't connect to socket %s\n", port_name);
@@ -263,9 +498,59 @@ void communicate(bool is_virtual, bool is_usb, uint8_t port_num) {
     relay->dev_id.type = -1;
     relay->dev_id.year = -1;
     relay->dev_id.uid = -1;
-    relay->last_received_msg_time = 0;
+    relay->checksum = CHECKSUM_XOR;
+    atomic_init(&relay->last_received_msg_time, 0);
+    atomic_init(&relay->last_sent_msg_time, 0);
     pthread_mutex_init(&relay->relay_lock, NULL);
     pthread_cond_init(&relay->start_cond, NULL);
+    atomic_init(&relay->baud_state, BAUD_DONE);
+    relay->baud_rate = DEFAULT_BAUD_RATE;
+    relay->baud_deadline = 0;
+    relay->rx_start = 0;
+    relay->rx_len = 0;
+    relay->rx_skipped = 0;
+    atomic_init(&relay->bytes_in, 0);
+    atomic_init(&relay->reads, 0);
+    atomic_init(&relay->bytes_out, 0);
+    atomic_init(&relay->frames_in, 0);
+    atomic_init(&relay->frames_out, 0);
+    atomic_init(&relay->decode_errors, 0);
+    atomic_init(&relay->checksum_errors, 0);
+    atomic_init(&relay->resync_bytes, 0);
+    atomic_init(&relay->handshake_rtt_us, 0);
+    atomic_init(&relay->tx_drops, 0);
+    memset(&relay->link_stats, 0, sizeof(relay->link_stats));
+    relay->sub_bytes_in = 0;
+    memset(relay->read_times, 0, sizeof(relay->read_times));
+    relay->net_read_period = 1;
+    relay->throttle = 0;
+    relay->subscribed = false;
+    relay->tx_msg.payload = relay->tx_payload;
+    relay->tx_msg.max_payload_length = MAX_PAYLOAD_SIZE;
+    relay->worker = NULL;
+    relay->next = NULL;
+    relay->watched = false;
+    relay->tx_queued = 0;
+
+    if (num_workers > 0) {
+        worker_t* worker = &workers[0];
+        for (int i = 1; i < num_workers; i++) {
+            if (workers[i].num_devices < worker->num_devices) {
+                worker = &workers[i];
+            }
+        }
+        relay->worker = worker;
+        pthread_mutex_lock(&worker->lock);
+        relay->next = worker->pending;
+        worker->pending = relay;
+        worker->num_devices++;
+        pthread_mutex_unlock(&worker->lock);
+        uint64_t one = 1;
+        if (write(worker->wake_fd, &one, sizeof(one)) != sizeof(one)) {
+            log_printf(ERROR, "communicate: Couldn't wake worker--%s", strerror(errno));
+        }
+        return;
+    }
 
     // Open threads for sender, receiver, and relayer
     if (pthread_create(&relay->sender, NULL, sender, relay) != 0) {
@@ -280,7 +565,7 @@ void communicate(bool is_virtual, bool is_usb, uint8_t port_num) {
 }
 
 /**
- * Sends a DEVICE_PING to the device and waits for an ACKNOWLEDGEMENT
+ * Sends a CHECKSUM_OFFER and a DEVICE_PING to the device and waits for an ACKNOWLEDGEMENT
  * If the ACKNOWLEDGEMENT takes too long, close the device and exit all threads
  * Connects the device to shared memory and signals the sender and receiver to start
  * Continuously checks if the device disconnected or timed out
@@ -295,17 +580,14 @@ void* relayer(void* relay_cast) {
     // Verify that the device is a lowcar device
     ret = verify_device(relay);
     if (ret != 0) {
-        log_printf(DEBUG, "/dev/ttyACM%d couldn't be verified to be a lowcar device", relay->port_num);
-        log_printf(ERROR, "A non-PiE device was recently plugged in. Please unplug immediately");
-        relay_clean_up(relay);
+        reject_device(relay);
         return NULL;
     }
 
     // At this point, the device is confirmed to be a lowcar device!
 
     // Connect the lowcar device to shared memory
-    device_connect(&relay->dev_id, &relay->shm_dev_idx);
-    if (relay->shm_dev_idx == -1) {
+    if (connect_device(relay) != 0) {
         relay_clean_up(relay);
         return NULL;
     }
@@ -314,42 +596,85 @@ void* relayer(void* relay_cast) {
     pthread_cond_broadcast(&relay->start_cond);
 
     // If the device disconnects or times out, clean up
-    log_printf(DEBUG, "Monitoring %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
-    char port_name[MAX_PORT_NAME_SIZE];
-    construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
     while (1) {
-        // If Arduino port file doesn't exist, it disconnected
-        if (access(port_name, F_OK) == -1) {
-            log_printf(INFO, "%s (0x%016llX) disconnected!", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        if (check_device(relay) != 0) {
             relay_clean_up(relay);
             return NULL;
         }
-        // If it took too long to receive a message, the device timed out
-        pthread_mutex_lock(&relay->relay_lock);
-        if ((millis() - relay->last_received_msg_time) >= TIMEOUT) {
-            pthread_mutex_unlock(&relay->relay_lock);
-            log_printf(WARN, "%s (0x%016llX) timed out!", get_device_name(relay->dev_id.type), relay->dev_id.uid);
-            relay_clean_up(relay);
-            return NULL;
-        }
-        pthread_mutex_unlock(&relay->relay_lock);
         usleep(POLL_INTERVAL);
     }
 }
 
+/**
+ * Logs that a device couldn't be verified to be a lowcar device and cleans up after it
+ * Arguments:
+ *    relay: Struct containing device info
+ */
+void reject_device(relay_t* relay) {
+    log_printf(DEBUG, "/dev/ttyACM%d couldn't be verified to be a lowcar device", relay->port_num);
+    log_printf(ERROR, "A non-PiE device was recently plugged in. Please unplug immediately");
+    relay_clean_up(relay);
+}
+
+/**
+ * Connects a verified lowcar device to shared memory
+ * Arguments:
+ *    relay: Struct containing device info; relay->shm_dev_idx is set on success
+ * Returns:
+ *    0 on success
+ *    -1 if the device couldn't be connected to shared memory
+ */
+int connect_device(relay_t* relay) {
+    device_connect(&relay->dev_id, &relay->shm_dev_idx);
+    if (relay->shm_dev_idx == -1) {
+        return -1;
+    }
+    log_printf(DEBUG, "Monitoring %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+    return 0;
+}
+
+/**
+ * Checks whether a connected device disconnected or timed out
+ * Also falls back to DEFAULT_BAUD_RATE if negotiating HIGH_BAUD_RATE took too long (see check_baud())
+ * Arguments:
+ *    relay: Struct containing device info
+ * Returns:
+ *    0 if the device is still connected
+ *    1 if the device disconnected or timed out, and needs to be cleaned up
+ */
+int check_device(relay_t* relay) {
+    // If Arduino port file doesn't exist, it disconnected
+    char port_name[MAX_PORT_NAME_SIZE];
+    construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
+    if (access(port_name, F_OK) == -1) {
+        log_printf(INFO, "%s (0x%016llX) disconnected!", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        return 1;
+    }
+    // If it took too long to receive a message, the device timed out
+    // The timestamp is loaded before calling millis() so that it can't be later than the current time
+    uint64_t last_received_msg_time = atomic_load_explicit(&relay->last_received_msg_time, memory_order_relaxed);
+    if ((millis() - last_received_msg_time) >= TIMEOUT) {
+        log_printf(WARN, "%s (0x%016llX) timed out!", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        return 1;
+    }
+    check_baud(relay);
+    return 0;
+}
+
 /**
  * Called by relayer to clean up after the device.
  * Closes serialport/socket, cancels threads,
  * disconnects from shared memory, and frees the RELAY struct
+ * In event loop mode, called by the worker instead, which frees the RELAY struct after the current batch of events
  * Arguments:
  *    relay: Struct containing device/thread info used to clean up
  */
 void relay_clean_up(relay_t* relay) {
     // If couldn't connect to device in the first place, just mark as unused
     if (relay->file_descriptor == -1) {
-        uint32_t* used_ports = NULL;
+        bitmap_t* used_ports = NULL;
         get_used_ports_bitmap(&used_ports, relay->is_virtual, relay->is_usb);
-        *used_ports &= ~(1 << relay->port_num);  // Set bit to 0 to indicate unused
+        *used_ports &= ~BITMAP_BIT(relay->port_num);  // Set bit to 0 to indicate unused
         free(relay);
         // Sleep so that we don't spam attempts to connect to a possibly bad device
         sleep(TIMEOUT / 1000);
@@ -357,14 +682,20 @@ void relay_clean_up(relay_t* relay) {
     }
 
     int ret;
-    // Cancel the sender and receiver threads when ongoing transfers are completed
-    pthread_cancel(relay->sender);
-    pthread_cancel(relay->receiver);
-    if ((ret = pthread_join(relay->sender, NULL)) != 0) {
-        log_printf(ERROR, "relay_clean_up: pthread_join on sender failed -- error: %d", ret);
-    }
-    if ((ret = pthread_join(relay->receiver, NULL)) != 0) {
-        log_printf(ERROR, "relay_clean_up: pthread_join on receiver failed -- error: %d", ret);
+    if (relay->worker == NULL) {
+        // Cancel the sender and receiver threads when ongoing transfers are completed
+        pthread_cancel(relay->sender);
+        pthread_cancel(relay->receiver);
+        if ((ret = pthread_join(relay->sender, NULL)) != 0) {
+            log_printf(ERROR, "relay_clean_up: pthread_join on sender failed -- error: %d", ret);
+        }
+        if ((ret = pthread_join(relay->receiver, NULL)) != 0) {
+            log_printf(ERROR, "relay_clean_up: pthread_join on receiver failed -- error: %d", ret);
+        }
+    } else if (relay->watched) {
+        // Stop watching the device before its file descriptor is closed and possibly reused
+        epoll_ctl(relay->worker->epoll_fd, EPOLL_CTL_DEL, relay->file_descriptor, NULL);
+        relay->watched = false;
     }
 
     // Disconnect the device from shared memory if it's connected
@@ -382,14 +713,15 @@ void relay_clean_up(relay_t* relay) {
 
     // Close the device
     serialport_close(relay->file_descriptor);
+    relay->file_descriptor = -1;
 
     // Mark that the device is disconnected in the global bitmap
     if ((ret = pthread_mutex_lock(&used_ports_lock))) {
         log_printf(ERROR, "relay_clean_up: used_ports_lock mutex lock failed with code %d", ret);
     }
-    uint32_t* used_ports = NULL;
+    bitmap_t* used_ports = NULL;
     get_used_ports_bitmap(&used_ports, relay->is_virtual, relay->is_usb);
-    *used_ports &= ~(1 << relay->port_num);  // Set bit to 0 to indicate unused
+    *used_ports &= ~BITMAP_BIT(relay->port_num);  // Set bit to 0 to indicate unused
 
     /// Clean up relay struct
     pthread_mutex_unlock(&used_ports_lock);
@@ -402,16 +734,37 @@ void relay_clean_up(relay_t* relay) {
     } else {
         log_printf(DEBUG, "Cleaned up %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
     }
-    free(relay);
+    if (relay->worker == NULL) {
+        free(relay);
+        return;
+    }
+
+    // Move the device from the worker's list to its dead list, since events in the current batch may still refer to it
+    worker_t* worker = relay->worker;
+    for (relay_t** link = &worker->devices; *link != NULL; link = &(*link)->next) {
+        if (*link == relay) {
+            *link = relay->next;
+            break;
+        }
+    }
+    relay->next = worker->dead;
+    worker->dead = relay;
+    pthread_mutex_lock(&worker->lock);
+    worker->num_devices--;
+    pthread_mutex_unlock(&worker->lock);
 }
 
 /**
- * Continuously sends DEVICE_PING and reads from shared memory to send DEVICE_WRITE
+ * Continuously reads from shared memory to send DEVICE_WRITE, and sends DEVICE_PING when nothing else was sent
+ * for PING_FREQ milliseconds
+ * Blocks on the device's command doorbell between iterations, so it only wakes up when
+ * a command is written or a DEVICE_PING is due.
  * Arguments:
  *    relay_cast: Uncasted relay_t struct containing device info
  */
 void* sender(void* relay_cast) {
     relay_t* relay = relay_cast;
+    realtime_thread("sender");
 
     // Wait until relayer gets an ACKNOWLEDGEMENT
     pthread_mutex_lock(&relay->relay_lock);
@@ -423,59 +776,50 @@ void* sender(void* relay_cast) {
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
 
     // Start doing work
-    uint32_t pmap[MAX_DEVICES + 1];
-    param_val_t* params = malloc(MAX_PARAMS * sizeof(param_val_t));  // Array of params to be filled on device_read()
+    param_val_t* params = malloc(MAX_PARAMS * sizeof(param_val_t));  // Array of params to be filled on device_claim_commands()
     if (params == NULL) {
         log_printf(FATAL, "sender: Failed to malloc");
         exit(1);
     }
-    message_t* msg;  // Message to build
-    int ret;         // Hold the value from send_message()
-    uint64_t last_sent_ping_time = millis();
+    uint32_t doorbell;  // Value of the device's command doorbell before checking for commands
+    relay->last_subscribe_time = millis();
+    relay->last_stats_time = relay->last_subscribe_time;
+    request_baud(relay);
+    uint64_t last_sent_msg_time;
+    uint64_t quiet_time;  // Milliseconds since the last message sent to the device
     while (1) {
         // Write to device if needed via a DEVICE_WRITE message
-        get_cmd_map(pmap);
-        if (pmap[0] & (1 << relay->shm_dev_idx)) {  // If bit i in pmap[0] != 0, there are values to write to device i
-            // Read the new parameter values to write from shared memory as DEV_HANDLER from the COMMAND stream
-            device_read(relay->shm_dev_idx, DEV_HANDLER, COMMAND, pmap[1 + relay->shm_dev_idx], params);
-            // Serialize and bulk transfer a DeviceWrite packet with PARAMS to the device
-            msg = make_device_write(relay->dev_id.type, pmap[1 + relay->shm_dev_idx], params);
-            ret = send_message(relay, msg);
-            if (ret != 0) {
-                log_printf(WARN, "Couldn't send DEVICE_WRITE to %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
-            }
-            destroy_message(msg);
-        }
-
-        // Send another DEVICE_PING every PING_FREQ milliseconds
-        if ((millis() - last_sent_ping_time) >= PING_FREQ) {
-            msg = make_ping();
-            ret = send_message(relay, msg);
-            if (ret != 0) {
-                log_printf(WARN, "Couldn't send DEVICE_PING to %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
-            }
-            // Update the timestamp at which we sent a DEVICE_PING
-            last_sent_ping_time = millis();
-            destroy_message(msg);
+        doorbell = get_cmd_doorbell(relay->shm_dev_idx);  // Must be read before claiming commands so that no command is missed
+        send_commands(relay, params);
+
+        update_subscription(relay);
+        publish_link_stats(relay);
+        // Send a DEVICE_PING if nothing else was sent for PING_FREQ milliseconds
+        last_sent_msg_time = atomic_load_explicit(&relay->last_sent_msg_time, memory_order_relaxed);
+        quiet_time = millis() - last_sent_msg_time;
+        if (quiet_time >= PING_FREQ) {
+            send_ping(relay);
+            quiet_time = 0;
         }
 
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
         pthread_testcancel();  // Cancellation point
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
-        // Sleep to throttle this loop; Determines how frequently we can send messages to the device
-        usleep(1000);
+        // Sleep until a new command is written for this device or the next DEVICE_PING is due
+        wait_for_cmd(relay->shm_dev_idx, doorbell, PING_FREQ - quiet_time);
     }
     return NULL;
 }
 
 /**
  * Continuously attempts to parse incoming data over serial and send to shared memory
- * Sets relay->last_received_msg_time upon receiving a message
+ * Sets relay->last_received_msg_time upon receiving a valid message (see handle_message())
  * Arguments:
  *    relay_cast: uncasted relay_t struct containing device info
  */
 void* receiver(void* relay_cast) {
     relay_t* relay = relay_cast;
+    realtime_thread("receiver");
 
     // Wait until relayer gets an ACKNOWLEDGEMENT
     pthread_mutex_lock(&relay->relay_lock);
@@ -502,32 +846,11 @@ void* receiver(void* relay_cast) {
             // Message was broken... try to read the next message
             continue;
         }
-        if (msg->message_id == DEVICE_DATA || msg->message_id == LOG || msg->message_id == DEVICE_PING) {
-            // Update last received message time
-            pthread_mutex_lock(&relay->relay_lock);
-            relay->last_received_msg_time = millis();
-            pthread_mutex_unlock(&relay->relay_lock);
-            // Handle message
-            if (msg->message_id == DEVICE_DATA) {
-                // If received DEVICE_DATA, write to shared memory
-                parse_device_data(relay->dev_id.type, msg, vals);  // Get param values from payload
-                device_write(relay->shm_dev_idx, DEV_HANDLER, DATA, *((uint32_t*) msg->payload), vals);
-            } else if (msg->message_id == LOG) {
-                // If received LOG, send it to the logger
-                log_printf(DEBUG, "[%s (0x%016llX)]: %s", get_device_name(relay->dev_id.type), relay->dev_id.uid, msg->payload);
-            }
+        if (handle_message(relay, msg, vals) != 0) {
             // Device is going to disconnect, so we clean up on our end
-        } else if (msg->message_id == RST) {
             relay_clean_up(relay);
             return NULL;
-        } else {  // Invalid message type
-            log_printf(WARN, "Dropped bad message (type %d) from %s (0x%016llX)", msg->message_id, get_device_name(relay->dev_id.type), relay->dev_id.uid);
-        }
-        // Now that the message is taken care of, clear the message
-        msg->message_id = 0x0;
-        msg->payload_length = 0;
-        msg->max_payload_length = MAX_PAYLOAD_SIZE;
-        memset(msg->payload, 0, MAX_PAYLOAD_SIZE);
+        }
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
         pthread_testcancel();  // Cancellation point
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
@@ -535,37 +858,390 @@ void* receiver(void* relay_cast) {
     return NULL;
 }
 
+// **************************** EVENT LOOP MODE ***************************** //
+
+/**
+ * Starts the workers of event loop mode and the thread that wakes them up when commands are written
+ * Arguments:
+ *    n: The number of workers to start, from 1 to MAX_WORKERS
+ */
+void start_workers(int n) {
+    struct itimerspec tick = {0};
+    tick.it_value.tv_nsec = EVENT_TICK * 1000000;
+    tick.it_interval.tv_nsec = EVENT_TICK * 1000000;
+    for (int i = 0; i < n; i++) {
+        worker_t* worker = &workers[i];
+        worker->epoll_fd = epoll_create1(0);
+        worker->timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+        worker->wake_fd = eventfd(0, 0);
+        if (worker->epoll_fd == -1 || worker->timer_fd == -1 || worker->wake_fd == -1 || timerfd_settime(worker->timer_fd, 0, &tick, NULL) == -1) {
+            log_printf(FATAL, "start_workers: Couldn't create file descriptors for worker %d--%s", i, strerror(errno));
+            exit(1);
+        }
+        // The timer and eventfd are told apart from devices by pointing at the worker's own fields
+        struct epoll_event timer_event = {.events = EPOLLIN, .data.ptr = &worker->timer_fd};
+        struct epoll_event wake_event = {.events = EPOLLIN, .data.ptr = &worker->wake_fd};
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->timer_fd, &timer_event) == -1 || epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->wake_fd, &wake_event) == -1) {
+            log_printf(FATAL, "start_workers: Couldn't watch file descriptors of worker %d--%s", i, strerror(errno));
+            exit(1);
+        }
+        if (pthread_mutex_init(&worker->lock, NULL) != 0) {
+            log_printf(FATAL, "start_workers: Couldn't init lock of worker %d", i);
+            exit(1);
+        }
+        worker->pending = NULL;
+        worker->num_devices = 0;
+        worker->devices = NULL;
+        worker->dead = NULL;
+        if (pthread_create(&worker->thread, NULL, event_loop, worker) != 0) {
+            log_printf(FATAL, "start_workers: Couldn't spawn thread for worker %d", i);
+            exit(1);
+        }
+    }
+    num_workers = n;
+
+    pthread_t waker;
+    if (pthread_create(&waker, NULL, command_waker, NULL) != 0) {
+        log_printf(FATAL, "start_workers: Couldn't spawn thread for COMMAND_WAKER");
+        exit(1);
+    }
+    log_printf(INFO, "Handling devices with %d event loop(s)", n);
+}
+
+/**
+ * Helper function for event_loop()
+ * Starts watching the devices handed over by communicate() and sends each a DEVICE_PING,
+ * which must be answered with an ACKNOWLEDGEMENT within TIMEOUT milliseconds (see verify_device())
+ * Their file descriptors are made non-blocking, so that a device that can't keep up doesn't hold up the others
+ * Arguments:
+ *    worker: The worker to pick up new devices for
+ */
+static void watch_pending(worker_t* worker) {
+    pthread_mutex_lock(&worker->lock);
+    relay_t* pending = worker->pending;
+    worker->pending = NULL;
+    pthread_mutex_unlock(&worker->lock);
+    char port_name[MAX_PORT_NAME_SIZE];
+
+    while (pending != NULL) {
+        relay_t* relay = pending;
+        pending = relay->next;
+        relay->next = worker->devices;
+        worker->devices = relay;
+
+        int flags = fcntl(relay->file_descriptor, F_GETFL);
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = relay};
+        if (flags == -1 || fcntl(relay->file_descriptor, F_SETFL, flags | O_NONBLOCK) == -1
+            || epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, relay->file_descriptor, &event) == -1) {
+            construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
+            log_printf(ERROR, "watch_pending: Couldn't watch %s--%s", port_name, strerror(errno));
+            relay_clean_up(relay);
+            continue;
+        }
+        relay->watched = true;
+
+        // Send a CHECKSUM_OFFER and a DEVICE_PING
+        relay->verify_deadline = millis() + TIMEOUT;
+        if (send_verify_request(relay) != 0) {
+            reject_device(relay);
+        }
+    }
+}
+
+/**
+ * Helper function for event_loop(), called every EVENT_TICK milliseconds
+ * Rejects devices that didn't send an ACKNOWLEDGEMENT in time, sends DEVICE_PINGs over links that have been quiet,
+ * and every POLL_INTERVAL cleans up after devices that disconnected or timed out (see relayer() and sender())
+ * Arguments:
+ *    worker: The worker whose devices to check
+ */
+static void event_tick(worker_t* worker) {
+    uint64_t now = millis();
+    uint64_t last_sent_msg_time;
+    relay_t* next;
+    for (relay_t* relay = worker->devices; relay != NULL; relay = next) {
+        next = relay->next;  // RELAY may be cleaned up below
+        if (relay->shm_dev_idx == -1) {
+            // Still waiting for an ACKNOWLEDGEMENT
+            if (now >= relay->verify_deadline) {
+                char port_name[MAX_PORT_NAME_SIZE];
+                construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
+                log_printf(WARN, "Timed out when waiting for ACK from %s!", port_name);
+                log_printf(DEBUG, "Didn't receive ACK");
+                reject_device(relay);
+            }
+            continue;
+        }
+        update_subscription(relay);
+        publish_link_stats(relay);
+        // Send a DEVICE_PING if nothing else was sent for PING_FREQ milliseconds
+        last_sent_msg_time = atomic_load_explicit(&relay->last_sent_msg_time, memory_order_relaxed);
+        if (millis() - last_sent_msg_time >= PING_FREQ) {
+            send_ping(relay);
+        }
+        // If the device disconnects or times out, clean up
+        if (now - relay->last_checked_time >= POLL_INTERVAL / 1000) {
+            relay->last_checked_time = now;
+            if (check_device(relay) != 0) {
+                relay_clean_up(relay);
+            }
+        }
+    }
+}
+
+/**
+ * Helper function for receive_events()
+ * Writes as much of a device's send queue as its file descriptor takes, and stops waiting for EPOLLOUT once it's empty
+ * Arguments:
+ *    relay: Contains the file descriptor and the send queue
+ */
+static void send_queued(relay_t* relay) {
+    ssize_t transferred = write(relay->file_descriptor, relay->tx_queue, relay->tx_queued);
+    if (transferred > 0) {
+        memmove(relay->tx_queue, &relay->tx_queue[transferred], relay->tx_queued - transferred);
+        relay->tx_queued -= transferred;
+    }
+    if (relay->tx_queued == 0) {
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = relay};
+        epoll_ctl(relay->worker->epoll_fd, EPOLL_CTL_MOD, relay->file_descriptor, &event);
+    }
+}
+
+/**
+ * Helper function for receive_events()
+ * Handles every complete message in a device's receive buffer the way receiver()
+ * (or verify_device() and relayer(), for a device that isn't verified yet) would
+ * Arguments:
+ *    relay: Struct containing device info and the receive buffer
+ *    msg: An empty message to parse the received data into
+ *    vals: Array of MAX_PARAMS params to be used by handle_message() and send_commands()
+ */
+static void receive_buffered(relay_t* relay, message_t* msg, param_val_t* vals) {
+    int ret;
+    while ((ret = next_message(relay, msg)) != -1) {
+        if (relay->shm_dev_idx == -1) {
+            // The first message received must be a perfectly constructed ACKNOWLEDGEMENT
+            if (ret != 0) {
+                log_printf(DEBUG, "Didn't receive ACK");
+            }
+            if (ret != 0 || accept_ack(relay, msg) != 0) {
+                reject_device(relay);
+                return;
+            }
+            if (connect_device(relay) != 0) {
+                relay_clean_up(relay);
+                return;
+            }
+            relay->last_checked_time = millis();
+            relay->last_subscribe_time = relay->last_checked_time;
+            relay->last_stats_time = relay->last_checked_time;
+            request_baud(relay);
+            send_commands(relay, vals);
+        } else if (ret == 0 && handle_message(relay, msg, vals) != 0) {
+            // Device is going to disconnect, so we clean up on our end
+            relay_clean_up(relay);
+            return;
+        }
+    }
+}
+
+/**
+ * Helper function for event_loop()
+ * Sends what's queued for a device once its file descriptor is ready for it (see send_queued()), then
+ * reads what the device sent into its receive buffer and handles the complete messages in it
+ * On EOF or an error, stops watching the device, which is then cleaned up once it
+ * disconnects or times out (or right away if it isn't verified yet)
+ * Arguments:
+ *    relay: Struct containing device info
+ *    events: The epoll events that occurred on the device's file descriptor
+ *    msg: An empty message to parse the received data into
+ *    vals: Array of MAX_PARAMS params to be used by handle_message() and send_commands()
+ */
+static void receive_events(relay_t* relay, uint32_t events, message_t* msg, param_val_t* vals) {
+    if (relay->file_descriptor == -1) {
+        return;  // Cleaned up earlier in this batch of events
+    }
+    if (events & EPOLLOUT) {
+        send_queued(relay);
+        if (!(events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+            return;
+        }
+    }
+    if (events & EPOLLIN) {
+        ssize_t num_bytes_read = read_available(relay);
+        if (num_bytes_read > 0) {
+            receive_buffered(relay, msg, vals);
+            return;
+        } else if (num_bytes_read == -1 && (errno == EINTR || errno == EAGAIN)) {
+            return;
+        } else if (num_bytes_read == -1) {
+            log_printf(ERROR, "receive_events: error reading from file: %s", strerror(errno));
+        }
+    }
+    epoll_ctl(relay->worker->epoll_fd, EPOLL_CTL_DEL, relay->file_descriptor, NULL);
+    relay->watched = false;
+    if (relay->shm_dev_idx == -1) {
+        log_printf(DEBUG, "Didn't receive ACK");
+        reject_device(relay);
+    }
+}
+
+/**
+ * Communicates with all devices of a worker from one epoll event loop, in place of
+ * the relayer, sender, and receiver threads of each device
+ *  On wakeup: starts verifying newly handed over devices and sends new commands in DEVICE_WRITEs
+ *  Every EVENT_TICK milliseconds: sends DEVICE_PINGs over quiet links and checks for timeouts and disconnects
+ *  When a device sends data: handles the messages received
+ * Arguments:
+ *    worker_cast: Uncasted worker_t struct of the worker
+ */
+void* event_loop(void* worker_cast) {
+    worker_t* worker = worker_cast;
+    realtime_thread("event loop");
+
+    // An empty message to parse the received data into
+    message_t* msg = make_empty(MAX_PAYLOAD_SIZE);
+    // An array of parameter values, filled from DEVICE_DATA payloads and on device_claim_commands()
+    param_val_t* vals = malloc(MAX_PARAMS * sizeof(param_val_t));
+    if (vals == NULL) {
+        log_printf(FATAL, "event_loop: Failed to malloc");
+        exit(1);
+    }
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t count;  // Number of expirations or wakeups read from TIMER_FD or WAKE_FD
+    while (1) {
+        int num_events = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, -1);
+        if (num_events == -1 && errno != EINTR) {
+            log_printf(ERROR, "event_loop: epoll_wait failed--%s", strerror(errno));
+        }
+        for (int i = 0; i < num_events; i++) {
+            if (events[i].data.ptr == &worker->timer_fd) {
+                if (read(worker->timer_fd, &count, sizeof(count)) == sizeof(count)) {
+                    event_tick(worker);
+                }
+            } else if (events[i].data.ptr == &worker->wake_fd) {
+                if (read(worker->wake_fd, &count, sizeof(count)) == sizeof(count)) {
+                    watch_pending(worker);
+                    // Claim and send the new commands of every connected device
+                    for (relay_t* relay = worker->devices; relay != NULL; relay = relay->next) {
+                        if (relay->shm_dev_idx != -1) {
+                            send_commands(relay, vals);
+                        }
+                    }
+                }
+            } else {
+                receive_events(events[i].data.ptr, events[i].events, msg, vals);
+            }
+        }
+        // Free the devices cleaned up in this batch, now that no event refers to them
+        while (worker->dead != NULL) {
+            relay_t* relay = worker->dead;
+            worker->dead = relay->next;
+            free(relay);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Wakes up every worker whenever a command is written to any device, since epoll can't watch
+ * the command doorbells in shared memory
+ * Arguments:
+ *    args: Unused
+ */
+void* command_waker(void* args) {
+    realtime_thread("command waker");
+    uint32_t doorbell = get_any_cmd_doorbell();
+    uint64_t one = 1;
+    while (1) {
+        if (wait_for_any_cmd(doorbell, TIMEOUT) != 0) {
+            continue;
+        }
+        doorbell = get_any_cmd_doorbell();  // Must be read before waking the workers so that no command is missed
+        for (int i = 0; i < num_workers; i++) {
+            if (write(workers[i].wake_fd, &one, sizeof(one)) != sizeof(one)) {
+                log_printf(ERROR, "command_waker: Couldn't wake worker %d--%s", i, strerror(errno));
+            }
+        }
+    }
+    return NULL;
+}
+
 // ************************** DEVICE COMMUNICATION ************************** //
 
+/**
+ * Helper function for send_message() in event loop mode
+ * Writes as much of the encoded message in relay->tx_buf as the non-blocking file descriptor takes, and queues the rest
+ * to be sent on EPOLLOUT. Nothing is written while bytes are queued, so that messages are sent in order.
+ * A message that doesn't fit in the queue is dropped whole and counted in relay->tx_drops; the rest of a partly
+ * written message always fits, since the queue is empty when anything is written.
+ * Arguments:
+ *    relay: Contains the file descriptor and the send queue
+ *    len: Number of bytes in relay->tx_buf
+ * Returns:
+ *    LEN if the message was written or queued
+ *    -1 if it was dropped, or couldn't be written
+ */
+static int queue_message(relay_t* relay, int len) {
+    ssize_t transferred = 0;
+    if (relay->tx_queued == 0) {
+        transferred = write(relay->file_descriptor, relay->tx_buf, len);
+        if (transferred == -1 && errno != EAGAIN && errno != EINTR) {
+            return -1;
+        } else if (transferred == -1) {
+            transferred = 0;
+        }
+    }
+    if (transferred == len) {
+        return len;
+    }
+    if (relay->tx_queued + len - transferred > TX_QUEUE_SIZE) {
+        atomic_fetch_add_explicit(&relay->tx_drops, 1, memory_order_relaxed);
+        return -1;
+    }
+    if (relay->tx_queued == 0 && relay->watched) {
+        struct epoll_event event = {.events = EPOLLIN | EPOLLOUT, .data.ptr = relay};
+        epoll_ctl(relay->worker->epoll_fd, EPOLL_CTL_MOD, relay->file_descriptor, &event);
+    }
+    memcpy(&relay->tx_queue[relay->tx_queued], &relay->tx_buf[transferred], len - transferred);
+    relay->tx_queued += len - transferred;
+    return len;
+}
+
 /**
  * Helper function for sender()
  * Serializes, encodes, and sends a message
+ * In event loop mode, the file descriptor is non-blocking: what it isn't ready for is queued (see queue_message())
+ * Sets relay->last_sent_msg_time if it was sent, since any message tells the device that dev handler is still there,
+ * and counts it in the link statistics
  * Arguments:
  *    relay: Contains the file descriptor
  *    msg: The message to be sent
  * Returns:
  *    0 if successful
- *    -1 if couldn't write all the bytes
+ *    -1 if couldn't write all the bytes (or, in event loop mode, queue them)
  */
 int send_message(relay_t* relay, message_t* msg) {
-    int len = calc_max_cobs_msg_length(msg);
-    uint8_t* data = malloc(len);
-    if (data == NULL) {
-        log_printf(FATAL, "send_message: Failed to malloc");
-        exit(1);
+    // Encode into the relay's buffer; only one thread sends to a device at a time
+    int len = message_to_bytes(msg, relay->tx_buf, MAX_COBS_MSG_LENGTH, relay->checksum);
+    if (len == -1) {
+        log_printf(WARN, "Couldn't encode message (type %d) to %s (0x%016llX)", msg->message_id, get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        return -1;
     }
-    len = message_to_bytes(msg, data, len);
-    int transferred = writen(relay->file_descriptor, data, len);
+    int transferred = (relay->worker == NULL) ? writen(relay->file_descriptor, relay->tx_buf, len) : queue_message(relay, len);
     if (transferred != len) {
-        log_printf(WARN, "Sent only %d out of %d bytes to %d (0x%016llX)\n", transferred, len, get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        log_printf(WARN, "Sent only %d out of %d bytes to %s (0x%016llX)\n", transferred, len, get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        return -1;
     }
-    free(data);
-    return (transferred == len) ? 0 : -1;
+    atomic_store_explicit(&relay->last_sent_msg_time, millis(), memory_order_relaxed);
+    atomic_fetch_add_explicit(&relay->bytes_out, len, memory_order_relaxed);
+    atomic_fetch_add_explicit(&relay->frames_out, 1, memory_order_relaxed);
+    return 0;
 }
 
 /**
  * Helper function for receiver()
- * Continuously reads from stream until reads the next message, then attempts to parse
+ * Reads from stream in bulk until the receive buffer holds the next message, then attempts to parse
  * This function blocks until it reads a (possibly broken) message
  * Arguments:
  *    relay: Contains the file descriptor and port number of the device
@@ -577,95 +1253,169 @@ int send_message(relay_t* relay, message_t* msg) {
  *    3 on timeout
  */
 int receive_message(relay_t* relay, message_t* msg) {
-    uint8_t last_byte_read = 0;  // Variable to temporarily hold a read byte
-    int num_bytes_read = 0;
     char port_name[MAX_PORT_NAME_SIZE];
     construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
+    int ret;
+    ssize_t num_bytes_read;
 
-    if (relay->dev_id.uid == (uint64_t) -1) {
-        /* Haven't verified device is lowcar yet
-         * read() is set to timeout while waiting for an ACK (see serialport_open())*/
+    // Most of the time, the last read() already got the next message (and possibly more)
+    while ((ret = next_message(relay, msg)) == -1) {
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-        num_bytes_read = read(relay->file_descriptor, &last_byte_read, 1);
+        num_bytes_read = read_available(relay);  // Waiting for bytes can block
+        if (num_bytes_read == 0 && relay->dev_id.uid != (uint64_t) -1) {
+            // received EOF so sleep to make device disconnected
+            sleep(TIMEOUT / 1000 + 1);
+        }
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
-        if (num_bytes_read == -1) {
-            log_printf(ERROR, "receive_message: Error on read() for ACK--%s", strerror(errno));
-            return 3;
-        } else if (num_bytes_read == 0) {  // read() returned due to timeout
-            log_printf(WARN, "Timed out when waiting for ACK from %s!", port_name);
-            return 3;
-        } else if (last_byte_read != 0x00) {
-            // If the first thing received isn't a perfect ACK, we won't accept it
-            log_printf(WARN, "Attempting to read delimiter but got 0x%02X from %s\n", last_byte_read, port_name);
+        if (relay->dev_id.uid == (uint64_t) -1) {
+            /* Haven't verified device is lowcar yet
+             * read() is set to timeout while waiting for an ACK (see serialport_open())*/
+            if (num_bytes_read == -1) {
+                log_printf(ERROR, "receive_message: Error on read() for ACK--%s", strerror(errno));
+                return 3;
+            } else if (num_bytes_read == 0) {  // read() returned due to timeout
+                log_printf(WARN, "Timed out when waiting for ACK from %s!", port_name);
+                return 3;
+            }
+        } else if (num_bytes_read == 0) {
+            return 1;
+        } else if (num_bytes_read == -1 && errno != EINTR && errno != EAGAIN) {
+            log_printf(ERROR, "receive_message: error reading from file: %s", strerror(errno));
             return 1;
         }
-    } else {  // Receiving from a verified device
-        // Keep reading a byte until we get the delimiter byte
-        while (1) {
-            pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-            num_bytes_read = readn(relay->file_descriptor, &last_byte_read, 1);  // Waiting for first byte can block
-            if (num_bytes_read == 0) {
-                // received EOF so sleep to make device disconnected
-                sleep(TIMEOUT / 1000 + 1);
-                return 1;
-            } else if (num_bytes_read == -1) {
-                log_printf(ERROR, "receive_message: error reading from file: %s", strerror(errno));
-                return 1;
-            }
-            pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
-            if (last_byte_read == 0x00) {
-                // Found start of a message
-                break;
-            }
-            // If we were able to read a byte but it wasn't the delimiter
-            log_printf(WARN, "Attempting to read delimiter but got 0x%02X from %s\n", last_byte_read, port_name);
+    }
+    return ret;
+}
+
+/**
+ * Reads as many bytes as are available from a device (blocking until there is at least one) into
+ * its receive buffer, after moving the bytes of the next, incomplete message to the front of the buffer
+ * Arguments:
+ *    relay: Contains the file descriptor and the receive buffer of the device
+ * Returns:
+ *    The number of bytes read
+ *    0 on EOF (or timeout while waiting for an ACK)
+ *    -1 on error and sets errno
+ */
+ssize_t read_available(relay_t* relay) {
+    if (relay->rx_start > 0) {
+        memmove(relay->rx_buf, &relay->rx_buf[relay->rx_start], relay->rx_len - relay->rx_start);
+        relay->rx_len -= relay->rx_start;
+        relay->rx_start = 0;
+    }
+    ssize_t num_bytes_read = read(relay->file_descriptor, &relay->rx_buf[relay->rx_len], RX_BUF_SIZE - relay->rx_len);
+    atomic_fetch_add_explicit(&relay->reads, 1, memory_order_relaxed);
+    if (num_bytes_read > 0) {
+        relay->rx_len += num_bytes_read;
+        atomic_fetch_add_explicit(&relay->bytes_in, num_bytes_read, memory_order_relaxed);
+    }
+    return num_bytes_read;
+}
+
+/**
+ * Takes the next message out of a device's receive buffer and attempts to parse it (decoding it in place)
+ * Bytes before the next delimiter are skipped with a single warning once the delimiter is found, however many reads
+ * they took to arrive, and so is a message cut short by a delimiter
+ * Skipped bytes, dropped messages, and valid messages are counted in the link statistics
+ * Arguments:
+ *    relay: Contains the receive buffer and port number of the device
+ *    msg: The message_t *to be populated with the parsed data (if successful)
+ * Returns:
+ *    0 on successful parse
+ *    1 on broken message
+ *    2 on incorrect checksum
+ *    -1 if the receive buffer doesn't hold a complete message yet
+ */
+int next_message(relay_t* relay, message_t* msg) {
+    uint8_t* data = &relay->rx_buf[relay->rx_start];
+    uint16_t num_bytes = relay->rx_len - relay->rx_start;
+    char port_name[MAX_PORT_NAME_SIZE];
+
+    // Skip to the next delimiter
+    uint8_t* delimiter = memchr(data, 0x00, num_bytes);
+    uint16_t num_skipped = (delimiter == NULL) ? num_bytes : delimiter - data;
+    if (num_skipped > 0) {
+        relay->rx_start += num_skipped;
+        relay->rx_skipped += num_skipped;
+        atomic_fetch_add_explicit(&relay->resync_bytes, num_skipped, memory_order_relaxed);
+        data = delimiter;
+        num_bytes -= num_skipped;
+    }
+    if (relay->rx_skipped > 0 && (delimiter != NULL || relay->dev_id.uid == (uint64_t) -1)) {
+        construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
+        log_printf(WARN, "Attempting to read delimiter but skipped %u bytes from %s\n", relay->rx_skipped, port_name);
+        relay->rx_skipped = 0;
+        if (relay->dev_id.uid == (uint64_t) -1) {
+            // If the first thing received isn't a perfect ACK, we won't accept it
+            return 1;
         }
     }
 
-    // Read the next byte, which tells how many bytes left are in the message
-    uint8_t cobs_len;
-    num_bytes_read = readn(relay->file_descriptor, &cobs_len, 1);
-    if (num_bytes_read != 1) {
-        return 1;
-    } else if (cobs_len > (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + CHECKSUM_SIZE + 1)) {  // + 1 for cobs encoding overhead
+    // The next byte tells how many bytes left are in the message
+    if (num_bytes < DELIMITER_SIZE + COBS_LENGTH_SIZE) {
+        return -1;
+    }
+    uint8_t cobs_len = data[1];
+    if (cobs_len > (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + CHECKSUM_SIZE(relay->checksum) + 1)) {  // + 1 for cobs encoding overhead
         // Got some weird message that is unusually long (longer than a valid message with the longest payload)
         log_printf(WARN, "Received a cobs length that is too large");
+        relay->rx_start += DELIMITER_SIZE + COBS_LENGTH_SIZE;
+        atomic_fetch_add_explicit(&relay->decode_errors, 1, memory_order_relaxed);
         return 1;
-    } else if (cobs_len < (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + CHECKSUM_SIZE + 1)) {  // + 1 for cobs encoding overhead
+    } else if (cobs_len < (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + CHECKSUM_SIZE(relay->checksum) + 1)) {  // + 1 for cobs encoding overhead
         // Got some weird message that is unusually short (shorter than a DEVICE_PING with no payload)
         log_printf(WARN, "Received a cobs length that is too small");
+        relay->rx_start += DELIMITER_SIZE + COBS_LENGTH_SIZE;
+        atomic_fetch_add_explicit(&relay->decode_errors, 1, memory_order_relaxed);
         return 1;
     }
 
-    // Allocate buffer to read message into
-    uint8_t* data = malloc(DELIMITER_SIZE + COBS_LENGTH_SIZE + cobs_len);
-    if (data == NULL) {
-        log_printf(FATAL, "receive_message: Failed to malloc");
-        exit(1);
-    }
-    data[0] = 0x00;
-    data[1] = cobs_len;
-
-    // Read the message
-    num_bytes_read = readn(relay->file_descriptor, &data[2], cobs_len);
-    if (num_bytes_read != cobs_len) {
-        log_printf(WARN, "Read only %d out of %d bytes from %s (0x%016llX)\n", num_bytes_read, cobs_len, get_device_name(relay->dev_id.type), relay->dev_id.uid);
-        free(data);
+    // Resynchronize on a delimiter inside the message, since cobs encoded messages have none
+    uint16_t num_available = (num_bytes - DELIMITER_SIZE - COBS_LENGTH_SIZE < cobs_len) ? num_bytes - DELIMITER_SIZE - COBS_LENGTH_SIZE : cobs_len;
+    delimiter = memchr(&data[2], 0x00, num_available);
+    if (delimiter != NULL) {
+        log_printf(WARN, "Read only %d out of %d bytes from %s (0x%016llX)\n", (int) (delimiter - &data[2]), cobs_len, get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        relay->rx_start += delimiter - data;
+        atomic_fetch_add_explicit(&relay->decode_errors, 1, memory_order_relaxed);
         return 1;
+    } else if (num_available < cobs_len) {
+        return -1;
     }
 
     // Parse the message
-    int ret = parse_message(data, msg);
-    free(data);
+    relay->rx_start += DELIMITER_SIZE + COBS_LENGTH_SIZE + cobs_len;
+    int ret = parse_message(data, msg, relay->checksum);
     if (ret != 0) {
+        construct_port_name(port_name, relay->is_virtual, relay->is_usb, relay->port_num);
         log_printf(WARN, "Couldn't parse message from %s\n", port_name);
+        atomic_fetch_add_explicit((ret == 1) ? &relay->checksum_errors : &relay->decode_errors, 1, memory_order_relaxed);
         return 2;
     }
+    atomic_fetch_add_explicit(&relay->frames_in, 1, memory_order_relaxed);
     return 0;
 }
 
 /**
- * Sends a DEVICE_PING to the device and waits for an ACKNOWLEDGEMENT
+ * Helper function for verify_device() and watch_pending()
+ * Offers the checksums that dev handler supports in a CHECKSUM_OFFER, then sends the DEVICE_PING to be acknowledged
+ * Arguments:
+ *    relay: Struct containing all relevant port information
+ * Returns:
+ *    0 on success
+ *    nonzero if either message couldn't be sent
+ */
+int send_verify_request(relay_t* relay) {
+    fill_checksum_offer(&relay->tx_msg);
+    if (send_message(relay, &relay->tx_msg) != 0) {
+        return 1;
+    }
+    fill_ping(&relay->tx_msg);
+    relay->request_time = micros();
+    return send_message(relay, &relay->tx_msg);
+}
+
+/**
+ * Sends a CHECKSUM_OFFER and a DEVICE_PING to the device and waits for an ACKNOWLEDGEMENT
  * The first message received must be a perfectly constructed ACKNOWLEDGEMENT
  * Arguments:
  *    relay: Struct containing all relevant port information.
@@ -676,10 +1426,8 @@ int receive_message(relay_t* relay, message_t* msg) {
  *    2 if ACKNOWLEDGEMENT wasn't received
  */
 int verify_device(relay_t* relay) {
-    // Send a DEVICE_PING
-    message_t* ping = make_ping();
-    int ret = send_message(relay, ping);
-    destroy_message(ping);
+    // Send a CHECKSUM_OFFER and a DEVICE_PING
+    int ret = send_verify_request(relay);
     if (ret != 0) {
         return 1;
     }
@@ -691,9 +1439,28 @@ int verify_device(relay_t* relay) {
         log_printf(DEBUG, "Didn't receive ACK");
         destroy_message(ack);
         return 2;
-    } else if (ack->message_id != ACKNOWLEDGEMENT) {
+    }
+    ret = accept_ack(relay, ack);
+    destroy_message(ack);
+    return ret;
+}
+
+/**
+ * Helper function for verify_device()
+ * Checks that the first message received from a device is an ACKNOWLEDGEMENT and, if so, accepts the device
+ * A device that supports other checksums than CHECKSUM_XOR appends the one that it picked to the ACKNOWLEDGEMENT
+ * Arguments:
+ *    relay: Struct containing all relevant port information.
+ *           dev_id field will be populated if ACK is an ACKNOWLEDGEMENT
+ *    ack: The first message received from the device
+ * Returns:
+ *    0 if ACK is an ACKNOWLEDGEMENT. Sets relay->dev_id, relay->checksum, and relay->handshake_rtt_us
+ *    2 if ACK isn't an ACKNOWLEDGEMENT, or picks a checksum that dev handler doesn't support
+ *    -1 if the serial port options couldn't be updated
+ */
+int accept_ack(relay_t* relay, message_t* ack) {
+    if (ack->message_id != ACKNOWLEDGEMENT) {
         log_printf(DEBUG, "Message is not an ACK, but of type %d", ack->message_id);
-        destroy_message(ack);
         return 2;
     }
 
@@ -702,7 +1469,7 @@ int verify_device(relay_t* relay) {
     /* Set serial port options to allow read() to block indefinitely
      * We expect the lowcar device to continuously send data
      * In serialport_open(), we set read() to timeout specifically for waiting for ACK */
-    if (!relay->is_virtual) {
+    if (relay->is_serial) {
         struct termios toptions;
         if (tcgetattr(relay->file_descriptor, &toptions) < 0) {  // Get current options
             log_printf(ERROR, "verify_lowcar: Couldn't get term attributes for %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
@@ -721,12 +1488,302 @@ int verify_device(relay_t* relay) {
     memcpy(&relay->dev_id.type, &ack->payload[0], 1);
     memcpy(&relay->dev_id.year, &ack->payload[1], 1);
     memcpy(&relay->dev_id.uid, &ack->payload[2], 8);
+    if (ack->payload_length > DEVICE_ID_SIZE) {
+        uint8_t checksum = ack->payload[DEVICE_ID_SIZE];
+        if (checksum >= NUM_CHECKSUMS || !(SUPPORTED_CHECKSUMS & (1 << checksum))) {
+            log_printf(WARN, "%s (0x%016llX) picked unsupported checksum %d", get_device_name(relay->dev_id.type), relay->dev_id.uid, checksum);
+            return 2;
+        }
+        relay->checksum = checksum;
+    }
     log_printf(INFO, "Connected %s (0x%016llX) from year %d!", get_device_name(relay->dev_id.type), relay->dev_id.uid, relay->dev_id.year);
-    relay->last_received_msg_time = millis();
-    destroy_message(ack);
+    atomic_store_explicit(&relay->last_received_msg_time, millis(), memory_order_relaxed);
+    atomic_store_explicit(&relay->handshake_rtt_us, micros() - relay->request_time, memory_order_relaxed);
     return 0;
 }
 
+/**
+ * Sends a DEVICE_PING to a connected device
+ * Arguments:
+ *    relay: Struct containing device info
+ */
+void send_ping(relay_t* relay) {
+    fill_ping(&relay->tx_msg);
+    if (send_message(relay, &relay->tx_msg) != 0) {
+        log_printf(WARN, "Couldn't send DEVICE_PING to %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+    }
+}
+
+/**
+ * Claims the new parameter values to write to a connected device from the COMMAND stream,
+ * and sends them in a DEVICE_WRITE if there are any
+ * Arguments:
+ *    relay: Struct containing device info
+ *    params: Array of MAX_PARAMS params to be filled on device_claim_commands()
+ */
+void send_commands(relay_t* relay, param_val_t* params) {
+    bitmap_t params_to_send = device_claim_commands(relay->shm_dev_idx, params);
+    if (params_to_send != 0) {
+        // Serialize and bulk transfer a DeviceWrite packet with PARAMS to the device
+        fill_device_write(&relay->tx_msg, relay->dev_id.type, params_to_send, params);
+        if (send_message(relay, &relay->tx_msg) != 0) {
+            log_printf(WARN, "Couldn't send DEVICE_WRITE to %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        }
+    }
+}
+
+/**
+ * Handles a message received from a connected device
+ * Sets relay->last_received_msg_time upon receiving any valid message, which tells us that the device is still there
+ * A SET_BAUD is the device's answer to request_baud()
+ * Arguments:
+ *    relay: Struct containing device info
+ *    msg: The received message
+ *    vals: Array of MAX_PARAMS params to be populated from DEVICE_DATA payloads and written to shared memory
+ * Returns:
+ *    0 if the message was handled or dropped
+ *    1 if the device sent RST and needs to be cleaned up
+ */
+int handle_message(relay_t* relay, message_t* msg, param_val_t* vals) {
+    // Update last received message time
+    atomic_store_explicit(&relay->last_received_msg_time, millis(), memory_order_relaxed);
+    if (msg->message_id == DEVICE_DATA || msg->message_id == LOG || msg->message_id == DEVICE_PING) {
+        // A valid message at the rate we switched to means that the device switched too
+        // RELAY_LOCK is taken only then, so that handling a message doesn't normally lock
+        if (relay->baud_state == BAUD_SWITCHED) {
+            pthread_mutex_lock(&relay->relay_lock);
+            if (relay->baud_state == BAUD_SWITCHED) {
+                relay->baud_state = BAUD_DONE;
+                log_printf(INFO, "%s (0x%016llX) switched to %u baud", get_device_name(relay->dev_id.type), relay->dev_id.uid, relay->baud_rate);
+            }
+            pthread_mutex_unlock(&relay->relay_lock);
+        }
+        // Handle message
+        if (msg->message_id == DEVICE_DATA) {
+            // If received DEVICE_DATA, write to shared memory
+            // A DEVICE_DATA without params (nothing changed) only tells us that the device is still there
+            bitmap_t params_received = parse_device_data(relay->dev_id.type, msg, vals);  // Get param values from payload
+            if (params_received != 0) {
+                device_write(relay->shm_dev_idx, DEV_HANDLER, DATA, params_received, vals);
+            }
+        } else if (msg->message_id == LOG) {
+            // If received LOG, send it to the logger
+            log_printf(DEBUG, "[%s (0x%016llX)]: %.*s", get_device_name(relay->dev_id.type), relay->dev_id.uid, (int) msg->payload_length, msg->payload);
+        }
+    } else if (msg->message_id == SET_BAUD) {
+        switch_baud(relay, msg);
+    } else if (msg->message_id == RST) {
+        return 1;
+    } else {  // Invalid message type
+        log_printf(WARN, "Dropped bad message (type %d) from %s (0x%016llX)", msg->message_id, get_device_name(relay->dev_id.type), relay->dev_id.uid);
+    }
+    return 0;
+}
+
+/**
+ * Asks a connected device on a serial port to switch to HIGH_BAUD_RATE by sending a SET_BAUD
+ * The rest of the negotiation happens in switch_baud(), handle_message(), and check_baud()
+ * Does nothing for a device on a socket, which has no baud rate
+ * Arguments:
+ *    relay: Struct containing device info
+ */
+void request_baud(relay_t* relay) {
+    if (!relay->is_serial) {
+        return;
+    }
+    // The echo may be received by another thread as soon as the SET_BAUD is sent
+    pthread_mutex_lock(&relay->relay_lock);
+    relay->baud_state = BAUD_REQUESTED;
+    relay->baud_deadline = millis() + BAUD_TIMEOUT;
+    relay->request_time = micros();
+    pthread_mutex_unlock(&relay->relay_lock);
+    fill_set_baud(&relay->tx_msg, HIGH_BAUD_RATE);
+    if (send_message(relay, &relay->tx_msg) != 0) {
+        log_printf(WARN, "Couldn't send SET_BAUD to %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+    }
+}
+
+/**
+ * Switches the serial port to the baud rate in a SET_BAUD echoed by a device, which switches right after sending it
+ * The device falls back to DEFAULT_BAUD_RATE if it doesn't receive a valid message at the new rate in time
+ * The time the device took to echo the SET_BAUD is kept as the link's handshake round trip time
+ * Arguments:
+ *    relay: Struct containing device info
+ *    echo: The SET_BAUD received from the device
+ */
+void switch_baud(relay_t* relay, message_t* echo) {
+    uint32_t baud_rate;
+    pthread_mutex_lock(&relay->relay_lock);
+    if (relay->baud_state != BAUD_REQUESTED || echo->payload_length != sizeof(baud_rate)) {
+        pthread_mutex_unlock(&relay->relay_lock);
+        log_printf(WARN, "Dropped unexpected SET_BAUD from %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        return;
+    }
+    memcpy(&baud_rate, echo->payload, sizeof(baud_rate));
+    atomic_store_explicit(&relay->handshake_rtt_us, micros() - relay->request_time, memory_order_relaxed);
+    if (set_baud_rate(relay->file_descriptor, baud_rate) != 0) {
+        relay->baud_state = BAUD_DONE;
+        log_printf(WARN, "Couldn't switch %s (0x%016llX) to %u baud", get_device_name(relay->dev_id.type), relay->dev_id.uid, baud_rate);
+    } else {
+        relay->baud_state = BAUD_SWITCHED;
+        relay->baud_rate = baud_rate;
+        relay->baud_deadline = millis() + BAUD_TIMEOUT;
+    }
+    pthread_mutex_unlock(&relay->relay_lock);
+}
+
+/**
+ * Gives up on negotiating HIGH_BAUD_RATE with a device if the current step took longer than BAUD_TIMEOUT
+ * If the serial port was already switched, it's switched back to DEFAULT_BAUD_RATE, as the device does on its end
+ * Arguments:
+ *    relay: Struct containing device info
+ */
+void check_baud(relay_t* relay) {
+    pthread_mutex_lock(&relay->relay_lock);
+    if (relay->baud_state != BAUD_DONE && millis() >= relay->baud_deadline) {
+        if (relay->baud_state == BAUD_REQUESTED) {
+            log_printf(DEBUG, "%s (0x%016llX) didn't answer SET_BAUD; staying at %u baud", get_device_name(relay->dev_id.type), relay->dev_id.uid, relay->baud_rate);
+        } else {
+            log_printf(WARN, "Nothing received from %s (0x%016llX) at %u baud; falling back to %u baud", get_device_name(relay->dev_id.type), relay->dev_id.uid, relay->baud_rate, DEFAULT_BAUD_RATE);
+            set_baud_rate(relay->file_descriptor, DEFAULT_BAUD_RATE);
+            relay->baud_rate = DEFAULT_BAUD_RATE;
+        }
+        relay->baud_state = BAUD_DONE;
+    }
+    pthread_mutex_unlock(&relay->relay_lock);
+}
+
+/**
+ * Every SUBSCRIBE_INTERVAL milliseconds, subscribes a connected device to just the params that executor or net handler
+ * read in the last INTEREST_TIMEOUT milliseconds, and sends a SUBSCRIBE if that changed
+ * Params read by executor are sent as often as they change, and those read only by net handler as often as it reads them.
+ * If the device is on a serial port whose link is busier than LINK_BUSY percent, the periods are doubled (up to
+ * MAX_THROTTLE times), and halved again once it's under LINK_IDLE percent.
+ * Waits until negotiating the baud rate is over, since a message sent while switching rates may be lost.
+ * Arguments:
+ *    relay: Struct containing device info
+ */
+void update_subscription(relay_t* relay) {
+    uint64_t now = millis();
+    uint64_t interval = now - relay->last_subscribe_time;
+    pthread_mutex_lock(&relay->relay_lock);
+    bool negotiating = relay->baud_state != BAUD_DONE;
+    uint32_t baud_rate = relay->baud_rate;
+    pthread_mutex_unlock(&relay->relay_lock);
+    if (interval < SUBSCRIBE_INTERVAL || negotiating) {
+        return;
+    }
+    relay->last_subscribe_time = now;
+
+    // Note which params were read since the last update, and how often net handler reads
+    bitmap_t params_read[NUM_READERS];
+    uint32_t num_reads[NUM_READERS];
+    device_collect_interest(relay->shm_dev_idx, params_read, num_reads);
+    for (int r = 0; r < NUM_READERS; r++) {
+        for (bitmap_t rest = params_read[r]; rest != 0;) {
+            relay->read_times[r][bitmap_pop(&rest)] = now;
+        }
+    }
+    if (num_reads[READER_NET_HANDLER] > 0) {
+        relay->net_read_period = (interval / num_reads[READER_NET_HANDLER] > 1) ? interval / num_reads[READER_NET_HANDLER] : 1;
+    }
+
+    // Throttle the device if the serial link is close to saturated
+    uint64_t bytes_in = atomic_load_explicit(&relay->bytes_in, memory_order_relaxed);
+    uint64_t rx_bytes = bytes_in - relay->sub_bytes_in;  // Bytes read from the device since the last update
+    relay->sub_bytes_in = bytes_in;
+    if (relay->is_serial) {
+        uint64_t load = rx_bytes * BITS_PER_BYTE * 1000 * 100 / (interval * baud_rate);  // Percent of the link's capacity
+        if (load >= LINK_BUSY && relay->throttle < MAX_THROTTLE) {
+            relay->throttle++;
+            log_printf(DEBUG, "Link to %s (0x%016llX) is %llu%% busy; throttling subscribed params by %d", get_device_name(relay->dev_id.type), relay->dev_id.uid, load, 1 << relay->throttle);
+        } else if (load < LINK_IDLE && relay->throttle > 0) {
+            relay->throttle--;
+        }
+    }
+
+    // Subscribe to the readable params that were read recently
+    bitmap_t pmap = 0;
+    uint16_t periods[MAX_PARAMS];
+    uint32_t period;
+    for (bitmap_t rest = get_readable_param_bitmap(relay->dev_id.type); rest != 0;) {
+        int i = bitmap_pop(&rest);
+        if (now - relay->read_times[READER_EXECUTOR][i] < INTEREST_TIMEOUT) {
+            period = 1;
+        } else if (now - relay->read_times[READER_NET_HANDLER][i] < INTEREST_TIMEOUT) {
+            period = relay->net_read_period;
+        } else {
+            continue;
+        }
+        period <<= relay->throttle;
+        periods[i] = (period > MAX_SUBSCRIBE_PERIOD) ? MAX_SUBSCRIBE_PERIOD : period;
+        pmap |= BITMAP_BIT(i);
+    }
+
+    // Send a SUBSCRIBE only if the subscription changed
+    bool changed = !relay->subscribed || pmap != relay->sub_params;
+    for (bitmap_t rest = pmap; rest != 0 && !changed;) {
+        int i = bitmap_pop(&rest);
+        changed = periods[i] != relay->sub_periods[i];
+    }
+    if (!changed) {
+        return;
+    }
+    fill_subscribe(&relay->tx_msg, pmap, periods);
+    if (send_message(relay, &relay->tx_msg) != 0) {
+        log_printf(WARN, "Couldn't send SUBSCRIBE to %s (0x%016llX)", get_device_name(relay->dev_id.type), relay->dev_id.uid);
+        return;
+    }
+    relay->subscribed = true;
+    relay->sub_params = pmap;
+    memcpy(relay->sub_periods, periods, sizeof(periods));
+}
+
+/**
+ * Every LINK_STATS_INTERVAL milliseconds, writes the link statistics of a connected device to shared memory
+ * The rates are over the time since the previous update; the write backlog is what the serial port or socket
+ * still holds of what was sent to the device
+ * Arguments:
+ *    relay: Struct containing device info
+ */
+void publish_link_stats(relay_t* relay) {
+    uint64_t now = millis();
+    uint64_t interval = now - relay->last_stats_time;
+    if (interval < LINK_STATS_INTERVAL) {
+        return;
+    }
+    relay->last_stats_time = now;
+
+    // Rates are the growth of each count since the last update
+    dev_link_stats_t* stats = &relay->link_stats;
+    uint64_t bytes_in = atomic_load_explicit(&relay->bytes_in, memory_order_relaxed);
+    uint64_t bytes_out = atomic_load_explicit(&relay->bytes_out, memory_order_relaxed);
+    uint64_t frames_in = atomic_load_explicit(&relay->frames_in, memory_order_relaxed);
+    uint64_t frames_out = atomic_load_explicit(&relay->frames_out, memory_order_relaxed);
+    stats->bytes_in_per_sec = (bytes_in - stats->bytes_in) * 1000 / interval;
+    stats->bytes_out_per_sec = (bytes_out - stats->bytes_out) * 1000 / interval;
+    stats->frames_in_per_sec = (frames_in - stats->frames_in) * 1000 / interval;
+    stats->frames_out_per_sec = (frames_out - stats->frames_out) * 1000 / interval;
+    stats->bytes_in = bytes_in;
+    stats->reads = atomic_load_explicit(&relay->reads, memory_order_relaxed);
+    stats->bytes_out = bytes_out;
+    stats->frames_in = frames_in;
+    stats->frames_out = frames_out;
+    stats->decode_errors = atomic_load_explicit(&relay->decode_errors, memory_order_relaxed);
+    stats->checksum_errors = atomic_load_explicit(&relay->checksum_errors, memory_order_relaxed);
+    stats->resync_bytes = atomic_load_explicit(&relay->resync_bytes, memory_order_relaxed);
+    stats->handshake_rtt_us = atomic_load_explicit(&relay->handshake_rtt_us, memory_order_relaxed);
+    stats->tx_drops = atomic_load_explicit(&relay->tx_drops, memory_order_relaxed);
+
+    // TIOCOUTQ is also SIOCOUTQ, so this works for virtual devices on sockets too
+    // In event loop mode, this is called by the worker, which also owns the bytes still in the send queue
+    int backlog;
+    stats->write_backlog = (ioctl(relay->file_descriptor, TIOCOUTQ, &backlog) == 0) ? backlog : 0;
+    stats->write_backlog += relay->tx_queued;
+
+    device_write_link_stats(relay->shm_dev_idx, stats);
+}
+
 // ************************* SOCKETS / SERIAL PORTS ************************* //
 
 /**
@@ -749,10 +1806,15 @@ int connect_socket(const char* socket_name) {
     struct sockaddr_un dev_socket_addr = {0};
     dev_socket_addr.sun_family = AF_UNIX;
     strcpy(dev_socket_addr.sun_path, socket_name);
-    if (connect(fd, (struct sockaddr*) &dev_socket_addr, sizeof(dev_socket_addr)) != 0) {
-        log_printf(ERROR, "connect_socket: Couldn't connect socket %s--%s", dev_socket_addr.sun_path, strerror(errno));
-        remove(socket_name);
-        return -1;
+    // A socket that was just created may not be listening yet, so retry a few times before giving up on it
+    for (int tries = 1; connect(fd, (struct sockaddr*) &dev_socket_addr, sizeof(dev_socket_addr)) != 0; tries++) {
+        if (errno != ECONNREFUSED || tries == SOCKET_CONNECT_TRIES) {
+            log_printf(ERROR, "connect_socket: Couldn't connect socket %s--%s", dev_socket_addr.sun_path, strerror(errno));
+            close(fd);
+            remove(socket_name);
+            return -1;
+        }
+        usleep(SOCKET_CONNECT_RETRY_WAIT);
     }
 
     // Set read() to timeout for up to TIMEOUT milliseconds
@@ -791,7 +1853,7 @@ int serialport_open(const char* port_name) {
         return -1;
     }
 
-    // Set the baudrate of communication to 115200 (same as on Arduino)
+    // Set the baudrate of communication to DEFAULT_BAUD_RATE (same as on Arduino until negotiated otherwise)
     speed_t brate = B115200;
     cfsetspeed(&toptions, brate);
 
@@ -820,6 +1882,52 @@ int serialport_open(const char* port_name) {
     return fd;
 }
 
+/**
+ * Changes the baud rate of a serial port opened via serialport_open(),
+ * after everything written to it so far has been sent
+ * Arguments:
+ *    fd: File descriptor obtained from serialport_open()
+ *    baud_rate: The new baud rate, one of the rates supported by termios from 115200 up
+ * Returns:
+ *    0 on success
+ *    -1 if BAUD_RATE isn't supported or the serial port options couldn't be updated
+ */
+int set_baud_rate(int fd, uint32_t baud_rate) {
+    speed_t brate;
+    switch (baud_rate) {
+        case 115200:
+            brate = B115200;
+            break;
+        case 230400:
+            brate = B230400;
+            break;
+        case 460800:
+            brate = B460800;
+            break;
+        case 500000:
+            brate = B500000;
+            break;
+        case 921600:
+            brate = B921600;
+            break;
+        case 1000000:
+            brate = B1000000;
+            break;
+        case 2000000:
+            brate = B2000000;
+            break;
+        default:
+            return -1;
+    }
+    struct termios toptions;
+    if (tcgetattr(fd, &toptions) < 0) {
+        return -1;
+    }
+    cfsetspeed(&toptions, brate);
+    // Flag TCSADRAIN waits for pending output to be sent at the old rate before switching
+    return (tcsetattr(fd, TCSADRAIN, &toptions) < 0) ? -1 : 0;
+}
+
 /**
  * Closes the serial port opened via serialport_open()
  * Arguments:
@@ -856,7 +1964,7 @@ void construct_port_name(char* port_name, bool is_virtual, bool is_usb, int port
     }
 }
 
-void get_used_ports_bitmap(uint32_t** used_ports, bool is_virtual, bool is_usb) {
+void get_used_ports_bitmap(bitmap_t** used_ports, bool is_virtual, bool is_usb) {
     if (is_virtual) {
         *used_ports = &used_virtual_ports;
     } else if (is_usb) {
@@ -866,6 +1974,15 @@ void get_used_ports_bitmap(uint32_t** used_ports, bool is_virtual, bool is_usb)
     }
 }
 
+/**
+ * Returns the number of microseconds on the monotonic clock, for timing round trips to devices
+ */
+uint64_t micros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 // ********************************** MAIN ********************************** //
 
 int main(int argc, char* argv[]) {
@@ -873,6 +1990,11 @@ int main(int argc, char* argv[]) {
     signal(SIGINT, stop);
     init();
     home_dir = getenv("HOME");  // set the home directory
+    // "dev_handler epoll [num_workers]" handles the devices from event loops instead of three threads per device
+    if (argc > 1 && strcmp(argv[1], "epoll") == 0) {
+        int n = (argc > 2) ? atoi(argv[2]) : 1;
+        start_workers((n < 1) ? 1 : (n > MAX_WORKERS) ? MAX_WORKERS : n);
+    }
     log_printf(INFO, "DEV_HANDLER initialized.");
     poll_connected_devices();
     return 0;
@@ -21,29 +21,48 @@ void print_bytes(uint8_t* data, size_t len) {
  * Returns:
  *    The size of the payload
  */
-static size_t device_write_payload_size(uint8_t device_type, uint32_t param_bitmap) {
+static size_t device_write_payload_size(uint8_t device_type, bitmap_t param_bitmap) {
     size_t result = BITMAP_SIZE;
     device_t* dev = get_device(device_type);
-    // Loop through each of the device's parameters and add the size of the parameter
-    for (int i = 0; ((param_bitmap >> i) > 0) && (i < MAX_PARAMS); i++) {
-        // Include parameter i if the i-th bit is on
-        if ((1 << i) & param_bitmap) {
-            switch (dev->params[i].type) {
-                case INT:
-                    result += sizeof(int32_t);
-                    break;
-                case FLOAT:
-                    result += sizeof(float);
-                    break;
-                case BOOL:
-                    result += sizeof(uint8_t);
-                    break;
-            }
+    // Loop through each parameter whose bit is on and add the size of the parameter
+    for (bitmap_t rest = param_bitmap; rest != 0;) {
+        switch (dev->params[bitmap_pop(&rest)].type) {
+            case INT:
+                result += sizeof(int32_t);
+                break;
+            case FLOAT:
+                result += sizeof(float);
+                break;
+            case BOOL:
+                result += sizeof(uint8_t);
+                break;
         }
     }
     return result;
 }
 
+/**
+ * Private utility function to turn off the bits of params that a device doesn't have or that can't be written to
+ * Arguments:
+ *    device_type: The type of device (refer to runtime_util)
+ *    param_bitmap: A bitmap, the i-th bit indicates whether param i is to be written
+ * Returns:
+ *    PARAM_BITMAP without the bits of non-existent and non-writeable params
+ */
+static bitmap_t writeable_params(uint8_t device_type, bitmap_t param_bitmap) {
+    device_t* dev = get_device(device_type);
+    // Don't write to non-existent params
+    param_bitmap &= BITMAP_LOW(dev->num_params);  // Set non-existent params to 0
+    // Set non-writeable params to 0
+    for (bitmap_t rest = param_bitmap; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        if (dev->params[i].write == 0) {
+            param_bitmap &= ~BITMAP_BIT(i);  // Set bit i to 0
+        }
+    }
+    return param_bitmap;
+}
+
 /**
  * Appends data to the end of a message's payload
  * Increments msg->payload_length accordingly
@@ -61,113 +80,181 @@ static int append_payload(message_t* msg, uint8_t* data, size_t len) {
     return (msg->payload_length > msg->max_payload_length) ? -1 : 0;
 }
 
+// Longest run of nonzero bytes in a cobs block, which is one less than the largest block length
+#define MAX_BLOCK_RUN 0xFE
+
+// For finding the zero bytes in a word (see zero_bytes())
+#define SWAR_LOWS 0x7F7F7F7F7F7F7F7FULL  // 0x7F in every byte
+
+// CRC-8 of each byte value (polynomial 0x07)
+static const uint8_t crc8_table[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3};
+
+// CRC-16 of each byte value in the high byte (polynomial 0x1021)
+static const uint16_t crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0};
+
 /**
- * Computes the checksum of input byte array by XOR-ing each byte
+ * Finds the zero bytes in a word, all at once
+ * Adding 0x7F to the low 7 bits of a byte carries into its highest bit unless they're all zero, without carrying
+ * into the next byte, so a byte ends up with its highest bit off exactly when all of its bits were off
  * Arguments:
- *    data: A byte array whose checksum will be computed
- *    len: the size of data
+ *    word: Eight bytes
  * Returns:
- *    The checksum of DATA
+ *    A word with the highest bit of each zero byte on (and every other bit off), or
+ *    0 if no byte of WORD is zero
  */
-static uint8_t checksum(uint8_t* data, size_t len) {
-    uint8_t chk = data[0];
-    for (size_t i = 1; i < len; i++) {
-        chk ^= data[i];
-    }
-    return chk;
+static inline uint64_t zero_bytes(uint64_t word) {
+    return ~(((word & SWAR_LOWS) + SWAR_LOWS) | word | SWAR_LOWS);
 }
 
-/**
- * A macro to help with cobs_encode
- */
-#define finish_block()                  \
-    {                                   \
-        block[0] = (uint8_t) block_len; \
-        block = dst;                    \
-        dst++;                          \
-        dst_len++;                      \
-        block_len = 1;                  \
-    };
+// ********************************* CODEC ********************************** //
 
-/**
- * Cobs encodes a byte array into a buffer
- * Arguments:
- *    src: The byte array to be encoded
- *    dst: The buffer to write the encoded data into
- *    src_len: The size of SRC
- * Returns:
- *    The size of the encoded data, DST
- */
-static ssize_t cobs_encode(uint8_t* dst, const uint8_t* src, size_t src_len) {
+ssize_t cobs_encode(uint8_t* dst, const uint8_t* src, size_t src_len) {
     const uint8_t* end = src + src_len;
-    uint8_t* block = dst;  // Advancing pointer to start of each block
-    dst++;
-    size_t block_len = 1;
-    ssize_t dst_len = 0;
+    uint8_t* block = dst;    // Where the length of the current block goes once the block ends
+    uint8_t* out = dst + 1;  // Each byte of SRC is copied one byte further along in DST (and more after a max-length block)
 
-    /* Build the DST array in "blocks", copying bytes one-by-one from SRC
-     * until a block ends.
+    /* Build the DST array in "blocks", copying SRC a word at a time
      * A block ends when
-     * 1) Encountering a 0x00 byte in the source array,
-     * 2) Reaching the max length of 256, or
+     * 1) Encountering a 0x00 byte in the source array, whose place in DST holds the length of the next block,
+     * 2) Reaching the max length of 255, or
      * 3) Source array is fully processed
      * When a block ends, insert the block length in DST at the beginning of
      * that block, then start a new block if there are still bytes in SRC to process
      */
     while (src < end) {
-        if (*src == 0) {
-            finish_block();
+        uint64_t word;
+        if ((size_t) (end - src) >= sizeof(word) && out + sizeof(word) - block <= MAX_BLOCK_RUN) {
+            // Copy a word, then end a block at each zero byte in it; a max-length block can't end in this word
+            memcpy(&word, src, sizeof(word));  // SRC and DST may not be aligned
+            memcpy(out, &word, sizeof(word));
+            uint64_t zeros = zero_bytes(word);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            zeros = __builtin_bswap64(zeros);  // Make the first byte the lowest one
+#endif
+            for (; zeros != 0; zeros &= zeros - 1) {
+                uint8_t* zero = out + __builtin_ctzll(zeros) / 8;
+                *block = (uint8_t) (zero - block);
+                block = zero;
+            }
+            out += sizeof(word);
+            src += sizeof(word);
         } else {
-            // Copy non-zero byte over without processing
-            *dst = *src;
-            dst++;
-            block_len++;
-            dst_len++;
-            if (block_len == 0xFF) {
-                // Reached max block length
-                finish_block();
+            // Copy a byte, near the end of SRC or of a max-length block
+            if (*src == 0) {
+                *block = (uint8_t) (out - block);
+                block = out;
+            } else {
+                *out = *src;
+                if (out + 1 - block == MAX_BLOCK_RUN + 1) {
+                    *block = MAX_BLOCK_RUN + 1;
+                    block = ++out;
+                }
             }
+            out++;
+            src++;
         }
-        src++;
     }
-    finish_block();
-    return dst_len;
+    *block = (uint8_t) (out - block);
+    return out - dst;
 }
 
-/**
- * Cobs decodes a byte array into a buffer
- * Arguments:
- *    src: The byte array to be decoded
- *    dst: The buffer to write the decoded data into
- *    src_len: The size of SRC
- * Returns:
- *    The size of the decoded data, DST
- */
-static ssize_t cobs_decode(uint8_t* dst, const uint8_t* src, size_t src_len) {
-    // Pointer to end of source array
+ssize_t cobs_decode(uint8_t* dst, const uint8_t* src, size_t src_len) {
     const uint8_t* end = src + src_len;
-    // Size counter of decoded array to return
-    ssize_t out_len = 0;
+    uint8_t* out = dst;
 
     while (src < end) {
-        int num_bytes_to_copy = *src;
-        src++;
-        for (int i = 1; i < num_bytes_to_copy; i++) {
-            *dst = *src;
-            dst++;
-            src++;
-            out_len++;
-            if (src > end) {  // Bad packet
-                return 0;
-            }
+        size_t block_len = *src++;
+        if (block_len == 0 || block_len - 1 > (size_t) (end - src)) {  // Bad packet
+            return 0;
         }
-        if (src != end) {
+        // Copy the block in one go; it may overlap with where it's copied to when decoding in place
+        memmove(out, src, block_len - 1);
+        out += block_len - 1;
+        src += block_len - 1;
+        if (block_len < MAX_BLOCK_RUN + 1 && src != end) {
             // Start decoding a new block, putting back the zero
-            *dst++ = 0;
-            out_len++;
+            *out++ = 0;
         }
     }
-    return out_len;
+    return out - dst;
+}
+
+uint16_t compute_checksum(checksum_t checksum, const uint8_t* data, size_t len) {
+    size_t i = 0;
+    if (checksum == CHECKSUM_CRC8) {
+        uint8_t crc = 0x00;
+        for (; i < len; i++) {
+            crc = crc8_table[crc ^ data[i]];
+        }
+        return crc;
+    } else if (checksum == CHECKSUM_CRC16) {
+        uint16_t crc = 0xFFFF;
+        for (; i < len; i++) {
+            crc = (uint16_t) (crc << 8) ^ crc16_table[(crc >> 8) ^ data[i]];
+        }
+        return crc;
+    }
+    // XOR a word at a time, then fold the bytes of the word together
+    uint64_t word, chk = 0;
+    for (; i + sizeof(word) <= len; i += sizeof(word)) {
+        memcpy(&word, &data[i], sizeof(word));
+        chk ^= word;
+    }
+    chk ^= chk >> 32;
+    chk ^= chk >> 16;
+    chk ^= chk >> 8;
+    for (; i < len; i++) {
+        chk ^= data[i];
+    }
+    return (uint8_t) chk;
 }
 
 // ************************* MESSAGE CONSTRUCTORS *************************** //
@@ -190,63 +277,19 @@ message_t* make_empty(ssize_t payload_size) {
 }
 
 message_t* make_ping() {
-    message_t* ping = malloc(sizeof(message_t));
-    if (ping == NULL) {
-        log_printf(FATAL, "make_ping: Failed to malloc");
-        exit(1);
-    }
-    ping->message_id = DEVICE_PING;
-    ping->payload = NULL;
-    ping->payload_length = 0;
-    ping->max_payload_length = 0;
+    message_t* ping = make_empty(0);
+    fill_ping(ping);
     return ping;
 }
 
-message_t* make_device_write(uint8_t dev_type, uint32_t pmap, param_val_t param_values[]) {
-    device_t* dev = get_device(dev_type);
-    // Don't write to non-existent params
-    pmap &= ((uint32_t) -1) >> (MAX_PARAMS - dev->num_params);  // Set non-existent params to 0
-    // Set non-writeable params to 0
-    for (int i = 0; ((pmap >> i) > 0) && (i < MAX_PARAMS); i++) {
-        if (dev->params[i].write == 0) {
-            pmap &= ~(1 << i);  // Set bit i to 0
-        }
-    }
-    // Build the message
-    message_t* dev_write = malloc(sizeof(message_t));
-    if (dev_write == NULL) {
-        log_printf(FATAL, "make_device_write: Failed to malloc");
-        exit(1);
-    }
-    dev_write->message_id = DEVICE_WRITE;
-    dev_write->payload_length = 0;
-    dev_write->max_payload_length = device_write_payload_size(dev_type, pmap);
-    dev_write->payload = malloc(dev_write->max_payload_length);
-    if (dev_write->payload == NULL) {
-        log_printf(FATAL, "make_device_write: Failed to malloc");
-        exit(1);
+message_t* make_device_write(uint8_t dev_type, bitmap_t pmap, param_val_t param_values[]) {
+    // Build the message with a payload of exactly the right size
+    message_t* dev_write = make_empty(device_write_payload_size(dev_type, writeable_params(dev_type, pmap)));
+    if (fill_device_write(dev_write, dev_type, pmap, param_values) != 0) {
+        destroy_message(dev_write);
+        return NULL;
     }
-    int status = 0;
-    // Append the param bitmap
-    status += append_payload(dev_write, (uint8_t*) &pmap, BITMAP_SIZE);
-    // Append the param values to the payload
-    for (int i = 0; ((pmap >> i) > 0) && (i < MAX_PARAMS); i++) {
-        // If the parameter is on in the bitmap, include it
-        if ((1 << i) & pmap) {
-            switch (dev->params[i].type) {
-                case INT:
-                    status += append_payload(dev_write, (uint8_t*) &(param_values[i].p_i), sizeof(int32_t));
-                    break;
-                case FLOAT:
-                    status += append_payload(dev_write, (uint8_t*) &(param_values[i].p_f), sizeof(float));
-                    break;
-                case BOOL:
-                    status += append_payload(dev_write, (uint8_t*) &(param_values[i].p_b), sizeof(uint8_t));
-                    break;
-            }
-        }
-    }
-    return (status == 0) ? dev_write : NULL;
+    return dev_write;
 }
 
 message_t* make_rst() {
@@ -267,10 +310,68 @@ void destroy_message(message_t* message) {
     free(message);
 }
 
+// ************************** MESSAGE FILLERS ******************************* //
+
+void fill_ping(message_t* msg) {
+    msg->message_id = DEVICE_PING;
+    msg->payload_length = 0;
+}
+
+void fill_checksum_offer(message_t* msg) {
+    uint8_t offered_checksums = SUPPORTED_CHECKSUMS;
+    msg->message_id = CHECKSUM_OFFER;
+    msg->payload_length = 0;
+    append_payload(msg, &offered_checksums, sizeof(offered_checksums));
+}
+
+int fill_device_write(message_t* msg, uint8_t dev_type, bitmap_t pmap, param_val_t param_values[]) {
+    device_t* dev = get_device(dev_type);
+    pmap = writeable_params(dev_type, pmap);
+    if (device_write_payload_size(dev_type, pmap) > msg->max_payload_length) {
+        return -1;
+    }
+    msg->message_id = DEVICE_WRITE;
+    msg->payload_length = 0;
+    int status = 0;
+    // Append the param bitmap
+    status += append_payload(msg, (uint8_t*) &pmap, BITMAP_SIZE);
+    // Append the values of the params that are on in the bitmap to the payload
+    for (bitmap_t rest = pmap; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        switch (dev->params[i].type) {
+            case INT:
+                status += append_payload(msg, (uint8_t*) &(param_values[i].p_i), sizeof(int32_t));
+                break;
+            case FLOAT:
+                status += append_payload(msg, (uint8_t*) &(param_values[i].p_f), sizeof(float));
+                break;
+            case BOOL:
+                status += append_payload(msg, (uint8_t*) &(param_values[i].p_b), sizeof(uint8_t));
+                break;
+        }
+    }
+    return (status == 0) ? 0 : -1;
+}
+
+void fill_set_baud(message_t* msg, uint32_t baud_rate) {
+    msg->message_id = SET_BAUD;
+    msg->payload_length = 0;
+    append_payload(msg, (uint8_t*) &baud_rate, sizeof(baud_rate));
+}
+
+void fill_subscribe(message_t* msg, bitmap_t pmap, uint16_t periods[]) {
+    msg->message_id = SUBSCRIBE;
+    msg->payload_length = 0;
+    append_payload(msg, (uint8_t*) &pmap, BITMAP_SIZE);
+    for (bitmap_t rest = pmap; rest != 0;) {
+        append_payload(msg, (uint8_t*) &periods[bitmap_pop(&rest)], sizeof(uint16_t));
+    }
+}
+
 // ********************* SERIALIZE AND PARSE MESSAGES *********************** //
 
 size_t calc_max_cobs_msg_length(message_t* msg) {
-    size_t required_packet_length = MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length + CHECKSUM_SIZE;
+    size_t required_packet_length = MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length + MAX_CHECKSUM_SIZE;
     // Cobs encoding a length N message adds overhead of at most ceil(N/254)
     size_t cobs_length = required_packet_length + (required_packet_length / 254) + 1;
     /* Add 2 additional bytes to the buffer for use in message_to_bytes()
@@ -279,90 +380,90 @@ size_t calc_max_cobs_msg_length(message_t* msg) {
     return DELIMITER_SIZE + COBS_LENGTH_SIZE + cobs_length;
 }
 
-ssize_t message_to_bytes(message_t* msg, uint8_t cobs_encoded[], size_t len) {
+ssize_t message_to_bytes(message_t* msg, uint8_t cobs_encoded[], size_t len, checksum_t checksum) {
     size_t required_length = calc_max_cobs_msg_length(msg);
-    if (len < required_length) {
+    if (len < required_length || msg->payload_length > UINT8_MAX) {
         return -1;
     }
     // Build an intermediate byte array to hold the serialized message to be encoded
-    uint8_t* data = malloc(MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length + CHECKSUM_SIZE);
-    if (data == NULL) {
-        log_printf(FATAL, "message_to_bytes: Failed to malloc");
-        exit(1);
-    }
+    uint8_t data[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + UINT8_MAX + MAX_CHECKSUM_SIZE];
+    size_t data_len = MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length;
     data[0] = msg->message_id;
     data[1] = msg->payload_length;
-    for (size_t i = 0; i < msg->payload_length; i++) {
-        data[i + MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE] = msg->payload[i];
-    }
-    data[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length] = checksum(data, MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length);
+    memcpy(&data[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE], msg->payload, msg->payload_length);
+    uint16_t chk = compute_checksum(checksum, data, data_len);
+    memcpy(&data[data_len], &chk, CHECKSUM_SIZE(checksum));  // Little-endian, like the payloads
+    data_len += CHECKSUM_SIZE(checksum);
 
     // Encode the intermediate byte array into output buffer
     cobs_encoded[0] = 0x00;
-    int cobs_len = cobs_encode(&cobs_encoded[2], data, MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length + CHECKSUM_SIZE);
-    free(data);
+    int cobs_len = cobs_encode(&cobs_encoded[2], data, data_len);
     cobs_encoded[1] = cobs_len;
     return DELIMITER_SIZE + COBS_LENGTH_SIZE + cobs_len;
 }
 
-int parse_message(uint8_t data[], message_t* msg_to_fill) {
+int parse_message(uint8_t data[], message_t* msg_to_fill, checksum_t checksum) {
     uint8_t cobs_len = data[1];
-    uint8_t* decoded = malloc(cobs_len);  // Actual number of bytes populated will be a couple less due to overhead
-    if (decoded == NULL) {
-        log_printf(FATAL, "parse_message: Failed to malloc");
-        exit(1);
-    }
+    uint8_t* decoded = &data[2];  // Decode in place; actual number of bytes populated will be a couple less due to overhead
     int ret = cobs_decode(decoded, &data[2], cobs_len);
-    if (ret < (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + CHECKSUM_SIZE)) {
+    if (ret < (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + CHECKSUM_SIZE(checksum))) {
         // Smaller than valid message
-        free(decoded);
         return 3;
-    } else if (ret > (int) (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + CHECKSUM_SIZE)) {
+    } else if (ret > (int) (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + CHECKSUM_SIZE(checksum))) {
         // Larger than the largest valid message
-        free(decoded);
         return 3;
     }
-    msg_to_fill->message_id = decoded[0];
-    msg_to_fill->payload_length = 0;
-    msg_to_fill->max_payload_length = decoded[MESSAGE_ID_SIZE];
-    ret = append_payload(msg_to_fill, &decoded[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE], msg_to_fill->max_payload_length);
-    if (ret != 0) {
-        log_printf(ERROR, "parse_message: Overwrote to payload\n");
+    uint8_t payload_length = decoded[MESSAGE_ID_SIZE];
+    if (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + payload_length + CHECKSUM_SIZE(checksum) > ret) {
+        // Payload length is longer than the decoded message
+        return 3;
+    } else if (payload_length > msg_to_fill->max_payload_length) {
+        log_printf(ERROR, "parse_message: Payload of %d bytes doesn't fit in %d bytes\n", payload_length, (int) msg_to_fill->max_payload_length);
         return 2;
     }
-    uint8_t expected_checksum = checksum(decoded, MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg_to_fill->payload_length);
-    uint8_t received_checksum = decoded[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg_to_fill->payload_length];
+    msg_to_fill->message_id = decoded[0];
+    msg_to_fill->payload_length = 0;
+    append_payload(msg_to_fill, &decoded[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE], payload_length);
+    uint16_t expected_checksum = compute_checksum(checksum, decoded, MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg_to_fill->payload_length);
+    uint16_t received_checksum = 0;
+    memcpy(&received_checksum, &decoded[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg_to_fill->payload_length], CHECKSUM_SIZE(checksum));
     if (expected_checksum != received_checksum) {
         log_printf(ERROR, "parse_message: Expected checksum 0x%02X. Received 0x%02X\n", expected_checksum, received_checksum);
     }
-    free(decoded);
     return (expected_checksum != received_checksum) ? 1 : 0;
 }
 
-void parse_device_data(uint8_t dev_type, message_t* dev_data, param_val_t vals[]) {
+bitmap_t parse_device_data(uint8_t dev_type, message_t* dev_data, param_val_t vals[]) {
     device_t* dev = get_device(dev_type);
-    // Bitmap is stored in the first 32 bits of the payload
-    uint32_t bitmap = *((uint32_t*) dev_data->payload);
-    /* Iterate through device's parameters. If bit is off, continue
-     * If bit is on, determine how much to read from the payload then put it in VALS in the appropriate field */
+    // Bitmap is stored little-endian in the first BITMAP_SIZE bytes of the payload
+    bitmap_t bitmap = 0;
+    memcpy(&bitmap, dev_data->payload, BITMAP_SIZE);
+    bitmap &= BITMAP_LOW(dev->num_params);  // Ignore non-existent params
+    /* Iterate through the params whose bit is on (they are included in the payload),
+     * determine how much to read from the payload then put it in VALS in the appropriate field
+     * Devices send only the params that changed in most DEVICE_DATA, so this is usually a few params */
     uint8_t* payload_ptr = &(dev_data->payload[BITMAP_SIZE]);  // Start the pointer at the beginning of the values (skip the bitmap)
-    for (int i = 0; ((bitmap >> i) > 0) && (i < MAX_PARAMS); i++) {
-        // If bit is on, parameter is included in the payload
-        if ((1 << i) & bitmap) {
-            switch (dev->params[i].type) {
-                case INT:
-                    vals[i].p_i = *((int32_t*) payload_ptr);
-                    payload_ptr += sizeof(int32_t) / sizeof(uint8_t);
-                    break;
-                case FLOAT:
-                    vals[i].p_f = *((float*) payload_ptr);
-                    payload_ptr += sizeof(float) / sizeof(uint8_t);
-                    break;
-                case BOOL:
-                    vals[i].p_b = *payload_ptr;
-                    payload_ptr += sizeof(uint8_t) / sizeof(uint8_t);
-                    break;
-            }
+    uint8_t* payload_end = &(dev_data->payload[dev_data->payload_length]);
+    for (bitmap_t rest = bitmap; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        if (payload_ptr + ((dev->params[i].type == BOOL) ? sizeof(uint8_t) : sizeof(int32_t)) > payload_end) {
+            log_printf(WARN, "parse_device_data: DEVICE_DATA from %s is too short for its param bitmap", dev->name);
+            return bitmap & ~(rest | BITMAP_BIT(i));  // Only the params before this one were read
+        }
+        switch (dev->params[i].type) {
+            case INT:
+                vals[i].p_i = *((int32_t*) payload_ptr);
+                payload_ptr += sizeof(int32_t) / sizeof(uint8_t);
+                break;
+            case FLOAT:
+                vals[i].p_f = *((float*) payload_ptr);
+                payload_ptr += sizeof(float) / sizeof(uint8_t);
+                break;
+            case BOOL:
+                vals[i].p_b = *payload_ptr;
+                payload_ptr += sizeof(uint8_t) / sizeof(uint8_t);
+                break;
         }
     }
+    return bitmap;
 }
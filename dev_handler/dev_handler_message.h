@@ -5,6 +5,7 @@
  * [delimiter][Length of cobs encoded message][Cobs encoded message]
  * The cobs encoded message, when decoded is in the following format:
  * [message id][payload length][payload][checksum]
+ * The checksum is one of checksum_t, agreed on when the device connects
  */
 
 #ifndef MESSAGE_H
@@ -13,15 +14,32 @@
 #include <logger.h>
 #include <runtime_util.h>
 
-/* The maximum number of milliseconds to wait between each DEVICE_PING from a device
+/* The maximum number of milliseconds to wait between each valid message from a device
  * Waiting for this long will exit all threads for that device (doing cleanup as necessary)
  * It's reasonable to match the TIMEOUT that the Arduino uses.
  */
 #define TIMEOUT 1000
 
-// The number of milliseconds between each DEVICE_PING sent to the device
+/* The number of milliseconds that the link to a device may go without a message sent to the device
+ * Any message sent to a device tells it that dev handler is still there, so a DEVICE_PING is sent only after this long
+ */
 #define PING_FREQ 250
 
+/* Devices on a serial port start out at DEFAULT_BAUD_RATE. After the ACKNOWLEDGEMENT, dev handler sends a SET_BAUD
+ * asking for HIGH_BAUD_RATE; a device that supports it echoes the SET_BAUD at the old rate and then switches.
+ * If either side doesn't receive a valid message at the new rate within BAUD_TIMEOUT milliseconds of switching,
+ * it falls back to DEFAULT_BAUD_RATE. BAUD_TIMEOUT must be longer than PING_FREQ, and well under TIMEOUT.
+ */
+#define DEFAULT_BAUD_RATE 115200
+#define HIGH_BAUD_RATE 1000000
+#define BAUD_TIMEOUT 500
+
+/* Until dev handler sends a SUBSCRIBE, a device sends every readable param whenever it changes. A SUBSCRIBE
+ * lists the params to send when they change, each with the least number of milliseconds between sending it.
+ * The other params are only sent in the keyframes that the device sends every so often with all of its params.
+ */
+#define MAX_SUBSCRIBE_PERIOD UINT16_MAX  // The longest period of a param in a SUBSCRIBE
+
 // The size in bytes of the message delimiter
 #define DELIMITER_SIZE 1
 // The size in bytes of the section specifying the length of the cobs encoded message
@@ -35,9 +53,31 @@
 // The size in bytes of the section specifying the device id for ACKNOWLEDGEMENT
 #define DEVICE_ID_SIZE 10
 // The size in bytes of the section specifying the checksum of the message id, the payload length, and the payload itself
-#define CHECKSUM_SIZE 1
+#define CHECKSUM_SIZE(checksum) (((checksum) == CHECKSUM_CRC16) ? 2 : 1)
+// The size in bytes of the largest checksum
+#define MAX_CHECKSUM_SIZE 2
 // The length of the largest payload in bytes, which may be reached for DEVICE_WRITE and DEVICE_DATA message types.
 #define MAX_PAYLOAD_SIZE (BITMAP_SIZE + (MAX_PARAMS * sizeof(float)))  // Bitmap + Each param (may be floats)
+_Static_assert(MAX_PAYLOAD_SIZE <= UINT8_MAX, "MAX_PAYLOAD_SIZE doesn't fit in PAYLOAD_LENGTH_SIZE; lower MAX_PARAMS");
+// The largest calc_max_cobs_msg_length() of a message with a payload of at most MAX_PAYLOAD_SIZE bytes
+#define MAX_COBS_MSG_LENGTH (DELIMITER_SIZE + COBS_LENGTH_SIZE + (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + MAX_CHECKSUM_SIZE) * 255 / 254 + 1)
+_Static_assert(MAX_COBS_MSG_LENGTH - DELIMITER_SIZE - COBS_LENGTH_SIZE <= UINT8_MAX, "The longest cobs encoded message doesn't fit in COBS_LENGTH_SIZE; lower MAX_PARAMS");
+
+/* The kinds of checksum at the end of a message
+ * Right before the DEVICE_PING that asks a new device for its ACKNOWLEDGEMENT, dev handler offers the ones that
+ * it supports in a CHECKSUM_OFFER (SUPPORTED_CHECKSUMS), and the device picks one of them and appends it to its
+ * ACKNOWLEDGEMENT. Until then, and with a device that doesn't append one (older lowcar firmware, which ignores
+ * the CHECKSUM_OFFER), both sides use CHECKSUM_XOR.
+ * The XOR of every byte misses any error that flips the same bit in an even number of bytes,
+ * which the CRCs catch, so that a corrupted message isn't mistaken for a valid one.
+ */
+typedef enum {
+    CHECKSUM_XOR = 0,   // XOR of every byte
+    CHECKSUM_CRC8 = 1,  // CRC-8 with polynomial 0x07 and initial value 0x00 (CRC-8/SMBUS)
+    CHECKSUM_CRC16 = 2  // CRC-16 with polynomial 0x1021 and initial value 0xFFFF (CRC-16/CCITT-FALSE), little-endian
+} checksum_t;
+#define NUM_CHECKSUMS 3
+#define SUPPORTED_CHECKSUMS ((1 << CHECKSUM_XOR) | (1 << CHECKSUM_CRC8) | (1 << CHECKSUM_CRC16))  // Bit i is on iff checksum_t i is supported
 
 // The types of messages
 typedef enum {
@@ -47,7 +87,10 @@ typedef enum {
     DEVICE_WRITE = 0x03,     // To lowcar
     DEVICE_DATA = 0x04,      // To dev handler
     LOG = 0x05,              // To dev handler
-    RST = 0x06               // Between dev handler and lowcar
+    RST = 0x06,              // Between dev handler and lowcar
+    SET_BAUD = 0x07,         // Between dev handler and lowcar
+    SUBSCRIBE = 0x08,        // To lowcar
+    CHECKSUM_OFFER = 0x09    // To lowcar
 } message_id_t;
 
 // A struct defining a message to be sent over serial
@@ -103,7 +146,7 @@ message_t* make_ping();
  *      payload_length: sizeof(pmap) + sizeof(all the values in PARAM_VALUES)
  *      max_payload_length: same as above
  */
-message_t* make_device_write(uint8_t dev_type, uint32_t pmap, param_val_t param_values[]);
+message_t* make_device_write(uint8_t dev_type, bitmap_t pmap, param_val_t param_values[]);
 
 /**
  * Builds a RST message
@@ -121,6 +164,92 @@ message_t* make_rst();
  */
 void destroy_message(message_t* message);
 
+// ************************** MESSAGE FILLERS ******************************* //
+// These rebuild a message that the caller allocated once (ex. with make_empty(MAX_PAYLOAD_SIZE)), so they never allocate
+
+/**
+ * Turns a message into a DEVICE_PING, the same as make_ping() would build
+ * Arguments:
+ *    msg: The message to fill
+ */
+void fill_ping(message_t* msg);
+
+/**
+ * Turns a message into a CHECKSUM_OFFER, whose payload is SUPPORTED_CHECKSUMS
+ * Arguments:
+ *    msg: The message to fill; its max_payload_length must be at least 1
+ */
+void fill_checksum_offer(message_t* msg);
+
+/**
+ * Turns a message into a DEVICE_WRITE, the same as make_device_write() would build
+ * Arguments:
+ *    msg: The message to fill. Its payload must fit max_payload_length bytes
+ *    dev_type: The type of device. Used to verify params are writeable
+ *    pmap: param bitmap indicating which parameters will be written to
+ *    param_values: An array of the parameter values.
+ *      The i-th bit in PMAP is on if and only if its value is in the i-th index of PARAM_VALUES
+ * Returns:
+ *    0 on success
+ *    -1 if the payload doesn't fit in MSG
+ */
+int fill_device_write(message_t* msg, uint8_t dev_type, bitmap_t pmap, param_val_t param_values[]);
+
+/**
+ * Turns a message into a SET_BAUD, whose payload is the baud rate to switch to
+ * Arguments:
+ *    msg: The message to fill
+ *    baud_rate: The baud rate to switch to
+ */
+void fill_set_baud(message_t* msg, uint32_t baud_rate);
+
+/**
+ * Turns a message into a SUBSCRIBE, whose payload is a param bitmap followed by the
+ * period of each param in it (in the same order as the values of a DEVICE_DATA)
+ * Arguments:
+ *    msg: The message to fill; its max_payload_length must be at least BITMAP_SIZE + MAX_PARAMS * sizeof(uint16_t)
+ *    pmap: The params that the device should send when they change
+ *    periods: Array of MAX_PARAMS periods; periods[i] is the least number of milliseconds between sending param i
+ */
+void fill_subscribe(message_t* msg, bitmap_t pmap, uint16_t periods[]);
+
+// ******************************** CODEC *********************************** //
+
+/**
+ * Cobs encodes a byte array into a buffer, copying it a word at a time
+ * Arguments:
+ *    dst: The buffer to write the encoded data into; must fit SRC_LEN + SRC_LEN / 254 + 1 bytes
+ *    src: The byte array to be encoded
+ *    src_len: The size of SRC
+ * Returns:
+ *    The size of the encoded data, DST
+ */
+ssize_t cobs_encode(uint8_t* dst, const uint8_t* src, size_t src_len);
+
+/**
+ * Cobs decodes a byte array into a buffer
+ * DST may be the same as SRC to decode in place, since the decoded data is never longer than the encoded data
+ * Arguments:
+ *    dst: The buffer to write the decoded data into
+ *    src: The byte array to be decoded
+ *    src_len: The size of SRC
+ * Returns:
+ *    The size of the decoded data, DST, or
+ *    0 if SRC isn't validly encoded
+ */
+ssize_t cobs_decode(uint8_t* dst, const uint8_t* src, size_t src_len);
+
+/**
+ * Computes a checksum of a byte array
+ * Arguments:
+ *    checksum: The kind of checksum
+ *    data: A byte array whose checksum will be computed
+ *    len: The size of DATA
+ * Returns:
+ *    The checksum of DATA, whose lowest CHECKSUM_SIZE(checksum) bytes are sent
+ */
+uint16_t compute_checksum(checksum_t checksum, const uint8_t* data, size_t len);
+
 // ********************* SERIALIZE AND PARSE MESSAGES *********************** //
 
 /**
@@ -139,26 +268,30 @@ size_t calc_max_cobs_msg_length(message_t* msg);
  *    msg: the message to serialize
  *    cobs_encoded: empty buffer to be filled with the cobs-encoded message
  *    len: the length of COBS_ENCODED. Should be at least calc_max_cobs_msg_length(msg)
+ *    checksum: The kind of checksum to end the message with
  * Returns:
  *    The size of COBS_ENCODED that was actually populated
  *    -1 if len is too small (less than calc_max_cobs_msg_length)
  */
-ssize_t message_to_bytes(message_t* msg, uint8_t cobs_encoded[], size_t len);
+ssize_t message_to_bytes(message_t* msg, uint8_t cobs_encoded[], size_t len, checksum_t checksum);
 
 /**
  * Cobs decodes a byte array and populates the fields of input message
  * Arguments:
  *    data: A byte array containing a cobs encoded message.
  *      data[0] should be the delimiter. data[1] should be cobs_len
+ *      The message is decoded in place, so DATA is overwritten
  *    empty_msg: A message to be populated.
  *      Payload must be properly allocated memory. Use make_empty()
+ *      Its max_payload_length is the size of that memory, and is left unchanged
+ *    checksum: The kind of checksum that the message should end with
  * Returns:
  *    0 if successful parsing
  *    1 if incorrect checksum
  *    2 if max_payload_length is too small
  *    3 if invalid message (decoded message has invalid length)
  */
-int parse_message(uint8_t data[], message_t* empty_msg);
+int parse_message(uint8_t data[], message_t* empty_msg, checksum_t checksum);
 
 /**
  * Reads the parameter values from a DEVICE_DATA message into param_val_t[]
@@ -166,9 +299,11 @@ int parse_message(uint8_t data[], message_t* empty_msg);
  *    dev_type: The type of the device that the message was sent from
  *    dev_data: The DEVICE_DATA message to unpack
  *    vals: An array of param_val_t structs to be populated with the values from the message.
+ * Returns:
+ *    bitmap of the params of the device that were in the message (only the ones that changed, except in a keyframe)
  * NOTE: The length of vals MUST be at LEAST the number of params sent in the DEVICE_DATA message
  * Allocate MAX_PARAMS param_val_t structs to guarantee this
  */
-void parse_device_data(uint8_t dev_type, message_t* dev_data, param_val_t vals[]);
+bitmap_t parse_device_data(uint8_t dev_type, message_t* dev_data, param_val_t vals[]);
 
 #endif
@@ -14,6 +14,7 @@
 
 // runtime includes
 #include <logger.h>        // for runtime logger
+#include <realtime.h>      // for the real-time profile
 #include <runtime_util.h>  // for runtime constants
 #include <shm_wrapper.h>   // Shared memory wrapper to get/send device data
 
@@ -31,6 +32,7 @@ struct timespec setup_time = {2, 0};  // Max time allowed for setup functions
 struct timespec main_interval = {0, (long) ((1.0 / MIN_FREQ) * 1e9)};
 #define MAX_FREQ 10000.0                     // Maximum number of times per second the Python function should run
 uint64_t min_time = (1.0 / MAX_FREQ) * 1e9;  // Minimum time in nanoseconds that the Python function should take
+#define RUN_MODE_WAIT_TIMEOUT 1000           // Max milliseconds the main loop sleeps between checks of the run mode (changes wake it immediately)
 
 
 /**
@@ -53,35 +55,34 @@ static char* get_mode_str(robot_desc_val_t mode) {
  *  Resets relevant parameters to default values. This should be called at the end of AUTON and TELEOP.
  */
 static void reset_params() {
-    uint32_t catalog;
+    bitmap_t catalog;
     dev_id_t dev_ids[MAX_DEVICES];
     get_catalog(&catalog);
     get_device_identifiers(dev_ids);
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        if (catalog & (1 << i)) {  // If device at index i exists
-            device_t* device = get_device(dev_ids[i].type);
-            if (device == NULL) {
-                log_printf(ERROR, "reset_params: device at index %d with type %d is invalid\n", i, dev_ids[i].type);
-                continue;
-            }
-            uint32_t params_to_reset = 0;
-            param_val_t zero_params[MAX_PARAMS] = {0};  // By default we reset to 0
-
-            // reset KoalaBear velocity_a, velocity_b params to 0
-            if (strcmp(device->name, "KoalaBear") == 0) {
-                for (int j = 0; j < device->num_params; j++) {
-                    if (strcmp(device->params[j].name, "velocity_a") == 0) {
-                        params_to_reset |= (1 << j);
-                    } else if (strcmp(device->params[j].name, "velocity_b") == 0) {
-                        params_to_reset |= (1 << j);
-                    }
+    for (bitmap_t rest = catalog; rest != 0;) {
+        int i = bitmap_pop(&rest);  // Device at index i exists
+        device_t* device = get_device(dev_ids[i].type);
+        if (device == NULL) {
+            log_printf(ERROR, "reset_params: device at index %d with type %d is invalid\n", i, dev_ids[i].type);
+            continue;
+        }
+        bitmap_t params_to_reset = 0;
+        param_val_t zero_params[MAX_PARAMS] = {0};  // By default we reset to 0
+
+        // reset KoalaBear velocity_a, velocity_b params to 0
+        if (strcmp(device->name, "KoalaBear") == 0) {
+            for (int j = 0; j < device->num_params; j++) {
+                if (strcmp(device->params[j].name, "velocity_a") == 0) {
+                    params_to_reset |= BITMAP_BIT(j);
+                } else if (strcmp(device->params[j].name, "velocity_b") == 0) {
+                    params_to_reset |= BITMAP_BIT(j);
                 }
-                device_write_uid(dev_ids[i].uid, EXECUTOR, COMMAND, params_to_reset, zero_params);
             }
-            params_to_reset = 0;
-
-            // TODO: if more params for more devices need to be reset, follow construction above ^
+            device_write_uid(dev_ids[i].uid, EXECUTOR, COMMAND, params_to_reset, zero_params);
         }
+        params_to_reset = 0;
+
+        // TODO: if more params for more devices need to be reset, follow construction above ^
     }
 }
 
@@ -397,6 +398,7 @@ int main(int argc, char* argv[]) {
     signal(SIGINT, exit_handler);
     logger_init(EXECUTOR);
     shm_init();
+    realtime_init(EXECUTOR);  // student code subprocesses inherit the CPU pinning (but not the memory locking)
     chdir("../executor");
 
     char* student_code = "studentcode";
@@ -404,6 +406,7 @@ int main(int argc, char* argv[]) {
         student_code = argv[1];
     }
     robot_desc_val_t new_mode = IDLE;
+    uint32_t run_mode_seq = 0;  // Sequence number of the last change to the run mode that we've seen
     // Main loop that checks for new run mode in shared memory from the network handler
     while (1) {
         new_mode = robot_desc_read(RUN_MODE);
@@ -420,6 +423,7 @@ int main(int argc, char* argv[]) {
                 }
             }
         }
-        usleep(100000);  // throttle this thread to ~10 Hz
+        // Sleep until the network handler changes the run mode
+        robot_desc_wait(RUN_MODE, &run_mode_seq, RUN_MODE_WAIT_TIMEOUT);
     }
 }
@@ -6,8 +6,8 @@
  *   hypothermia: Motor velocities slowed until specified otherwise
  */
 
-// Microseconds between each time we poll shared memory for the current game state
-#define GAMESTATE_POLL_INTERVAL (0.5 * 1e6)
+// Maximum milliseconds the gamestate handler sleeps while waiting for the robot description to change
+#define GAMESTATE_WAIT_TIMEOUT 1000
 // Duration of POISON_IVY and DEHYDRATION in milliseconds
 #define DEBUFF_DURATION 10000
 // How much to slow motor velocities when HYPOTHERMIA is ACTIVE
@@ -22,6 +22,7 @@
 
 /**
  * A thread function that acts as a timer on gamestates and blocks forever.
+ * Sleeps until the robot description changes or a debuff runs out instead of polling.
  * Sets POISON_IVY and DEHYDRATION to INACTIVE after DEBUFF_DURATION milliseconds of ACTIVE.
  * Deactivates all game states when run mode is set to IDLE.
  * Arguments:
@@ -33,8 +34,10 @@ static void* gamestate_handler(void* args) {
     uint64_t poison_ivy_start = 0;   // The timestamp of when poison ivy started; 0 if inactive
     uint64_t dehydration_start = 0;  // The timestamp of when dehydration started; 0 if inactive
     uint64_t curr_time = 0;          // The current timestamp
+    uint32_t timeout;                // Milliseconds until the handler needs to run again if nothing changes
+    uint32_t rd_seq = 0;             // Sequence number of the last change to the robot description that we've seen
 
-    // Poll the current gamestate
+    // Update the gamestate every time the robot description changes
     while (1) {
         curr_time = millis();
 
@@ -62,8 +65,15 @@ static void* gamestate_handler(void* args) {
             }
         }
 
-        // Throttle the gamestate polling
-        usleep(GAMESTATE_POLL_INTERVAL);
+        // Sleep until the robot description changes or an active debuff runs out, whichever is first
+        timeout = GAMESTATE_WAIT_TIMEOUT;
+        if (poison_ivy_start && poison_ivy_start + DEBUFF_DURATION + 1 - curr_time < timeout) {
+            timeout = poison_ivy_start + DEBUFF_DURATION + 1 - curr_time;
+        }
+        if (dehydration_start && dehydration_start + DEBUFF_DURATION + 1 - curr_time < timeout) {
+            timeout = dehydration_start + DEBUFF_DURATION + 1 - curr_time;
+        }
+        robot_desc_wait(ROBOT_DESC_ANY, &rd_seq, timeout);
     }
     return NULL;
 }
@@ -99,7 +109,7 @@ static void bound_velocity(param_val_t* params) {
     }
 }
 
-int filter_device_write_uid(uint8_t dev_type, uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params) {
+int filter_device_write_uid(uint8_t dev_type, uint64_t dev_uid, process_t process, stream_t stream, bitmap_t params_to_write, param_val_t* params) {
     // Spring 2021: Only KoalaBear is affected by game states
     if (dev_type == KOALABEAR) {
         // Bound velocity to [-1.0, 1.0]
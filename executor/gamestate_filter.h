@@ -39,6 +39,6 @@ void start_gamestate_handler_thread();
  * A wrapper function to device_write_uid that modifies the input params
  * based on the current active game states.
  */
-int filter_device_write_uid(uint8_t dev_type, uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params);
+int filter_device_write_uid(uint8_t dev_type, uint64_t dev_uid, process_t process, stream_t stream, bitmap_t params_to_write, param_val_t* params);
 
 #endif
@@ -6,6 +6,7 @@ cdef extern from "../runtime_util/runtime_util.h":
     int NUM_GAMEPAD_BUTTONS
     int NUM_KEYBOARD_BUTTONS
     int LOG_KEY_LENGTH
+    ctypedef uint64_t bitmap_t
     ctypedef enum process_t:
         EXECUTOR
     ctypedef struct device_t:
@@ -47,11 +48,11 @@ cdef extern from "../shm_wrapper/shm_wrapper.h" nogil:
     ctypedef enum stream_t:
         DATA, COMMAND
     void shm_init()
-    int device_read_uid(uint64_t device_uid, process_t process, stream_t stream, uint32_t params_to_read, param_val_t *params)
-    int device_write_uid(uint64_t device_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t *params)
+    int device_read_uid(uint64_t device_uid, process_t process, stream_t stream, bitmap_t params_to_read, param_val_t *params)
+    int device_write_uid(uint64_t device_uid, process_t process, stream_t stream, bitmap_t params_to_write, param_val_t *params)
     int input_read (uint64_t *pressed_buttons, float *joystick_vals, robot_desc_field_t source)
     robot_desc_val_t robot_desc_read (robot_desc_field_t field)
     int log_data_write(char* key, param_type_t type, param_val_t value)
 
 cdef extern from "gamestate_filter.h":
-    int filter_device_write_uid(uint8_t dev_type, uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params)
+    int filter_device_write_uid(uint8_t dev_type, uint64_t dev_uid, process_t process, stream_t stream, bitmap_t params_to_write, param_val_t* params)
@@ -6,14 +6,18 @@ Device::Device(DeviceType dev_id, uint8_t dev_year, bool is_hardware_serial, Har
     this->dev_id.year = dev_year;
     this->dev_id.uid = 0;  // sets a temporary value
 
-    this->timeout = timeout;  // timeout in ms how long we tolerate not receiving a DEVICE_PING from dev handler
+    this->timeout = timeout;  // timeout in ms how long we tolerate not receiving a message from dev handler
     this->enabled = FALSE;    // Whether or not the device currently has a connection with Runtime
+    this->baud_pending = FALSE;
+    this->keyframe_due = TRUE;
+    this->last_sent_keyframe_time = 0;
+    subscribe_all();
 
     // make a new Messenger on the specified serial port
     this->msngr = new Messenger(is_hardware_serial, hw_serial_port);
     this->led = new StatusLED();
 
-    this->last_sent_data_time = this->last_received_ping_time = this->curr_time = millis();
+    this->last_sent_data_time = this->last_received_msg_time = this->curr_time = millis();
 }
 
 void Device::set_uid(uint64_t uid) {
@@ -26,27 +30,46 @@ void Device::loop() {
     sts = this->msngr->read_message(&(this->curr_msg));  // try to read a new message
 
     if (sts == Status::SUCCESS) {  // we have a message!
+        this->baud_pending = FALSE;                      // dev handler is at the same baud rate as us
+        this->last_received_msg_time = this->curr_time;  // and still there; it pings us only when it has nothing else to send
         switch (this->curr_msg.message_id) {
             case MessageID::DEVICE_PING:
-                this->last_received_ping_time = this->curr_time;
                 // If this is the first DEVICE_PING received, send an ACKNOWLEDGEMENT
                 if (!this->enabled) {
                     this->msngr->send_message(MessageID::ACKNOWLEDGEMENT, &(this->curr_msg), &(this->dev_id));
                     this->msngr->lowcar_printf("Device type %d, UID 0x...%X sent ACK", (uint8_t) this->dev_id.type, this->dev_id.uid);
                     this->enabled = TRUE;
+                    this->keyframe_due = TRUE;  // dev handler doesn't have any of our params yet
+                    subscribe_all();            // nor told us which ones it wants
                     device_enable();
                 }
                 break;
 
             case MessageID::DEVICE_WRITE:
-                this->last_received_ping_time = this->curr_time;
                 device_write_params(&(this->curr_msg));
                 break;
 
+            case MessageID::SET_BAUD:
+                set_baud_rate(&(this->curr_msg));
+                break;
+
+            case MessageID::CHECKSUM_OFFER:
+                // Comes right before the first DEVICE_PING; a later one would be for another connection
+                if (!this->enabled) {
+                    this->msngr->offer_checksums(&(this->curr_msg));
+                }
+                break;
+
+            case MessageID::SUBSCRIBE:
+                subscribe(&(this->curr_msg));
+                break;
+
             // Runtime intends to disconnect this device
             case MessageID::RST:
                 device_reset();
                 this->enabled = FALSE;
+                this->msngr->set_baud_rate(DEFAULT_BAUD_RATE);
+                this->msngr->set_checksum(Checksum::XOR);
                 break;
 
             // Receiving some other Message
@@ -58,9 +81,14 @@ void Device::loop() {
         this->msngr->lowcar_printf("Error when reading message by lowcar device");
     }
     device_actions();
-    // If it's been too long since we received a DEVICE_PING, disable the device
+    // If dev handler didn't switch to the new baud rate with us, fall back to the default
+    if (this->baud_pending && (this->curr_time - this->baud_switch_time >= BAUD_TIMEOUT_MS)) {
+        this->msngr->set_baud_rate(DEFAULT_BAUD_RATE);
+        this->baud_pending = FALSE;
+    }
+    // If it's been too long since we received a message, disable the device
     // Send a message to Runtime that we will terminate the connection
-    if (this->enabled && (this->timeout > 0) && (this->curr_time - this->last_received_ping_time >= this->timeout)) {
+    if (this->enabled && (this->timeout > 0) && (this->curr_time - this->last_received_msg_time >= this->timeout)) {
         device_reset();
         this->enabled = FALSE;
 
@@ -69,6 +97,10 @@ void Device::loop() {
         this->curr_msg.payload_length = 0;
         memset(this->curr_msg.payload, 0, MAX_PAYLOAD_SIZE);
         this->msngr->send_message(MessageID::RST, &(this->curr_msg));
+        // A new dev handler connection starts out at the default baud rate and checksum
+        this->msngr->set_baud_rate(DEFAULT_BAUD_RATE);
+        this->msngr->set_checksum(Checksum::XOR);
+        this->baud_pending = FALSE;
     }
 
     // If we still haven't gotten our first DEVICE_PING yet (or dev handler timed out), keep waiting for a DEVICE_PING
@@ -79,15 +111,16 @@ void Device::loop() {
     // do device-specific actions. This may change params
     // device_actions(); //[MOVED]
 
-    /* Send another DEVICE_DATA with all readable parameters if DATA_INTERVAL_MS
+    /* Send another DEVICE_DATA with the subscribed parameters that changed if DATA_INTERVAL_MS
      * milliseconds passed since the last time we sent a DEVICE_DATA
-     * Note that it is possible that no parameters are readable.
-     * We send an "empty" DEVICE_DATA anyways to let dev handler know we're still online
+     * If none changed, nothing is sent, except for keyframes; note that it is possible that no parameters
+     * are readable, so a keyframe may be "empty", which still lets dev handler know we're still online
      */
     if (this->curr_time - this->last_sent_data_time >= DATA_INTERVAL_MS) {
         this->last_sent_data_time = this->curr_time;
-        device_read_params(&(this->curr_msg));
-        this->msngr->send_message(MessageID::DEVICE_DATA, &(this->curr_msg));
+        if (device_read_params(&(this->curr_msg))) {
+            this->msngr->send_message(MessageID::DEVICE_DATA, &(this->curr_msg));
+        }
     }
 
     // Send any queued logs
@@ -118,29 +151,47 @@ void Device::device_actions() {
 
 // ***************************** HELPER METHODS ***************************** //
 
-void Device::device_read_params(message_t* msg) {
+uint8_t Device::device_read_params(message_t* msg) {
     // Clear the message before building device data
     msg->message_id = MessageID::DEVICE_DATA;
     msg->payload_length = 0;
     memset(msg->payload, 0, MAX_PAYLOAD_SIZE);
-    uint32_t param_bitmap = 0;
+    param_bitmap_t param_bitmap = 0;
+
+    // Every so often, send every readable parameter in case dev handler missed a change
+    if (this->curr_time - this->last_sent_keyframe_time >= KEYFRAME_INTERVAL_MS) {
+        this->keyframe_due = TRUE;
+    }
+    uint8_t keyframe = this->keyframe_due;
+    if (keyframe) {
+        this->keyframe_due = FALSE;
+        this->last_sent_keyframe_time = this->curr_time;
+    }
 
     // Loop through every parameter and attempt to read it into the buffer
-    // If the parameter is readable, then turn on the bit in the param_bitmap
+    // If the parameter is readable, subscribed, due, and changed (or this is a keyframe), keep it and turn on the bit in the param_bitmap
     msg->payload_length = PARAM_BITMAP_BYTES;
+    uint16_t now = (uint16_t) this->curr_time;  // Periods are short, so 16 bits of the time are enough to tell whether one passed
     for (uint8_t param_num = 0; param_num < MAX_PARAMS; param_num++) {
-        size_t param_size = device_read(param_num, msg->payload + msg->payload_length);
-        msg->payload_length += param_size;
+        param_bitmap_t param_bit = PARAM_BIT(param_num);
+        if (!keyframe && (!(this->subscribed_params & param_bit) || (uint16_t) (now - this->param_sent_time[param_num]) < this->param_periods[param_num])) {
+            continue;
+        }
+        uint8_t* param_value = msg->payload + msg->payload_length;
+        size_t param_size = device_read(param_num, param_value);
 
-        // If the parameter is readable
-        if (param_size > 0) {
-            param_bitmap |= 1 << param_num;
+        // If the parameter is readable and needs to be sent
+        if (param_size > 0 && (keyframe || memcmp(param_value, this->last_sent_params[param_num], param_size) != 0)) {
+            memcpy(this->last_sent_params[param_num], param_value, param_size);
+            this->param_sent_time[param_num] = now;
+            msg->payload_length += param_size;
+            param_bitmap |= param_bit;
         }
     }
 
-    // The first 32 bits of the payload should be set to the param_bitmap we determined
-    uint32_t* payload_ptr_uint32 = (uint32_t*) msg->payload;
-    *payload_ptr_uint32 = param_bitmap;
+    // The first PARAM_BITMAP_BYTES bytes of the payload should be set to the param_bitmap we determined
+    memcpy(msg->payload, &param_bitmap, PARAM_BITMAP_BYTES);
+    return keyframe || param_bitmap != 0;
 }
 
 void Device::device_write_params(message_t* msg) {
@@ -149,13 +200,61 @@ void Device::device_write_params(message_t* msg) {
     }
 
     // Param bitmap of parameters to write is at the beginning of the payload
-    uint32_t param_bitmap = *((uint32_t*) msg->payload);
+    param_bitmap_t param_bitmap = 0;
+    memcpy(&param_bitmap, msg->payload, PARAM_BITMAP_BYTES);
 
     // Loop over param_bitmap and attempt to write data for requested bits
     uint8_t* payload_ptr = msg->payload + PARAM_BITMAP_BYTES;
-    for (uint32_t param_num = 0; (param_bitmap >> param_num) > 0; param_num++) {
-        if (param_bitmap & (1 << param_num)) {
+    for (uint8_t param_num = 0; param_num < MAX_PARAMS && (param_bitmap >> param_num) > 0; param_num++) {
+        if (param_bitmap & PARAM_BIT(param_num)) {
             payload_ptr += device_write((uint8_t) param_num, payload_ptr);
         }
     }
 }
+
+void Device::set_baud_rate(message_t* msg) {
+    uint32_t baud_rate;
+    if (msg->payload_length != sizeof(baud_rate)) {
+        return;
+    }
+    memcpy(&baud_rate, msg->payload, sizeof(baud_rate));
+    if (baud_rate > MAX_BAUD_RATE) {
+        return;
+    }
+
+    // Echo the SET_BAUD at the current rate (this clears MSG), then switch
+    this->msngr->send_message(MessageID::SET_BAUD, msg);
+    this->msngr->set_baud_rate(baud_rate);
+    this->baud_pending = TRUE;
+    this->baud_switch_time = this->curr_time;
+}
+
+void Device::subscribe(message_t* msg) {
+    param_bitmap_t param_bitmap = 0;
+    if (msg->payload_length < PARAM_BITMAP_BYTES) {
+        return;
+    }
+    memcpy(&param_bitmap, msg->payload, PARAM_BITMAP_BYTES);
+
+    // The period of each subscribed param follows the bitmap, in the order of the params
+    uint8_t* payload_ptr = msg->payload + PARAM_BITMAP_BYTES;
+    for (uint8_t param_num = 0; param_num < MAX_PARAMS; param_num++) {
+        if (!(param_bitmap & PARAM_BIT(param_num))) {
+            continue;
+        }
+        if (payload_ptr + sizeof(uint16_t) > msg->payload + msg->payload_length) {
+            return;  // Malformed; keep the current subscription
+        }
+        memcpy(&this->param_periods[param_num], payload_ptr, sizeof(uint16_t));
+        payload_ptr += sizeof(uint16_t);
+    }
+    this->subscribed_params = param_bitmap;
+}
+
+void Device::subscribe_all() {
+    this->subscribed_params = ALL_PARAMS_BITMAP;
+    for (uint8_t param_num = 0; param_num < MAX_PARAMS; param_num++) {
+        this->param_periods[param_num] = 0;
+        this->param_sent_time[param_num] = 0;
+    }
+}
@@ -22,8 +22,8 @@ class Device {
      *    dev_year: The device year
      *    is_hardware_serial: False by default (use Serial); set to True for devices that use SerialX pins
      *    hw_serial_prt: Unused (NULL) by default; when is_hardware_serial == True, specify which SerialX port to use
-     *    timeout: the maximum number of milliseconds to wait between PING messages from
-     *      dev handler before disabling
+     *    timeout: the maximum number of milliseconds to wait between messages from
+     *      dev handler before disabling (it sends a PING when it has nothing else to send)
      *      It's reasonable to match the TIMEOUT that dev handler uses.
      */
     Device(DeviceType dev_type, uint8_t dev_year, bool is_hardware_serial = false, HardwareSerial* hw_serial_port = NULL, uint32_t timeout = 1000);
@@ -103,17 +103,34 @@ class Device {
 
   private:
     dev_id_t dev_id;                   // dev_id of this device determined when flashing
-    uint32_t timeout;                  // Maximum time (ms) we'll wait between PING messages from dev handler
+    uint32_t timeout;                  // Maximum time (ms) we'll wait between messages from dev handler
     uint64_t last_sent_data_time;      // Timestamp of last time we sent DEVICE_DATA
-    uint64_t last_received_ping_time;  // Timestamp of last time we received a PING
+    uint64_t last_sent_keyframe_time;  // Timestamp of last time we sent DEVICE_DATA with every readable param
+    uint8_t keyframe_due;              // Whether the next DEVICE_DATA must have every readable param
+    uint64_t last_received_msg_time;   // Timestamp of last time we received a message
+    uint8_t baud_pending;              // Whether we switched baud rates and haven't received a message at the new rate yet
+    uint64_t baud_switch_time;         // Timestamp of last time we switched baud rates
+    param_bitmap_t subscribed_params;  // Bitmap of the params that dev handler wants to receive when they change
     message_t curr_msg;                // current message being processed
 
+    // The value of each param when it was last sent in a DEVICE_DATA
+    uint8_t last_sent_params[MAX_PARAMS][sizeof(float)];
+    // The least number of milliseconds between sending each subscribed param, and the (truncated) time it was last sent
+    uint16_t param_periods[MAX_PARAMS];
+    uint16_t param_sent_time[MAX_PARAMS];
+
     /**
      * Builds a DEVICE_DATA message by reading all readable parameters.
+     * Only the subscribed parameters whose value changed since they were last sent, and whose period
+     * passed, are put in the message, except in a keyframe (every KEYFRAME_INTERVAL_MS, and right after
+     * connecting), which has all of them.
      * Arguments:
      *    msg: An empty message to be populated with parameter values ready for sending.
+     * Returns:
+     *    TRUE if the message should be sent (it has parameters, or it is a keyframe), or
+     *    FALSE if there is nothing to send.
      */
-    void device_read_params(message_t* msg);
+    uint8_t device_read_params(message_t* msg);
 
     /**
      * Writes to device parameters given a DEVICE_WRITE message.
@@ -121,6 +138,28 @@ class Device {
      *    msg: A DEVICE_WRITE message containing parameters to write to the device.
      */
     void device_write_params(message_t* msg);
+
+    /**
+     * Answers a SET_BAUD message by echoing it at the current baud rate, then switching to the requested rate.
+     * Requests for rates above MAX_BAUD_RATE are ignored, which leaves dev handler at the current rate.
+     * Arguments:
+     *    msg: A SET_BAUD message containing the baud rate to switch to.
+     */
+    void set_baud_rate(message_t* msg);
+
+    /**
+     * Sets which parameters to send when they change, and how often at most, given a SUBSCRIBE message.
+     * The payload is a param bitmap followed by a 16-bit period in milliseconds for each param in it.
+     * Unsubscribed parameters are still sent in keyframes.
+     * Arguments:
+     *    msg: A SUBSCRIBE message.
+     */
+    void subscribe(message_t* msg);
+
+    /**
+     * Subscribes dev handler to every parameter as often as possible, as before any SUBSCRIBE.
+     */
+    void subscribe_all();
 };
 
 #endif
@@ -29,6 +29,14 @@ void GeneralSerial::begin(unsigned long baud) {
     }
 }
 
+void GeneralSerial::flush() {
+    if (is_hardware_serial) {
+        this->hw_serial_port->flush();
+    } else {
+        Serial.flush();
+    }
+}
+
 size_t GeneralSerial::write(const uint8_t byte) {
     if (is_hardware_serial) {
         return this->hw_serial_port->write(byte);
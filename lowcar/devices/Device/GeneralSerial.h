@@ -26,6 +26,7 @@ class GeneralSerial : public Stream {
     virtual int peek();
     virtual int available();
     virtual void begin(unsigned long baud);
+    virtual void flush();
     virtual size_t write(const uint8_t byte);
     virtual size_t write(const uint8_t* buffer, size_t size);
     virtual int read();
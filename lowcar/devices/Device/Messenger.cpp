@@ -9,20 +9,77 @@ const int Messenger::COBS_LEN_BYTES = 1;   // Bytes indicating the size of the c
 // Message sizes
 const int Messenger::MESSAGEID_BYTES = 1;     // Bytes in message ID field of packet
 const int Messenger::PAYLOAD_SIZE_BYTES = 1;  // Bytes in payload size field of packet
-const int Messenger::CHECKSUM_BYTES = 1;      // Bytes in checksum field of packet
+const int Messenger::MAX_CHECKSUM_BYTES = 2;  // Bytes in the largest checksum field of packet
 
 // Sizes for ACKNOWLEDGEMENT message
 const int Messenger::DEV_ID_TYPE_BYTES = 1;  // Bytes in device type field of dev id
 const int Messenger::DEV_ID_YEAR_BYTES = 1;  // Bytes in year field of dev id
 const int Messenger::DEV_ID_UID_BYTES = 8;   // Bytes in uid field of dev id
 
+// CRC-8 of each byte value (polynomial 0x07), kept in flash
+const uint8_t crc8_table[256] PROGMEM = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3};
+
+// CRC-16 of each byte value in the high byte (polynomial 0x1021), kept in flash
+const uint16_t crc16_table[256] PROGMEM = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0};
+
 // ************************* MESSENGER CLASS METHODS ************************ //
 
 Messenger::Messenger(bool is_hardware_serial, HardwareSerial* hw_serial_port) {
     // Get a new GeneralSerial object to use with this device (will be Serial by default, which is typical)
     // Then, open a serial (USB) connection on that port
     this->serial_object = new GeneralSerial(is_hardware_serial, hw_serial_port);
-    this->serial_object->begin(115200);
+    this->baud_rate = DEFAULT_BAUD_RATE;
+    this->serial_object->begin(this->baud_rate);
+    this->checksum_type = Checksum::XOR;
+    this->offered_checksums = 1 << (uint8_t) Checksum::XOR;
 
     // A queue initialized with room for 10 strings each of size MAX_PAYLOAD_SIZE
     this->log_queue_max_size = 10;
@@ -41,11 +98,17 @@ Status Messenger::send_message(MessageID msg_id, message_t* msg, dev_id_t* dev_i
      * Build the message
      * All other Message Types (DEVICE_DATA, LOG) should already be built (if needed)
      */
+    Checksum picked = this->checksum_type;
     if (msg_id == MessageID::ACKNOWLEDGEMENT) {
+        // The offer is used up by this ACKNOWLEDGEMENT
+        picked = pick_checksum();
+        this->offered_checksums = 1 << (uint8_t) Checksum::XOR;
+        msg->payload_length = 0;
         int status = 0;
         status += append_payload(msg, (uint8_t*) &dev_id->type, Messenger::DEV_ID_TYPE_BYTES);
         status += append_payload(msg, (uint8_t*) &dev_id->year, Messenger::DEV_ID_YEAR_BYTES);
         status += append_payload(msg, (uint8_t*) &dev_id->uid, Messenger::DEV_ID_UID_BYTES);
+        status += append_payload(msg, (uint8_t*) &picked, sizeof(picked));
 
         if (status != 0) {
             return Status::PROCESS_ERROR;
@@ -53,10 +116,11 @@ Status Messenger::send_message(MessageID msg_id, message_t* msg, dev_id_t* dev_i
     }
 
     // Serialize the message into byte array
-    size_t msg_len = Messenger::MESSAGEID_BYTES + Messenger::PAYLOAD_SIZE_BYTES + msg->payload_length + Messenger::CHECKSUM_BYTES;
+    size_t msg_len = Messenger::MESSAGEID_BYTES + Messenger::PAYLOAD_SIZE_BYTES + msg->payload_length + checksum_bytes();
     uint8_t data[msg_len];
     message_to_byte(data, msg);
-    data[msg_len - Messenger::CHECKSUM_BYTES] = checksum(data, msg_len - Messenger::CHECKSUM_BYTES);  // put the checksum into data
+    uint16_t chk = checksum(data, msg_len - checksum_bytes());
+    memcpy(&data[msg_len - checksum_bytes()], &chk, checksum_bytes());  // put the checksum into data (little-endian)
 
     // Cobs encode the byte array
     uint8_t cobs_buf[Messenger::DELIMITER_BYTES + Messenger::COBS_LEN_BYTES + msg_len + 1];  // Cobs encoding adds at most 1 byte overhead
@@ -72,6 +136,9 @@ Status Messenger::send_message(MessageID msg_id, message_t* msg, dev_id_t* dev_i
     msg->payload_length = 0;
     memset(msg->payload, 0, MAX_PAYLOAD_SIZE);
 
+    // The ACKNOWLEDGEMENT itself is sent with the checksum that dev handler expects before it
+    this->checksum_type = picked;
+
     return (written == Messenger::DELIMITER_BYTES + Messenger::COBS_LEN_BYTES + cobs_len) ? Status::SUCCESS : Status::PROCESS_ERROR;
 }
 
@@ -109,14 +176,21 @@ Status Messenger::read_message(message_t* msg) {
 
     // Decode the cobs-encoded message into a buffer
     uint8_t data[cobs_len];  // The decoded message will be smaller than COBS_LEN
-    cobs_decode(data, cobs_buf, cobs_len);
+    size_t data_len = cobs_decode(data, cobs_buf, cobs_len);
+    if (data_len < (size_t) (Messenger::MESSAGEID_BYTES + Messenger::PAYLOAD_SIZE_BYTES + checksum_bytes())) {
+        return Status::MALFORMED_DATA;
+    }
 
     uint8_t message_id = data[0];
     uint8_t payload_length = data[1];
+    if (payload_length > MAX_PAYLOAD_SIZE || data_len < (size_t) (Messenger::MESSAGEID_BYTES + Messenger::PAYLOAD_SIZE_BYTES + payload_length + checksum_bytes())) {
+        return Status::MALFORMED_DATA;
+    }
 
     // Verify that the received message has the correct checksum
-    uint8_t expected_chk = checksum(data, Messenger::MESSAGEID_BYTES + Messenger::PAYLOAD_SIZE_BYTES + payload_length);
-    uint8_t received_chk = data[Messenger::MESSAGEID_BYTES + Messenger::PAYLOAD_SIZE_BYTES + payload_length];
+    uint16_t expected_chk = checksum(data, Messenger::MESSAGEID_BYTES + Messenger::PAYLOAD_SIZE_BYTES + payload_length);
+    uint16_t received_chk = 0;
+    memcpy(&received_chk, &data[Messenger::MESSAGEID_BYTES + Messenger::PAYLOAD_SIZE_BYTES + payload_length], checksum_bytes());
     if (received_chk != expected_chk) {
         return Status::MALFORMED_DATA;
     }
@@ -128,6 +202,23 @@ Status Messenger::read_message(message_t* msg) {
     return Status::SUCCESS;
 }
 
+void Messenger::set_baud_rate(uint32_t baud_rate) {
+    if (baud_rate == this->baud_rate) {
+        return;
+    }
+    this->serial_object->flush();  // Wait for outgoing data to be sent at the old rate
+    this->serial_object->begin(baud_rate);
+    this->baud_rate = baud_rate;
+}
+
+void Messenger::set_checksum(Checksum checksum) {
+    this->checksum_type = checksum;
+}
+
+void Messenger::offer_checksums(message_t* offer) {
+    this->offered_checksums = (offer->payload_length > 0) ? offer->payload[0] : (1 << (uint8_t) Checksum::XOR);
+}
+
 void Messenger::lowcar_printf(char* format, ...) {
     // Double the queue size if it's full
     if (this->num_logs == this->log_queue_max_size) {
@@ -197,7 +288,20 @@ void Messenger::message_to_byte(uint8_t* data, message_t* msg) {
     memcpy(&data[2], msg->payload, msg->payload_length);
 }
 
-uint8_t Messenger::checksum(uint8_t* data, int length) {
+uint16_t Messenger::checksum(uint8_t* data, int length) {
+    if (this->checksum_type == Checksum::CRC8) {
+        uint8_t crc = 0x00;
+        for (int i = 0; i < length; i++) {
+            crc = pgm_read_byte(&crc8_table[crc ^ data[i]]);
+        }
+        return crc;
+    } else if (this->checksum_type == Checksum::CRC16) {
+        uint16_t crc = 0xFFFF;
+        for (int i = 0; i < length; i++) {
+            crc = (uint16_t) (crc << 8) ^ pgm_read_word(&crc16_table[(crc >> 8) ^ data[i]]);
+        }
+        return crc;
+    }
     uint8_t chk = data[0];
     for (int i = 1; i < length; i++) {
         chk ^= data[i];
@@ -205,6 +309,19 @@ uint8_t Messenger::checksum(uint8_t* data, int length) {
     return chk;
 }
 
+int Messenger::checksum_bytes() {
+    return (this->checksum_type == Checksum::CRC16) ? 2 : 1;
+}
+
+Checksum Messenger::pick_checksum() {
+    if (this->offered_checksums & (1 << (uint8_t) Checksum::CRC16)) {
+        return Checksum::CRC16;
+    } else if (this->offered_checksums & (1 << (uint8_t) Checksum::CRC8)) {
+        return Checksum::CRC8;
+    }
+    return Checksum::XOR;
+}
+
 // ***************************** COBS ENCODING ****************************** //
 
 #define finish_block()              \
@@ -244,13 +361,14 @@ size_t Messenger::cobs_decode(uint8_t* dst, const uint8_t* src, size_t src_len)
 
     while (src < end) {
         uint8_t code = *src++;
-        for (uint8_t i = 1; i < code; i++) {
-            *dst++ = *src++;
-            out_len++;
-            if (src > end) {  // Bad packet
-                return 0;
-            }
+        if (code == 0 || (size_t) (code - 1) > (size_t) (end - src)) {  // Bad packet
+            return 0;
         }
+        // Copy the whole block at once
+        memcpy(dst, src, code - 1);
+        dst += code - 1;
+        src += code - 1;
+        out_len += code - 1;
         if (code < 0xFF && src != end) {
             *dst++ = 0;
             out_len++;
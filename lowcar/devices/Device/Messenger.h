@@ -22,6 +22,8 @@ class Messenger {
     /**
      * Handles any type of message and fills in appropriate parameters, then sends onto Serial port
      * Clears all of MSG's fields before returning.
+     * An ACKNOWLEDGEMENT ends with the checksum picked from the ones that dev handler offered (see pick_checksum()),
+     * which is used for every message after it
      * Arguments:
      *    msg_id: The MessageID to populate msg->message_id
      *    msg: The message to send
@@ -40,6 +42,27 @@ class Messenger {
      */
     Status read_message(message_t* msg);
 
+    /**
+     * Switches the Serial connection to a new baud rate once everything already written has been sent
+     * Arguments:
+     *    baud_rate: The new baud rate
+     */
+    void set_baud_rate(uint32_t baud_rate);
+
+    /**
+     * Switches the checksum of messages sent and received, such as back to Checksum::XOR when dev handler goes away
+     * Arguments:
+     *    checksum: The new checksum
+     */
+    void set_checksum(Checksum checksum);
+
+    /**
+     * Records the checksums offered in a CHECKSUM_OFFER, to pick from when sending the next ACKNOWLEDGEMENT
+     * Arguments:
+     *    offer: The CHECKSUM_OFFER
+     */
+    void offer_checksums(message_t* offer);
+
     // ****************************** LOGGING ******************************* //
 
     /**
@@ -74,7 +97,7 @@ class Messenger {
 
     const static int MESSAGEID_BYTES;     // bytes in message ID field of packet
     const static int PAYLOAD_SIZE_BYTES;  // bytes in payload size field of packet
-    const static int CHECKSUM_BYTES;      // bytes in checksum field of packet
+    const static int MAX_CHECKSUM_BYTES;  // bytes in the largest checksum field of packet
 
     const static int DEV_ID_TYPE_BYTES;  // bytes in device type field of dev_id
     const static int DEV_ID_YEAR_BYTES;  // bytes in year field of dev_id
@@ -85,6 +108,9 @@ class Messenger {
     char** log_queue;              // The log queue
     uint8_t num_logs;              // The number of logs in the log queue
     GeneralSerial* serial_object;  // The Serial port to use (either Serial or Serial1)
+    uint32_t baud_rate;            // The baud rate of SERIAL_OBJECT
+    Checksum checksum_type;        // The checksum at the end of each message
+    uint8_t offered_checksums;     // Checksums offered by dev handler since the last ACKNOWLEDGEMENT (bit i is on iff Checksum i is offered)
 
     // *************************** HELPER METHODS *************************** //
 
@@ -111,14 +137,27 @@ class Messenger {
 
     /**
      * Computes the checksum of a data buffer.
-     * The checksum is the bitwise XOR of each byte in the buffer.
+     * The checksum is the bitwise XOR of each byte in the buffer, or a CRC computed with a table in flash,
+     * depending on CHECKSUM_TYPE
      * Arguments:
      *    data: The data buffer whose checksum is to be computed.
      *    length: the size of DATA
      * Returns:
-     *    the checksum
+     *    the checksum, of which the lowest checksum_bytes() bytes are sent
+     */
+    uint16_t checksum(uint8_t* data, int length);
+
+    /**
+     * Returns the size in bytes of the checksum field of packet
+     */
+    int checksum_bytes();
+
+    /**
+     * Picks the strongest checksum in OFFERED_CHECKSUMS; older dev handlers don't offer any, so only Checksum::XOR can be picked
+     * Returns:
+     *    the checksum to use after the ACKNOWLEDGEMENT
      */
-    uint8_t checksum(uint8_t* data, int length);
+    Checksum pick_checksum();
 
     // **************************** COBS ENCODING *************************** //
 
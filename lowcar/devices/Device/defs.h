@@ -10,12 +10,41 @@
 // Number of milliseconds between sending data to Runtime
 #define DATA_INTERVAL_MS 1
 
+// Number of milliseconds between sending every readable param (a keyframe); the DEVICE_DATA in between carry only params that changed
+#define KEYFRAME_INTERVAL_MS 100
+
+// Baud rate of the serial connection until dev handler asks for a higher one with a SET_BAUD
+#define DEFAULT_BAUD_RATE 115200
+
+// The highest baud rate that a SET_BAUD is accepted for
+#define MAX_BAUD_RATE 1000000
+
+// Number of milliseconds to wait for a message at the new baud rate before falling back to DEFAULT_BAUD_RATE
+#define BAUD_TIMEOUT_MS 500
+
 // The size of the param bitmap used in various messages (8 bits in a byte)
 #define PARAM_BITMAP_BYTES (MAX_PARAMS / 8)
 
+/* A bitmap of params, with bit i on iff param i is in it
+ * Its width follows MAX_PARAMS like bitmap_t in runtime; in a message, it takes the first PARAM_BITMAP_BYTES bytes
+ * of the payload (little-endian), so it must be copied in and out with memcpy()
+ */
+#if MAX_PARAMS > 56
+#error "messages with every param of a device don't fit in a payload of 255 bytes with more than 56 parameters"
+#elif MAX_PARAMS > 32
+typedef uint64_t param_bitmap_t;
+#else
+typedef uint32_t param_bitmap_t;
+#endif
+#define PARAM_BIT(i) (((param_bitmap_t) 1) << (i))  // param bitmap with only bit i on
+
+// Param bitmap of a device that dev handler hasn't sent a SUBSCRIBE yet (it gets every param)
+#define ALL_PARAMS_BITMAP (~((param_bitmap_t) 0) >> (sizeof(param_bitmap_t) * 8 - MAX_PARAMS))
+
 // Maximum size of a message payload
 // achieved with a DEVICE_WRITE/DEVICE_DATA of MAX_PARAMS of all floats
 #define MAX_PAYLOAD_SIZE (PARAM_BITMAP_BYTES + (MAX_PARAMS * sizeof(float)))
+static_assert(MAX_PAYLOAD_SIZE <= UINT8_MAX, "MAX_PAYLOAD_SIZE doesn't fit in message_t's payload_length; lower MAX_PARAMS");
 
 // Use these with uint8_t instead of `bool` with `true` and `false`
 // This makes device_read() and device_write() cleaner when parsing on C
@@ -48,7 +77,20 @@ enum class MessageID : uint8_t {
     DEVICE_WRITE = 0x03,     // To lowcar
     DEVICE_DATA = 0x04,      // To dev handler
     LOG = 0x05,              // To dev handler
-    RST = 0x06               // Between dev handler and lowcar
+    RST = 0x06,              // Between dev handler and lowcar
+    SET_BAUD = 0x07,         // Between dev handler and lowcar
+    SUBSCRIBE = 0x08,        // To lowcar
+    CHECKSUM_OFFER = 0x09    // To lowcar
+};
+
+/* The kinds of checksum at the end of a message (the same values as checksum_t in dev handler)
+ * dev handler offers the ones it supports in a CHECKSUM_OFFER right before its first DEVICE_PING (bit i is on iff
+ * Checksum i is offered), and we pick one and append it to our ACKNOWLEDGEMENT; both sides use XOR until then
+ */
+enum class Checksum : uint8_t {
+    XOR = 0,   // XOR of every byte
+    CRC8 = 1,  // CRC-8 with polynomial 0x07 and initial value 0x00
+    CRC16 = 2  // CRC-16 with polynomial 0x1021 and initial value 0xFFFF, little-endian
 };
 
 // identification for device types
@@ -1,6 +1,7 @@
 #include <connection.h>
 #include <gamestate_filter.h>
 #include <net_util.h>
+#include <realtime.h>
 
 /*
  * Sets up TCP listening socket on raspberry pi.
@@ -117,6 +118,7 @@ int main() {
         return 1;
     }
     shm_init();
+    realtime_init(NET_HANDLER);
 
     // TODO: Net Handler is in charge of regulating game states.
     // Net Handler may not have this responsibility in the future.
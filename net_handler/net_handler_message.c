@@ -1,5 +1,8 @@
 #include <net_handler_message.h>
 
+#define NUM_LINK_STATS 10                  // number of statistics of dev handler's link to a device that are sent for each device
+#define LINK_STATS_TYPE (MAX_DEVICES + 1)  // device type of the LinkStats entries in DevData (CustomData is MAX_DEVICES)
+
 // ******************************************* SEND MESSAGES ***************************************** //
 
 /*
@@ -85,6 +88,49 @@ void send_timestamp_msg(int conn_fd, TimeStamps* dawn_timestamp_msg) {
     free(send_buf);
 }
 
+/*
+ * Fills in the LinkStats entry of DevData for a device, which has the uid of the device and the statistics of
+ * dev handler's link to it (see device_read_link_stats()) as read-only INT params. This keeps them apart from the
+ * params of the device, so that the frontend can show the health of each link separately.
+ * The entry lives in static storage that is reused by every call, so it must not be freed.
+ * Arguments:
+ *    - uint64_t uid: uid of the device
+ *    - int dev_ix: index of the device in shared memory
+ * Returns:
+ *    the entry, or
+ *    NULL if the statistics of the device couldn't be read
+ */
+static Device* link_stats_device(uint64_t uid, int dev_ix) {
+    static char* names[NUM_LINK_STATS] = {"msgs_in_per_sec", "bytes_in_per_sec", "msgs_out_per_sec", "bytes_out_per_sec", "decode_errors", "checksum_errors", "resync_bytes", "write_backlog", "tx_drops", "handshake_rtt_us"};
+    static Device devices[MAX_DEVICES];
+    static Param params[MAX_DEVICES][NUM_LINK_STATS];
+    static Param* param_ptrs[MAX_DEVICES][NUM_LINK_STATS];
+
+    dev_link_stats_t stats;
+    if (device_read_link_stats(dev_ix, &stats) != 0) {
+        return NULL;
+    }
+    int32_t vals[NUM_LINK_STATS] = {stats.frames_in_per_sec, stats.bytes_in_per_sec, stats.frames_out_per_sec, stats.bytes_out_per_sec, stats.decode_errors, stats.checksum_errors, stats.resync_bytes, stats.write_backlog, stats.tx_drops, stats.handshake_rtt_us};
+
+    Device* device = &devices[dev_ix];
+    device__init(device);
+    device->name = "LinkStats";
+    device->type = LINK_STATS_TYPE;
+    device->uid = uid;
+    device->n_params = NUM_LINK_STATS;
+    device->params = param_ptrs[dev_ix];
+    for (int i = 0; i < NUM_LINK_STATS; i++) {
+        Param* param = &params[dev_ix][i];
+        param__init(param);
+        param->name = names[i];
+        param->val_case = PARAM__VAL_IVAL;
+        param->ival = vals[i];
+        param->readonly = true;  // Statistics of the link; Not an actual parameter
+        param_ptrs[dev_ix][i] = param;
+    }
+    return device;
+}
+
 /**
  * Sends a Device Data message to Dawn.
  * Arguments:
@@ -95,30 +141,30 @@ void send_device_data(int dawn_socket_fd, uint64_t dawn_start_time) {
     int len_pb;
     uint8_t* buffer;
 
-    dev_id_t dev_ids[MAX_DEVICES];
+    dev_snapshot_t snapshot;
     int valid_dev_idxs[MAX_DEVICES];
-    uint32_t catalog;
+    int sent_dev_idxs[MAX_DEVICES];  // index in shared memory of each device in dev_data
 
-    param_val_t custom_params[UCHAR_MAX];
-    param_type_t custom_types[UCHAR_MAX];
-    char custom_names[UCHAR_MAX][LOG_KEY_LENGTH];
-    uint8_t num_params;
+    // copy of the custom log data, kept between calls so that only what changed is copied from shared memory
+    static param_val_t custom_params[UCHAR_MAX];
+    static param_type_t custom_types[UCHAR_MAX];
+    static char custom_names[UCHAR_MAX][LOG_KEY_LENGTH];
+    static uint8_t num_params = 0;
+    static uint32_t custom_names_version = 0;
+    static uint32_t custom_values_version = 0;
 
     DevData dev_data = DEV_DATA__INIT;
 
-    // get information
-    get_catalog(&catalog);
-    get_device_identifiers(dev_ids);
+    // get a consistent copy of all connected devices and their data
+    device_read_all(NET_HANDLER, &snapshot);
 
     // calculate num_devices, get valid device indices
     int num_devices = 0;
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        if (catalog & (1 << i)) {
-            valid_dev_idxs[num_devices] = i;
-            num_devices++;
-        }
+    for (bitmap_t rest = snapshot.catalog; rest != 0;) {
+        valid_dev_idxs[num_devices] = bitmap_pop(&rest);
+        num_devices++;
     }
-    dev_data.devices = malloc((num_devices + 1) * sizeof(Device*));  // + 1 is for custom data
+    dev_data.devices = malloc((2 * num_devices + 1) * sizeof(Device*));  // + 1 is for custom data; each device also has a LinkStats entry
     if (dev_data.devices == NULL) {
         log_printf(FATAL, "send_device_data: Failed to malloc");
         exit(1);
@@ -128,9 +174,9 @@ void send_device_data(int dawn_socket_fd, uint64_t dawn_start_time) {
     int dev_idx = 0;
     for (int i = 0; i < num_devices; i++) {
         int idx = valid_dev_idxs[i];
-        device_t* device_info = get_device(dev_ids[idx].type);
+        device_t* device_info = get_device(snapshot.dev_ids[idx].type);
         if (device_info == NULL) {
-            log_printf(ERROR, "send_device_data: Device %d in SHM with type %d is invalid", idx, dev_ids[idx].type);
+            log_printf(ERROR, "send_device_data: Device %d in SHM with type %d is invalid", idx, snapshot.dev_ids[idx].type);
             continue;
         }
 
@@ -141,13 +187,13 @@ void send_device_data(int dawn_socket_fd, uint64_t dawn_start_time) {
         }
         device__init(device);
         dev_data.devices[dev_idx] = device;
-        device->type = dev_ids[idx].type;
-        device->uid = dev_ids[idx].uid;
+        sent_dev_idxs[dev_idx] = idx;
+        device->type = snapshot.dev_ids[idx].type;
+        device->uid = snapshot.dev_ids[idx].uid;
         device->name = device_info->name;
 
         device->n_params = 0;
-        param_val_t param_data[MAX_PARAMS];
-        device_read_uid(device->uid, NET_HANDLER, DATA, get_readable_param_bitmap(device->type), param_data);
+        param_val_t* param_data = snapshot.params[idx];
 
         device->params = malloc(device_info->num_params * sizeof(Param*));
         if (device->params == NULL) {
@@ -192,7 +238,7 @@ void send_device_data(int dawn_socket_fd, uint64_t dawn_start_time) {
     }
     device__init(custom);
     dev_data.devices[dev_idx] = custom;
-    log_data_read(&num_params, custom_names, custom_types, custom_params);
+    log_data_read_changed(&custom_names_version, &custom_values_version, &num_params, custom_names, custom_types, custom_params);
     custom->n_params = num_params + 1;  // + 1 is for the current time
     custom->params = malloc(sizeof(Param*) * custom->n_params);
     if (custom->params == NULL) {
@@ -240,6 +286,15 @@ void send_device_data(int dawn_socket_fd, uint64_t dawn_start_time) {
     time->readonly = true;                    // Just displays the time; Writing to this parameter doesn't make sense
 
     dev_data.n_devices = dev_idx + 1;  // + 1 is for custom data
+    size_t num_allocated = dev_data.n_devices;
+
+    // Add the statistics of the link to each device after the custom data
+    for (int i = 0; i < dev_idx; i++) {
+        Device* link_stats = link_stats_device(dev_data.devices[i]->uid, sent_dev_idxs[i]);
+        if (link_stats != NULL) {
+            dev_data.devices[dev_data.n_devices++] = link_stats;
+        }
+    }
 
     len_pb = dev_data__get_packed_size(&dev_data);
     buffer = make_buf(DEVICE_DATA_MSG, len_pb);
@@ -250,8 +305,8 @@ void send_device_data(int dawn_socket_fd, uint64_t dawn_start_time) {
         log_printf(ERROR, "send_device_data: sending log message over socket failed: %s", strerror(errno));
     }
 
-    // free everything
-    for (size_t i = 0; i < dev_data.n_devices; i++) {
+    // free everything (but the LinkStats entries, which are static)
+    for (size_t i = 0; i < num_allocated; i++) {
         for (size_t j = 0; j < dev_data.devices[i]->n_params; j++) {
             free(dev_data.devices[i]->params[j]);
         }
@@ -53,30 +53,25 @@ int main() {
     pie_args[4] = NULL;
 
     while (1) {
-        dev_id_t dev_ids[MAX_DEVICES];
+        dev_snapshot_t snapshot;
         int valid_dev_idxs[MAX_DEVICES];
-        uint32_t catalog;
         char total_command[128];
 
         // get information
-        get_catalog(&catalog);
-        get_device_identifiers(dev_ids);
+        device_read_all(NETWORK_SWITCH, &snapshot);
 
         // calculate num_devices, get valid device indices
         int num_devices = 0;
-        for (int i = 0; i < MAX_DEVICES; i++) {
-            if (catalog & (1 << i)) {
-                valid_dev_idxs[num_devices] = i;
-                num_devices++;
-            }
+        for (bitmap_t rest = snapshot.catalog; rest != 0;) {
+            valid_dev_idxs[num_devices] = bitmap_pop(&rest);
+            num_devices++;
         }
         // check if device index is PDB
         for (int i = 0; i < num_devices; i++) {
             int idx = valid_dev_idxs[i];
-            if (dev_ids[idx].type == 7) {
-                device_t* device = get_device(dev_ids[idx].type);
-                param_val_t param_data[MAX_PARAMS];
-                device_read(idx, NET_HANDLER, DATA, get_readable_param_bitmap(device->type), param_data);
+            if (snapshot.dev_ids[idx].type == 7) {
+                device_t* device = get_device(snapshot.dev_ids[idx].type);
+                param_val_t* param_data = snapshot.params[idx];
                 bool curr_switch_bool = param_data[device->num_params - 1].p_b;  // network switch value is the last parameter
                 int curr_switch;
                 if (curr_switch_bool) {
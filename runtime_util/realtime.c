@@ -0,0 +1,142 @@
+#define _GNU_SOURCE  // for sched_setaffinity, CPU_SET, and pthread_setattr_default_np
+
+#include <sched.h>     // for sched_setaffinity, SCHED_FIFO
+#include <sys/mman.h>  // for mlockall
+
+#include "realtime.h"
+
+#define NUM_RT_CONFIGS 4            // number of configuration parameters in the config file
+#define MAX_RT_CONFIG_LINE_LEN 256  // maximum length of a configuration file line, in chars
+
+// *********************************** REAL-TIME-SPECIFIC GLOBAL VARS **************************************** //
+
+bool rt_enabled = false;     // whether real-time mode is on
+int dev_io_priority = 0;     // SCHED_FIFO priority of device I/O threads
+cpu_set_t dev_handler_cpus;  // CPUs that dev_handler is pinned to
+cpu_set_t executor_cpus;     // CPUs that executor is pinned to
+
+// ************************************ HELPER FUNCTIONS ****************************************** //
+
+/**
+ * Parses a comma-separated list of CPU numbers read in from the configuration file.
+ * Arguments:
+ *    cpus: the set to put the CPUs in
+ *    important: string read in from the config file (ex. "2,3")
+ */
+static void set_cpus(cpu_set_t* cpus, char* important) {
+    CPU_ZERO(cpus);
+    for (char* cpu = strtok(important, ","); cpu != NULL; cpu = strtok(NULL, ",")) {
+        CPU_SET(atoi(cpu), cpus);
+    }
+}
+
+/**
+ * Reads the real-time configuration file. Finds it the same way as the logger finds its configuration file,
+ * as long as the configuration file is in the same folder as this file. If the file can't be read, real-time mode stays off.
+ */
+static void read_config_file() {
+    char nextline[MAX_RT_CONFIG_LINE_LEN];
+    char not_important[128], important[128];  // for holding information read from the file
+    char important_char;
+    FILE* conf_fd;
+
+    // this logic gets the path of the real-time config file
+    char file_buf[128] = {0};
+    sprintf(file_buf, "%s", __FILE__);    // __FILE__ is the path of this file on the system
+    char* last = strrchr(file_buf, '/');  // use strrchr to get location of last '/' in path
+    strcpy(last + 1, RT_CONFIG_FILE);     // append RT_CONFIG_FILE to that path to get the path to config file
+
+    if ((conf_fd = fopen(file_buf, "r")) == NULL) {  // open the config file for reading
+        log_printf(ERROR, "realtime: could not open config file %s, real-time mode is off: %s", file_buf, strerror(errno));
+        return;
+    }
+
+    for (int i = 0; i < NUM_RT_CONFIGS; i++) {
+        // read until the next line read is not a comment or a blank line
+        do {
+            if (fgets(nextline, MAX_RT_CONFIG_LINE_LEN, conf_fd) == NULL) {
+                log_printf(ERROR, "realtime: end of config file reached before all configurations read, real-time mode is off");
+                rt_enabled = false;
+                fclose(conf_fd);
+                return;
+            }
+        } while (nextline[0] == '\n' || (nextline[0] == '/' && nextline[1] == '/'));
+
+        // get the configuration parameter in nextline sequentially
+        switch (i) {
+            case 0:
+                sscanf(nextline, "REALTIME: %c%s", &important_char, not_important);
+                rt_enabled = (important_char == 'Y' || important_char == 'y');
+                break;
+            case 1:
+                sscanf(nextline, "DEV_IO_PRIORITY: %d", &dev_io_priority);
+                break;
+            case 2:
+                sscanf(nextline, "DEV_HANDLER_CPUS: %s", important);
+                set_cpus(&dev_handler_cpus, important);
+                break;
+            case 3:
+                sscanf(nextline, "EXECUTOR_CPUS: %s", important);
+                set_cpus(&executor_cpus, important);
+                break;
+        }
+    }
+    fclose(conf_fd);
+}
+
+// ************************************ PUBLIC REAL-TIME FUNCTIONS ****************************************** //
+
+void realtime_init(process_t process) {
+    read_config_file();
+    if (!rt_enabled) {
+        return;
+    }
+
+    /* every thread stack is locked whole once memory is locked, so keep dev_handler's many device threads small
+     * (only dev_handler's: student code inherits executor's default, and its Python threads may recurse deeply) */
+    if (process == DEV_HANDLER) {
+        pthread_attr_t attr;
+        int err;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, RT_THREAD_STACK_SIZE);
+        if ((err = pthread_setattr_default_np(&attr)) != 0) {
+            log_printf(WARN, "realtime: couldn't set thread stack size: %s", strerror(err));
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    // lock (and fault in) everything mapped so far, including shared memory, and everything mapped from now on
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        log_printf(WARN, "realtime: couldn't lock memory: %s", strerror(errno));
+    } else {
+        log_printf(INFO, "realtime: memory locked and shared memory prefaulted");
+    }
+
+    // pin the process (and every thread and child it creates from now on) to its CPUs
+    cpu_set_t* cpus = (process == DEV_HANDLER) ? &dev_handler_cpus : (process == EXECUTOR) ? &executor_cpus : NULL;
+    if (cpus != NULL) {
+        if (sched_setaffinity(0, sizeof(cpu_set_t), cpus) == -1) {
+            log_printf(WARN, "realtime: couldn't pin to CPUs: %s", strerror(errno));
+        } else {
+            log_printf(INFO, "realtime: pinned to %d CPUs", CPU_COUNT(cpus));
+        }
+    }
+}
+
+bool realtime_configured() {
+    read_config_file();
+    return rt_enabled;
+}
+
+void realtime_thread(char* thread_desc) {
+    if (!rt_enabled) {
+        return;
+    }
+    struct sched_param param = {.sched_priority = dev_io_priority};
+    int err;
+    if ((err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0) {
+        log_printf(WARN, "realtime: couldn't make %s SCHED_FIFO: %s", thread_desc, strerror(err));
+    } else {
+        log_printf(DEBUG, "realtime: %s is SCHED_FIFO with priority %d", thread_desc, dev_io_priority);
+    }
+}
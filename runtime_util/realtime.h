@@ -0,0 +1,39 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <logger.h>        // for logger
+#include <runtime_util.h>  // for process_t
+
+#define RT_CONFIG_FILE "realtime.config"  // name of the real-time configuration file, in the same folder as this file
+
+#define RT_THREAD_STACK_SIZE (256 * 1024)  // size in bytes of dev_handler's thread stacks in real-time mode, where every stack is locked into memory whole
+
+// ************************************ PUBLIC REAL-TIME FUNCTIONS ****************************************** //
+
+/**
+ * Call at process start, after logger_init() and shm_init(), to apply the real-time profile in the configuration file.
+ * Does nothing unless real-time mode is turned on there. Otherwise, locks all current and future memory of the process
+ * (which prefaults the shared memory mapped by shm_init()) and pins the process to the CPUs configured for it.
+ * In dev_handler, also shrinks the default thread stack size to RT_THREAD_STACK_SIZE.
+ * Logs whether each setting took effect; a setting that didn't take effect is not fatal.
+ * Arguments:
+ *    process: one of the processes defined in runtime_util; selects the CPUs to pin to (and whether to shrink stacks)
+ */
+void realtime_init(process_t process);
+
+/**
+ * Reads the configuration file without applying anything (ex. for a test whose expectations depend on the profile)
+ * Returns:
+ *    true iff real-time mode is turned on in the configuration file
+ */
+bool realtime_configured();
+
+/**
+ * Call at the start of a device I/O thread to give it the configured SCHED_FIFO priority,
+ * so that it preempts student code and other normal threads. Does nothing unless real-time mode is on.
+ * Arguments:
+ *    thread_desc: description of the calling thread, used in logs
+ */
+void realtime_thread(char* thread_desc);
+
+#endif
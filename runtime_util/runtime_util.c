@@ -248,15 +248,15 @@ char* get_device_name(uint8_t dev_type) {
     return device->name;
 }
 
-uint32_t get_readable_param_bitmap(uint8_t dev_type) {
+bitmap_t get_readable_param_bitmap(uint8_t dev_type) {
     device_t* device = get_device(dev_type);
     if (device == NULL) {
         return 0;
     }
-    uint32_t readable_param_bitmap = 0;
+    bitmap_t readable_param_bitmap = 0;
     for (int i = 0; i < device->num_params; i++) {
-        if (device->params->read) {
-            readable_param_bitmap |= (1 << i);
+        if (device->params[i].read) {
+            readable_param_bitmap |= BITMAP_BIT(i);
         }
     }
     return readable_param_bitmap;
@@ -297,9 +297,9 @@ param_id_t* get_params_to_kill(uint8_t* num_devices_with_params_to_kill) {
      */
     param_id_t params_to_kill[] = {
         {.device_type = KoalaBear.type,
-         .param_bitmap = (1 << get_param_idx(KoalaBear.type, "velocity_a") | (1 << get_param_idx(KoalaBear.type, "velocity_b")))},
+         .param_bitmap = BITMAP_BIT(get_param_idx(KoalaBear.type, "velocity_a")) | BITMAP_BIT(get_param_idx(KoalaBear.type, "velocity_b"))},
         {.device_type = SimpleTestDevice.type,
-         .param_bitmap = 1 << get_param_idx(SimpleTestDevice.type, "MY_INT")},
+         .param_bitmap = BITMAP_BIT(get_param_idx(SimpleTestDevice.type, "MY_INT"))},
     };
     // This properly calculates the length of the array
     *num_devices_with_params_to_kill = sizeof(params_to_kill) / sizeof(param_id_t);
@@ -315,7 +315,7 @@ uint8_t is_param_to_kill(uint8_t dev_type, char* param_name) {
     uint8_t ret = 0;
     for (uint8_t i = 0; i < num_devices_with_params_to_kill; i++) {
         if (dev_type == params_to_kill[i].device_type) {  // There's a match for a device with param to kill
-            uint32_t bit = 1 << get_param_idx(dev_type, param_name);
+            bitmap_t bit = BITMAP_BIT(get_param_idx(dev_type, param_name));
             if (bit & params_to_kill[i].param_bitmap) {  // There's a match for the specific parameter
                 ret = 1;
                 break;
@@ -344,7 +344,7 @@ char** get_joystick_names() {
 uint64_t get_button_bit(char* button_name) {
     for (int i = 0; i < NUM_GAMEPAD_BUTTONS; i++) {
         if (strcmp(button_name, BUTTON_NAMES[i]) == 0) {
-            return 1 << i;
+            return ((uint64_t) 1) << i;
         }
     }
     return -1;
@@ -361,7 +361,7 @@ char** get_key_names() {
 uint64_t get_key_bit(char* key_name) {
     for (int i = 0; i < NUM_KEYBOARD_BUTTONS; i++) {
         if (strcmp(key_name, KEY_NAMES[i]) == 0) {
-            return 1 << i;
+            return ((uint64_t) 1) << i;
         }
     }
     return -1;
@@ -404,6 +404,12 @@ uint64_t millis() {
     return s1 + s2;
 }
 
+uint64_t monotonic_millis() {
+    struct timespec time;  // Holds the current time in seconds + nanoseconds
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) (time.tv_sec) * 1000 + time.tv_nsec / 1000000;
+}
+
 // ********************* READ/WRITE TO FILE DESCRIPTOR ********************** //
 
 int readn(int fd, void* buf, uint16_t n) {
@@ -16,6 +16,7 @@
 #include <sys/stat.h>    // for various system-related types and functions (sem_t, mkfifo)
 #include <sys/time.h>    // for time-related structures and time functions
 #include <sys/un.h>      // for struct sockaddr_un
+#include <time.h>        // for clock_gettime
 #include <unistd.h>      // for F_OK, R_OK, SEEK_SET, SEEK_END, access, ftruncate, read, write, etc.
 
 // ***************************** DEFINED CONSTANTS ************************** //
@@ -98,6 +99,45 @@ typedef enum param_type {
     BOOL
 } param_type_t;
 
+// ********************************* BITMAPS ******************************** //
+
+/* A bitmap with one bit per device (such as the catalog) or one bit per parameter of a device.
+ * Its width follows MAX_DEVICES and MAX_PARAMS, so raising either past 32 only needs a rebuild, up to 64 devices
+ * and 56 params: a DEVICE_DATA or DEVICE_WRITE with every param must fit in a payload whose length is one byte
+ * (see MAX_PAYLOAD_SIZE in dev_handler_message.h).
+ */
+#if MAX_DEVICES > 64
+#error "bitmap_t can't hold more than 64 devices"
+#elif MAX_PARAMS > 56
+#error "messages with every param of a device don't fit in a payload of 255 bytes with more than 56 parameters"
+#elif (MAX_DEVICES > 32) || (MAX_PARAMS > 32)
+typedef uint64_t bitmap_t;
+#else
+typedef uint32_t bitmap_t;
+#endif
+
+#define BITMAP_BIT(i) (((bitmap_t) 1) << (i))                                               // bitmap with only bit i on
+#define BITMAP_LOW(n) (((n) == 0) ? 0 : (~((bitmap_t) 0) >> (sizeof(bitmap_t) * 8 - (n))))  // bitmap with bits 0 to n - 1 on
+#define ALL_PARAMS BITMAP_LOW(MAX_PARAMS)                                                   // bitmap with the bit of every param on
+
+/**
+ * Returns the index of the lowest bit that is on in a bitmap, and turns that bit off.
+ * Iterates over the bits that are on in one step per bit that is on, instead of one step per bit:
+ *    for (bitmap_t rest = bitmap; rest != 0;) {
+ *        int i = bitmap_pop(&rest);
+ *        ...
+ *    }
+ * Arguments:
+ *    rest: bitmap to take the lowest bit from; must not be 0
+ * Returns:
+ *    index of the bit that was turned off
+ */
+static inline int bitmap_pop(bitmap_t* rest) {
+    int i = (sizeof(bitmap_t) > sizeof(unsigned int)) ? __builtin_ctzll(*rest) : __builtin_ctz(*rest);
+    *rest &= *rest - 1;
+    return i;
+}
+
 // ***************************** CUSTOM STRUCTS ***************************** //
 
 // hold a single param value. One-to-one mapping to param_val_t enum
@@ -126,7 +166,7 @@ typedef struct param_desc {
 // when the robot needs to be emergency stopped (ex: motor velocities)
 typedef struct param_id {
     uint8_t device_type;    // The type of the device that should have params killed
-    uint32_t param_bitmap;  // Bitmap of parameters that should be killd
+    bitmap_t param_bitmap;  // Bitmap of parameters that should be killd
 } param_id_t;
 
 // A struct defining a kind of device (ex: LimitSwitch, KoalaBear)
@@ -176,7 +216,7 @@ char* get_device_name(uint8_t dev_type);
  * Returns:
  *    bitmap where the i-th bit is on iff the i-th parameter exists and is readable
  */
-uint32_t get_readable_param_bitmap(uint8_t dev_type);
+bitmap_t get_readable_param_bitmap(uint8_t dev_type);
 
 /**
  * Returns a parameter descriptor.
@@ -274,6 +314,12 @@ char* field_to_string(robot_desc_field_t field);
  */
 uint64_t millis();
 
+/**
+ * Returns the number of milliseconds on the monotonic clock, which is unaffected by changes to the system time.
+ * Only differences between two values are meaningful.
+ */
+uint64_t monotonic_millis();
+
 // ********************* READ/WRITE TO FILE DESCRIPTOR ********************** //
 
 /**
@@ -0,0 +1,104 @@
+#include <shm_wrapper.h>
+
+#define PERCENTILE 99  // percentile of wait and hold times that is printed
+
+// ************************************ STATS UTILITY *********************************************** //
+
+/**
+ * Returns the upper bound, in microseconds, of the histogram bucket that holds the given percentile of a histogram.
+ * Arguments:
+ *    hist: the histogram; see sem_stats_t for its buckets
+ *    percentile: the percentile to find, from 0 to 100
+ * Returns the upper bound in microseconds, 0 if the histogram is empty, or -1 if the percentile is in the last (unbounded) bucket.
+ */
+static long hist_percentile_us(_Atomic uint32_t hist[SEM_STATS_BUCKETS], int percentile) {
+    uint64_t total = 0, seen = 0;
+    for (int i = 0; i < SEM_STATS_BUCKETS; i++) {
+        total += hist[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    for (int i = 0; i < SEM_STATS_BUCKETS - 1; i++) {
+        seen += hist[i];
+        if (seen * 100 >= total * percentile) {
+            return 1L << i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Formats a percentile returned by hist_percentile_us() for printing.
+ * Arguments:
+ *    us: the percentile
+ *    buf: buffer of at least 16 bytes the formatted percentile will be put in
+ * Returns BUF.
+ */
+static char* format_percentile(long us, char* buf) {
+    if (us == 0) {
+        strcpy(buf, "-");
+    } else if (us == -1) {
+        sprintf(buf, ">%ld", 1L << (SEM_STATS_BUCKETS - 2));
+    } else {
+        sprintf(buf, "<%ld", us);
+    }
+    return buf;
+}
+
+/**
+ * Prints the statistics of every lock that was acquired since statistics were last reset.
+ */
+static void print_stats() {
+    sem_stats_t stats;
+    char name[SNAME_SIZE];
+    char wait_buf[16], hold_buf[16];
+
+    printf("Lock statistics are %s\n", atomic_load(&sem_stats_shm_ptr->enabled) ? "on" : "off");
+    printf("%-12s %12s %12s %12s %12s %12s %12s\n", "lock", "acquired", "contended", "avg wait us", "p99 wait us", "avg hold us", "p99 hold us");
+    for (int i = 0; i < NUM_SHM_LOCKS; i++) {
+        sem_stats_read(i, &stats);
+        if (stats.acquisitions == 0) {
+            continue;
+        }
+        sem_stats_name(i, name);
+        printf("%-12s %12llu %12llu %12.1f %12s %12.1f %12s\n", name, (unsigned long long) stats.acquisitions, (unsigned long long) stats.contended,
+               (stats.contended == 0) ? 0.0 : (double) stats.wait_ns / stats.contended / 1000,
+               format_percentile(hist_percentile_us(stats.wait_hist, PERCENTILE), wait_buf),
+               (double) stats.hold_ns / stats.acquisitions / 1000,
+               format_percentile(hist_percentile_us(stats.hold_hist, PERCENTILE), hold_buf));
+    }
+}
+
+/**
+ * This program turns the collection of lock statistics on or off, resets them, or prints them.
+ * Usage:
+ *    sem_stats          print the statistics of every lock that was acquired since they were last reset
+ *    sem_stats on       reset the statistics and start collecting them
+ *    sem_stats off      stop collecting statistics (the collected ones can still be printed)
+ *    sem_stats reset    reset the statistics
+ */
+int main(int argc, char** argv) {
+    // set up
+    logger_init(SHM);
+    shm_init();
+
+    if (argc == 1) {
+        print_stats();
+    } else if (strcmp(argv[1], "on") == 0) {
+        if (!SEM_STATS) {
+            printf("Lock statistics were compiled out (SEM_STATS is 0)\n");
+            return 1;
+        }
+        sem_stats_reset();
+        sem_stats_enable(true);
+    } else if (strcmp(argv[1], "off") == 0) {
+        sem_stats_enable(false);
+    } else if (strcmp(argv[1], "reset") == 0) {
+        sem_stats_reset();
+    } else {
+        printf("Usage: %s [on | off | reset]\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}
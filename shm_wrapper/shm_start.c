@@ -1,28 +1,24 @@
 #include <shm_wrapper.h>
 
-char sname[SNAME_SIZE];  // being lazy here but this is for holding all the semaphore names
-
 // ************************************ SHM UTILITY *********************************************** //
 
 /**
- * Custom wrapper function for sem_open with create flag. Prints out descriptive logging message on failure
- * exits (not being able to create and open a semaphore is fatal to Runtime).
+ * Initializes one of the locks in shared memory as a process-shared, robust mutex.
+ * Prints out descriptive logging message on failure and exits (not being able to create a lock is fatal to Runtime).
  * Arguments:
- *    sem_name: name of a semaphore to be created and opened
- *    sem_desc: string that describes the semaphore being created and opened, displayed with error message
- * Returns a pointer to the semaphore that was created and opened.
+ *    lock_ix: index of the lock to initialize (one of the SHM_LOCK_* defines)
+ *    attr: attributes to initialize the mutex with
  */
-static sem_t* my_sem_open_create(char* sem_name, char* sem_desc) {
-    sem_t* ret;
-    if ((ret = sem_open(sem_name, O_CREAT, 0660, 1)) == SEM_FAILED) {
-        log_printf(FATAL, "sem_open: %s. %s", sem_desc, strerror(errno));
+static void my_mutex_init(int lock_ix, pthread_mutexattr_t* attr) {
+    int err;
+    if ((err = pthread_mutex_init(&shm_ptr->locks[lock_ix].mutex, attr)) != 0) {
+        log_printf(FATAL, "pthread_mutex_init: lock %d. %s", lock_ix, strerror(err));
         exit(1);
     }
-    return ret;
 }
 
 /**
- * This program creates and opens all of the shared memory blocks and associated semaphores.
+ * This program creates and maps the shared memory segment and the locks in it.
  * Must run before net_handler, dev_handler, or executor connect to it.
  * Initializes shared memory blocks to default values.
  */
@@ -32,99 +28,72 @@ int main() {
 
     int fd_shm;
 
-    // create all semaphores with initial value 1
-    catalog_sem = my_sem_open_create(CATALOG_MUTEX_NAME, "catalog mutex");
-    cmd_map_sem = my_sem_open_create(CMDMAP_MUTEX_NAME, "cmd map mutex");
-    input_sem = my_sem_open_create(INPUTS_MUTEX_NAME, "inputs mutex");
-    rd_sem = my_sem_open_create(RD_MUTEX_NAME, "robot desc mutex");
-    log_data_sem = my_sem_open_create(LOG_DATA_MUTEX, "log data mutex");
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        generate_sem_name(DATA, i, sname);  // get the data name
-        if ((sems[i].data_sem = sem_open((const char*) sname, O_CREAT, 0660, 1)) == SEM_FAILED) {
-            log_printf(FATAL, "sem_open: data sem for dev_ix %d: %s", i, strerror(errno));
-            exit(1);
-        }
-        generate_sem_name(COMMAND, i, sname);  // get the command name
-        if ((sems[i].command_sem = sem_open((const char*) sname, O_CREAT, 0660, 1)) == SEM_FAILED) {
-            log_printf(FATAL, "sem_open: command sem for dev_ix %d: %s", i, strerror(errno));
-            exit(1);
-        }
-    }
-
-    // create device shm block
-    if ((fd_shm = shm_open(DEV_SHM_NAME, O_RDWR | O_CREAT, 0660)) == -1) {
-        log_printf(FATAL, "shm_open devices: %s", strerror(errno));
-        exit(1);
-    }
-    if (ftruncate(fd_shm, sizeof(dev_shm_t)) == -1) {
-        log_printf(FATAL, "ftruncate devices: %s", strerror(errno));
-        exit(1);
-    }
-    if ((dev_shm_ptr = mmap(NULL, sizeof(dev_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_shm, 0)) == MAP_FAILED) {
-        log_printf(FATAL, "mmap devices: %s", strerror(errno));
-        exit(1);
-    }
-    if (close(fd_shm) == -1) {
-        log_printf(ERROR, "close devices: %s", strerror(errno));
-    }
-
-    // create inputs shm block
-    if ((fd_shm = shm_open(INPUTS_SHM_NAME, O_RDWR | O_CREAT, 0660)) == -1) {
-        log_printf(FATAL, "shm_open input_shm: %s", strerror(errno));
-        exit(1);
-    }
-    if (ftruncate(fd_shm, sizeof(input_shm_t)) == -1) {
-        log_printf(FATAL, "ftruncate input_shm: %s", strerror(errno));
-        exit(1);
-    }
-    if ((input_shm_ptr = mmap(NULL, sizeof(input_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_shm, 0)) == MAP_FAILED) {
-        log_printf(FATAL, "mmap input_shm: %s", strerror(errno));
+    // remove a segment left over by a previous run, so that no process still mapping it sees it being reinitialized
+    if (shm_unlink(SHM_NAME) == -1 && errno != ENOENT) {
+        log_printf(FATAL, "shm_unlink: %s", strerror(errno));
         exit(1);
     }
-    if (close(fd_shm) == -1) {
-        log_printf(ERROR, "close input_shm: %s", strerror(errno));
-    }
 
-    // create robot description shm block
-    if ((fd_shm = shm_open(ROBOT_DESC_SHM_NAME, O_RDWR | O_CREAT, 0660)) == -1) {
-        log_printf(FATAL, "shm_open robot_desc_shm: %s", strerror(errno));
+    // create the shm segment
+    if ((fd_shm = shm_open(SHM_NAME, O_RDWR | O_CREAT | O_EXCL, 0660)) == -1) {
+        log_printf(FATAL, "shm_open: %s", strerror(errno));
         exit(1);
     }
-    if (ftruncate(fd_shm, sizeof(robot_desc_shm_t)) == -1) {
-        log_printf(FATAL, "ftruncate robot_desc_shm: %s", strerror(errno));
+    if (ftruncate(fd_shm, sizeof(shm_segment_t)) == -1) {
+        log_printf(FATAL, "ftruncate: %s", strerror(errno));
         exit(1);
     }
-    if ((rd_shm_ptr = mmap(NULL, sizeof(robot_desc_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_shm, 0)) == MAP_FAILED) {
-        log_printf(FATAL, "mmap robot_desc_shm: %s", strerror(errno));
+    if ((shm_ptr = mmap(NULL, sizeof(shm_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_shm, 0)) == MAP_FAILED) {
+        log_printf(FATAL, "mmap: %s", strerror(errno));
         exit(1);
     }
     if (close(fd_shm) == -1) {
-        log_printf(ERROR, "close robot_desc_shm: %s", strerror(errno));
+        log_printf(ERROR, "close: %s", strerror(errno));
     }
+    dev_shm_ptr = &shm_ptr->devices;
+    input_shm_ptr = &shm_ptr->inputs;
+    rd_shm_ptr = &shm_ptr->robot_desc;
+    log_data_shm_ptr = &shm_ptr->log_data;
+    sem_stats_shm_ptr = &shm_ptr->sem_stats;
 
-    // create log data shm block
-    if ((fd_shm = shm_open(LOG_DATA_SHM, O_RDWR | O_CREAT, 0660)) == -1) {
-        log_printf(FATAL, "shm_open log_data_shm: %s", strerror(errno));
-        exit(1);
-    }
-    if (ftruncate(fd_shm, sizeof(log_data_shm_t)) == -1) {
-        log_printf(FATAL, "ftruncate log_data_shm: %s", strerror(errno));
-        exit(1);
-    }
-    if ((log_data_shm_ptr = mmap(NULL, sizeof(log_data_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_shm, 0)) == MAP_FAILED) {
-        log_printf(FATAL, "mmap log_data_shm: %s", strerror(errno));
-        exit(1);
-    }
-    if (close(fd_shm) == -1) {
-        log_printf(ERROR, "close log_data_shm: %s", strerror(errno));
-    }
+    // create all locks; a lock whose holder dies is handed to the next locker to recover instead of staying locked forever
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    for (int i = 0; i < NUM_SHM_LOCKS; i++) {
+        my_mutex_init(i, &attr);
+    }
+    pthread_mutexattr_destroy(&attr);
 
     // initialize everything
     dev_shm_ptr->catalog = 0;
+    atomic_init(&dev_shm_ptr->catalog_gen, 0);
     for (int i = 0; i < MAX_DEVICES + 1; i++) {
-        dev_shm_ptr->cmd_map[i] = 0;
+        atomic_init(&dev_shm_ptr->cmd_map[i], 0);
+    }
+    atomic_init(&dev_shm_ptr->cmd_doorbell, 0);
+    for (int i = 0; i < UID_INDEX_SIZE; i++) {
+        atomic_init(&dev_shm_ptr->uid_index[i].gen, 0);
+        dev_shm_ptr->uid_index[i].state = UID_SLOT_EMPTY;
+    }
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        atomic_init(&dev_shm_ptr->streams[DATA][i].seq, 0);
+        atomic_init(&dev_shm_ptr->streams[COMMAND][i].doorbell, 0);
+        atomic_init(&dev_shm_ptr->history[i].head, 0);
+        atomic_init(&dev_shm_ptr->history[i].first, 0);
+        for (int j = 0; j < DEV_HISTORY_LEN; j++) {
+            atomic_init(&dev_shm_ptr->history[i].slots[j].gen, 0);
+        }
+        for (int j = 0; j < NUM_READERS; j++) {
+            atomic_init(&dev_shm_ptr->interest[i].params[j], 0);
+            atomic_init(&dev_shm_ptr->interest[i].num_reads[j], 0);
+            atomic_init(&dev_shm_ptr->interest[i].last_read[j], 0);
+        }
     }
     for (int j = 0; j < 2; j++) {
+        atomic_init(&input_shm_ptr->inputs[j].seq, 0);
+        input_shm_ptr->inputs[j].timestamp = 0;
         input_shm_ptr->inputs[j].buttons = 0;
         for (int i = 0; i < 4; i++) {
             input_shm_ptr->inputs[j].joysticks[i] = 0.0;
@@ -138,9 +107,23 @@ int main() {
     rd_shm_ptr->fields[GAMEPAD] = DISCONNECTED;
     rd_shm_ptr->fields[KEYBOARD] = DISCONNECTED;
     rd_shm_ptr->fields[START_POS] = LEFT;
+    atomic_init(&rd_shm_ptr->seq, 0);
+    for (int i = 0; i < NUM_DESC_FIELDS; i++) {
+        atomic_init(&rd_shm_ptr->field_seqs[i], 0);
+    }
 
     memset(log_data_shm_ptr, 0, sizeof(log_data_shm_t));
 
+    // lock statistics start off (and zeroed)
+    atomic_init(&sem_stats_shm_ptr->enabled, 0);
+    sem_stats_reset();
+    for (int i = 0; i < NUM_SHM_LOCKS; i++) {
+        sem_stats_shm_ptr->sems[i].acquired_at = 0;
+    }
+
+    // processes refuse to map the segment until this is set, so it goes last
+    atomic_store_explicit(&shm_ptr->layout_version, SHM_LAYOUT_VERSION, memory_order_release);
+
     log_printf(INFO, "SHM created");
 
     return 0;  // returns to start everything
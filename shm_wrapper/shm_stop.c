@@ -1,67 +1,20 @@
 #include <shm_wrapper.h>
 
-char sname[SNAME_SIZE];  // being lazy here but this is for holding all the semaphore names
-
 // *********************************** SHM PROCESS UTILITIES *********************************************** //
 
 /**
- * Unlinks a block of shared memory (so it will be removed from the system once all processes call shm_close() on it)
- * Arguments:
- *    shm_name: name of shared memory block (ex. "/dev-shm")
- *    shm_desc: description of shared memory block, to be printed with descriptive error message should shm_unlink() fail
- */
-static void my_shm_unlink(char* shm_name, char* shm_desc) {
-    if (shm_unlink(shm_name) == -1) {
-        log_printf(ERROR, "shm_unlink: %s. %s", shm_desc, strerror(errno));
-    }
-}
-
-/**
- * Unlinks a semaphore (so it will be removed from the system once all processes call sem_close() on it)
- * Arguments:
- *    sem_name: name of semaphore (ex. "/ct-mutex")
- *    sem_desc: description of semaphore, to be printed with descriptive error message should sem_unlink() fail
- */
-static void my_sem_unlink(char* sem_name, char* sem_desc) {
-    if (sem_unlink(sem_name) == -1) {
-        log_printf(ERROR, "sem_unlink: %s. %s", sem_desc, strerror(errno));
-    }
-}
-
-/**
- * This program unlinks all of the shared memory blocks and associated semaphores.
+ * This program unlinks the shared memory segment (the locks in it go away with it).
  * Must run after net_handler, dev_handler, or executor terminate during reboot
  */
 int main() {
-    // init the logger and shared memory
+    // init the logger; shared memory isn't mapped, so that a segment with a stale layout can still be removed
     logger_init(SHM);
-    shm_init();
-
-    // unlink all shared memory blocks
-    my_shm_unlink(DEV_SHM_NAME, "dev_shm");
-    my_shm_unlink(INPUTS_SHM_NAME, "input_shm");
-    my_shm_unlink(ROBOT_DESC_SHM_NAME, "robot_desc_shm");
-    my_shm_unlink(LOG_DATA_SHM, "log_data_shm");
 
-    // unlink all semaphores
-    my_sem_unlink(CATALOG_MUTEX_NAME, "catalog mutex");
-    my_sem_unlink(CMDMAP_MUTEX_NAME, "cmd map mutex");
-    my_sem_unlink(INPUTS_MUTEX_NAME, "input mutex");
-    my_sem_unlink(RD_MUTEX_NAME, "robot desc mutex");
-    my_sem_unlink(LOG_DATA_MUTEX, "log data mutex");
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        generate_sem_name(DATA, i, sname);
-        if (sem_unlink((const char*) sname) == -1) {
-            log_printf(ERROR, "sem_unlink: data_sem for dev_ix %d. %s", i, strerror(errno));
-        }
-        generate_sem_name(COMMAND, i, sname);
-        if (sem_unlink((const char*) sname) == -1) {
-            log_printf(ERROR, "sem_unlink: command_sem for dev_ix %d. %s", i, strerror(errno));
-        }
+    // unlink the shared memory segment (so it will be removed from the system once all processes call shm_close() on it)
+    if (shm_unlink(SHM_NAME) == -1) {
+        log_printf(ERROR, "shm_unlink: %s", strerror(errno));
     }
 
-    // Using shm_init() calls shm_stop() automatically on process exit, so semaphores and shm blocks will be closed on exit
-
     log_printf(INFO, "SHM destroyed. RUNTIME FUNTIME HAD TOO MUCH FUN!!!");
 
     /*
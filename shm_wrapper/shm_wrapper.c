@@ -1,19 +1,17 @@
 #include <shm_wrapper.h>
 
-// *********************************** WRAPPER-SPECIFIC GLOBAL VARS **************************************** //
+#include <linux/futex.h>  // for FUTEX_WAIT, FUTEX_WAKE
+#include <sys/syscall.h>  // for SYS_futex
 
-dual_sem_t sems[MAX_DEVICES];  // array of semaphores, two for each possible device (one for data and one for commands)
-dev_shm_t* dev_shm_ptr;        // points to memory-mapped shared memory block for device data and commands
-sem_t* catalog_sem;            // semaphore used as a mutex on the catalog
-sem_t* cmd_map_sem;            // semaphore used as a mutex on the command bitmap
+// *********************************** WRAPPER-SPECIFIC GLOBAL VARS **************************************** //
 
-input_shm_t* input_shm_ptr;    // points to memory-mapped shared memory block for user inputs
-robot_desc_shm_t* rd_shm_ptr;  // points to memory-mapped shared memory block for robot description
-sem_t* input_sem;              // semaphore used as a mutex on the inputs
-sem_t* rd_sem;                 // semaphore used as a mutex on the robot description
+shm_segment_t* shm_ptr;  // points to the memory-mapped shared memory segment
 
-log_data_shm_t* log_data_shm_ptr;  // points to shared memory block for log data specified by executor
-sem_t* log_data_sem;               // semaphore used as a mutex on the log data
+dev_shm_t* dev_shm_ptr;              // points to memory-mapped shared memory block for device data and commands
+input_shm_t* input_shm_ptr;          // points to memory-mapped shared memory block for user inputs
+robot_desc_shm_t* rd_shm_ptr;        // points to memory-mapped shared memory block for robot description
+log_data_shm_t* log_data_shm_ptr;    // points to shared memory block for log data specified by executor
+sem_stats_shm_t* sem_stats_shm_ptr;  // points to shared memory block for lock statistics
 
 // ****************************************** EMERGENCY CONTROL ***************************************** //
 
@@ -30,7 +28,7 @@ static void stop_robot() {
     param_id_t* params_to_kill = get_params_to_kill(&num_devices_with_params_to_kill);
 
     // Get currently connected devices
-    uint32_t catalog = 0;
+    bitmap_t catalog = 0;
     get_catalog(&catalog);
     dev_id_t dev_ids[MAX_DEVICES] = {0};
     get_device_identifiers(dev_ids);
@@ -39,13 +37,12 @@ static void stop_robot() {
     param_val_t params_zero[MAX_PARAMS] = {0};
 
     // Search through currently connected devices and kill the necessary parameters as found above
-    for (int device_idx = 0; device_idx < MAX_DEVICES; device_idx++) {
-        if (catalog & (1 << device_idx)) {  // Device is connected
-            // Check if it has parameters to be killed
-            for (uint8_t i = 0; i < num_devices_with_params_to_kill; i++) {
-                if (dev_ids[device_idx].type == params_to_kill[i].device_type) {
-                    device_write(device_idx, SHM, COMMAND, params_to_kill[i].param_bitmap, params_zero);
-                }
+    for (bitmap_t rest = catalog; rest != 0;) {
+        int device_idx = bitmap_pop(&rest);  // Device is connected
+        // Check if it has parameters to be killed
+        for (uint8_t i = 0; i < num_devices_with_params_to_kill; i++) {
+            if (dev_ids[device_idx].type == params_to_kill[i].device_type) {
+                device_write(device_idx, SHM, COMMAND, params_to_kill[i].param_bitmap, params_zero);
             }
         }
     }
@@ -53,63 +50,358 @@ static void stop_robot() {
     free(params_to_kill);
 }
 
-// ****************************************** SEMAPHORE UTILITIES ***************************************** //
+// ******************************************** LOCK UTILITIES ******************************************** //
+
+#if SEM_STATS
+/**
+ * Returns the number of nanoseconds on the monotonic clock, for lock statistics.
+ */
+static uint64_t sem_stats_nanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
 /**
- * Custom wrapper function for sem_wait. Prints out descriptive logging message on failure
+ * Adds a duration to a histogram of lock statistics.
  * Arguments:
- *    sem: pointer to a semaphore to wait on
- *    sem_desc: string that describes the semaphore being waited on, displayed with error message
+ *    hist: the histogram; see sem_stats_t for its buckets
+ *    ns: the duration in nanoseconds
  */
-static void my_sem_wait(sem_t* sem, char* sem_desc) {
-    if (sem_wait(sem) == -1) {
-        log_printf(ERROR, "sem_wait: %s. %s", sem_desc, strerror(errno));
+static void sem_stats_record(_Atomic uint32_t hist[SEM_STATS_BUCKETS], uint64_t ns) {
+    uint64_t us = ns / 1000;
+    int bucket = (us == 0) ? 0 : 64 - __builtin_clzll(us);
+    if (bucket >= SEM_STATS_BUCKETS) {
+        bucket = SEM_STATS_BUCKETS - 1;
     }
+    atomic_fetch_add_explicit(&hist[bucket], 1, memory_order_relaxed);
 }
+#endif
 
 /**
- * Custom wrapper function for sem_post. Prints out descriptive logging message on failure
+ * Makes every sequence counter that the holder of a lock may have left odd (mid-write) even again,
+ * so that lock-free readers stop retrying. The data under the counter may be half-written; the next write fixes it.
  * Arguments:
- *    sem: pointer to a semaphore to post
- *    sem_desc: string that describes the semaphore being posted, displayed with error message
+ *    lock_ix: index of the lock whose holder died (one of the SHM_LOCK_* defines)
  */
-static void my_sem_post(sem_t* sem, char* sem_desc) {
-    if (sem_post(sem) == -1) {
-        log_printf(ERROR, "sem_post: %s. %s", sem_desc, strerror(errno));
+static void recover_lock(int lock_ix) {
+    _Atomic uint32_t* seqs[UID_INDEX_SIZE + DEV_HISTORY_LEN + 2];
+    int num_seqs = 0;
+
+    if (lock_ix == SHM_LOCK_CATALOG) {
+        seqs[num_seqs++] = &dev_shm_ptr->catalog_gen;
+        for (int i = 0; i < UID_INDEX_SIZE; i++) {
+            seqs[num_seqs++] = &dev_shm_ptr->uid_index[i].gen;
+        }
+    } else if (lock_ix == SHM_LOCK_INPUT) {
+        for (int i = 0; i < 2; i++) {
+            seqs[num_seqs++] = &input_shm_ptr->inputs[i].seq;
+        }
+    } else if (lock_ix >= SHM_LOCK_DATA(0) && lock_ix < SHM_LOCK_DATA(MAX_DEVICES)) {
+        int dev_ix = lock_ix - SHM_LOCK_DATA(0);
+        seqs[num_seqs++] = &dev_shm_ptr->streams[DATA][dev_ix].seq;
+        for (int i = 0; i < DEV_HISTORY_LEN; i++) {
+            seqs[num_seqs++] = &dev_shm_ptr->history[dev_ix].slots[i].gen;
+        }
+        seqs[num_seqs++] = &dev_shm_ptr->link_stats[dev_ix].gen;
+    }
+    for (int i = 0; i < num_seqs; i++) {
+        if (atomic_load(seqs[i]) % 2 == 1) {
+            atomic_fetch_add(seqs[i], 1);
+        }
     }
 }
 
 /**
- * Custom wrapper function for sem_open. Prints out descriptive logging message on failure
- * exits (not being able to open a semaphore is fatal to Runtime).
+ * Locks one of the locks in shared memory. Prints out descriptive logging message on failure
+ * If the previous holder died while holding the lock, recovers it (see recover_lock()) and carries on.
+ * If lock statistics are enabled, counts the acquisition, and whether and for how long it had to wait.
  * Arguments:
- *    sem_name: name of a semaphore to be opened
- *    sem_desc: string that describes the semaphore being opened, displayed with error message
- * Returns a pointer to the semaphore that was opened.
+ *    lock_ix: index of the lock to lock (one of the SHM_LOCK_* defines)
+ *    lock_desc: string that describes the lock being locked, displayed with error message
  */
-static sem_t* my_sem_open(char* sem_name, char* sem_desc) {
-    sem_t* ret;
-    if ((ret = sem_open(sem_name, 0, 0, 0)) == SEM_FAILED) {
-        log_printf(FATAL, "sem_open: %s. %s", sem_desc, strerror(errno));
-        exit(1);
+static void my_mutex_lock(int lock_ix, char* lock_desc) {
+    pthread_mutex_t* mutex = &shm_ptr->locks[lock_ix].mutex;
+    int err;
+#if SEM_STATS
+    if (atomic_load_explicit(&sem_stats_shm_ptr->enabled, memory_order_relaxed)) {
+        sem_stats_t* stats = &sem_stats_shm_ptr->sems[lock_ix];
+        uint64_t start = 0;
+        // only time the acquisitions that can't succeed right away
+        if ((err = pthread_mutex_trylock(mutex)) == EBUSY) {
+            start = sem_stats_nanos();
+            err = pthread_mutex_lock(mutex);
+        }
+        stats->acquired_at = sem_stats_nanos();
+        atomic_fetch_add_explicit(&stats->acquisitions, 1, memory_order_relaxed);
+        if (start != 0) {
+            atomic_fetch_add_explicit(&stats->contended, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&stats->wait_ns, stats->acquired_at - start, memory_order_relaxed);
+            sem_stats_record(stats->wait_hist, stats->acquired_at - start);
+        }
+    } else
+#endif
+    {
+        err = pthread_mutex_lock(mutex);
+    }
+    if (err == EOWNERDEAD) {
+        log_printf(WARN, "pthread_mutex_lock: holder of %s died; recovering it", lock_desc);
+        recover_lock(lock_ix);
+        pthread_mutex_consistent(mutex);
+    } else if (err != 0) {
+        log_printf(ERROR, "pthread_mutex_lock: %s. %s", lock_desc, strerror(err));
+    }
+}
+
+/**
+ * Unlocks one of the locks in shared memory. Prints out descriptive logging message on failure
+ * If lock statistics are enabled, records for how long the lock was held.
+ * Arguments:
+ *    lock_ix: index of the lock to unlock (one of the SHM_LOCK_* defines)
+ *    lock_desc: string that describes the lock being unlocked, displayed with error message
+ */
+static void my_mutex_unlock(int lock_ix, char* lock_desc) {
+    int err;
+#if SEM_STATS
+    if (atomic_load_explicit(&sem_stats_shm_ptr->enabled, memory_order_relaxed)) {
+        sem_stats_t* stats = &sem_stats_shm_ptr->sems[lock_ix];
+        // the lock may have been acquired before statistics were enabled
+        if (stats->acquired_at != 0) {
+            uint64_t held = sem_stats_nanos() - stats->acquired_at;
+            stats->acquired_at = 0;
+            atomic_fetch_add_explicit(&stats->hold_ns, held, memory_order_relaxed);
+            sem_stats_record(stats->hold_hist, held);
+        }
+    }
+#endif
+    if ((err = pthread_mutex_unlock(&shm_ptr->locks[lock_ix].mutex)) != 0) {
+        log_printf(ERROR, "pthread_mutex_unlock: %s. %s", lock_desc, strerror(err));
+    }
+}
+
+// ******************************************** FUTEX UTILITIES ******************************************* //
+
+/**
+ * Blocks until the word at ADDR is woken by futex_wake() or the timeout expires.
+ * Returns immediately if the word no longer holds EXPECTED. Callers must recheck their condition on return,
+ * since the wait may also end early because of a signal.
+ * Arguments:
+ *    addr: pointer to a 32-bit word in shared memory
+ *    expected: the value the word must hold for the caller to sleep
+ *    timeout_ms: maximum number of milliseconds to wait
+ */
+static void futex_wait(_Atomic uint32_t* addr, uint32_t expected, uint64_t timeout_ms) {
+    struct timespec timeout = {.tv_sec = timeout_ms / 1000, .tv_nsec = (timeout_ms % 1000) * 1000000};
+    if (syscall(SYS_futex, (uint32_t*) addr, FUTEX_WAIT, expected, &timeout, NULL, 0) == -1) {
+        if (errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) {
+            log_printf(ERROR, "futex_wait: %s", strerror(errno));
+        }
     }
-    return ret;
 }
 
 /**
- * Custom wrapper function for sem_close. Prints out descriptive logging message on failure
+ * Wakes every process and thread blocked in futex_wait() on the word at ADDR
  * Arguments:
- *    sem: pointer to a semaphore to close
- *    sem_desc: string that describes the semaphore being closed, displayed with error message
+ *    addr: pointer to a 32-bit word in shared memory
  */
-static void my_sem_close(sem_t* sem, char* sem_desc) {
-    if (sem_close(sem) == -1) {
-        log_printf(ERROR, "sem_close: %s. %s", sem_desc, strerror(errno));
+static void futex_wake(_Atomic uint32_t* addr) {
+    if (syscall(SYS_futex, (uint32_t*) addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0) == -1) {
+        log_printf(ERROR, "futex_wake: %s", strerror(errno));
     }
 }
 
 // ******************************************** HELPER FUNCTIONS ****************************************** //
 
+/**
+ * Blocks until a doorbell changes from LAST_DOORBELL or the timeout expires, whichever is first.
+ * Arguments:
+ *    doorbell: the doorbell to wait on
+ *    last_doorbell: doorbell value previously read by the caller
+ *    timeout_ms: maximum number of milliseconds to wait
+ * Returns:
+ *    0 if the doorbell changed
+ *    -1 on timeout
+ */
+static int doorbell_wait(_Atomic uint32_t* doorbell, uint32_t last_doorbell, uint32_t timeout_ms) {
+    uint64_t deadline = millis() + timeout_ms;
+    uint64_t now;
+
+    // sleep until the doorbell changes, retrying on spurious wakeups
+    while (atomic_load_explicit(doorbell, memory_order_acquire) == last_doorbell) {
+        now = millis();
+        if (now >= deadline) {
+            return -1;
+        }
+        futex_wait(doorbell, last_doorbell, deadline - now);
+    }
+    return 0;
+}
+
+/**
+ * Marks the start of a write to a device's DATA stream by making its sequence counter odd.
+ * Caller must hold the device's data lock so that there is only ever one writer.
+ * Arguments:
+ *    dev_ix: device index of the device whose data is about to be written
+ */
+static void data_seqlock_write_begin(int dev_ix) {
+    _Atomic uint32_t* seq = &dev_shm_ptr->streams[DATA][dev_ix].seq;
+    atomic_store_explicit(seq, atomic_load_explicit(seq, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Marks the end of a write to a device's DATA stream by making its sequence counter even again.
+ * Caller must hold the device's data lock.
+ * Arguments:
+ *    dev_ix: device index of the device whose data was written
+ */
+static void data_seqlock_write_end(int dev_ix) {
+    _Atomic uint32_t* seq = &dev_shm_ptr->streams[DATA][dev_ix].seq;
+    atomic_store_explicit(seq, atomic_load_explicit(seq, memory_order_relaxed) + 1, memory_order_release);
+}
+
+/**
+ * Starts a lock-free read of a device's DATA stream, waiting out any write in progress.
+ * Arguments:
+ *    dev_ix: device index of the device whose data is being read
+ * Returns the (even) value of the stream's sequence counter, to be passed to data_seqlock_read_retry()
+ */
+static uint32_t data_seqlock_read_begin(int dev_ix) {
+    _Atomic uint32_t* seq = &dev_shm_ptr->streams[DATA][dev_ix].seq;
+    uint32_t start;
+
+    while ((start = atomic_load_explicit(seq, memory_order_acquire)) & 1) {
+        sched_yield();
+    }
+    return start;
+}
+
+/**
+ * Ends a lock-free read of a device's DATA stream.
+ * Arguments:
+ *    dev_ix: device index of the device whose data was read
+ *    start: value returned by data_seqlock_read_begin() before the read
+ * Returns true iff the stream was written during the read, so everything read must be discarded and read again
+ */
+static bool data_seqlock_read_retry(int dev_ix, uint32_t start) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&dev_shm_ptr->streams[DATA][dev_ix].seq, memory_order_relaxed) != start;
+}
+
+/**
+ * Reads the requested params of a device's DATA stream without taking any locks.
+ * The stream's seq counter is odd while a writer is modifying the block; the copy is retried
+ * until it was made entirely between two identical, even values of the counter.
+ * Arguments:
+ *    dev_ix: device index of the device whose data is being requested
+ *    params_to_read: bitmap representing which params to be read
+ *    params: pointer to array of param_val_t's that the device data will be read into
+ */
+static void data_seqlock_read(int dev_ix, bitmap_t params_to_read, param_val_t* params) {
+    volatile param_val_t* src = dev_shm_ptr->streams[DATA][dev_ix].params;
+    uint32_t start;
+
+    do {
+        start = data_seqlock_read_begin(dev_ix);
+        for (bitmap_t rest = params_to_read; rest != 0;) {
+            int i = bitmap_pop(&rest);
+            params[i].p_i = src[i].p_i;  // copy the whole 32 bits regardless of type
+        }
+    } while (data_seqlock_read_retry(dev_ix, start));
+}
+
+/**
+ * Copies the params of a stream that changed since a given version.
+ * Caller must either hold the stream's lock or retry the copy if it overlapped a write.
+ * Arguments:
+ *    block: the stream to copy from
+ *    since_version: params stamped with a later version than this are copied
+ *    version: the current version of the stream will be put here
+ *    params: pointer to array of MAX_PARAMS param_val_t's that the changed params will be copied into
+ * Returns the bitmap of params that were copied.
+ */
+static bitmap_t copy_changed_params(volatile dev_stream_t* block, uint32_t since_version, uint32_t* version, param_val_t* params) {
+    bitmap_t changed = 0;
+
+    *version = block->version;
+    for (int i = 0; i < MAX_PARAMS; i++) {
+        // compare the difference so that versions wrapping around don't matter
+        if ((int32_t) (block->param_versions[i] - since_version) > 0) {
+            params[i].p_i = block->params[i].p_i;
+            changed |= BITMAP_BIT(i);
+        }
+    }
+    return changed;
+}
+
+/**
+ * Appends the current values of a device's DATA stream to its history ring.
+ * Caller must hold the device's data lock so that there is only ever one writer.
+ * Arguments:
+ *    dev_ix: device index of the device whose data was written
+ *    written: bitmap of the params that were written
+ *    timestamp: monotonic_millis() at the write
+ */
+static void history_append(int dev_ix, bitmap_t written, uint64_t timestamp) {
+    dev_history_t* history = &dev_shm_ptr->history[dev_ix];
+    uint32_t index = atomic_load_explicit(&history->head, memory_order_relaxed);
+    history_slot_t* slot = &history->slots[index & (DEV_HISTORY_LEN - 1)];
+
+    atomic_fetch_add_explicit(&slot->gen, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->sample.index = index;
+    slot->sample.written = written;
+    slot->sample.timestamp = timestamp;
+    memcpy(slot->sample.params, dev_shm_ptr->streams[DATA][dev_ix].params, sizeof(slot->sample.params));
+    atomic_fetch_add_explicit(&slot->gen, 1, memory_order_release);
+
+    // publish the sample
+    atomic_store_explicit(&history->head, index + 1, memory_order_release);
+}
+
+/**
+ * Replaces the link statistics of a device, bracketed by increments of the slot's gen for device_read_link_stats().
+ * Caller must hold the device's data lock so that there is only ever one writer.
+ * Arguments:
+ *    dev_ix: device index of the device
+ *    stats: pointer to the new statistics, copied as is
+ */
+static void link_stats_store(int dev_ix, dev_link_stats_t* stats) {
+    link_stats_slot_t* slot = &dev_shm_ptr->link_stats[dev_ix];
+
+    atomic_fetch_add_explicit(&slot->gen, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->stats = *stats;
+    atomic_fetch_add_explicit(&slot->gen, 1, memory_order_release);
+}
+
+/**
+ * Records that a process read some params of a device's DATA stream, if it's one whose reads count towards subscriptions
+ * Only touches the device's interest record when the read adds params or is in a new millisecond, so repeated reads stay cheap
+ * Arguments:
+ *    dev_ix: device index of the device that was read
+ *    process: the calling process
+ *    params_read: bitmap of the params that were read
+ */
+static void record_interest(int dev_ix, process_t process, bitmap_t params_read) {
+    int reader;
+    if (process == EXECUTOR) {
+        reader = READER_EXECUTOR;
+    } else if (process == NET_HANDLER) {
+        reader = READER_NET_HANDLER;
+    } else {
+        return;
+    }
+    dev_interest_t* interest = &dev_shm_ptr->interest[dev_ix];
+    if ((atomic_load_explicit(&interest->params[reader], memory_order_relaxed) & params_read) != params_read) {
+        atomic_fetch_or_explicit(&interest->params[reader], params_read, memory_order_relaxed);
+    }
+    uint32_t now = (uint32_t) monotonic_millis();
+    if (atomic_exchange_explicit(&interest->last_read[reader], now, memory_order_relaxed) != now) {
+        atomic_fetch_add_explicit(&interest->num_reads[reader], 1, memory_order_relaxed);
+    }
+}
+
 /**
  * Function that does the actual reading into shared memory for device_read and device_read_uid
  * Takes care of updating the param bitmap for fast transfer of commands from executor to device handler
@@ -121,46 +413,42 @@ static void my_sem_close(sem_t* sem, char* sem_desc) {
  *    params: pointer to array of param_val_t's that is at least as long as highest requested param number
  *        device data will be read into the corresponding param_val_t's
  */
-static void device_read_helper(int dev_ix, process_t process, stream_t stream, uint32_t params_to_read, param_val_t* params) {
-    // grab semaphore for the appropriate stream and device
+static void device_read_helper(int dev_ix, process_t process, stream_t stream, bitmap_t params_to_read, param_val_t* params) {
+    // the data stream is protected by a seqlock, so readers never block the writer
     if (stream == DATA) {
-        my_sem_wait(sems[dev_ix].data_sem, "data sem @device_read");
-    } else {
-        my_sem_wait(sems[dev_ix].command_sem, "command sem @device_read");
+        data_seqlock_read(dev_ix, params_to_read, params);
+        record_interest(dev_ix, process, params_to_read);
+        return;
     }
 
+    // lock the command stream of the device
+    my_mutex_lock(SHM_LOCK_COMMAND(dev_ix), "command lock @device_read");
+
     // read all requested params
-    for (int i = 0; i < MAX_PARAMS; i++) {
-        if (params_to_read & (1 << i)) {
-            params[i] = dev_shm_ptr->params[stream][dev_ix][i];
-        }
+    for (bitmap_t rest = params_to_read; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        params[i] = dev_shm_ptr->streams[stream][dev_ix].params[i];
     }
 
     // if the device handler has processed the command, then turn off the change
     // if stream = downstream and process = dev_handler then also update params bitmap
-    if (process == DEV_HANDLER && stream == COMMAND) {
-        // wait on cmd_map_sem
-        my_sem_wait(cmd_map_sem, "cmd_map_sem @device_read");
-
-        dev_shm_ptr->cmd_map[0] &= (~(1 << dev_ix));            // turn off changed device bit in cmd_map[0]
-        dev_shm_ptr->cmd_map[dev_ix + 1] &= (~params_to_read);  // turn off bits for params that were changed and then read in cmd_map[dev_ix + 1]
-
-        // release cmd_map_sem
-        my_sem_post(cmd_map_sem, "cmd_map_sem @device_read");
+    if (process == DEV_HANDLER) {
+        // turn off changed device bit first, so that a concurrent write re-raises it after we're done
+        atomic_fetch_and_explicit(&dev_shm_ptr->cmd_map[0], ~BITMAP_BIT(dev_ix), memory_order_acq_rel);
+        // turn off bits for params that were changed and then read; keep the device flagged if any are left
+        if (atomic_fetch_and_explicit(&dev_shm_ptr->cmd_map[dev_ix + 1], ~params_to_read, memory_order_acq_rel) & ~params_to_read) {
+            atomic_fetch_or_explicit(&dev_shm_ptr->cmd_map[0], BITMAP_BIT(dev_ix), memory_order_release);
+        }
     }
 
-    // release semaphore for appropriate stream and device
-    if (stream == DATA) {
-        my_sem_post(sems[dev_ix].data_sem, "data sem @device_read");
-    } else {
-        my_sem_post(sems[dev_ix].command_sem, "command sem @device_read");
-    }
+    // unlock the command stream of the device
+    my_mutex_unlock(SHM_LOCK_COMMAND(dev_ix), "command lock @device_read");
 }
 
 /**
  * Function that does the actual writing into shared memory for device_write and device_write_uid
  * Takes care of updating the param bitmap for fast transfer of commands from executor to device handler
- * Grabs either one or two semaphores depending on calling process and stream requested.
+ * Locks either one or two locks depending on calling process and stream requested.
  * Arguments:
  *    dev_ix: device index of the device whose data is being written
  *    process: the calling process, one of DEV_HANDLER, EXECUTOR, or NET_HANDLER
@@ -169,97 +457,219 @@ static void device_read_helper(int dev_ix, process_t process, stream_t stream, u
  *    params: pointer to array of param_val_t's that is at least as long as highest requested param number
  *        device data will be written into the corresponding param_val_t's
  */
-static void device_write_helper(int dev_ix, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params) {
-    // grab semaphore for the appropriate stream and device
+static void device_write_helper(int dev_ix, process_t process, stream_t stream, bitmap_t params_to_write, param_val_t* params) {
+    // lock the appropriate stream of the device
     if (stream == DATA) {
-        my_sem_wait(sems[dev_ix].data_sem, "data sem @device_write");
+        my_mutex_lock(SHM_LOCK_DATA(dev_ix), "data lock @device_write");
     } else {
-        my_sem_wait(sems[dev_ix].command_sem, "command sem @device_write");
+        my_mutex_lock(SHM_LOCK_COMMAND(dev_ix), "command lock @device_write");
     }
 
-    // write all requested params
-    for (int i = 0; i < MAX_PARAMS; i++) {
-        if (params_to_write & (1 << i)) {
-            dev_shm_ptr->params[stream][dev_ix][i] = params[i];
+    // the data lock serializes writers; mark the data block as being modified for lock-free readers
+    if (stream == DATA) {
+        data_seqlock_write_begin(dev_ix);
+    }
+
+    // write all requested params, stamping the ones whose value changes with the next version of the stream
+    dev_stream_t* block = &dev_shm_ptr->streams[stream][dev_ix];
+    uint32_t next_version = block->version + 1;
+    bool changed = false;
+    for (bitmap_t rest = params_to_write; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        if (block->params[i].p_i != params[i].p_i) {
+            block->params[i] = params[i];
+            block->param_versions[i] = next_version;
+            changed = true;
         }
     }
+    if (changed) {
+        block->version = next_version;
+    }
+    block->last_update = monotonic_millis();
+    if (stream == DATA) {
+        history_append(dev_ix, params_to_write, block->last_update);
+    }
+
+    if (stream == DATA) {
+        data_seqlock_write_end(dev_ix);
+    }
 
     // If writing a command, update the command map to indicate which param should be changed
+    // The param bits must be turned on before the device bit (see device_claim_commands)
     if (stream == COMMAND) {
-        // wait on cmd_map_sem
-        my_sem_wait(cmd_map_sem, "cmd_map_sem @device_write");
-
-        dev_shm_ptr->cmd_map[0] |= (1 << dev_ix);             // turn on changed device bit in cmd_map[0]
-        dev_shm_ptr->cmd_map[dev_ix + 1] |= params_to_write;  // turn on bits for params that were written in cmd_map[dev_ix + 1]
-
-        // release cmd_map_sem
-        my_sem_post(cmd_map_sem, "cmd_map_sem @device_write");
+        atomic_fetch_or_explicit(&dev_shm_ptr->cmd_map[dev_ix + 1], params_to_write, memory_order_release);  // turn on bits for params that were written in cmd_map[dev_ix + 1]
+        atomic_fetch_or_explicit(&dev_shm_ptr->cmd_map[0], BITMAP_BIT(dev_ix), memory_order_release);              // turn on changed device bit in cmd_map[0]
+
+        // ring the doorbells to wake up the device handler thread (or event loop) waiting to send this command
+        atomic_fetch_add_explicit(&dev_shm_ptr->streams[COMMAND][dev_ix].doorbell, 1, memory_order_release);
+        futex_wake(&dev_shm_ptr->streams[COMMAND][dev_ix].doorbell);
+        atomic_fetch_add_explicit(&dev_shm_ptr->cmd_doorbell, 1, memory_order_release);
+        futex_wake(&dev_shm_ptr->cmd_doorbell);
     }
 
-    // release semaphore for appropriate stream and device
+    // unlock the appropriate stream of the device
     if (stream == DATA) {
-        my_sem_post(sems[dev_ix].data_sem, "data sem @device_write");
+        my_mutex_unlock(SHM_LOCK_DATA(dev_ix), "data lock @device_write");
     } else {
-        my_sem_post(sems[dev_ix].command_sem, "command sem @device_write");
+        my_mutex_unlock(SHM_LOCK_COMMAND(dev_ix), "command lock @device_write");
     }
 }
 
 /**
- * This function will be called when process that called shm_init() exits
- * Closes all semaphores; unmaps all shared memory (but does not unlink anything)
+ * Returns the slot of the uid index at which the probe sequence for a uid starts (Fibonacci hashing)
+ * Arguments:
+ *    uid: 64-bit unique ID of a device
  */
-static void shm_close() {
-    // close all the semaphores
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        my_sem_close(sems[i].data_sem, "data sem");
-        my_sem_close(sems[i].command_sem, "command sem");
+static int uid_index_home(uint64_t uid) {
+    return (int) ((uid * 0x9E3779B97F4A7C15ULL) >> (64 - UID_INDEX_BITS));
+}
+
+/**
+ * Overwrites a slot of the uid index, bumping its generation so that lock-free lookups can detect the change.
+ * Caller must hold the catalog lock.
+ * Arguments:
+ *    slot: the slot to write
+ *    state: new state of the slot
+ *    dev_ix: new device index held by the slot
+ *    uid: new uid held by the slot
+ */
+static void uid_slot_write(uid_slot_t* slot, uid_slot_state_t state, int dev_ix, uint64_t uid) {
+    atomic_fetch_add_explicit(&slot->gen, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->state = state;
+    slot->dev_ix = dev_ix;
+    slot->uid = uid;
+    atomic_fetch_add_explicit(&slot->gen, 1, memory_order_release);
+}
+
+/**
+ * Adds a newly connected device to the uid index. Caller must hold the catalog lock.
+ * Arguments:
+ *    uid: 64-bit unique ID of the device
+ *    dev_ix: index of the device in shared memory
+ */
+static void uid_index_insert(uint64_t uid, int dev_ix) {
+    uid_slot_t* index = dev_shm_ptr->uid_index;
+    int free_slot = -1;  // first slot in the probe sequence that doesn't hold a device
+
+    for (int i = 0, s = uid_index_home(uid); i < UID_INDEX_SIZE; i++, s = (s + 1) & (UID_INDEX_SIZE - 1)) {
+        if (index[s].state == UID_SLOT_USED && index[s].uid == uid) {
+            // a device with the same uid is already connected; point the uid at the newest one
+            uid_slot_write(&index[s], UID_SLOT_USED, dev_ix, uid);
+            return;
+        }
+        if (index[s].state != UID_SLOT_USED && free_slot == -1) {
+            free_slot = s;
+        }
+        if (index[s].state == UID_SLOT_EMPTY) {
+            break;
+        }
     }
-    my_sem_close(catalog_sem, "catalog sem");
-    my_sem_close(cmd_map_sem, "cmd map sem");
-    my_sem_close(input_sem, "inputs_mutex");
-    my_sem_close(rd_sem, "robot_desc_mutex");
-    my_sem_close(log_data_sem, "log data mutex");
+    // there are twice as many slots as devices, so a free slot is always found
+    uid_slot_write(&index[free_slot], UID_SLOT_USED, dev_ix, uid);
+}
 
-    // unmap all shared memory blocks
-    if (munmap(dev_shm_ptr, sizeof(dev_shm_t)) == -1) {
-        log_printf(ERROR, "munmap: dev_shm. %s", strerror(errno));
+/**
+ * Removes a disconnecting device from the uid index. Caller must hold the catalog lock,
+ * and the device must already be removed from the catalog.
+ * Arguments:
+ *    uid: 64-bit unique ID of the device
+ *    dev_ix: index of the device in shared memory
+ */
+static void uid_index_remove(uint64_t uid, int dev_ix) {
+    uid_slot_t* index = dev_shm_ptr->uid_index;
+    int s = uid_index_home(uid);
+
+    // find the slot holding the device
+    for (int i = 0; i < UID_INDEX_SIZE; i++, s = (s + 1) & (UID_INDEX_SIZE - 1)) {
+        if (index[s].state == UID_SLOT_EMPTY) {
+            return;
+        }
+        if (index[s].state == UID_SLOT_USED && index[s].uid == uid) {
+            break;
+        }
     }
-    if (munmap(input_shm_ptr, sizeof(input_shm_t)) == -1) {
-        log_printf(ERROR, "munmap: input_shm. %s", strerror(errno));
+    if (index[s].state != UID_SLOT_USED || index[s].uid != uid || index[s].dev_ix != dev_ix) {
+        return;
     }
-    if (munmap(rd_shm_ptr, sizeof(robot_desc_shm_t)) == -1) {
-        log_printf(ERROR, "munmap: robot_desc_shm. %s", strerror(errno));
+
+    // if another connected device has the same uid, it takes over the slot
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if ((dev_shm_ptr->catalog & BITMAP_BIT(i)) && dev_shm_ptr->dev_ids[i].uid == uid) {
+            uid_slot_write(&index[s], UID_SLOT_USED, i, uid);
+            return;
+        }
     }
-    if (munmap(log_data_shm_ptr, sizeof(log_data_shm_t)) == -1) {
-        log_printf(ERROR, "munmap: log_data_shm_ptr. %s", strerror(errno));
+
+    // a slot followed by an empty slot is not in the middle of any probe sequence, so it (and any
+    // deleted slots right before it) can be emptied; otherwise it must be marked deleted
+    if (index[(s + 1) & (UID_INDEX_SIZE - 1)].state != UID_SLOT_EMPTY) {
+        uid_slot_write(&index[s], UID_SLOT_DELETED, 0, 0);
+        return;
     }
+    do {
+        uid_slot_write(&index[s], UID_SLOT_EMPTY, 0, 0);
+        s = (s - 1) & (UID_INDEX_SIZE - 1);
+    } while (index[s].state == UID_SLOT_DELETED);
 }
 
-// ************************************ PUBLIC WRAPPER FUNCTIONS ****************************************** //
-
-bool shm_exists() {
-    // Assumes all shared memory blocks are created together and destroyed together
-    return (access("/dev/shm/dev-shm", F_OK) == 0);
+/**
+ * Returns the FNV-1a hash of a Robot.log key, used to find its slot in the hash index of log data keys
+ * Arguments:
+ *    key: null-terminated key
+ */
+static uint32_t log_key_hash(char* key) {
+    uint32_t hash = 2166136261u;
+    for (; *key != '\0'; key++) {
+        hash = (hash ^ (uint8_t) *key) * 16777619u;
+    }
+    return hash;
 }
 
-void generate_sem_name(stream_t stream, int dev_ix, char* name) {
-    if (stream == DATA) {
-        sprintf(name, "/data_sem_%d", dev_ix);
-    } else if (stream == COMMAND) {
-        sprintf(name, "/command_sem_%d", dev_ix);
+/**
+ * This function will be called when process that called shm_init() exits
+ * Unmaps the shared memory segment (but does not unlink it); the locks in it go away with the segment
+ */
+static void shm_close() {
+    if (munmap(shm_ptr, sizeof(shm_segment_t)) == -1) {
+        log_printf(ERROR, "munmap: shm. %s", strerror(errno));
     }
 }
 
+// ************************************ PUBLIC WRAPPER FUNCTIONS ****************************************** //
+
+bool shm_exists() {
+    // every block and lock is in the one segment
+    return (access("/dev/shm" SHM_NAME, F_OK) == 0);
+}
+
 int get_dev_ix_from_uid(uint64_t dev_uid) {
-    int dev_ix = -1;
+    uid_slot_t* slot;
+    uint32_t gen;
+    uint8_t state, dev_ix;
+    uint64_t uid;
+
+    for (int i = 0, s = uid_index_home(dev_uid); i < UID_INDEX_SIZE; i++, s = (s + 1) & (UID_INDEX_SIZE - 1)) {
+        slot = &dev_shm_ptr->uid_index[s];
+
+        // get a consistent copy of the slot; retry if it changed while we were reading it
+        do {
+            while ((gen = atomic_load_explicit(&slot->gen, memory_order_acquire)) & 1) {
+                sched_yield();
+            }
+            state = slot->state;
+            dev_ix = slot->dev_ix;
+            uid = slot->uid;
+            atomic_thread_fence(memory_order_acquire);
+        } while (atomic_load_explicit(&slot->gen, memory_order_relaxed) != gen);
 
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        if ((dev_shm_ptr->catalog & (1 << i)) && (dev_shm_ptr->dev_ids[i].uid == dev_uid)) {
-            dev_ix = i;
+        if (state == UID_SLOT_EMPTY) {
             break;
+        } else if (state == UID_SLOT_USED && uid == dev_uid) {
+            return dev_ix;
         }
     }
-    return dev_ix;
+    return -1;
 }
 
 void shm_init() {
@@ -269,152 +679,145 @@ void shm_init() {
         exit(1);
     }
 
-    int fd_shm;              // file descriptor of the memory-mapped shared memory
-    char sname[SNAME_SIZE];  // for holding semaphore names
-
-    // open all the semaphores
-    catalog_sem = my_sem_open(CATALOG_MUTEX_NAME, "catalog mutex");
-    cmd_map_sem = my_sem_open(CMDMAP_MUTEX_NAME, "cmd map mutex");
-    input_sem = my_sem_open(INPUTS_MUTEX_NAME, "inputs mutex");
-    rd_sem = my_sem_open(RD_MUTEX_NAME, "robot desc mutex");
-    log_data_sem = my_sem_open(LOG_DATA_MUTEX, "log data mutex");
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        generate_sem_name(DATA, i, sname);  // get the data name
-        if ((sems[i].data_sem = sem_open((const char*) sname, 0, 0, 0)) == SEM_FAILED) {
-            log_printf(ERROR, "sem_open: data sem for dev_ix %d: %s", i, strerror(errno));
-        }
-        generate_sem_name(COMMAND, i, sname);  // get the command name
-        if ((sems[i].command_sem = sem_open((const char*) sname, 0, 0, 0)) == SEM_FAILED) {
-            log_printf(ERROR, "sem_open: command sem for dev_ix %d: %s", i, strerror(errno));
-        }
-    }
+    int fd_shm;  // file descriptor of the memory-mapped shared memory
 
-    // open dev shm block and map to client process virtual memory
-    if ((fd_shm = shm_open(DEV_SHM_NAME, O_RDWR, 0)) == -1) {  // no O_CREAT
-        log_printf(FATAL, "shm_open dev_shm: %s", strerror(errno));
+    // open the shm segment and map it to client process virtual memory
+    if ((fd_shm = shm_open(SHM_NAME, O_RDWR, 0)) == -1) {  // no O_CREAT
+        log_printf(FATAL, "shm_open: %s", strerror(errno));
         exit(1);
     }
-    if ((dev_shm_ptr = mmap(NULL, sizeof(dev_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_shm, 0)) == MAP_FAILED) {
-        log_printf(FATAL, "mmap dev_shm: %s", strerror(errno));
+    // a segment created by a shm_start with a different shm_segment_t would be misread (or be too small to map)
+    struct stat shm_stat;
+    if (fstat(fd_shm, &shm_stat) == -1) {
+        log_printf(FATAL, "fstat shm: %s", strerror(errno));
         exit(1);
     }
-    if (close(fd_shm) == -1) {
-        log_printf(ERROR, "close dev_shm: %s", strerror(errno));
-    }
-
-    // open gamepad shm block and map to client process virtual memory
-    if ((fd_shm = shm_open(INPUTS_SHM_NAME, O_RDWR, 0)) == -1) {  // no O_CREAT
-        log_printf(FATAL, "shm_open: input_shm. %s", strerror(errno));
+    if (shm_stat.st_size != sizeof(shm_segment_t)) {
+        log_printf(FATAL, "shm is %ld bytes but this process expects %zu; rerun shm_stop and shm_start", (long) shm_stat.st_size, sizeof(shm_segment_t));
         exit(1);
     }
-    if ((input_shm_ptr = mmap(NULL, sizeof(input_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_shm, 0)) == MAP_FAILED) {
-        log_printf(FATAL, "mmap: input_shm. %s", strerror(errno));
+    if ((shm_ptr = mmap(NULL, sizeof(shm_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_shm, 0)) == MAP_FAILED) {
+        log_printf(FATAL, "mmap shm: %s", strerror(errno));
         exit(1);
     }
     if (close(fd_shm) == -1) {
-        log_printf(ERROR, "close: input_shm. %s", strerror(errno));
-    }
-
-    // open robot desc shm block and map to client process virtual memory
-    if ((fd_shm = shm_open(ROBOT_DESC_SHM_NAME, O_RDWR, 0)) == -1) {  // no O_CREAT
-        log_printf(FATAL, "shm_open: robot_desc_shm. %s", strerror(errno));
-        exit(1);
+        log_printf(ERROR, "close shm: %s", strerror(errno));
     }
-    if ((rd_shm_ptr = mmap(NULL, sizeof(robot_desc_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_shm, 0)) == MAP_FAILED) {
-        log_printf(FATAL, "mmap: robot_desc_shm. %s", strerror(errno));
+    // shm_start sets the layout version last, so this also catches a segment that isn't initialized yet
+    uint32_t layout_version = atomic_load_explicit(&shm_ptr->layout_version, memory_order_acquire);
+    if (layout_version != SHM_LAYOUT_VERSION) {
+        log_printf(FATAL, "shm has layout version %u but this process expects %d; rerun shm_stop and shm_start", layout_version, SHM_LAYOUT_VERSION);
         exit(1);
     }
-    if (close(fd_shm) == -1) {
-        log_printf(ERROR, "close: robot_desc_shm. %s", strerror(errno));
-    }
 
-    // create log data shm block and map to client process virtual memory
-    if ((fd_shm = shm_open(LOG_DATA_SHM, O_RDWR | O_CREAT, 0660)) == -1) {
-        log_printf(FATAL, "shm_open log_data_shm: %s", strerror(errno));  // no O_CREAT
-        exit(1);
-    }
-    if ((log_data_shm_ptr = mmap(NULL, sizeof(log_data_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_shm, 0)) == MAP_FAILED) {
-        log_printf(FATAL, "mmap log_data_shm: %s", strerror(errno));
-        exit(1);
-    }
-    if (close(fd_shm) == -1) {
-        log_printf(ERROR, "close log_data_shm: %s", strerror(errno));
-    }
+    dev_shm_ptr = &shm_ptr->devices;
+    input_shm_ptr = &shm_ptr->inputs;
+    rd_shm_ptr = &shm_ptr->robot_desc;
+    log_data_shm_ptr = &shm_ptr->log_data;
+    sem_stats_shm_ptr = &shm_ptr->sem_stats;
 
     atexit(shm_close);
 }
 
 void device_connect(dev_id_t* dev_id, int* dev_ix) {
-    // wait on catalog_sem
-    my_sem_wait(catalog_sem, "catalog_sem");
+    // lock the catalog
+    my_mutex_lock(SHM_LOCK_CATALOG, "catalog lock");
 
     // find a valid dev_ix
     for (*dev_ix = 0; *dev_ix < MAX_DEVICES; (*dev_ix)++) {
-        if (!(dev_shm_ptr->catalog & (1 << *dev_ix))) {  // if the spot at dev_ix is free
+        if (!(dev_shm_ptr->catalog & BITMAP_BIT(*dev_ix))) {  // if the spot at dev_ix is free
             break;
         }
     }
     if (*dev_ix == MAX_DEVICES) {
         log_printf(ERROR, "device_connect: maximum device limit %d reached, connection refused", MAX_DEVICES);
-        my_sem_post(catalog_sem, "catalog_sem");  // release the catalog semaphore
+        my_mutex_unlock(SHM_LOCK_CATALOG, "catalog lock");  // unlock the catalog
         *dev_ix = -1;
         return;
     }
 
     // wait on associated data and command sems
-    my_sem_wait(sems[*dev_ix].data_sem, "data_sem");
-    my_sem_wait(sems[*dev_ix].command_sem, "command_sem");
+    my_mutex_lock(SHM_LOCK_DATA(*dev_ix), "data lock");
+    my_mutex_lock(SHM_LOCK_COMMAND(*dev_ix), "command lock");
+
+    // mark the catalog as changing for device_read_all
+    atomic_fetch_add_explicit(&dev_shm_ptr->catalog_gen, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
 
     // fill in dev_id for that device with provided values
     dev_shm_ptr->dev_ids[*dev_ix].type = dev_id->type;
     dev_shm_ptr->dev_ids[*dev_ix].year = dev_id->year;
     dev_shm_ptr->dev_ids[*dev_ix].uid = dev_id->uid;
 
-    // update the catalog
-    dev_shm_ptr->catalog |= (1 << *dev_ix);
+    // update the catalog and the uid index
+    dev_shm_ptr->catalog |= BITMAP_BIT(*dev_ix);
+    uid_index_insert(dev_id->uid, *dev_ix);
+
+    // reset param values to 0; versions keep increasing so that a reader of the previous device sees every param change
+    data_seqlock_write_begin(*dev_ix);
+    for (int s = 0; s < 2; s++) {
+        dev_stream_t* block = &dev_shm_ptr->streams[s][*dev_ix];
+        block->version++;
+        block->last_update = 0;
+        for (int i = 0; i < MAX_PARAMS; i++) {
+            block->params[i] = (const param_val_t){0};
+            block->param_versions[i] = block->version;
+        }
+    }
 
-    // reset param values to 0
-    for (int i = 0; i < MAX_PARAMS; i++) {
-        dev_shm_ptr->params[DATA][*dev_ix][i] = (const param_val_t){0};
-        dev_shm_ptr->params[COMMAND][*dev_ix][i] = (const param_val_t){0};
+    // samples already in the history ring belong to the previous device at this index
+    dev_history_t* history = &dev_shm_ptr->history[*dev_ix];
+    atomic_store_explicit(&history->first, atomic_load_explicit(&history->head, memory_order_relaxed), memory_order_relaxed);
+    data_seqlock_write_end(*dev_ix);
+
+    // the link statistics belong to the previous device at this index too
+    link_stats_store(*dev_ix, &(dev_link_stats_t){0});
+
+    // nothing has read the new device yet
+    for (int r = 0; r < NUM_READERS; r++) {
+        atomic_store_explicit(&dev_shm_ptr->interest[*dev_ix].params[r], 0, memory_order_relaxed);
+        atomic_store_explicit(&dev_shm_ptr->interest[*dev_ix].num_reads[r], 0, memory_order_relaxed);
     }
+    atomic_fetch_add_explicit(&dev_shm_ptr->catalog_gen, 1, memory_order_release);
 
     // release associated data and command sems
-    my_sem_post(sems[*dev_ix].data_sem, "data_sem");
-    my_sem_post(sems[*dev_ix].command_sem, "command_sem");
+    my_mutex_unlock(SHM_LOCK_DATA(*dev_ix), "data lock");
+    my_mutex_unlock(SHM_LOCK_COMMAND(*dev_ix), "command lock");
 
-    // release catalog_sem
-    my_sem_post(catalog_sem, "catalog_sem");
+    // unlock the catalog
+    my_mutex_unlock(SHM_LOCK_CATALOG, "catalog lock");
 }
 
 void device_disconnect(int dev_ix) {
-    // wait on catalog_sem
-    my_sem_wait(catalog_sem, "catalog_sem");
+    // lock the catalog
+    my_mutex_lock(SHM_LOCK_CATALOG, "catalog lock");
 
     // wait on associated data and command sems
-    my_sem_wait(sems[dev_ix].data_sem, "data_sem");
-    my_sem_wait(sems[dev_ix].command_sem, "command_sem");
-    my_sem_wait(cmd_map_sem, "cmd_map_sem");
+    my_mutex_lock(SHM_LOCK_DATA(dev_ix), "data lock");
+    my_mutex_lock(SHM_LOCK_COMMAND(dev_ix), "command lock");
 
     // update the catalog
-    dev_shm_ptr->catalog &= (~(1 << dev_ix));
+    atomic_fetch_add_explicit(&dev_shm_ptr->catalog_gen, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    dev_shm_ptr->catalog &= (~BITMAP_BIT(dev_ix));
+    uid_index_remove(dev_shm_ptr->dev_ids[dev_ix].uid, dev_ix);
+    atomic_fetch_add_explicit(&dev_shm_ptr->catalog_gen, 1, memory_order_release);
 
     // reset cmd bitmap values to 0
-    dev_shm_ptr->cmd_map[0] &= (~(1 << dev_ix));  // reset the changed bit flag in cmd_map[0]
-    dev_shm_ptr->cmd_map[dev_ix + 1] = 0;         // turn off all changed bits for the device
+    atomic_fetch_and(&dev_shm_ptr->cmd_map[0], ~BITMAP_BIT(dev_ix));  // reset the changed bit flag in cmd_map[0]
+    atomic_store(&dev_shm_ptr->cmd_map[dev_ix + 1], 0);          // turn off all changed bits for the device
 
-    my_sem_post(cmd_map_sem, "cmd_map_sem");
     // release associated upstream and downstream sems
-    my_sem_post(sems[dev_ix].data_sem, "data_sem");
-    my_sem_post(sems[dev_ix].command_sem, "command_sem");
+    my_mutex_unlock(SHM_LOCK_DATA(dev_ix), "data lock");
+    my_mutex_unlock(SHM_LOCK_COMMAND(dev_ix), "command lock");
 
-    // release catalog_sem
-    my_sem_post(catalog_sem, "catalog_sem");
+    // unlock the catalog
+    my_mutex_unlock(SHM_LOCK_CATALOG, "catalog lock");
 }
 
-int device_read(int dev_ix, process_t process, stream_t stream, uint32_t params_to_read, param_val_t* params) {
+int device_read(int dev_ix, process_t process, stream_t stream, bitmap_t params_to_read, param_val_t* params) {
     // check catalog to see if dev_ix is valid, if not then return immediately
-    if (!(dev_shm_ptr->catalog & (1 << dev_ix))) {
+    if (!(dev_shm_ptr->catalog & BITMAP_BIT(dev_ix))) {
         log_printf(ERROR, "device_read: no device at dev_ix = %d, read failed", dev_ix);
         return -1;
     }
@@ -424,7 +827,7 @@ int device_read(int dev_ix, process_t process, stream_t stream, uint32_t params_
     return 0;
 }
 
-int device_read_uid(uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_read, param_val_t* params) {
+int device_read_uid(uint64_t dev_uid, process_t process, stream_t stream, bitmap_t params_to_read, param_val_t* params) {
     int dev_ix;
 
     // if device doesn't exist, return immediately
@@ -438,9 +841,9 @@ int device_read_uid(uint64_t dev_uid, process_t process, stream_t stream, uint32
     return 0;
 }
 
-int device_write(int dev_ix, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params) {
+int device_write(int dev_ix, process_t process, stream_t stream, bitmap_t params_to_write, param_val_t* params) {
     // check catalog to see if dev_ix is valid, if not then return immediately
-    if (!(dev_shm_ptr->catalog & (1 << dev_ix))) {
+    if (!(dev_shm_ptr->catalog & BITMAP_BIT(dev_ix))) {
         log_printf(ERROR, "device_write: no device at dev_ix = %d, write failed", dev_ix);
         return -1;
     }
@@ -450,7 +853,7 @@ int device_write(int dev_ix, process_t process, stream_t stream, uint32_t params
     return 0;
 }
 
-int device_write_uid(uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params) {
+int device_write_uid(uint64_t dev_uid, process_t process, stream_t stream, bitmap_t params_to_write, param_val_t* params) {
     int dev_ix;
 
     // if device doesn't exist, return immediately
@@ -464,63 +867,255 @@ int device_write_uid(uint64_t dev_uid, process_t process, stream_t stream, uint3
     return 0;
 }
 
-void get_cmd_map(uint32_t bitmap[MAX_DEVICES + 1]) {
-    // wait on cmd_map_sem
-    my_sem_wait(cmd_map_sem, "cmd_map_sem");
+void device_read_all(process_t process, dev_snapshot_t* snapshot) {
+    _Atomic uint32_t* gen = &dev_shm_ptr->catalog_gen;
+    bitmap_t readable[MAX_DEVICES];  // readable params of each connected device
+
+    do {
+        // wait out any connect or disconnect in progress
+        while ((snapshot->generation = atomic_load_explicit(gen, memory_order_acquire)) & 1) {
+            sched_yield();
+        }
+        snapshot->catalog = dev_shm_ptr->catalog;
+        for (bitmap_t rest = snapshot->catalog; rest != 0;) {
+            int i = bitmap_pop(&rest);
+            snapshot->dev_ids[i] = dev_shm_ptr->dev_ids[i];
+            readable[i] = get_readable_param_bitmap(snapshot->dev_ids[i].type);
+            data_seqlock_read(i, readable[i], snapshot->params[i]);
+        }
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(gen, memory_order_relaxed) != snapshot->generation);
+
+    for (bitmap_t rest = snapshot->catalog; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        record_interest(i, process, readable[i]);
+    }
+}
+
+void device_collect_interest(int dev_ix, bitmap_t params[NUM_READERS], uint32_t num_reads[NUM_READERS]) {
+    dev_interest_t* interest = &dev_shm_ptr->interest[dev_ix];
+    for (int r = 0; r < NUM_READERS; r++) {
+        params[r] = atomic_exchange_explicit(&interest->params[r], 0, memory_order_relaxed);
+        num_reads[r] = atomic_exchange_explicit(&interest->num_reads[r], 0, memory_order_relaxed);
+    }
+}
+
+void device_write_link_stats(int dev_ix, dev_link_stats_t* stats) {
+    dev_link_stats_t stamped = *stats;
+    stamped.updated_at = monotonic_millis();
+
+    my_mutex_lock(SHM_LOCK_DATA(dev_ix), "data lock @device_write_link_stats");
+    link_stats_store(dev_ix, &stamped);
+    my_mutex_unlock(SHM_LOCK_DATA(dev_ix), "data lock @device_write_link_stats");
+}
+
+bitmap_t device_claim_commands(int dev_ix, param_val_t* params) {
+    bitmap_t claimed;
+
+    // nothing to do if no commands were written since the last claim
+    if (!(atomic_load_explicit(&dev_shm_ptr->cmd_map[0], memory_order_acquire) & BITMAP_BIT(dev_ix))) {
+        return 0;
+    }
+
+    // turn off the changed device bit before claiming the param bits; device_write turns them on in the
+    // opposite order, so a param written after the exchange below always leaves the device flagged again
+    atomic_fetch_and_explicit(&dev_shm_ptr->cmd_map[0], ~BITMAP_BIT(dev_ix), memory_order_acq_rel);
+    claimed = atomic_exchange_explicit(&dev_shm_ptr->cmd_map[dev_ix + 1], 0, memory_order_acq_rel);
+    if (claimed == 0) {
+        return 0;
+    }
+
+    // read the claimed params; values are at least as new as the writes that turned on the claimed bits
+    my_mutex_lock(SHM_LOCK_COMMAND(dev_ix), "command lock @device_claim_commands");
+    for (bitmap_t rest = claimed; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        params[i] = dev_shm_ptr->streams[COMMAND][dev_ix].params[i];
+    }
+    my_mutex_unlock(SHM_LOCK_COMMAND(dev_ix), "command lock @device_claim_commands");
+    return claimed;
+}
+
+int device_read_changed(int dev_ix, stream_t stream, uint32_t since_version, bitmap_t* changed, uint32_t* version, param_val_t* params) {
+    dev_stream_t* block = &dev_shm_ptr->streams[stream][dev_ix];
+    uint32_t start;
+
+    // check catalog to see if dev_ix is valid, if not then return immediately
+    if (!(dev_shm_ptr->catalog & BITMAP_BIT(dev_ix))) {
+        log_printf(ERROR, "device_read_changed: no device at dev_ix = %d, read failed", dev_ix);
+        return -1;
+    }
+
+    if (stream == DATA) {
+        do {
+            start = data_seqlock_read_begin(dev_ix);
+            *changed = copy_changed_params(block, since_version, version, params);
+        } while (data_seqlock_read_retry(dev_ix, start));
+    } else {
+        my_mutex_lock(SHM_LOCK_COMMAND(dev_ix), "command lock @device_read_changed");
+        *changed = copy_changed_params(block, since_version, version, params);
+        my_mutex_unlock(SHM_LOCK_COMMAND(dev_ix), "command lock @device_read_changed");
+    }
+    return 0;
+}
+
+uint64_t device_last_update(int dev_ix, stream_t stream) {
+    volatile dev_stream_t* block = &dev_shm_ptr->streams[stream][dev_ix];
+    uint64_t last_update;
+    uint32_t start;
+
+    if (!(dev_shm_ptr->catalog & BITMAP_BIT(dev_ix))) {
+        return 0;
+    }
+
+    // the timestamp is 64 bits, which isn't read atomically on the Pi
+    if (stream == DATA) {
+        do {
+            start = data_seqlock_read_begin(dev_ix);
+            last_update = block->last_update;
+        } while (data_seqlock_read_retry(dev_ix, start));
+    } else {
+        my_mutex_lock(SHM_LOCK_COMMAND(dev_ix), "command lock @device_last_update");
+        last_update = block->last_update;
+        my_mutex_unlock(SHM_LOCK_COMMAND(dev_ix), "command lock @device_last_update");
+    }
+    return last_update;
+}
+
+int device_read_history(int dev_ix, uint32_t* cursor, dev_sample_t* samples, int max_samples) {
+    dev_history_t* history = &dev_shm_ptr->history[dev_ix];
+    history_slot_t* slot;
+    uint32_t head, oldest, index, gen;
+    int num_samples = 0;
+
+    // check catalog to see if dev_ix is valid, if not then return immediately
+    if (!(dev_shm_ptr->catalog & BITMAP_BIT(dev_ix))) {
+        log_printf(ERROR, "device_read_history: no device at dev_ix = %d, read failed", dev_ix);
+        return -1;
+    }
+
+    // start at the oldest sample still in the ring if the cursor is older than that (or nonsensical)
+    head = atomic_load_explicit(&history->head, memory_order_acquire);
+    oldest = (head < DEV_HISTORY_LEN) ? 0 : head - DEV_HISTORY_LEN;
+    if ((int32_t) (atomic_load_explicit(&history->first, memory_order_relaxed) - oldest) > 0) {
+        oldest = atomic_load_explicit(&history->first, memory_order_relaxed);  // don't return samples of a previous device
+    }
+    if ((int32_t) (*cursor - oldest) < 0 || (int32_t) (head - *cursor) < 0) {
+        *cursor = oldest;
+    }
+
+    for (index = *cursor; index != head && num_samples < max_samples; index++) {
+        slot = &history->slots[index & (DEV_HISTORY_LEN - 1)];
+
+        // get a consistent copy of the slot; retry if it changed while we were reading it
+        do {
+            while ((gen = atomic_load_explicit(&slot->gen, memory_order_acquire)) & 1) {
+                sched_yield();
+            }
+            samples[num_samples] = slot->sample;
+            atomic_thread_fence(memory_order_acquire);
+        } while (atomic_load_explicit(&slot->gen, memory_order_relaxed) != gen);
+
+        // the writer lapped us and overwrote this sample with a newer one; skip it
+        if (samples[num_samples].index == index) {
+            num_samples++;
+        }
+    }
+    *cursor = index;
+    return num_samples;
+}
+
+int device_read_link_stats(int dev_ix, dev_link_stats_t* stats) {
+    link_stats_slot_t* slot = &dev_shm_ptr->link_stats[dev_ix];
+    uint32_t gen;
 
+    // check catalog to see if dev_ix is valid, if not then return immediately
+    if (!(dev_shm_ptr->catalog & BITMAP_BIT(dev_ix))) {
+        log_printf(ERROR, "device_read_link_stats: no device at dev_ix = %d, read failed", dev_ix);
+        return -1;
+    }
+
+    // get a consistent copy of the stats; retry if dev handler changed them while we were reading them
+    do {
+        while ((gen = atomic_load_explicit(&slot->gen, memory_order_acquire)) & 1) {
+            sched_yield();
+        }
+        *stats = slot->stats;
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&slot->gen, memory_order_relaxed) != gen);
+    return 0;
+}
+
+void get_cmd_map(bitmap_t bitmap[MAX_DEVICES + 1]) {
     for (int i = 0; i < MAX_DEVICES + 1; i++) {
-        bitmap[i] = dev_shm_ptr->cmd_map[i];
+        bitmap[i] = atomic_load_explicit(&dev_shm_ptr->cmd_map[i], memory_order_acquire);
     }
+}
+
+uint32_t get_cmd_doorbell(int dev_ix) {
+    return atomic_load_explicit(&dev_shm_ptr->streams[COMMAND][dev_ix].doorbell, memory_order_acquire);
+}
+
+int wait_for_cmd(int dev_ix, uint32_t last_doorbell, uint32_t timeout_ms) {
+    return doorbell_wait(&dev_shm_ptr->streams[COMMAND][dev_ix].doorbell, last_doorbell, timeout_ms);
+}
+
+uint32_t get_any_cmd_doorbell() {
+    return atomic_load_explicit(&dev_shm_ptr->cmd_doorbell, memory_order_acquire);
+}
 
-    // release cmd_map_sem
-    my_sem_post(cmd_map_sem, "cmd_map_sem");
+int wait_for_any_cmd(uint32_t last_doorbell, uint32_t timeout_ms) {
+    return doorbell_wait(&dev_shm_ptr->cmd_doorbell, last_doorbell, timeout_ms);
 }
 
 void get_device_identifiers(dev_id_t dev_ids[MAX_DEVICES]) {
-    // wait on catalog_sem
-    my_sem_wait(catalog_sem, "catalog_sem");
+    // lock the catalog
+    my_mutex_lock(SHM_LOCK_CATALOG, "catalog lock");
 
     for (int i = 0; i < MAX_DEVICES; i++) {
         dev_ids[i] = dev_shm_ptr->dev_ids[i];
     }
 
-    // release catalog_sem
-    my_sem_post(catalog_sem, "catalog_sem");
+    // unlock the catalog
+    my_mutex_unlock(SHM_LOCK_CATALOG, "catalog lock");
 }
 
-void get_catalog(uint32_t* catalog) {
-    // wait on catalog_sem
-    my_sem_wait(catalog_sem, "catalog_sem");
+void get_catalog(bitmap_t* catalog) {
+    // lock the catalog
+    my_mutex_lock(SHM_LOCK_CATALOG, "catalog lock");
 
     *catalog = dev_shm_ptr->catalog;
 
-    // release catalog_sem
-    my_sem_post(catalog_sem, "catalog_sem");
+    // unlock the catalog
+    my_mutex_unlock(SHM_LOCK_CATALOG, "catalog lock");
 }
 
 robot_desc_val_t robot_desc_read(robot_desc_field_t field) {
     robot_desc_val_t ret;
 
-    // wait on rd_sem
-    my_sem_wait(rd_sem, "robot_desc_mutex");
+    // lock the robot description
+    my_mutex_lock(SHM_LOCK_RD, "robot_desc_mutex");
 
     // read the value out, and turn off the appropriate element
     ret = rd_shm_ptr->fields[field];
 
-    // release rd_sem
-    my_sem_post(rd_sem, "robot_desc_mutex");
+    // unlock the robot description
+    my_mutex_unlock(SHM_LOCK_RD, "robot_desc_mutex");
 
     return ret;
 }
 
 void robot_desc_write(robot_desc_field_t field, robot_desc_val_t val) {
-    // wait on rd_sem
-    my_sem_wait(rd_sem, "robot_desc_mutex");
+    // lock the robot description
+    my_mutex_lock(SHM_LOCK_RD, "robot_desc_mutex");
 
     robot_desc_val_t prev_val = rd_shm_ptr->fields[field];
     if (prev_val != val) {
-        // write the val into the field
+        // write the val into the field, then wake up everyone waiting for a change
         rd_shm_ptr->fields[field] = val;
+        uint32_t seq = atomic_load_explicit(&rd_shm_ptr->seq, memory_order_relaxed) + 1;
+        atomic_store_explicit(&rd_shm_ptr->field_seqs[field], seq, memory_order_relaxed);
+        atomic_store_explicit(&rd_shm_ptr->seq, seq, memory_order_release);
+        futex_wake(&rd_shm_ptr->seq);
 
         /**
          * Edge case: If no inputs are connected during TELEOP, stop the robot
@@ -539,42 +1134,65 @@ void robot_desc_write(robot_desc_field_t field, robot_desc_val_t val) {
         }
     }
 
-    // release rd_sem
-    my_sem_post(rd_sem, "robot_desc_mutex");
+    // unlock the robot description
+    my_mutex_unlock(SHM_LOCK_RD, "robot_desc_mutex");
+}
+
+int robot_desc_wait(robot_desc_field_t field, uint32_t* last_seq, uint32_t timeout_ms) {
+    uint64_t deadline = monotonic_millis() + timeout_ms;
+    uint64_t now;
+    uint32_t seq, field_seq;
+
+    // sleep until the field changes, retrying on spurious wakeups and changes to other fields
+    while (1) {
+        seq = atomic_load_explicit(&rd_shm_ptr->seq, memory_order_acquire);
+        field_seq = (field == ROBOT_DESC_ANY) ? seq : atomic_load_explicit(&rd_shm_ptr->field_seqs[field], memory_order_relaxed);
+        if ((int32_t) (field_seq - *last_seq) > 0) {
+            *last_seq = field_seq;
+            return 0;
+        }
+        now = monotonic_millis();
+        if (now >= deadline) {
+            return -1;
+        }
+        futex_wait(&rd_shm_ptr->seq, seq, deadline - now);
+    }
 }
 
 int input_read(uint64_t* pressed_buttons, float joystick_vals[4], robot_desc_field_t source) {
+    uint32_t seq;
+    uint64_t timestamp;
+    return input_read_seq(pressed_buttons, joystick_vals, source, &seq, &timestamp);
+}
+
+int input_read_seq(uint64_t* pressed_buttons, float joystick_vals[4], robot_desc_field_t source, uint32_t* seq, uint64_t* timestamp) {
     if (source != GAMEPAD && source != KEYBOARD) {
         log_printf(FATAL, "input_read: incorrect API usage, can only read inputs for GAMEPAD and KEYBOARD.");
         exit(1);
     }
 
-    // wait on rd_sem
-    my_sem_wait(rd_sem, "robot_desc_mutex");
-
-    // if input isn't connected, then release rd_sem and return
-    if (rd_shm_ptr->fields[source] == DISCONNECTED) {
-        my_sem_post(rd_sem, "robot_desc_mutex");
+    // if input isn't connected, then return; a single byte is read atomically, so the robot description lock isn't needed
+    if (((volatile uint8_t*) rd_shm_ptr->fields)[source] == DISCONNECTED) {
         return -1;
     }
 
-    // release rd_sem
-    my_sem_post(rd_sem, "robot_desc_mutex");
-
-    // wait on gp_sem
-    my_sem_wait(input_sem, "input_mutex");
-
-    int index = (source == GAMEPAD) ? 0 : 1;
-    *pressed_buttons = input_shm_ptr->inputs[index].buttons;
-    if (source == GAMEPAD) {
-        for (int i = 0; i < 4; i++) {
-            joystick_vals[i] = input_shm_ptr->inputs[index].joysticks[i];
+    // get a consistent copy of the input; retry if it was written while we were reading it
+    volatile input_t* input = &input_shm_ptr->inputs[(source == GAMEPAD) ? 0 : 1];
+    uint32_t start;
+    do {
+        while ((start = atomic_load_explicit(&input->seq, memory_order_acquire)) & 1) {
+            sched_yield();
         }
-    }
-
-
-    // release gp_sem
-    my_sem_post(input_sem, "input_mutex");
+        *timestamp = input->timestamp;
+        *pressed_buttons = input->buttons;
+        if (source == GAMEPAD) {
+            for (int i = 0; i < 4; i++) {
+                joystick_vals[i] = input->joysticks[i];
+            }
+        }
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&input->seq, memory_order_relaxed) != start);
+    *seq = start / 2;
 
     return 0;
 }
@@ -585,80 +1203,96 @@ int input_write(uint64_t pressed_buttons, float joystick_vals[4], robot_desc_fie
         exit(1);
     }
 
-    // wait on rd_sem
-    my_sem_wait(rd_sem, "robot_desc_mutex");
+    // lock the robot description
+    my_mutex_lock(SHM_LOCK_RD, "robot_desc_mutex");
 
-    // if input isn't connected, then release rd_sem and return
+    // if input isn't connected, then unlock the robot description and return
     if (rd_shm_ptr->fields[source] == DISCONNECTED) {
         log_printf(ERROR, "input_write: no %s connected", field_to_string(source));
-        my_sem_post(rd_sem, "robot_desc_mutex");
+        my_mutex_unlock(SHM_LOCK_RD, "robot_desc_mutex");
         return -1;
     }
 
-    // release rd_sem
-    my_sem_post(rd_sem, "robot_desc_mutex");
+    // unlock the robot description
+    my_mutex_unlock(SHM_LOCK_RD, "robot_desc_mutex");
 
-    // wait on gp_sem
-    my_sem_wait(input_sem, "input_mutex");
+    // lock the inputs
+    my_mutex_lock(SHM_LOCK_INPUT, "input_mutex");
 
-    int index = (source == GAMEPAD) ? 0 : 1;
-    input_shm_ptr->inputs[index].buttons = pressed_buttons;
+    // the input lock serializes writers; mark the input as being modified for lock-free readers
+    input_t* input = &input_shm_ptr->inputs[(source == GAMEPAD) ? 0 : 1];
+    atomic_store_explicit(&input->seq, atomic_load_explicit(&input->seq, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    input->timestamp = monotonic_millis();
+    input->buttons = pressed_buttons;
 
     // if source == KEYBOARD, then joystick_vals = NULL, resulting in segfault
     if (source == GAMEPAD) {
         for (int i = 0; i < 4; i++) {
-            input_shm_ptr->inputs[index].joysticks[i] = joystick_vals[i];
+            input->joysticks[i] = joystick_vals[i];
         }
     }
 
-    // release gp_sem
-    my_sem_post(input_sem, "input_mutex");
+    atomic_store_explicit(&input->seq, atomic_load_explicit(&input->seq, memory_order_relaxed) + 1, memory_order_release);
+
+    // unlock the inputs
+    my_mutex_unlock(SHM_LOCK_INPUT, "input_mutex");
 
     return 0;
 }
 
 int log_data_write(char* key, param_type_t type, param_val_t value) {
-    // wait on log_data_sem
-    my_sem_wait(log_data_sem, "log_data_mutex");
-
-    // find the index corresponding to this key in the log_data shm block
-    int idx = 0;
-    for (; idx < log_data_shm_ptr->num_params; idx++) {
-        if (strcmp(key, log_data_shm_ptr->names[idx]) == 0) {
-            break;
-        }
-    }
-
-    // return if we ran out of keys for log data
-    if (idx == UCHAR_MAX) {
-        log_printf(ERROR, "Maximum number of %d log data keys reached. can't add key %s", UCHAR_MAX, key);
-        return -1;
-    }
-
     if (strlen(key) >= LOG_KEY_LENGTH) {
         log_printf(ERROR, "Key name %s for log data is longer than %d characters", key, LOG_KEY_LENGTH);
         return -2;
     }
 
-    // copy over the name, type, and parameter of the log data into the shared memory block
-    strcpy(log_data_shm_ptr->names[idx], key);
-    log_data_shm_ptr->types[idx] = type;
-    log_data_shm_ptr->params[idx] = value;
+    // lock the log data
+    my_mutex_lock(SHM_LOCK_LOG_DATA, "log_data_mutex");
 
-    // if this a new parameter, increment the number of parameters in log data shared memory block
-    if (idx == log_data_shm_ptr->num_params) {
-        log_data_shm_ptr->num_params++;
+    // find the index corresponding to this key in the log_data shm block, or the empty slot of the hash index where it goes
+    int slot = log_key_hash(key) & (LOG_INDEX_SIZE - 1);
+    while (log_data_shm_ptr->index[slot] != 0 && strcmp(key, log_data_shm_ptr->names[log_data_shm_ptr->index[slot] - 1]) != 0) {
+        slot = (slot + 1) & (LOG_INDEX_SIZE - 1);
     }
 
-    // release log_data_sem
-    my_sem_post(log_data_sem, "log_data_mutex");
+    int idx;
+    if (log_data_shm_ptr->index[slot] != 0) {
+        idx = log_data_shm_ptr->index[slot] - 1;
+    } else {
+        // return if we ran out of keys for log data
+        if (log_data_shm_ptr->num_params == UCHAR_MAX) {
+            my_mutex_unlock(SHM_LOCK_LOG_DATA, "log_data_mutex");
+            log_printf(ERROR, "Maximum number of %d log data keys reached. can't add key %s", UCHAR_MAX, key);
+            return -1;
+        }
+
+        // this is a new parameter; add it at the end and to the hash index
+        idx = log_data_shm_ptr->num_params++;
+        strcpy(log_data_shm_ptr->names[idx], key);
+        log_data_shm_ptr->types[idx] = type;
+        log_data_shm_ptr->index[slot] = idx + 1;
+        log_data_shm_ptr->names_version++;
+    }
+
+    // copy over the type and parameter of the log data into the shared memory block
+    if (log_data_shm_ptr->types[idx] != type) {
+        log_data_shm_ptr->types[idx] = type;
+        log_data_shm_ptr->names_version++;
+    }
+    log_data_shm_ptr->params[idx] = value;
+    log_data_shm_ptr->value_versions[idx] = ++log_data_shm_ptr->values_version;
+
+    // unlock the log data
+    my_mutex_unlock(SHM_LOCK_LOG_DATA, "log_data_mutex");
 
     return 0;
 }
 
 void log_data_read(uint8_t* num_params, char names[UCHAR_MAX][LOG_KEY_LENGTH], param_type_t types[UCHAR_MAX], param_val_t values[UCHAR_MAX]) {
-    // wait on log_data_sem
-    my_sem_wait(log_data_sem, "log_data_mutex");
+    // lock the log data
+    my_mutex_lock(SHM_LOCK_LOG_DATA, "log_data_mutex");
 
     // read all of the data in the log data shared memory block into provided pointers
     *num_params = log_data_shm_ptr->num_params;
@@ -668,6 +1302,94 @@ void log_data_read(uint8_t* num_params, char names[UCHAR_MAX][LOG_KEY_LENGTH], p
         values[i] = log_data_shm_ptr->params[i];
     }
 
-    // release log_data_sem
-    my_sem_post(log_data_sem, "log_data_mutex");
+    // unlock the log data
+    my_mutex_unlock(SHM_LOCK_LOG_DATA, "log_data_mutex");
+}
+
+bool log_data_read_changed(uint32_t* names_version, uint32_t* values_version, uint8_t* num_params, char names[UCHAR_MAX][LOG_KEY_LENGTH],
+                           param_type_t types[UCHAR_MAX], param_val_t values[UCHAR_MAX]) {
+    bool changed = false;
+
+    // lock the log data
+    my_mutex_lock(SHM_LOCK_LOG_DATA, "log_data_mutex");
+
+    // copy names and types only if keys were added or changed type
+    if (log_data_shm_ptr->names_version != *names_version) {
+        for (int i = 0; i < log_data_shm_ptr->num_params; i++) {
+            if (i >= *num_params || log_data_shm_ptr->types[i] != types[i]) {
+                strcpy(names[i], log_data_shm_ptr->names[i]);
+                types[i] = log_data_shm_ptr->types[i];
+            }
+        }
+        *num_params = log_data_shm_ptr->num_params;
+        *names_version = log_data_shm_ptr->names_version;
+        changed = true;
+    }
+
+    // copy only the values written since the caller's copy was last brought up to date
+    if (log_data_shm_ptr->values_version != *values_version) {
+        for (int i = 0; i < *num_params; i++) {
+            if ((int32_t) (log_data_shm_ptr->value_versions[i] - *values_version) > 0) {
+                values[i] = log_data_shm_ptr->params[i];
+            }
+        }
+        *values_version = log_data_shm_ptr->values_version;
+        changed = true;
+    }
+
+    // unlock the log data
+    my_mutex_unlock(SHM_LOCK_LOG_DATA, "log_data_mutex");
+
+    return changed;
+}
+
+// **************************************** LOCK STATISTICS *********************************************** //
+
+void sem_stats_enable(bool enabled) {
+#if SEM_STATS
+    atomic_store_explicit(&sem_stats_shm_ptr->enabled, enabled, memory_order_relaxed);
+#endif
+}
+
+void sem_stats_reset() {
+    for (int i = 0; i < NUM_SHM_LOCKS; i++) {
+        sem_stats_t* stats = &sem_stats_shm_ptr->sems[i];
+        atomic_store_explicit(&stats->acquisitions, 0, memory_order_relaxed);
+        atomic_store_explicit(&stats->contended, 0, memory_order_relaxed);
+        atomic_store_explicit(&stats->wait_ns, 0, memory_order_relaxed);
+        atomic_store_explicit(&stats->hold_ns, 0, memory_order_relaxed);
+        for (int j = 0; j < SEM_STATS_BUCKETS; j++) {
+            atomic_store_explicit(&stats->wait_hist[j], 0, memory_order_relaxed);
+            atomic_store_explicit(&stats->hold_hist[j], 0, memory_order_relaxed);
+        }
+    }
+}
+
+void sem_stats_read(int lock_ix, sem_stats_t* stats) {
+    sem_stats_t* src = &sem_stats_shm_ptr->sems[lock_ix];
+    atomic_init(&stats->acquisitions, atomic_load_explicit(&src->acquisitions, memory_order_relaxed));
+    atomic_init(&stats->contended, atomic_load_explicit(&src->contended, memory_order_relaxed));
+    atomic_init(&stats->wait_ns, atomic_load_explicit(&src->wait_ns, memory_order_relaxed));
+    atomic_init(&stats->hold_ns, atomic_load_explicit(&src->hold_ns, memory_order_relaxed));
+    for (int j = 0; j < SEM_STATS_BUCKETS; j++) {
+        atomic_init(&stats->wait_hist[j], atomic_load_explicit(&src->wait_hist[j], memory_order_relaxed));
+        atomic_init(&stats->hold_hist[j], atomic_load_explicit(&src->hold_hist[j], memory_order_relaxed));
+    }
+    stats->acquired_at = 0;
+}
+
+void sem_stats_name(int lock_ix, char* name) {
+    if (lock_ix == SHM_LOCK_CATALOG) {
+        strcpy(name, "catalog");
+    } else if (lock_ix == SHM_LOCK_INPUT) {
+        strcpy(name, "inputs");
+    } else if (lock_ix == SHM_LOCK_RD) {
+        strcpy(name, "robot desc");
+    } else if (lock_ix == SHM_LOCK_LOG_DATA) {
+        strcpy(name, "log data");
+    } else if (lock_ix < SHM_LOCK_COMMAND(0)) {
+        sprintf(name, "data %d", lock_ix - SHM_LOCK_DATA(0));
+    } else {
+        sprintf(name, "command %d", lock_ix - SHM_LOCK_COMMAND(0));
+    }
 }
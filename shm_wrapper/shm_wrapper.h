@@ -2,28 +2,57 @@
 #define SHM_WRAPPER_H
 
 #include <limits.h>     // for UCHAR_MAX
-#include <semaphore.h>  // for semaphores
+#include <sched.h>      // for sched_yield
+#include <stdatomic.h>  // for atomic sequence counters
 #include <stdbool.h>
 #include <sys/mman.h>  // for posix shared memory
 
 #include <logger.h>        // for logger
 #include <runtime_util.h>  // for runtime constants
 
-// names of various objects used in shm_wrapper; should not be used outside of shm_wrapper.c, shm_start.c, and shm_stop.c
-#define DEV_SHM_NAME "/dev-shm"        // name of shared memory block across devices
-#define CATALOG_MUTEX_NAME "/cat-sem"  // name of semaphore used as a mutex on the catalog
-#define CMDMAP_MUTEX_NAME "/cmap-sem"  // name of semaphore used as a mutex on the command bitmap
+// name of the shared memory segment that holds every block and lock; should not be used outside of shm_wrapper.c, shm_start.c, and shm_stop.c
+#define SHM_NAME "/runtime-shm"
 
-#define INPUTS_SHM_NAME "/inputs-shm"    // name of shared memory block for inputs
-#define INPUTS_MUTEX_NAME "/inputs-sem"  // name of semaphore used as mutex over inputs shm
+#define SNAME_SIZE 32  // size of buffers that hold lock names, in bytes
 
-#define ROBOT_DESC_SHM_NAME "/rd-shm"  // name of shared memory block for robot description
-#define RD_MUTEX_NAME "/rd-sem"        // name of semaphore used as mutex over robot description shm
+#define ROBOT_DESC_ANY NUM_DESC_FIELDS  // pass to robot_desc_wait() in place of a field to wait for a change to any field
 
-#define LOG_DATA_SHM "/log-data-shm"    // name of shared memory block for Robot.log data
-#define LOG_DATA_MUTEX "/log-data-sem"  // name of semaphore used as mutex over Robot.log shm
+#define CACHE_LINE_SIZE 64    // size of a cache line on the Raspberry Pi (and x86), in bytes
+#define SHM_LAYOUT_VERSION 8  // increment whenever shm_segment_t changes; shm_init() refuses to map a segment with a different layout
 
-#define SNAME_SIZE 32  // size of buffers that hold semaphore names, in bytes
+#define DEV_HISTORY_LEN 64  // number of DATA samples of each device kept in its history ring (must be a power of 2)
+
+// processes whose reads of device data are recorded so that dev handler subscribes each device to just the params that are read
+#define READER_EXECUTOR 0     // index of executor in dev_interest_t
+#define READER_NET_HANDLER 1  // index of net handler in dev_interest_t
+#define NUM_READERS 2         // number of processes whose reads are recorded
+
+#define LOG_INDEX_SIZE 512  // number of slots in the hash index of Robot.log keys (a power of 2 at least twice UCHAR_MAX)
+
+// log2 of the number of slots in the uid index
+#if MAX_DEVICES <= 32
+#define UID_INDEX_BITS 6
+#else
+#define UID_INDEX_BITS 7
+#endif
+#define UID_INDEX_SIZE (1 << UID_INDEX_BITS)  // number of slots in the uid index; at least twice MAX_DEVICES to keep probe sequences short
+_Static_assert(UID_INDEX_SIZE >= 2 * MAX_DEVICES, "the uid index needs at least twice MAX_DEVICES slots");
+
+// set to 0 (ex: with -DSEM_STATS=0) to compile lock statistics out of every lock and unlock
+#ifndef SEM_STATS
+#define SEM_STATS 1
+#endif
+
+#define SEM_STATS_BUCKETS 16  // number of buckets in each wait-time and hold-time histogram (see sem_stats_t)
+
+// index of each lock in shm_segment_t, and of its statistics in sem_stats_shm_t
+#define SHM_LOCK_CATALOG 0                                     // catalog mutex
+#define SHM_LOCK_INPUT 1                                       // inputs mutex
+#define SHM_LOCK_RD 2                                          // robot description mutex
+#define SHM_LOCK_LOG_DATA 3                                    // log data mutex
+#define SHM_LOCK_DATA(dev_ix) (4 + (dev_ix))                   // mutex on the data stream of device dev_ix
+#define SHM_LOCK_COMMAND(dev_ix) (4 + MAX_DEVICES + (dev_ix))  // mutex on the command stream of device dev_ix
+#define NUM_SHM_LOCKS (4 + 2 * MAX_DEVICES)                    // number of locks
 
 // *********************************** SHM TYPEDEFS  ****************************************************** //
 
@@ -33,23 +62,113 @@ typedef enum stream {
     COMMAND
 } stream_t;
 
+// state of a slot in the uid index
+typedef enum uid_slot_state {
+    UID_SLOT_EMPTY,    // never used, or cleaned up; ends a probe sequence
+    UID_SLOT_USED,     // holds the uid of a connected device
+    UID_SLOT_DELETED   // held the uid of a device that has since disconnected; does not end a probe sequence
+} uid_slot_state_t;
+
+// one slot of the open-addressed (linear probing) hash index from device uid to dev_ix
+typedef struct {
+    _Atomic uint32_t gen;  // incremented before and after every change to the slot (odd while a change is in progress)
+    uint8_t state;         // one of the uid_slot_state_t's
+    uint8_t dev_ix;        // index of the device in shared memory, if state is UID_SLOT_USED
+    uint64_t uid;          // uid of the device, if state is UID_SLOT_USED
+} uid_slot_t;
+
+// one device's DATA or COMMAND stream; each is aligned to a cache line so that writes to one device never invalidate another's
+typedef struct {
+    _Atomic uint32_t seq;                 // DATA only: seqlock counter (odd while a write is in progress)
+    _Atomic uint32_t doorbell;            // COMMAND only: incremented (and futex-woken) on every write
+    uint32_t version;                     // incremented on every write that changes the value of at least one param
+    uint64_t last_update;                 // monotonic_millis() at the last write to the stream (0 if not written since the device connected)
+    param_val_t params[MAX_PARAMS];       // the device parameter values of this stream
+    uint32_t param_versions[MAX_PARAMS];  // value of version when each param last changed
+} __attribute__((aligned(CACHE_LINE_SIZE))) dev_stream_t;
+
+// one sample of a device's DATA stream, as kept in its history ring
+typedef struct {
+    uint32_t index;                  // number of the sample; each device's samples are numbered consecutively in the order they were written
+    bitmap_t written;                // bitmap of the params written by the device_write() that produced the sample
+    uint64_t timestamp;              // monotonic_millis() when the sample was written
+    param_val_t params[MAX_PARAMS];  // values of all params of the DATA stream right after that write
+} dev_sample_t;
+
+// one slot of a device's history ring
+typedef struct {
+    _Atomic uint32_t gen;  // incremented before and after every change to the slot (odd while a change is in progress)
+    dev_sample_t sample;   // the sample held by the slot
+} history_slot_t;
+
+// ring of the most recent DATA samples of a device, written by device_write() and read lock-free by device_read_history()
+typedef struct {
+    _Atomic uint32_t head;                  // number of samples ever written (index of the next sample)
+    _Atomic uint32_t first;                 // index of the first sample of the device currently connected at this index
+    history_slot_t slots[DEV_HISTORY_LEN];  // sample with index i is in slot i % DEV_HISTORY_LEN
+} __attribute__((aligned(CACHE_LINE_SIZE))) dev_history_t;
+
+// which params of a device's DATA stream each reader read recently, recorded by device_read() and device_read_all() and collected by device_collect_interest()
+typedef struct {
+    _Atomic bitmap_t params[NUM_READERS];     // params each reader read since dev handler last collected them
+    _Atomic uint32_t num_reads[NUM_READERS];  // number of different milliseconds in which each reader read the device since then
+    _Atomic uint32_t last_read[NUM_READERS];  // lower 32 bits of monotonic_millis() at each reader's last read
+} __attribute__((aligned(CACHE_LINE_SIZE))) dev_interest_t;
+
+// statistics of dev handler's link to a device since the device connected; rates are over the interval between the last two updates
+typedef struct {
+    uint64_t bytes_in;            // number of bytes received from the device
+    uint64_t reads;               // number of read() calls that dev handler made to receive them
+    uint64_t bytes_out;           // number of bytes sent to the device
+    uint64_t frames_in;           // number of valid messages received from the device
+    uint64_t frames_out;          // number of messages sent to the device
+    uint32_t bytes_in_per_sec;    // bytes received per second
+    uint32_t bytes_out_per_sec;   // bytes sent per second
+    uint32_t frames_in_per_sec;   // valid messages received per second
+    uint32_t frames_out_per_sec;  // messages sent per second
+    uint32_t decode_errors;       // number of messages dropped because they were cut short, had a bad length, or couldn't be parsed
+    uint32_t checksum_errors;     // number of messages dropped because their checksum didn't match
+    uint64_t resync_bytes;        // number of received bytes skipped to find the start of the next message
+    uint32_t write_backlog;       // number of bytes sent to the device that were still queued in the serial port or socket (or in event loop mode, dev handler's send queue) at the last update
+    uint32_t tx_drops;            // number of messages not sent because the device didn't take them fast enough (event loop mode only)
+    uint32_t handshake_rtt_us;    // microseconds the device took to answer the DEVICE_PING before its ACKNOWLEDGEMENT, or its last SET_BAUD; measured only then, since connected devices don't answer DEVICE_PINGs
+    uint64_t updated_at;          // monotonic_millis() at the last update (0 if not updated since the device connected)
+} dev_link_stats_t;
+
+// a device's link statistics, written by device_write_link_stats() and read lock-free by device_read_link_stats()
+typedef struct {
+    _Atomic uint32_t gen;    // incremented before and after every change to the stats (odd while a change is in progress)
+    dev_link_stats_t stats;  // the statistics of the device currently connected at this index
+} __attribute__((aligned(CACHE_LINE_SIZE))) link_stats_slot_t;
+
 // shared memory block that holds device information, data, and commands has this structure
+// fields that are written by different processes at different times start on their own cache lines
 typedef struct {
-    uint32_t catalog;                                // catalog of valid devices
-    uint32_t cmd_map[MAX_DEVICES + 1];               // bitmap is 33 32-bit integers (changed devices and changed params of device commands from executor to dev_handler)
-    param_val_t params[2][MAX_DEVICES][MAX_PARAMS];  // all the device parameter info, data and commands
-    dev_id_t dev_ids[MAX_DEVICES];                   // all the device identification info
+    bitmap_t catalog;                                                     // catalog of valid devices
+    _Atomic uint32_t catalog_gen;                                         // incremented before and after every change to catalog and dev_ids (odd while a change is in progress)
+    _Alignas(CACHE_LINE_SIZE) dev_id_t dev_ids[MAX_DEVICES];              // all the device identification info
+    _Alignas(CACHE_LINE_SIZE) _Atomic bitmap_t cmd_map[MAX_DEVICES + 1];  // bitmap is MAX_DEVICES + 1 bitmaps (changed devices and changed params of device commands from executor to dev_handler)
+    _Atomic uint32_t cmd_doorbell;                                        // incremented (and futex-woken) on every write to any device's COMMAND stream
+    _Alignas(CACHE_LINE_SIZE) dev_stream_t streams[2][MAX_DEVICES];       // all the device parameter info, data and commands
+    _Alignas(CACHE_LINE_SIZE) uid_slot_t uid_index[UID_INDEX_SIZE];       // hash index from uid to dev_ix of connected devices (maintained by device_connect/disconnect)
+    dev_history_t history[MAX_DEVICES];                                   // recent DATA samples of each device
+    dev_interest_t interest[MAX_DEVICES];                                 // params of each device that executor and net handler read recently
+    link_stats_slot_t link_stats[MAX_DEVICES];                            // statistics of dev handler's link to each device
 } dev_shm_t;
 
-// two mutex semaphores for each device
+// consistent copy of every connected device's identifiers and data, filled in by device_read_all()
 typedef struct {
-    sem_t* data_sem;     // semaphore on the data stream of a device
-    sem_t* command_sem;  // semaphore on the command stream of a device
-} dual_sem_t;
+    uint32_t generation;                          // value of catalog_gen when the snapshot was taken; changes iff devices connected or disconnected
+    bitmap_t catalog;                             // catalog of valid devices
+    dev_id_t dev_ids[MAX_DEVICES];                // device identification info (valid only for devices in the catalog)
+    param_val_t params[MAX_DEVICES][MAX_PARAMS];  // readable DATA params of each device (valid only for devices in the catalog)
+} dev_snapshot_t;
 
 
 // struct describing an input
 typedef struct {
+    _Atomic uint32_t seq;       // incremented before and after every write (odd while a write is in progress); seq / 2 is the number of writes
+    uint64_t timestamp;         // monotonic_millis() when the input was last written
     uint64_t buttons;           // bitmap for which buttons are pressed
     float joysticks[4];         // array to hold joystick positions, only for gamepad
     robot_desc_field_t source;  // which hardware device the command came from, either GAMEPAD or KEYBOARD
@@ -62,53 +181,82 @@ typedef struct {
 
 // shared memory for robot description
 typedef struct {
-    uint8_t fields[NUM_DESC_FIELDS];  // array to hold the robot state (each is a enum stored as a uint8_t)
+    uint8_t fields[NUM_DESC_FIELDS];               // array to hold the robot state (each is a enum stored as a uint8_t)
+    _Atomic uint32_t seq;                          // incremented (and futex-woken) on every change to any field
+    _Atomic uint32_t field_seqs[NUM_DESC_FIELDS];  // value of seq right after each field last changed
 } robot_desc_shm_t;
 
 
 // shared memory for Robot.log data
 typedef struct {
     uint8_t num_params;                     // number of quantities the student wants to log
+    uint32_t names_version;                 // incremented every time a key is added or the type of a key changes
+    uint32_t values_version;                // incremented on every write of a value
+    uint8_t index[LOG_INDEX_SIZE];          // open-addressed (linear probing) hash index from key to its position + 1 (0 if empty)
     char names[UCHAR_MAX][LOG_KEY_LENGTH];  // keys (names) of quantities that student wants to log
     param_val_t params[UCHAR_MAX];          // values of quantities that student wants to log
     param_type_t types[UCHAR_MAX];          // types of the values that student wants to log
+    uint32_t value_versions[UCHAR_MAX];     // value of values_version when each value was last written
 } log_data_shm_t;
 
+/* Statistics of one lock, updated by every process that locks or unlocks it while statistics are enabled.
+ * Bucket 0 of a histogram counts durations under 1 microsecond; bucket i counts durations of [2^(i-1), 2^i)
+ * microseconds, except for the last bucket, which counts all longer durations too.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t acquisitions;  // number of times the lock was acquired
+    _Atomic uint64_t contended;                               // number of acquisitions that had to wait for another holder
+    _Atomic uint64_t wait_ns;                                 // total nanoseconds spent waiting by contended acquisitions
+    _Atomic uint64_t hold_ns;                                 // total nanoseconds the lock was held
+    _Atomic uint32_t wait_hist[SEM_STATS_BUCKETS];            // histogram of the wait times of contended acquisitions
+    _Atomic uint32_t hold_hist[SEM_STATS_BUCKETS];            // histogram of the hold times
+    uint64_t acquired_at;                                     // time the current holder acquired the lock (0 if unknown); only touched by the holder
+} sem_stats_t;
+
+// shared memory for lock statistics
+typedef struct {
+    _Atomic uint32_t enabled;         // whether locks and unlocks update the statistics
+    sem_stats_t sems[NUM_SHM_LOCKS];  // statistics of each lock; indexed by the SHM_LOCK_* defines
+} sem_stats_shm_t;
+
+// a mutex in shared memory, on its own cache line
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t mutex;  // process-shared and robust: if its holder dies, the next locker recovers it
+} shm_lock_t;
+
+// the single shared memory segment that holds every block and the locks that protect them
+typedef struct {
+    _Atomic uint32_t layout_version;  // SHM_LAYOUT_VERSION of the shm_start that created the segment; set once the segment is initialized
+    shm_lock_t locks[NUM_SHM_LOCKS];  // indexed by the SHM_LOCK_* defines
+    dev_shm_t devices;                // device information, data, and commands
+    input_shm_t inputs;               // gamepad and keyboard inputs
+    robot_desc_shm_t robot_desc;      // robot description
+    log_data_shm_t log_data;          // Robot.log data
+    sem_stats_shm_t sem_stats;        // lock statistics
+} shm_segment_t;
+
 // *********************************** SHM EXTERNAL VARIABLES  ******************************************** //
 
 // DO NOT USE THESE UNDER NORMAL CIRCUMSTANCES
 // THESE ARE ONLY USED TO SIMPLIFY CODE IN SHM_START AND SHM_STOP
 
-extern dual_sem_t sems[MAX_DEVICES];  // array of semaphores, two for each possible device (one for data and one for commands)
-extern dev_shm_t* dev_shm_ptr;        // points to memory-mapped shared memory block for device data and commands
-extern sem_t* catalog_sem;            // semaphore used as a mutex on the catalog
-extern sem_t* cmd_map_sem;            // semaphore used as a mutex on the command bitmap
-
-extern input_shm_t* input_shm_ptr;    // points to memory-mapped shared memory block for user inputs
-extern robot_desc_shm_t* rd_shm_ptr;  // points to memory-mapped shared memory block for robot description
-extern sem_t* input_sem;              // semaphore used as a mutex on the inputs
-extern sem_t* rd_sem;                 // semaphore used as a mutex on the robot description
+extern shm_segment_t* shm_ptr;  // points to the memory-mapped shared memory segment
 
-extern log_data_shm_t* log_data_shm_ptr;  // points to shared memory block for log data specified by executor
-extern sem_t* log_data_sem;               // semaphore used as a mutex on the log data
+// each of these points to its block inside the segment
+extern dev_shm_t* dev_shm_ptr;              // points to memory-mapped shared memory block for device data and commands
+extern input_shm_t* input_shm_ptr;          // points to memory-mapped shared memory block for user inputs
+extern robot_desc_shm_t* rd_shm_ptr;        // points to memory-mapped shared memory block for robot description
+extern log_data_shm_t* log_data_shm_ptr;    // points to shared memory block for log data specified by executor
+extern sem_stats_shm_t* sem_stats_shm_ptr;  // points to shared memory block for lock statistics
 
 // ******************************************* WRAPPER FUNCTIONS ****************************************** //
 
 // Returns true iff shared memory exists.
 bool shm_exists();
 
-/**
- * Function that generates a semaphore name for the data and command streams
- * Should only be externally called by shm_start and shm_stop programs
- * Arguments:
- *    stream: stream for which the semaphore is created (one of DATA or COMMAND)
- *    dev_ix: index of device whose STREAM is being created
- *    name: pointer to a buffer of size SNAME_SIZE into which the name of the semaphore will be put
- */
-void generate_sem_name(stream_t stream, int dev_ix, char* name);
-
 /**
  * Returns the index in the SHM block of the specified device if it exists (-1 if it doesn't)
+ * Runs in constant time using the uid index and doesn't block; safe to call while devices connect or disconnect.
  * Arguments:
  *    dev_uid: 64-bit unique ID of the device
  * Returns: device index in shared memory of the specified device, -1 if specified device is not in shared memory
@@ -118,7 +266,7 @@ int get_dev_ix_from_uid(uint64_t dev_uid);
 /**
  * Call this function from every process that wants to use the shared memory wrapper
  * No return value (will exit on fatal errors).
- * Will configure process to close all shared memory and semaphores on process exit.
+ * Will configure process to unmap shared memory on process exit.
  */
 void shm_init();
 
@@ -144,6 +292,9 @@ void device_disconnect(int dev_ix);
 /**
  * Should be called from every process wanting to read the device data
  * Takes care of updating the param bitmap for fast transfer of commands from executor to device handler
+ * Reads of the DATA stream are lock-free: they never take a lock and retry if they overlap a write.
+ * Reads of the DATA stream by EXECUTOR or NET_HANDLER are recorded, so that the device keeps sending those params (see device_collect_interest()).
+ * See device_read_changed() to read only the params that changed since a previous read.
  * Arguments:
  *    dev_ix: device index of the device whose data is being requested
  *    process: the calling process, one of DEV_HANDLER, EXECUTOR, or NET_HANDLER
@@ -155,18 +306,22 @@ void device_disconnect(int dev_ix);
  *    0 on success
  *    -1 on failure (specified device is not connected in shm)
  */
-int device_read(int dev_ix, process_t process, stream_t stream, uint32_t params_to_read, param_val_t* params);
+int device_read(int dev_ix, process_t process, stream_t stream, bitmap_t params_to_read, param_val_t* params);
 
 /**
  * This function is the exact same as the above function, but instead uses the 64-bit device UID to identify
  * the device that should be read, rather than the device index.
  */
-int device_read_uid(uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_read, param_val_t* params);
+int device_read_uid(uint64_t dev_uid, process_t process, stream_t stream, bitmap_t params_to_read, param_val_t* params);
 
 /**
  * Should be called from every process wanting to write to the device data
  * Takes care of updating the param bitmap for fast transfer of commands from executor to device handler
- * Grabs either one or two semaphores depending on calling process and stream requested.
+ * Grabs either one or two locks depending on calling process and stream requested.
+ * Writes to the DATA stream bump the device's sequence counter so that lock-free readers can detect them.
+ * Params whose value is changed by the write are stamped with a new version of the stream, and the
+ * stream's last update time is set, whether or not any value changed.
+ * Every write to the DATA stream also appends a sample to the device's history ring.
  * Arguments:
  *    dev_ix: device index of the device whose data is being written
  *    process: the calling process, one of DEV_HANDLER, EXECUTOR, or NET_HANDLER
@@ -178,26 +333,176 @@ int device_read_uid(uint64_t dev_uid, process_t process, stream_t stream, uint32
  *    0 on success
  *    -1 on failure (specified device is not connected in shm)
  */
-int device_write(int dev_ix, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params);
+int device_write(int dev_ix, process_t process, stream_t stream, bitmap_t params_to_write, param_val_t* params);
 
 /**
  * This function is the exact same as the above function, but instead uses the 64-bit device UID to identify
  * the device that should be written, rather than the device index.
  */
-int device_write_uid(uint64_t dev_uid, process_t process, stream_t stream, uint32_t params_to_write, param_val_t* params);
+int device_write_uid(uint64_t dev_uid, process_t process, stream_t stream, bitmap_t params_to_write, param_val_t* params);
 
 /**
- * Should be called from all processes that want to know current state of the command map (i.e. device handler)
- * Blocks on the command bitmap semaphore for obvious reasons
+ * Should be called from processes that only want the params of a device that changed since they last looked
+ * (i.e. to stream only deltas, or to skip work when nothing changed).
+ * Reads every param that changed since SINCE_VERSION, along with the current version of the stream.
+ * Does not block on the DATA stream, and does not affect the command map when reading the COMMAND stream.
  * Arguments:
- *    bitmap[MAX_DEVICES + 1]: pointer to array of 33 32-bit integers to copy the bitmap into. See the README for a
+ *    dev_ix: device index of the device whose data is being requested
+ *    stream: the requested block to read from, one of DATA, COMMAND
+ *    since_version: version returned by a previous call for the same device and stream (0 to read every param)
+ *    changed: bitmap of the params that changed since SINCE_VERSION will be put here
+ *    version: current version of the stream will be put here; pass it as SINCE_VERSION in the next call
+ *    params: pointer to array of MAX_PARAMS param_val_t's; the changed params will be read into the corresponding param_val_t's
+ * Returns:
+ *    0 on success
+ *    -1 on failure (specified device is not connected in shm)
+ */
+int device_read_changed(int dev_ix, stream_t stream, uint32_t since_version, bitmap_t* changed, uint32_t* version, param_val_t* params);
+
+/**
+ * Returns the time of the last write to a device's stream, for detecting stale values.
+ * Arguments:
+ *    dev_ix: device index of the device
+ *    stream: one of DATA, COMMAND
+ * Returns:
+ *    monotonic_millis() at the last write to the stream, or
+ *    0 if the stream wasn't written since the device connected, or the device isn't connected
+ */
+uint64_t device_last_update(int dev_ix, stream_t stream);
+
+/**
+ * Should be called from processes that want every update of a device's data rather than just the latest
+ * (i.e. for plots, or computing derivatives), without having to poll at the rate the device sends data.
+ * Copies the samples of the device's history ring from CURSOR onwards, oldest first. Does not block.
+ * Only the last DEV_HISTORY_LEN samples are kept; samples that were overwritten before they could be
+ * read are skipped, which shows as a gap in the sample indices.
+ * Arguments:
+ *    dev_ix: device index of the device whose history is being requested
+ *    cursor: index of the first sample wanted (0 for the oldest one kept, which is never from a previously
+ *        connected device); will be set to the index after the
+ *        last sample copied, so that passing it to the next call returns only newer samples
+ *    samples: pointer to array of dev_sample_t's that the samples will be copied into
+ *    max_samples: length of SAMPLES
+ * Returns:
+ *    number of samples copied into SAMPLES (0 if there are no new samples), or
+ *    -1 on failure (specified device is not connected in shm)
+ */
+int device_read_history(int dev_ix, uint32_t* cursor, dev_sample_t* samples, int max_samples);
+
+/**
+ * Should be called from processes that show or report the health of device links (i.e. shm_ui, net handler)
+ * Copies the statistics that device handler keeps about its link to a device. Does not block; the copy is
+ * retried if device handler updates the statistics during it, so they are never torn.
+ * Device handler updates them about once a second, so updated_at of the copy can be up to a second old.
+ * Arguments:
+ *    dev_ix: device index of the device whose link statistics are being requested
+ *    stats: pointer to the dev_link_stats_t that the statistics will be copied into
+ * Returns:
+ *    0 on success
+ *    -1 on failure (specified device is not connected in shm)
+ */
+int device_read_link_stats(int dev_ix, dev_link_stats_t* stats);
+
+/**
+ * Should be called from all processes that want to know current state of the command map
+ * Does not block; each entry of the command map is read atomically.
+ * Arguments:
+ *    bitmap[MAX_DEVICES + 1]: pointer to array of MAX_DEVICES + 1 bitmaps to copy the command map into. See the README for a
  *        description for how this bitmap works.
  */
-void get_cmd_map(uint32_t bitmap[MAX_DEVICES + 1]);
+void get_cmd_map(bitmap_t bitmap[MAX_DEVICES + 1]);
+
+/**
+ * Should be called from processes that want the data of every connected device at once (i.e. net handler)
+ * Copies the catalog, the identifiers of all connected devices, and their readable DATA params in a single pass.
+ * Params that aren't readable are left as they were in the snapshot.
+ * Does not block; the copy is retried if a device connects or disconnects during it, so the catalog and
+ * identifiers always match each other, and each device's params are never torn.
+ * Like device_read(), a read by EXECUTOR or NET_HANDLER is recorded (as a read of every readable param of every device).
+ * Arguments:
+ *    process: the calling process
+ *    snapshot: pointer to the snapshot to fill in
+ */
+void device_read_all(process_t process, dev_snapshot_t* snapshot);
+
+/**
+ * Should only be called from device handler
+ * Collects which params of a device executor and net handler read since the last call, and in how many
+ * different milliseconds they read them, then starts recording again from nothing.
+ * Device handler uses this to subscribe the device to just the params that are read, as often as they are read.
+ * Arguments:
+ *    dev_ix: device index of the device
+ *    params: array of NUM_READERS bitmaps; the params each reader read will be put here (indexed by READER_EXECUTOR, READER_NET_HANDLER)
+ *    num_reads: array of NUM_READERS counts; the number of milliseconds in which each reader read the device will be put here
+ */
+void device_collect_interest(int dev_ix, bitmap_t params[NUM_READERS], uint32_t num_reads[NUM_READERS]);
+
+/**
+ * Should only be called from device handler
+ * Replaces the link statistics of a device with new ones and stamps them with the current time.
+ * The statistics are reset to 0 when the device connects.
+ * Arguments:
+ *    dev_ix: device index of the device
+ *    stats: pointer to the new statistics (updated_at is ignored)
+ */
+void device_write_link_stats(int dev_ix, dev_link_stats_t* stats);
+
+/**
+ * Should only be called from device handler
+ * Atomically claims every param of the device that has a pending command and reads their values from the COMMAND stream.
+ * Claimed params are removed from the command map, so each command is handed out exactly once;
+ * a param written again after being claimed will be pending again.
+ * Arguments:
+ *    dev_ix: device index of the device whose commands are being claimed
+ *    params: pointer to array of MAX_PARAMS param_val_t's that the claimed params will be read into
+ * Returns:
+ *    bitmap of the params that were claimed and read into PARAMS (0 if there were no pending commands)
+ */
+bitmap_t device_claim_commands(int dev_ix, param_val_t* params);
+
+/**
+ * Returns the current value of a device's command doorbell, which is incremented on every write to its COMMAND stream.
+ * Read this before checking the command map so that a command written afterwards is never missed by wait_for_cmd().
+ * Arguments:
+ *    dev_ix: device index of the device whose doorbell is being read
+ * Returns the current doorbell value.
+ */
+uint32_t get_cmd_doorbell(int dev_ix);
+
+/**
+ * Blocks until a new command is written to the given device or the timeout expires, whichever is first.
+ * Intended for the device handler's sender threads, which would otherwise have to poll the command map.
+ * Arguments:
+ *    dev_ix: device index of the device to wait on
+ *    last_doorbell: doorbell value previously returned by get_cmd_doorbell()
+ *    timeout_ms: maximum number of milliseconds to wait
+ * Returns:
+ *    0 if a command was written since LAST_DOORBELL was read
+ *    -1 on timeout
+ */
+int wait_for_cmd(int dev_ix, uint32_t last_doorbell, uint32_t timeout_ms);
+
+/**
+ * Same as get_cmd_doorbell(), but for the doorbell that is incremented on every write to any device's COMMAND stream.
+ * Returns the current doorbell value.
+ */
+uint32_t get_any_cmd_doorbell();
+
+/**
+ * Blocks until a new command is written to any device or the timeout expires, whichever is first.
+ * Intended for the device handler's event loop, which handles every device from one thread.
+ * Arguments:
+ *    last_doorbell: doorbell value previously returned by get_any_cmd_doorbell()
+ *    timeout_ms: maximum number of milliseconds to wait
+ * Returns:
+ *    0 if a command was written since LAST_DOORBELL was read
+ *    -1 on timeout
+ */
+int wait_for_any_cmd(uint32_t last_doorbell, uint32_t timeout_ms);
 
 /**
  * Should be called from all processes that want to know device identifiers of all currently connected devices
- * Blocks on catalog semaphore for obvious reasons
+ * Blocks on catalog lock for obvious reasons
  * Arguments:
  *    dev_id_t dev_ids[MAX_DEVICES]: pointer to array of dev_id_t's to copy the information into
  */
@@ -205,14 +510,14 @@ void get_device_identifiers(dev_id_t dev_ids[MAX_DEVICES]);
 
 /**
  * Should be called from all processes that want to know which dev_ix's are valid
- * Blocks on catalog semaphore for obvious reasons
+ * Blocks on catalog lock for obvious reasons
  * Arguments:
- *    catalog: pointer to 32-bit integer into which the current catalog will be read into
+ *    catalog: pointer to bitmap into which the current catalog will be read into
  */
-void get_catalog(uint32_t* catalog);
+void get_catalog(bitmap_t* catalog);
 
 /**
- * Reads the specified robot description field. Blocks on the robot description semaphore.
+ * Reads the specified robot description field. Blocks on the robot description lock.
  * Arguments:
  *    field: one of the robot_desc_val_t's defined above to read from
  * Returns one of the robot_desc_val_t's defined in runtime_util that is the current value of the requested field.
@@ -220,16 +525,32 @@ void get_catalog(uint32_t* catalog);
 robot_desc_val_t robot_desc_read(robot_desc_field_t field);
 
 /**
- * Writes the specified value into the specified field. Blocks on the robot description semaphore.
+ * Writes the specified value into the specified field. Blocks on the robot description lock.
  * Arguments:
  *    field: one of the robot_desc_val_t's defined above to write val to
  *    val: one of the robot_desc_vals defined in runtime_util.c to write to the specified field
  */
 void robot_desc_write(robot_desc_field_t field, robot_desc_val_t val);
 
+/**
+ * Blocks until the specified robot description field changes or the timeout expires, whichever is first.
+ * Sleeps on a futex in shared memory, so the caller wakes up as soon as robot_desc_write() changes the field;
+ * use it instead of polling robot_desc_read().
+ * Writes that don't change the value of a field don't count as changes.
+ * Arguments:
+ *    field: one of the robot_desc_field_t's defined in runtime_util to wait on, or ROBOT_DESC_ANY to wait on all of them
+ *    last_seq: pointer to the sequence number of the last change the caller has seen (start with 0);
+ *        set to the sequence number of the change that ended the wait, for use in the next call
+ *    timeout_ms: maximum number of milliseconds to wait
+ * Returns:
+ *    0 if the field changed after LAST_SEQ (read it with robot_desc_read())
+ *    -1 on timeout
+ */
+int robot_desc_wait(robot_desc_field_t field, uint32_t* last_seq, uint32_t timeout_ms);
+
 /**
  * Reads current state of the gamepad to the provided pointers.
- * Blocks on both the gamepad semaphore and device description semaphore (to check if gamepad connected).
+ * Does not block: the buttons and joysticks are always from the same write, retrying if the read overlaps one.
  * Arguments:
  *    pressed_buttons: pointer to 64-bit bitmap to which the current button bitmap state will be read into
  *    joystick_vals[4]: array of 4 floats to which the current joystick states will be read into
@@ -240,9 +561,23 @@ void robot_desc_write(robot_desc_field_t field, robot_desc_val_t val);
  */
 int input_read(uint64_t* pressed_buttons, float joystick_vals[4], robot_desc_field_t source);
 
+/**
+ * This function is the exact same as the above function, but also returns the sequence number and time of
+ * the write that is read, so that the caller can tell whether the input is new since its last read.
+ * Arguments:
+ *    pressed_buttons, joystick_vals, source: same as for input_read()
+ *    seq: the number of times the input had been written when it was read will be put here
+ *    timestamp: monotonic_millis() when the input that was read was written will be put here
+ * Returns:
+ *    0 on success
+ *    -1 if input is not connected
+ */
+int input_read_seq(uint64_t* pressed_buttons, float joystick_vals[4], robot_desc_field_t source, uint32_t* seq, uint64_t* timestamp);
+
 /**
  * This function writes the given state of the gamepad to shared memory.
- * Blocks on both the gamepad semaphore and device description semaphore (to check if gamepad connected).
+ * Blocks on both the gamepad lock and robot description lock (to check if gamepad connected).
+ * Bumps the input's sequence number so that lock-free readers can detect the write.
  * Arguments:
  *    pressed_buttons: a 64-bit bitmap that corresponds to which buttons are currently pressed.
  *                     only some of the bits are used, depending on the input source
@@ -277,4 +612,51 @@ int log_data_write(char* key, param_type_t type, param_val_t value);
  */
 void log_data_read(uint8_t* num_params, char names[UCHAR_MAX][LOG_KEY_LENGTH], param_type_t types[UCHAR_MAX], param_val_t values[UCHAR_MAX]);
 
+/**
+ * Brings a copy of the custom log data kept by the caller up to date, copying only what changed since the copy
+ * was last brought up to date: names and types only when keys were added (or changed type), and only the values
+ * that were written since. Should be used instead of log_data_read() by callers that read the log data repeatedly.
+ * Arguments:
+ *    names_version: version of the names in the caller's copy (0 for an empty copy); will be updated
+ *    values_version: version of the values in the caller's copy (0 for an empty copy); will be updated
+ *    num_params, names, types, values: the caller's copy, as filled in by log_data_read() (num_params is 0 for an empty copy)
+ * Returns:
+ *    true if anything in the caller's copy changed, false otherwise
+ */
+bool log_data_read_changed(uint32_t* names_version, uint32_t* values_version, uint8_t* num_params, char names[UCHAR_MAX][LOG_KEY_LENGTH],
+                           param_type_t types[UCHAR_MAX], param_val_t values[UCHAR_MAX]);
+
+// **************************************** LOCK STATISTICS *********************************************** //
+
+/**
+ * Turns the collection of lock statistics on or off for all processes.
+ * Statistics are off when shared memory is created; while off, locks and unlocks only check this flag.
+ * Does nothing if statistics were compiled out (SEM_STATS is 0).
+ * Arguments:
+ *    enabled: whether statistics should be collected
+ */
+void sem_stats_enable(bool enabled);
+
+/**
+ * Zeroes the statistics of every lock.
+ */
+void sem_stats_reset();
+
+/**
+ * Copies the statistics of a lock.
+ * The counters are read one at a time, so they may be off from each other by the acquisitions made during the copy.
+ * Arguments:
+ *    lock_ix: index of the lock (one of the SHM_LOCK_* defines)
+ *    stats: pointer to the struct the statistics will be copied into
+ */
+void sem_stats_read(int lock_ix, sem_stats_t* stats);
+
+/**
+ * Generates a human-readable name for a lock.
+ * Arguments:
+ *    lock_ix: index of the lock (one of the SHM_LOCK_* defines)
+ *    name: pointer to a buffer of size SNAME_SIZE into which the name will be put
+ */
+void sem_stats_name(int lock_ix, char* name);
+
 #endif
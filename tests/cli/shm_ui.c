@@ -69,8 +69,8 @@ WINDOW* DEVICE_WIN;      // Displays device information (id, commands, and data)
 #define KEYBOARD_START_X (GAMEPAD_START_X + GAMEPAD_WIDTH)
 
 // DEVICE_HEIGHT should be large enough to display all the parameters,
-// with extra lines for device id, the table itself, and the message about using the arrow keys
-#define DEVICE_HEIGHT (MAX_PARAMS + 6)
+// with extra lines for device id, the table itself, the link statistics, and the message about using the arrow keys
+#define DEVICE_HEIGHT (MAX_PARAMS + 8)
 // DEVICE_WIDTH is enough to fit the information for each parameter
 #define DEVICE_WIDTH 75
 #define DEVICE_START_Y 0
@@ -377,15 +377,14 @@ void display_keyboard_state(char** key_names) {
  * Param Idx (int) | Name (str) | Command (var) | Data (var)
  *
  * Arguments:
- *    catalog: current shared memory catalog; Used to handle when device at shm_idx is invalid
- *    dev_ids: current shared memory device information; used to get device information at shm_idx
+ *    snapshot: current catalog, device information, and device data in shared memory
  *    shm_idx: the index of shared memory of the device to display
  *             set to MAX_DEVICES if displaying the custom data block is desired
  */
-void display_device(uint32_t catalog, dev_id_t dev_ids[MAX_DEVICES], int shm_idx) {
+void display_device(dev_snapshot_t* snapshot, int shm_idx) {
     // Special case handling
     const int show_custom_data = (shm_idx == MAX_DEVICES);
-    if (!show_custom_data && !(catalog & (1 << shm_idx))) {  // Device is not connected at this shared memory index
+    if (!show_custom_data && !(snapshot->catalog & BITMAP_BIT(shm_idx))) {  // Device is not connected at this shared memory index
         // Clear the window if not clear already (Happens when we disconnect a device while we're inspecting it)
         if (!DEVICE_WIN_IS_BLANK) {
             // Clear the entire window, but put back the header and the borders
@@ -416,11 +415,12 @@ void display_device(uint32_t catalog, dev_id_t dev_ids[MAX_DEVICES], int shm_idx
     if (show_custom_data) {
         mvwprintw(DEVICE_WIN, line++, INDENT, "Custom Data:");
     } else {
-        device = get_device(dev_ids[shm_idx].type);
+        dev_id_t* dev_id = &snapshot->dev_ids[shm_idx];
+        device = get_device(dev_id->type);
         if (device == NULL) {  // This should never happen if the handling above is correct
             log_printf(ERROR, "device == NULL");
         }
-        mvwprintw(DEVICE_WIN, line++, 1, "[%s] Type %d; Year %d; UID = %llu", device->name, dev_ids[shm_idx].type, dev_ids[shm_idx].year, dev_ids[shm_idx].uid);
+        mvwprintw(DEVICE_WIN, line++, 1, "[%s] Type %d; Year %d; UID = %llu", device->name, dev_id->type, dev_id->year, dev_id->uid);
     }
     // Move to the first parameter (Skip the next two lines because we'll display the table headers with the horizontal line)
     line += 2;
@@ -430,9 +430,9 @@ void display_device(uint32_t catalog, dev_id_t dev_ids[MAX_DEVICES], int shm_idx
     uint8_t num_params = 0;
 
     // Init arrays to hold shm data
-    uint32_t cmd_map_all_devs[MAX_DEVICES + 1];
+    bitmap_t cmd_map_all_devs[MAX_DEVICES + 1];
     param_val_t command_vals[MAX_PARAMS];
-    param_val_t data_vals[MAX_PARAMS];
+    param_val_t* data_vals = snapshot->params[shm_idx];  // Unused for custom data
 
     // Init variables to hold custom data information
     char custom_param_names[UCHAR_MAX][64];
@@ -444,14 +444,13 @@ void display_device(uint32_t catalog, dev_id_t dev_ids[MAX_DEVICES], int shm_idx
         log_data_read(&num_params, custom_param_names, custom_param_types, custom_param_values);
     } else {
         num_params = device->num_params;
-        // Get command values and data values
+        // Get command values (data values are already in the snapshot)
         get_cmd_map(cmd_map_all_devs);
-        device_read(shm_idx, SHM, COMMAND, ~0, command_vals);
-        device_read(shm_idx, SHM, DATA, ~0, data_vals);
+        device_read(shm_idx, SHM, COMMAND, ALL_PARAMS, command_vals);
     }
 
     // We care about only the specified device (this is just for the sake of brevity)
-    uint32_t cmd_map = cmd_map_all_devs[shm_idx + 1];
+    bitmap_t cmd_map = cmd_map_all_devs[shm_idx + 1];
 
     // Each iteration prints out a row for each parameter
     int display_cmd_val;  // Flag for whether we should display the command value for a parameter
@@ -470,7 +469,7 @@ void display_device(uint32_t catalog, dev_id_t dev_ids[MAX_DEVICES], int shm_idx
         } else if (device->params[i].write == 0) {  // Read-only parameter
             mvwprintw(DEVICE_WIN, line, COMMAND_VAL_COL, "RD_ONLY");
             display_cmd_val = 0;
-        } else if ((cmd_map & (1 << i)) == 0) {  // No command to this parameter
+        } else if ((cmd_map & BITMAP_BIT(i)) == 0) {  // No command to this parameter
             mvwprintw(DEVICE_WIN, line, COMMAND_VAL_COL, "NONE");
             display_cmd_val = 0;
         } else {  // There is a command for the write-able parameter
@@ -511,6 +510,16 @@ void display_device(uint32_t catalog, dev_id_t dev_ids[MAX_DEVICES], int shm_idx
         wmove(DEVICE_WIN, ++line, 0);
     }
 
+    // Display the statistics of dev handler's link to the device below the table (there are none for custom data)
+    dev_link_stats_t link_stats;
+    wclrtoeol(DEVICE_WIN);
+    wmove(DEVICE_WIN, line + 1, 0);
+    wclrtoeol(DEVICE_WIN);
+    if (!show_custom_data && device_read_link_stats(shm_idx, &link_stats) == 0) {
+        mvwprintw(DEVICE_WIN, line, INDENT, "Link: in %u msg/s, %u B/s; out %u msg/s, %u B/s; handshake RTT %u us", link_stats.frames_in_per_sec, link_stats.bytes_in_per_sec, link_stats.frames_out_per_sec, link_stats.bytes_out_per_sec, link_stats.handshake_rtt_us);
+        mvwprintw(DEVICE_WIN, line + 1, INDENT, "Dropped: %u bad, %u bad checksum, %u unsent; skipped %llu B; backlog %u B; %llu reads", link_stats.decode_errors, link_stats.checksum_errors, link_stats.tx_drops, (unsigned long long) link_stats.resync_bytes, link_stats.write_backlog, (unsigned long long) link_stats.reads);
+    }
+
     // Display table
     display_param_table(table_header_line);
 
@@ -558,8 +567,7 @@ int main(int argc, char** argv) {
     char** joystick_names = get_joystick_names();
     char** button_names = get_button_names();
     char** key_names = get_key_names();
-    uint32_t catalog = 0;           // Shared memory catalog (bitmap of connected devices)
-    dev_id_t dev_ids[MAX_DEVICES];  // Device identifying info on each shm-connected device
+    dev_snapshot_t snapshot;  // Shared memory catalog, device identifying info, and data of each shm-connected device
 
     // Turn on keyboard input for DEVICE_WIN
     keypad(DEVICE_WIN, 1);
@@ -579,8 +587,7 @@ int main(int argc, char** argv) {
         }
 
         // Get newest shm data
-        get_catalog(&catalog);
-        get_device_identifiers(dev_ids);
+        device_read_all(SHM, &snapshot);
 
         // Detect arrow key inputs to increase/decrease device_selection
         int direction = 0;
@@ -605,14 +612,14 @@ int main(int argc, char** argv) {
             do {
                 device_selection += direction;
                 device_selection = (device_selection + DEVICE_WRAP) % DEVICE_WRAP;
-            } while (device_selection != MAX_DEVICES && !(catalog & (1 << device_selection)));
+            } while (device_selection != MAX_DEVICES && !(snapshot.catalog & BITMAP_BIT(device_selection)));
         }
 
         // Update each window
         display_robot_desc();
         display_gamepad_state(joystick_names, button_names);
         display_keyboard_state(key_names);
-        display_device(catalog, dev_ids, device_selection);
+        display_device(&snapshot, device_selection);
 
         // Throttle refresh rate
         usleep(100000 / FPS);
@@ -620,7 +627,7 @@ int main(int argc, char** argv) {
         // Display catalog and current device selection
         int line = 0;
         mvprintw(line++, 1, "Shared Memory Dashboard");
-        mvprintw(line++, 1, "Catalog:\t  0x%08X", catalog);
+        mvprintw(line++, 1, "Catalog:\t  0x%08X", snapshot.catalog);
         mvprintw(line++, 1, "Selected Device: %02d", device_selection);
 
         refresh();
@@ -1,3 +1,10 @@
+#define _GNU_SOURCE  // for posix_openpt(), grantpt(), unlockpt(), ptsname()
+
+#include <fcntl.h>     // for O_RDWR, O_NOCTTY
+#include <limits.h>    // for PATH_MAX
+#include <sys/mman.h>  // for mmap() in count_dev_handler_mallocs()
+#include <termios.h>   // for cfmakeraw() in connect_pty()
+
 #include "dev_handler_client.h"
 
 // Timeout time in ms for a socket read()
@@ -13,10 +20,19 @@ const char* home_dir;  // holds home directory path
 // Process id of the dev_handler fork
 pid_t dev_handler_pid;
 
+// Argument that dev handler is started with to pick its mode (NULL for the default)
+char* dev_handler_mode = NULL;
+
+// The malloc counter preloaded into dev handler (relative to the tests directory), and the file it keeps its count in
+#define MALLOC_COUNTER_LIB "bin/malloc_counter.so"
+#define MALLOC_COUNTER_FILE "/tmp/dev_handler_mallocs"
+volatile uint64_t* malloc_counter = NULL;  // Mapped count of dev handler's allocations, or NULL if they aren't counted
+
 // Struct grouping a virtual device's process id, socket fd, and name
 typedef struct {
     pid_t pid;         // The process id of the virtual device
-    int fd;            // The socket's file descriptor
+    int fd;            // The socket's file descriptor (or the pseudoterminal's master end)
+    int serial_fd;     // The pseudoterminal's serial end, held open until disconnect; -1 for a socket
     char* dev_name;    // The name of the virtual device's name
     uint64_t dev_uid;  // The device uid
 } device_socket_t;
@@ -101,6 +117,7 @@ static int connect_socket() {
         exit(1);
     }
     used_sockets[socket_num]->fd = connection_fd;
+    used_sockets[socket_num]->serial_fd = -1;
 
     // Set read() to timeout for up to TIMEOUT milliseconds
     struct timeval tv;
@@ -111,47 +128,78 @@ static int connect_socket() {
     return socket_num;
 }
 
-// ******************************** Public ********************************* //
-
-void start_dev_handler() {
-    // Check to see if creation of child is successful
-    if ((dev_handler_pid = fork()) < 0) {
-        log_printf(ERROR, "fork: %s\n", strerror(errno));
-    } else if (dev_handler_pid == 0) {  // child created!
-        // redirect to dev handler folder
-        if (chdir("../dev_handler") == -1) {
-            log_printf(ERROR, "chdir: %s\n", strerror(errno));
-        }
-        // execute the device handler process
-        if (execlp("./../bin/dev_handler", "dev_handler", (char*) 0) < 0) {
-            log_printf(ERROR, "execlp: %s\n", strerror(errno));
+/**
+ * Returns the socket number after linking it to a new pseudoterminal,
+ * which dev handler opens like the serial port of an Arduino
+ * Returns:
+ *    The socket number, or
+ *    -1 if error
+ */
+static int connect_pty() {
+    // Get an unoccupied socket number
+    int socket_num = -1;
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (used_sockets[i] == NULL) {
+            socket_num = i;
+            break;
         }
-    } else {  // in parent
-        home_dir = getenv("HOME");
     }
-}
-
-void stop_dev_handler() {
-    // send signal to dev_handler and wait for termination
-    if (kill(dev_handler_pid, SIGINT) < 0) {
-        log_printf(ERROR, "kill dev_handler:  %s\n", strerror(errno));
+    if (socket_num == -1) {
+        return -1;
     }
-    if (waitpid(dev_handler_pid, NULL, 0) < 0) {
-        log_printf(ERROR, "waitpid dev_haandler: %s\n", strerror(errno));
+
+    // Make a pseudoterminal; the virtual device gets the master end
+    int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd < 0 || grantpt(master_fd) < 0 || unlockpt(master_fd) < 0) {
+        log_printf(ERROR, "connect_pty: Couldn't create pseudoterminal -- %s\n", strerror(errno));
+        return -1;
     }
-}
 
-int connect_virtual_device(char* dev_name, uint64_t uid) {
-    // Connect a socket
-    int socket_num = connect_socket();
-    if (socket_num == -1) {
+    /* Hold the serial end open (in raw mode) so that reads on the master end block instead of failing
+     * until dev handler opens it, and link to it from where dev handler looks for virtual devices */
+    char* pty_name = ptsname(master_fd);
+    int serial_fd = open(pty_name, O_RDWR | O_NOCTTY);
+    struct termios toptions;
+    if (serial_fd < 0 || tcgetattr(serial_fd, &toptions) < 0) {
+        log_printf(ERROR, "connect_pty: Couldn't open %s -- %s\n", pty_name, strerror(errno));
+        return -1;
+    }
+    cfmakeraw(&toptions);
+    tcsetattr(serial_fd, TCSANOW, &toptions);
+    char socket_name[64];
+    sprintf(socket_name, "%s/%s%d", home_dir, SOCKET_PREFIX, socket_num);
+    if (symlink(pty_name, socket_name) < 0) {
+        log_printf(ERROR, "connect_pty: Couldn't link %s to %s -- %s\n", socket_name, pty_name, strerror(errno));
         return -1;
     }
 
-    // Take note of the type of device connected
-    used_sockets[socket_num]->dev_name = malloc(strlen(dev_name));
+    // Indicate in global variable that socket is now used
+    used_sockets[socket_num] = malloc(sizeof(device_socket_t));
     if (used_sockets[socket_num] == NULL) {
-        log_printf(ERROR, "connect_virtual_device: Failed to malloc\n");
+        log_printf(ERROR, "connect_pty: Failed to malloc\n");
+        exit(1);
+    }
+    used_sockets[socket_num]->fd = master_fd;
+    used_sockets[socket_num]->serial_fd = serial_fd;
+    return socket_num;
+}
+
+/**
+ * Runs a virtual device on a connected socket in a child process
+ * Arguments:
+ *    socket_num: The socket number returned from connect_socket() or connect_pty()
+ *    dev_name: The name of a virtual device's name
+ *    uid: The uid to designate the device
+ *    extra_arg: An argument to pass to the device after the file descriptor and uid (NULL for none)
+ * Returns:
+ *    SOCKET_NUM on success
+ *    -1 on failure
+ */
+static int spawn_virtual_device(int socket_num, char* dev_name, uint64_t uid, char* extra_arg) {
+    // Take note of the type of device connected
+    used_sockets[socket_num]->dev_name = malloc(strlen(dev_name) + 1);
+    if (used_sockets[socket_num]->dev_name == NULL) {
+        log_printf(ERROR, "spawn_virtual_device: Failed to malloc\n");
         exit(1);
     }
     strcpy(used_sockets[socket_num]->dev_name, dev_name);
@@ -168,12 +216,12 @@ int connect_virtual_device(char* dev_name, uint64_t uid) {
             log_printf(ERROR, "chdir: %s\n", strerror(errno));
         }
 
-        // Become the virtual device by calling "./<dev_name> <fd> <uid>"
+        // Become the virtual device by calling "./<dev_name> <fd> <uid> [extra_arg]"
         char exe_name[32], fd_str[4], uid_str[20];
         sprintf(exe_name, "./%s", used_sockets[socket_num]->dev_name);
         sprintf(fd_str, "%d", used_sockets[socket_num]->fd);
         sprintf(uid_str, "0x%016llX", uid);
-        if (execlp(exe_name, used_sockets[socket_num]->dev_name, fd_str, uid_str, (char*) NULL) < 0) {
+        if (execlp(exe_name, used_sockets[socket_num]->dev_name, fd_str, uid_str, extra_arg, (char*) NULL) < 0) {
             log_printf(ERROR, "connect_device: execlp %s failed -- %s\n", exe_name, strerror(errno));
             return -1;
         }
@@ -187,6 +235,99 @@ int connect_virtual_device(char* dev_name, uint64_t uid) {
     return socket_num;
 }
 
+// ******************************** Public ********************************* //
+
+void start_dev_handler() {
+    char malloc_counter_lib[PATH_MAX];
+    if (malloc_counter != NULL) {
+        // Dev handler runs from another directory, so it needs the full path to the library
+        if (realpath(MALLOC_COUNTER_LIB, malloc_counter_lib) == NULL) {
+            log_printf(ERROR, "start_dev_handler: Couldn't find %s -- %s\n", MALLOC_COUNTER_LIB, strerror(errno));
+            exit(1);
+        }
+        *malloc_counter = 0;
+    }
+
+    // Check to see if creation of child is successful
+    if ((dev_handler_pid = fork()) < 0) {
+        log_printf(ERROR, "fork: %s\n", strerror(errno));
+    } else if (dev_handler_pid == 0) {  // child created!
+        if (malloc_counter != NULL) {
+            setenv("LD_PRELOAD", malloc_counter_lib, 1);
+            setenv("MALLOC_COUNTER_FILE", MALLOC_COUNTER_FILE, 1);
+        }
+        // redirect to dev handler folder
+        if (chdir("../dev_handler") == -1) {
+            log_printf(ERROR, "chdir: %s\n", strerror(errno));
+        }
+        // execute the device handler process
+        if (execlp("./../bin/dev_handler", "dev_handler", dev_handler_mode, (char*) 0) < 0) {
+            log_printf(ERROR, "execlp: %s\n", strerror(errno));
+        }
+    } else {  // in parent
+        home_dir = getenv("HOME");
+    }
+}
+
+void set_dev_handler_mode(char* mode) {
+    dev_handler_mode = mode;
+}
+
+void count_dev_handler_mallocs() {
+    if (malloc_counter != NULL) {
+        return;
+    }
+    int fd = open(MALLOC_COUNTER_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || ftruncate(fd, sizeof(uint64_t)) < 0) {
+        log_printf(ERROR, "count_dev_handler_mallocs: Couldn't create %s -- %s\n", MALLOC_COUNTER_FILE, strerror(errno));
+        exit(1);
+    }
+    void* mapped = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        log_printf(ERROR, "count_dev_handler_mallocs: Couldn't map %s -- %s\n", MALLOC_COUNTER_FILE, strerror(errno));
+        exit(1);
+    }
+    malloc_counter = (volatile uint64_t*) mapped;
+}
+
+uint64_t dev_handler_mallocs() {
+    if (malloc_counter == NULL) {
+        return 0;
+    }
+    return __atomic_load_n(malloc_counter, __ATOMIC_RELAXED);
+}
+
+void stop_dev_handler() {
+    // send signal to dev_handler and wait for termination
+    if (kill(dev_handler_pid, SIGINT) < 0) {
+        log_printf(ERROR, "kill dev_handler:  %s\n", strerror(errno));
+    }
+    if (waitpid(dev_handler_pid, NULL, 0) < 0) {
+        log_printf(ERROR, "waitpid dev_haandler: %s\n", strerror(errno));
+    }
+}
+
+int connect_virtual_device(char* dev_name, uint64_t uid) {
+    // Connect a socket
+    int socket_num = connect_socket();
+    if (socket_num == -1) {
+        return -1;
+    }
+    return spawn_virtual_device(socket_num, dev_name, uid, NULL);
+}
+
+int connect_virtual_serial_device(char* dev_name, uint64_t uid, uint32_t max_baud_rate) {
+    // Connect a pseudoterminal
+    int socket_num = connect_pty();
+    if (socket_num == -1) {
+        return -1;
+    }
+    char baud_str[12];
+    sprintf(baud_str, "%u", max_baud_rate);
+    return spawn_virtual_device(socket_num, dev_name, uid, baud_str);
+}
+
 int disconnect_virtual_device(int socket_num) {
     // Do nothing if socket is unused
     if ((socket_num < 0) || (socket_num >= MAX_DEVICES) || (used_sockets[socket_num] == NULL)) {
@@ -197,6 +338,9 @@ int disconnect_virtual_device(int socket_num) {
     waitpid(used_sockets[socket_num]->pid, NULL, 0);  // Block until killed
     // CLose file descriptor
     close(used_sockets[socket_num]->fd);
+    if (used_sockets[socket_num]->serial_fd != -1) {
+        close(used_sockets[socket_num]->serial_fd);
+    }
     // Remove socket (dev handler should recognize disconnect after removal)
     char socket_name[32];
     sprintf(socket_name, "%s/%s%d", home_dir, SOCKET_PREFIX, socket_num);
@@ -17,6 +17,27 @@
 // Starts dev handler with "virtual" argument
 void start_dev_handler();
 
+/**
+ * Sets the mode that start_dev_handler() starts dev handler in from now on
+ * Call it before start_test() for the whole test to use that mode
+ * Arguments:
+ *    mode: NULL to give each device its own threads (the default), or "epoll" to handle every device from an event loop
+ */
+void set_dev_handler_mode(char* mode);
+
+/**
+ * Makes start_dev_handler() preload the malloc counter (tests/preload/malloc_counter.c) into dev handler from now on,
+ * resetting the count each time it starts dev handler
+ * Call it before start_test() to count from the start of the test
+ */
+void count_dev_handler_mallocs();
+
+/**
+ * Returns the number of times that dev handler allocated memory since start_dev_handler() last started it,
+ * or 0 if count_dev_handler_mallocs() wasn't called
+ */
+uint64_t dev_handler_mallocs();
+
 // Stops dev handler
 void stop_dev_handler();
 
@@ -31,6 +52,19 @@ void stop_dev_handler();
  */
 int connect_virtual_device(char* dev_name, uint64_t uid);
 
+/**
+ * Connects a virtual device to dev handler through a pseudoterminal instead of a socket,
+ * which dev handler opens like the serial port of an Arduino (with a baud rate)
+ * Arguments:
+ *    dev_name: The name of a virtual device's name; it should handle SET_BAUD (ex. SerialTestDevice)
+ *    uid: The uid to designate the device
+ *    max_baud_rate: The highest baud rate that the device agrees to switch to (ex. 115200 for a device that stays at the default rate)
+ * Returns:
+ *    the socket number for the virtual device on success (nonnegative)
+ *    -1 on failure
+ */
+int connect_virtual_serial_device(char* dev_name, uint64_t uid, uint32_t max_baud_rate);
+
 /**
  * Disconnects a virtual device from dev handler
  * Arguments:
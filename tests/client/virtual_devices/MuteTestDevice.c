@@ -0,0 +1,61 @@
+/**
+ * MuteTestDevice, a virtual device that acknowledges dev handler's DEVICE_PING like a SimpleTestDevice,
+ * but never sends anything after that. It keeps reading what dev handler sends, so dev handler should
+ * time it out and send it a RST, which it reports before exiting
+ */
+
+#include "virtual_device_util.h"
+
+/**
+ * Arguments:
+ *    int: file descriptor for the socket
+ *    uint64_t: device uid
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("Incorrect number of arguments: %d out of %d\n", argc, 3);
+        exit(1);
+    }
+
+    int fd = atoi(argv[1]);
+    uint64_t uid = strtoull(argv[2], NULL, 0);
+    uint8_t dev_type = device_name_to_type("SimpleTestDevice");
+
+    message_t* incoming_msg = make_empty(MAX_PAYLOAD_SIZE);
+    message_t* outgoing_msg;
+    uint8_t sent_ack = 0;
+    uint8_t offered = 1 << CHECKSUM_XOR;  // Checksums offered in dev handler's CHECKSUM_OFFER
+    checksum_t checksum = CHECKSUM_XOR;   // Switched to the one picked in the ACKNOWLEDGEMENT once it's sent
+
+    while (1) {
+        if (receive_message(fd, incoming_msg, checksum) != 0) {
+            continue;
+        }
+        switch (incoming_msg->message_id) {
+            case CHECKSUM_OFFER:
+                if (!sent_ack) {
+                    offered = offered_checksums(incoming_msg);
+                }
+                break;
+
+            case DEVICE_PING:
+                if (!sent_ack) {
+                    // Send an ack with the checksum that we picked, then switch to it and go quiet
+                    outgoing_msg = make_acknowledgement(dev_type, dev_type, uid, pick_checksum(offered));
+                    send_message(fd, outgoing_msg, checksum);
+                    destroy_message(outgoing_msg);
+                    checksum = pick_checksum(offered);
+                    sent_ack = 1;
+                }
+                break;
+
+            case RST:
+                printf("MuteTestDevice (0x%llX): Received a RST\n", (unsigned long long) uid);
+                exit(0);
+
+            default:
+                break;
+        }
+    }
+    return 0;
+}
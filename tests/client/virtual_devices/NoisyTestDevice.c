@@ -0,0 +1,87 @@
+/**
+ * NoisyTestDevice, a virtual device that acts like a SimpleTestDevice, but every second, between two messages,
+ * writes a burst of BURST_SIZE bytes of line noise (none of them a delimiter), up to NUM_BURSTS times.
+ * Dev handler should skip each burst with a single warning and keep the device connected.
+ */
+#include "virtual_device_util.h"
+
+#define BURST_SIZE 2000      // Bytes of noise in each burst; more than dev handler buffers at a time
+#define NUM_BURSTS 5         // Number of bursts to write
+#define BURST_INTERVAL 1000  // Milliseconds between bursts
+
+// SimpleTestDevice params
+enum {
+    // Read-only
+    INCREASING,
+    DOUBLING,
+    FLIP_FLOP,
+    // Read and Write
+    MY_INT
+};
+
+int noise_fd;         // File descriptor to write the noise to
+int bursts_sent = 0;  // Number of bursts written so far
+
+/**
+ * Initialize the values for each param
+ * Arguments:
+ *    params: Array of params to be initialized
+ */
+void init_params(param_val_t params[]) {
+    params[INCREASING].p_i = 0;
+    params[DOUBLING].p_f = 1;
+    params[FLIP_FLOP].p_b = 1;
+    params[MY_INT].p_i = 0;
+}
+
+/**
+ * Changes device's read-only params like a SimpleTestDevice, and writes a burst of noise,
+ * except on the first call (made right after the ACKNOWLEDGEMENT) and after NUM_BURSTS bursts
+ * Arguments:
+ *    params: Array of param values to be modified
+ */
+void device_actions(param_val_t params[]) {
+    static uint8_t noise[BURST_SIZE];
+    static int num_calls = 0;
+
+    params[INCREASING].p_i += 1;
+    params[DOUBLING].p_f *= 2;
+    params[FLIP_FLOP].p_b = 1 - params[FLIP_FLOP].p_b;
+
+    if (num_calls++ == 0 || bursts_sent == NUM_BURSTS) {
+        return;
+    }
+    for (int i = 0; i < BURST_SIZE; i++) {
+        noise[i] = (rand() % 255) + 1;  // Never 0x00, which would start a message
+    }
+    int transferred = write(noise_fd, noise, BURST_SIZE);
+    if (transferred != BURST_SIZE) {
+        printf("NoisyTestDevice: Sent only %d out of %d bytes of noise\n", transferred, BURST_SIZE);
+    }
+    bursts_sent++;
+}
+
+/**
+ * A device that behaves like a lowcar device on a noisy line, connected to dev handler via a socket
+ * Arguments:
+ *    int: file descriptor for the socket
+ *    uint64_t: device uid
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("Incorrect number of arguments: %d out of %d\n", argc, 3);
+        exit(1);
+    }
+
+    noise_fd = atoi(argv[1]);
+    uint64_t uid = strtoull(argv[2], NULL, 0);
+
+    uint8_t dev_type = device_name_to_type("SimpleTestDevice");
+    device_t* dev = get_device(dev_type);
+
+    param_val_t params[dev->num_params];
+    init_params(params);
+
+    lowcar_protocol(noise_fd, dev_type, dev_type, uid, params, &device_actions, BURST_INTERVAL);
+    return 0;
+}
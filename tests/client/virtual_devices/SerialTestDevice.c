@@ -0,0 +1,221 @@
+/**
+ * SerialTestDevice, a virtual device that acts like a lowcar device on a serial port
+ * It's connected to dev handler through a pseudoterminal (see connect_virtual_serial_device()),
+ * and sends the params of a GeneralTestDevice in a DEVICE_DATA every DATA_INTERVAL milliseconds
+ * Like a lowcar device, it only sends the subscribed params that changed (see next_device_data()); the read-only
+ * params jitter like sensor readings, so until dev handler sends a SUBSCRIBE, most params are sent every time
+ * A pseudoterminal moves bytes instantly whatever its baud rate, so the serial line is emulated:
+ *  - Sending a message takes as long as it would at the device's baud rate (BITS_PER_BYTE bits per byte)
+ *  - If the device and the serial port aren't at the same baud rate, messages in both directions are garbled
+ * Answers SET_BAUD like lowcar does (see Device::set_baud_rate()), including falling back to DEFAULT_BAUD_RATE,
+ * except that it stays at its rate if asked for one above its maximum (like older lowcar firmware stays at DEFAULT_BAUD_RATE)
+ * INCREASING_ODD goes up by 2 with each DEVICE_DATA sent, which tells how many messages the line carried
+ */
+
+#include <poll.h>     // for poll()
+#include <termios.h>  // for tcgetattr(), cfgetospeed()
+
+#include "virtual_device_util.h"
+
+// Number of milliseconds between sending each DEVICE_DATA message
+#define DATA_INTERVAL 1
+
+// Number of bits sent per byte with 8-N-1 (start bit, 8 data bits, stop bit)
+#define BITS_PER_BYTE 10
+
+// Byte that sent and received bytes are XORed with when the baud rates don't match
+#define GARBLE 0x5A
+
+// The param that goes up by 2 with each DEVICE_DATA sent (the same index as in GeneralTestDevice)
+#define INCREASING_ODD 0
+
+// The params whose lowest bit flips with each DEVICE_DATA sent, like a noisy sensor (the other read-only params of GeneralTestDevice)
+#define NOISY_PARAMS (BITMAP_LOW(16) & ~BITMAP_BIT(INCREASING_ODD))
+
+/**
+ * Returns the baud rate that dev handler set the serial end of the pseudoterminal to
+ * Arguments:
+ *    fd: The master end of the pseudoterminal
+ * Returns:
+ *    The baud rate, or
+ *    0 if it's not a rate that dev handler uses
+ */
+uint32_t port_baud_rate(int fd) {
+    struct termios toptions;
+    if (tcgetattr(fd, &toptions) < 0) {
+        return 0;
+    }
+    switch (cfgetospeed(&toptions)) {
+        case B115200:
+            return 115200;
+        case B230400:
+            return 230400;
+        case B460800:
+            return 460800;
+        case B500000:
+            return 500000;
+        case B921600:
+            return 921600;
+        case B1000000:
+            return 1000000;
+        case B2000000:
+            return 2000000;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Sends a message, taking as long as it would over a serial line at BAUD_RATE
+ * Arguments:
+ *    fd: The master end of the pseudoterminal
+ *    msg: The message to send
+ *    baud_rate: The baud rate that the device is at
+ *    checksum: The kind of checksum to end the message with
+ */
+void send_serial(int fd, message_t* msg, uint32_t baud_rate, checksum_t checksum) {
+    uint8_t data[MAX_COBS_MSG_LENGTH];
+    int len = message_to_bytes(msg, data, MAX_COBS_MSG_LENGTH, checksum);
+    usleep((uint64_t) len * BITS_PER_BYTE * 1000000 / baud_rate);
+    if (port_baud_rate(fd) != baud_rate) {
+        for (int i = 0; i < len; i++) {
+            data[i] ^= GARBLE;
+        }
+    }
+    if (write(fd, data, len) != len) {
+        printf("send_serial: Couldn't send message -- %s\n", strerror(errno));
+    }
+}
+
+/**
+ * A device that behaves like a lowcar device, connected to dev handler via a pseudoterminal
+ * Arguments:
+ *    int: file descriptor for the master end of the pseudoterminal
+ *    uint64_t: device uid
+ *    uint32_t: highest baud rate to switch to (optional; HIGH_BAUD_RATE by default)
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("Incorrect number of arguments: %d out of %d\n", argc, 3);
+        exit(1);
+    }
+
+    int fd = atoi(argv[1]);
+    uint64_t uid = strtoull(argv[2], NULL, 0);
+    uint32_t max_baud_rate = (argc > 3) ? strtoul(argv[3], NULL, 0) : HIGH_BAUD_RATE;
+
+    uint8_t dev_type = device_name_to_type("GeneralTestDevice");
+    bitmap_t readable_param_bitmap = get_readable_param_bitmap(dev_type);
+    param_val_t params[MAX_PARAMS] = {0};
+    params[INCREASING_ODD].p_i = 1;
+    data_state_t data_state;
+    init_data_state(&data_state);
+    bitmap_t data_bitmap;
+
+    message_t* incoming_msg = make_empty(MAX_PAYLOAD_SIZE);
+    message_t* outgoing_msg;
+    struct pollfd incoming = {.fd = fd, .events = POLLIN};
+    uint32_t baud_rate = DEFAULT_BAUD_RATE;
+    uint32_t new_baud_rate;
+    uint8_t baud_pending = 0;  // Whether we switched baud rates and haven't received a message at the new rate yet
+    uint64_t baud_switch_time = 0;
+    uint64_t last_received_msg_time = millis();
+    uint64_t last_sent_data_time = 0;
+    uint8_t sent_ack = 0;
+    uint8_t offered = 1 << CHECKSUM_XOR;  // Checksums offered in dev handler's CHECKSUM_OFFER
+    checksum_t checksum = CHECKSUM_XOR;  // Switched to the one picked in the ACKNOWLEDGEMENT once it's sent
+    checksum_t picked;
+    uint64_t now;
+
+    // Every cycle, read a message and respond accordingly, then send DEVICE_DATA if it's due
+    while (1) {
+        now = millis();
+        int wait = (sent_ack && now - last_sent_data_time < DATA_INTERVAL) ? DATA_INTERVAL - (now - last_sent_data_time) : 0;
+        // A message sent at a different baud rate than ours is garbled, so it's dropped
+        if (poll(&incoming, 1, sent_ack ? wait : -1) > 0 && receive_message(fd, incoming_msg, checksum) == 0 && port_baud_rate(fd) == baud_rate) {
+            baud_pending = 0;
+            last_received_msg_time = now;  // Any message tells us that dev handler is still there
+            switch (incoming_msg->message_id) {
+                case CHECKSUM_OFFER:
+                    if (!sent_ack) {
+                        offered = offered_checksums(incoming_msg);
+                    }
+                    break;
+
+                case DEVICE_PING:
+                    if (!sent_ack) {
+                        // Send an ack with the checksum that we picked, then switch to it
+                        picked = pick_checksum(offered);
+                        outgoing_msg = make_acknowledgement(dev_type, dev_type, uid, picked);
+                        send_serial(fd, outgoing_msg, baud_rate, checksum);
+                        destroy_message(outgoing_msg);
+                        checksum = picked;
+                        sent_ack = 1;
+                    }
+                    break;
+
+                case DEVICE_WRITE:
+                    device_write(dev_type, incoming_msg, params);
+                    break;
+
+                case SUBSCRIBE:
+                    device_subscribe(incoming_msg, &data_state);
+                    break;
+
+                case SET_BAUD:
+                    // Echo the SET_BAUD at the current rate, then switch
+                    memcpy(&new_baud_rate, incoming_msg->payload, sizeof(new_baud_rate));
+                    if (new_baud_rate <= max_baud_rate) {
+                        send_serial(fd, incoming_msg, baud_rate, checksum);
+                        baud_rate = new_baud_rate;
+                        baud_pending = 1;
+                        baud_switch_time = now;
+                    }
+                    break;
+
+                case RST:
+                    printf("SerialTestDevice (%llX): Received a RST\n", (unsigned long long) uid);
+                    exit(1);
+
+                default:
+                    printf("SerialTestDevice (%llX): Received message of invalid type\n", (unsigned long long) uid);
+                    break;
+            }
+        }
+        incoming_msg->message_id = NOP;
+        incoming_msg->payload_length = 0;
+        incoming_msg->max_payload_length = MAX_PAYLOAD_SIZE;
+
+        //  Don't send any other messages until we've sent an ACK
+        if (!sent_ack) {
+            continue;
+        }
+
+        // If dev handler didn't switch to the new baud rate with us, fall back to the default
+        if (baud_pending && (now - baud_switch_time) >= BAUD_TIMEOUT) {
+            baud_rate = DEFAULT_BAUD_RATE;
+            baud_pending = 0;
+        }
+
+        // Make sure we're receiving messages still
+        if ((now - last_received_msg_time) >= TIMEOUT) {
+            printf("SerialTestDevice (%llX): DEV_HANDLER timed out!\n", (unsigned long long) uid);
+            exit(1);
+        }
+
+        // Check if we should send another DEVICE_DATA
+        if ((now - last_sent_data_time) >= DATA_INTERVAL) {
+            last_sent_data_time = now;
+            if (next_device_data(&data_state, readable_param_bitmap, params, now, &data_bitmap)) {
+                outgoing_msg = make_device_data(dev_type, data_bitmap, params);
+                send_serial(fd, outgoing_msg, baud_rate, checksum);
+                destroy_message(outgoing_msg);
+                params[INCREASING_ODD].p_i += 2;
+                for (bitmap_t rest = NOISY_PARAMS; rest != 0;) {
+                    params[bitmap_pop(&rest)].p_i ^= 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
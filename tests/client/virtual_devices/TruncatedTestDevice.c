@@ -0,0 +1,114 @@
+/**
+ * TruncatedTestDevice, a virtual device that identifies as a SimpleTestDevice and answers each DEVICE_PING from
+ * dev handler with the next DEVICE_DATA of a script:
+ *  - every param, like the first keyframe
+ *  - NUM_DELTAS frames with only INCREASING, as if the other params stopped changing
+ *  - a frame with INCREASING, DOUBLING, and FLIP_FLOP whose payload is cut in the middle of DOUBLING's value
+ *  - empty frames from then on, so that it stays connected
+ * Dev handler should keep the params it isn't sent, and take only INCREASING from the cut frame.
+ */
+
+#include "virtual_device_util.h"
+
+#define NUM_DELTAS 3  // Frames with only INCREASING
+
+// SimpleTestDevice params
+enum {
+    // Read-only
+    INCREASING,
+    DOUBLING,
+    FLIP_FLOP,
+    // Read and Write
+    MY_INT
+};
+
+/**
+ * Builds the next DEVICE_DATA of the script
+ * Arguments:
+ *    dev_type: The type of the device
+ *    step: The number of DEVICE_DATA sent before this one
+ *    params: Array of param values, updated for this step
+ * Returns:
+ *    The DEVICE_DATA to send
+ */
+message_t* next_step(uint8_t dev_type, int step, param_val_t params[]) {
+    message_t* dev_data;
+    if (step == 0) {
+        params[INCREASING].p_i = 1;
+        params[DOUBLING].p_f = 1.5;
+        params[FLIP_FLOP].p_b = 1;
+        params[MY_INT].p_i = 7;
+        return make_device_data(dev_type, BITMAP_LOW(4), params);
+    } else if (step <= NUM_DELTAS) {
+        params[INCREASING].p_i += 1;
+        return make_device_data(dev_type, BITMAP_BIT(INCREASING), params);
+    } else if (step == NUM_DELTAS + 1) {
+        params[INCREASING].p_i += 1;
+        params[DOUBLING].p_f *= 2;
+        params[FLIP_FLOP].p_b = 0;
+        dev_data = make_device_data(dev_type, BITMAP_BIT(INCREASING) | BITMAP_BIT(DOUBLING) | BITMAP_BIT(FLIP_FLOP), params);
+        dev_data->payload_length = BITMAP_SIZE + sizeof(int32_t) + sizeof(float) / 2;  // Cut in the middle of DOUBLING
+        return dev_data;
+    }
+    return make_device_data(dev_type, 0, params);
+}
+
+/**
+ * Arguments:
+ *    int: file descriptor for the socket
+ *    uint64_t: device uid
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("Incorrect number of arguments: %d out of %d\n", argc, 3);
+        exit(1);
+    }
+
+    int fd = atoi(argv[1]);
+    uint64_t uid = strtoull(argv[2], NULL, 0);
+    uint8_t dev_type = device_name_to_type("SimpleTestDevice");
+
+    message_t* incoming_msg = make_empty(MAX_PAYLOAD_SIZE);
+    message_t* outgoing_msg;
+    param_val_t params[MAX_PARAMS];
+    int step = 0;
+    uint8_t sent_ack = 0;
+    uint8_t offered = 1 << CHECKSUM_XOR;  // Checksums offered in dev handler's CHECKSUM_OFFER
+    checksum_t checksum = CHECKSUM_XOR;   // Switched to the one picked in the ACKNOWLEDGEMENT once it's sent
+
+    while (1) {
+        if (receive_message(fd, incoming_msg, checksum) != 0) {
+            continue;
+        }
+        switch (incoming_msg->message_id) {
+            case CHECKSUM_OFFER:
+                if (!sent_ack) {
+                    offered = offered_checksums(incoming_msg);
+                }
+                break;
+
+            case DEVICE_PING:
+                if (!sent_ack) {
+                    // Send an ack with the checksum that we picked, then switch to it
+                    outgoing_msg = make_acknowledgement(dev_type, dev_type, uid, pick_checksum(offered));
+                    send_message(fd, outgoing_msg, checksum);
+                    destroy_message(outgoing_msg);
+                    checksum = pick_checksum(offered);
+                    sent_ack = 1;
+                } else {
+                    outgoing_msg = next_step(dev_type, step++, params);
+                    send_message(fd, outgoing_msg, checksum);
+                    destroy_message(outgoing_msg);
+                }
+                break;
+
+            case RST:
+                printf("TruncatedTestDevice (0x%llX): Received a RST\n", (unsigned long long) uid);
+                exit(0);
+
+            default:
+                break;
+        }
+    }
+    return 0;
+}
@@ -3,27 +3,41 @@
 // Number of milliseconds between sending each DEVICE_DATA message
 #define DATA_INTERVAL 1
 
-message_t* make_acknowledgement(uint8_t type, uint8_t year, uint64_t uid) {
+message_t* make_acknowledgement(uint8_t type, uint8_t year, uint64_t uid, checksum_t checksum) {
     message_t* msg = malloc(sizeof(message_t));
     if (msg == NULL) {
         printf("make_acknowledgement: Failed to malloc\n");
         exit(1);
     }
     msg->message_id = ACKNOWLEDGEMENT;
-    msg->max_payload_length = DEVICE_ID_SIZE;
+    msg->max_payload_length = DEVICE_ID_SIZE + 1;
     msg->payload = malloc(msg->max_payload_length);
     if (msg->payload == NULL) {
         printf("make_acknowledgement: Failed to malloc\n");
         exit(1);
     }
-    msg->payload_length = DEVICE_ID_SIZE;
+    msg->payload_length = DEVICE_ID_SIZE + 1;
     msg->payload[0] = type;
     msg->payload[1] = year;
     memcpy(&msg->payload[2], &uid, 8);
+    msg->payload[DEVICE_ID_SIZE] = checksum;
     return msg;
 }
 
-int receive_message(int fd, message_t* msg) {
+uint8_t offered_checksums(message_t* offer) {
+    return (offer->payload_length > 0) ? offer->payload[0] : (1 << CHECKSUM_XOR);
+}
+
+checksum_t pick_checksum(uint8_t offered) {
+    if (offered & (1 << CHECKSUM_CRC16)) {
+        return CHECKSUM_CRC16;
+    } else if (offered & (1 << CHECKSUM_CRC8)) {
+        return CHECKSUM_CRC8;
+    }
+    return CHECKSUM_XOR;
+}
+
+int receive_message(int fd, message_t* msg, checksum_t checksum) {
     uint8_t last_byte_read = 0;  // Variable to temporarily hold a read byte
     int num_bytes_read = 0;
 
@@ -66,7 +80,7 @@ int receive_message(int fd, message_t* msg) {
     }
 
     // Parse the message
-    int ret = parse_message(data, msg);
+    int ret = parse_message(data, msg, checksum);
     free(data);
     if (ret != 0) {
         printf("receive_message: Incorrect checksum\n");
@@ -75,14 +89,14 @@ int receive_message(int fd, message_t* msg) {
     return 0;
 }
 
-void send_message(int fd, message_t* msg) {
+void send_message(int fd, message_t* msg, checksum_t checksum) {
     int len = calc_max_cobs_msg_length(msg);
     uint8_t* data = malloc(len);
     if (data == NULL) {
         printf("send_message: Failed to malloc\n");
         exit(1);
     }
-    len = message_to_bytes(msg, data, len);
+    len = message_to_bytes(msg, data, len, checksum);
     int transferred = write(fd, data, len);
     if (transferred != len) {
         printf("send_message: Sent only %d out of %d bytes\n", transferred, len);
@@ -93,32 +107,31 @@ void send_message(int fd, message_t* msg) {
 void device_write(uint8_t type, message_t* dev_write, param_val_t params[]) {
     device_t* dev = get_device(type);
     // Get bitmap from payload
-    uint32_t pmap;
+    bitmap_t pmap = 0;
     memcpy(&pmap, &dev_write->payload[0], BITMAP_SIZE);
     // Process each parameter
     uint8_t* payload_ptr = &dev_write->payload[BITMAP_SIZE];
-    for (int i = 0; ((pmap >> i) > 0) && (i < MAX_PARAMS); i++) {
-        if (pmap & (1 << i)) {
-            // Write to the corresponding field in params[i]
-            switch (dev->params[i].type) {
-                case INT:
-                    params[i].p_i = *((int32_t*) payload_ptr);
-                    payload_ptr += sizeof(int32_t);
-                    break;
-                case FLOAT:
-                    params[i].p_f = *((float*) payload_ptr);
-                    payload_ptr += sizeof(float);
-                    break;
-                case BOOL:
-                    params[i].p_b = *((uint8_t*) payload_ptr);
-                    payload_ptr += sizeof(uint8_t);
-                    break;
-            }
+    for (bitmap_t rest = pmap; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        // Write to the corresponding field in params[i]
+        switch (dev->params[i].type) {
+            case INT:
+                params[i].p_i = *((int32_t*) payload_ptr);
+                payload_ptr += sizeof(int32_t);
+                break;
+            case FLOAT:
+                params[i].p_f = *((float*) payload_ptr);
+                payload_ptr += sizeof(float);
+                break;
+            case BOOL:
+                params[i].p_b = *((uint8_t*) payload_ptr);
+                payload_ptr += sizeof(uint8_t);
+                break;
         }
     }
 }
 
-message_t* make_device_data(uint8_t type, uint32_t pmap, param_val_t params[]) {
+message_t* make_device_data(uint8_t type, bitmap_t pmap, param_val_t params[]) {
     message_t* dev_data = make_empty(MAX_PAYLOAD_SIZE);
     dev_data->message_id = DEVICE_DATA;
     // Copy pmap into payload
@@ -127,25 +140,24 @@ message_t* make_device_data(uint8_t type, uint32_t pmap, param_val_t params[]) {
     // Copy params into payload
     device_t* dev = get_device(type);
     uint8_t* payload_ptr = &dev_data->payload[BITMAP_SIZE];
-    for (int i = 0; ((pmap >> i) > 0) && (i < MAX_PARAMS); i++) {
-        if (pmap & (1 << i)) {
-            switch (dev->params[i].type) {
-                case INT:
-                    memcpy(payload_ptr, &params[i].p_i, sizeof(int32_t));
-                    payload_ptr += sizeof(int32_t);
-                    dev_data->payload_length += sizeof(int32_t);
-                    break;
-                case FLOAT:
-                    memcpy(payload_ptr, &params[i].p_f, sizeof(float));
-                    payload_ptr += sizeof(float);
-                    dev_data->payload_length += sizeof(float);
-                    break;
-                case BOOL:
-                    memcpy(payload_ptr, &params[i].p_b, sizeof(uint8_t));
-                    payload_ptr += sizeof(uint8_t);
-                    dev_data->payload_length += sizeof(uint8_t);
-                    break;
-            }
+    for (bitmap_t rest = pmap; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        switch (dev->params[i].type) {
+            case INT:
+                memcpy(payload_ptr, &params[i].p_i, sizeof(int32_t));
+                payload_ptr += sizeof(int32_t);
+                dev_data->payload_length += sizeof(int32_t);
+                break;
+            case FLOAT:
+                memcpy(payload_ptr, &params[i].p_f, sizeof(float));
+                payload_ptr += sizeof(float);
+                dev_data->payload_length += sizeof(float);
+                break;
+            case BOOL:
+                memcpy(payload_ptr, &params[i].p_b, sizeof(uint8_t));
+                payload_ptr += sizeof(uint8_t);
+                dev_data->payload_length += sizeof(uint8_t);
+                break;
         }
     }
     // This field is useless for this function but we'll set it to be consistent
@@ -153,31 +165,97 @@ message_t* make_device_data(uint8_t type, uint32_t pmap, param_val_t params[]) {
     return dev_data;
 }
 
+void init_data_state(data_state_t* state) {
+    memset(state, 0, sizeof(data_state_t));
+    state->subscribed = ALL_PARAMS;
+}
+
+void device_subscribe(message_t* subscribe, data_state_t* state) {
+    bitmap_t pmap = 0;
+    uint16_t periods[MAX_PARAMS];
+    if (subscribe->payload_length < BITMAP_SIZE) {
+        return;
+    }
+    memcpy(&pmap, subscribe->payload, BITMAP_SIZE);
+    pmap &= ALL_PARAMS;  // bitmap_t may be wider than BITMAP_SIZE bytes
+    // The period of each subscribed param follows the bitmap
+    uint8_t* payload_ptr = &subscribe->payload[BITMAP_SIZE];
+    for (bitmap_t rest = pmap; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        if (payload_ptr + sizeof(uint16_t) > &subscribe->payload[subscribe->payload_length]) {
+            return;
+        }
+        memcpy(&periods[i], payload_ptr, sizeof(uint16_t));
+        payload_ptr += sizeof(uint16_t);
+    }
+    state->subscribed = pmap;
+    for (bitmap_t rest = pmap; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        state->periods[i] = periods[i];
+    }
+}
+
+int next_device_data(data_state_t* state, bitmap_t readable, param_val_t params[], uint64_t now, bitmap_t* pmap) {
+    int keyframe = (now - state->last_keyframe_time) >= KEYFRAME_INTERVAL;
+    if (keyframe) {
+        state->last_keyframe_time = now;
+        *pmap = readable;
+    } else {
+        *pmap = 0;
+        for (bitmap_t rest = readable & state->subscribed; rest != 0;) {
+            int i = bitmap_pop(&rest);
+            if (params[i].p_i != state->last_sent[i].p_i && now - state->sent_times[i] >= state->periods[i]) {
+                *pmap |= BITMAP_BIT(i);
+            }
+        }
+    }
+    for (bitmap_t rest = *pmap; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        state->last_sent[i] = params[i];
+        state->sent_times[i] = now;
+    }
+    return keyframe || *pmap != 0;
+}
+
 void lowcar_protocol(int fd, uint8_t type, uint8_t year, uint64_t uid,
                      param_val_t params[], void (*device_actions)(param_val_t[]), int32_t action_interval) {
     message_t* incoming_msg = make_empty(MAX_PAYLOAD_SIZE);
     message_t* outgoing_msg;
-    uint64_t last_sent_ping_time = 0;
-    uint64_t last_received_ping_time = millis();
+    uint64_t last_sent_msg_time = 0;
+    uint64_t last_received_msg_time = millis();
     uint64_t last_sent_data_time = 0;
     uint64_t last_device_action = 0;
     uint8_t sent_ack = 0;
+    uint8_t offered = 1 << CHECKSUM_XOR;  // Checksums offered in dev handler's CHECKSUM_OFFER
+    checksum_t checksum = CHECKSUM_XOR;  // Switched to the one picked in the ACKNOWLEDGEMENT once it's sent
+    checksum_t picked;
     uint64_t now;
-    uint32_t readable_param_bitmap = get_readable_param_bitmap(type);  // Calculated once outside the loop for performance
+    bitmap_t readable_param_bitmap = get_readable_param_bitmap(type);  // Calculated once outside the loop for performance
+    bitmap_t data_bitmap;
+    data_state_t data_state;
+    init_data_state(&data_state);
 
     // Every cycle, read a message and respond accordingly, then send messages as needed
     while (1) {
         now = millis();
-        if (receive_message(fd, incoming_msg) == 0) {
-            // Got a message
+        if (receive_message(fd, incoming_msg, checksum) == 0) {
+            // Got a message, so dev handler is still there
+            last_received_msg_time = now;
             switch (incoming_msg->message_id) {
+                case CHECKSUM_OFFER:
+                    if (!sent_ack) {
+                        offered = offered_checksums(incoming_msg);
+                    }
+                    break;
+
                 case DEVICE_PING:
-                    last_received_ping_time = now;
                     if (!sent_ack) {
-                        // Send an ack
-                        outgoing_msg = make_acknowledgement(type, year, uid);
-                        send_message(fd, outgoing_msg);
+                        // Send an ack with the checksum that we picked, then switch to it
+                        picked = pick_checksum(offered);
+                        outgoing_msg = make_acknowledgement(type, year, uid, picked);
+                        send_message(fd, outgoing_msg, checksum);
                         destroy_message(outgoing_msg);
+                        checksum = picked;
                         sent_ack = 1;
                     }
                     break;
@@ -190,6 +268,10 @@ void lowcar_protocol(int fd, uint8_t type, uint8_t year, uint64_t uid,
                     }
                     break;
 
+                case SUBSCRIBE:
+                    device_subscribe(incoming_msg, &data_state);
+                    break;
+
                 case RST:
                     printf("lowcar_protocol (%llX): Received a RST\n", uid);
                     exit(1);
@@ -209,35 +291,36 @@ void lowcar_protocol(int fd, uint8_t type, uint8_t year, uint64_t uid,
             continue;
         }
 
-        // Make sure we're receiving DEVICE_PING messages still
-        if ((now - last_received_ping_time) >= TIMEOUT) {
+        // Make sure we're receiving messages still
+        if ((now - last_received_msg_time) >= TIMEOUT) {
             printf("lowcar_protocol (%llX): DEV_HANDLER timed out!\n", uid);
             // Send a RST
             outgoing_msg = make_rst();
-            send_message(fd, outgoing_msg);
+            send_message(fd, outgoing_msg, checksum);
             destroy_message(outgoing_msg);
             exit(1);
         }
 
-        // Check if we should send another DEVICE_PING
+        // Send a DEVICE_PING if we sent nothing else for PING_FREQ milliseconds
         // TODO: Physical lowcar devices don't send DEVICE_PING messages.
         // We should remove this. See issue #164.
-        if ((now - last_sent_ping_time) >= PING_FREQ) {
+        if ((now - last_sent_msg_time) >= PING_FREQ) {
             outgoing_msg = make_ping();
-            send_message(fd, outgoing_msg);
+            send_message(fd, outgoing_msg, checksum);
             destroy_message(outgoing_msg);
-            last_sent_ping_time = now;
+            last_sent_msg_time = now;
         }
         // Change read-only params periodically
         if (action_interval != -1 && (now - last_device_action) >= action_interval) {
             (*device_actions)(params);
             last_device_action = now;
         }
-        // Check if we should send another DEVICE_DATA
-        if ((now - last_sent_data_time) >= DATA_INTERVAL) {
-            outgoing_msg = make_device_data(type, readable_param_bitmap, params);
-            send_message(fd, outgoing_msg);
+        // Check if we should send another DEVICE_DATA, with only the subscribed params that changed unless a keyframe is due
+        if ((now - last_sent_data_time) >= DATA_INTERVAL && next_device_data(&data_state, readable_param_bitmap, params, now, &data_bitmap)) {
+            outgoing_msg = make_device_data(type, data_bitmap, params);
+            send_message(fd, outgoing_msg, checksum);
             destroy_message(outgoing_msg);
+            last_sent_msg_time = now;
         }
     }
 }
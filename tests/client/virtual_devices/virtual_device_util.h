@@ -8,39 +8,72 @@
 #include <dev_handler_message.h>
 #include <runtime_util.h>
 
+// Number of milliseconds between sending a DEVICE_DATA with all readable params (a keyframe), like lowcar does
+#define KEYFRAME_INTERVAL 100
+
+// What a virtual device sent in its DEVICE_DATA, and which params dev handler subscribed to
+typedef struct {
+    bitmap_t subscribed;                // Params to send when they change (every param until dev handler sends a SUBSCRIBE)
+    uint16_t periods[MAX_PARAMS];       // Least number of milliseconds between sending each subscribed param
+    uint64_t sent_times[MAX_PARAMS];    // Time at which each param was last sent
+    param_val_t last_sent[MAX_PARAMS];  // Value of each param when it was last sent
+    uint64_t last_keyframe_time;        // Time of the last keyframe (0 before the first one)
+} data_state_t;
+
 /**
  * Builds an ACKNOWLEDGEMENT message.
  * Arguments:
  *    type: The type of device
  *    year: The year of the device
  *    uid: The uid of the device
+ *    checksum: The checksum that the device picked (see pick_checksum())
  * Returns:
  *    A message of type ACKNOWLEDGEMENT
- *      Payload: type, year, then uid
- *      payload_length: sizeof(type) + sizeof(year) + sizeof(uid)
+ *      Payload: type, year, uid, then checksum
+ *      payload_length: sizeof(type) + sizeof(year) + sizeof(uid) + 1
  *      max_payload_length: same as above
  */
-message_t* make_acknowledgement(uint8_t type, uint8_t year, uint64_t uid);
+message_t* make_acknowledgement(uint8_t type, uint8_t year, uint64_t uid, checksum_t checksum);
+
+/**
+ * Reads the checksums offered in a CHECKSUM_OFFER
+ * Arguments:
+ *    offer: The CHECKSUM_OFFER
+ * Returns:
+ *    A bitmap whose bit i is on iff checksum_t i is offered
+ */
+uint8_t offered_checksums(message_t* offer);
+
+/**
+ * Picks the strongest checksum offered, like lowcar's Messenger::pick_checksum()
+ * Arguments:
+ *    offered: The checksums offered in dev handler's CHECKSUM_OFFER (see offered_checksums())
+ * Returns:
+ *    The checksum to use for every message after the ACKNOWLEDGEMENT
+ */
+checksum_t pick_checksum(uint8_t offered);
 
 /**
  * Receives a message
  * Arguments:
  *    fd: File descriptor to read from
  *    msg: message_t to be populated with parsed message
+ *    checksum: The kind of checksum that the message should end with
  * Returns:
  *    0 on success
  *    1 on bad read
  *    2 on incorrect checksum
  */
-int receive_message(int fd, message_t* msg);
+int receive_message(int fd, message_t* msg, checksum_t checksum);
 
 /**
  * Sends a message
  * Arguments:
  *    fd: File descriptor to write to
  *    msg: message_t to be sent
+ *    checksum: The kind of checksum to end the message with
  */
-void send_message(int fd, message_t* msg);
+void send_message(int fd, message_t* msg, checksum_t checksum);
 
 /**
  * Processes a DEVICE_WRITE message, writing to params as appropriate
@@ -61,11 +94,43 @@ void device_write(uint8_t type, message_t* dev_write, param_val_t params[]);
  * Returns:
  *    a DEVICE_DATA message
  */
-message_t* make_device_data(uint8_t type, uint32_t pmap, param_val_t params[]);
+message_t* make_device_data(uint8_t type, bitmap_t pmap, param_val_t params[]);
+
+/**
+ * Initializes what a device sent in DEVICE_DATA to nothing, and subscribes it to every param
+ * Arguments:
+ *    state: The state to initialize
+ */
+void init_data_state(data_state_t* state);
+
+/**
+ * Processes a SUBSCRIBE message, setting which params to send and how often at most
+ * Arguments:
+ *    subscribe: A SUBSCRIBE message to process
+ *    state: The state of the device's DEVICE_DATA; left as it is if SUBSCRIBE is malformed
+ */
+void device_subscribe(message_t* subscribe, data_state_t* state);
+
+/**
+ * Decides which params to send in the next DEVICE_DATA, like lowcar's Device::device_read_params(), and records them as sent
+ * These are the subscribed params that changed since they were last sent and whose period passed,
+ * or every readable param in a keyframe (every KEYFRAME_INTERVAL milliseconds, starting with the first DEVICE_DATA)
+ * Arguments:
+ *    state: The state of the device's DEVICE_DATA
+ *    readable: bitmap of the readable params of the device
+ *    params: The current param values
+ *    now: The current time
+ *    pmap: bitmap of the params to send will be put here
+ * Returns:
+ *    1 if a DEVICE_DATA with PMAP should be sent (a keyframe is sent even if it's empty)
+ *    0 if there is nothing to send
+ */
+int next_device_data(data_state_t* state, bitmap_t readable, param_val_t params[], uint64_t now, bitmap_t* pmap);
 
 /**
  * Executes the lowcar protocol, receiving/responding to messages, and sending
  * messages as appropriate
+ * Like lowcar, each DEVICE_DATA has only the subscribed params that changed (see next_device_data())
  * Arguments:
  *    fd: The file descriptor to read from and write to
  *    type: The device type
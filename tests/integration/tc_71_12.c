@@ -21,12 +21,12 @@ int main() {
     // Get current parameters then wait
     device_t* dev = get_device(simple_type);
     param_val_t vals_before[dev->num_params];
-    device_read_uid(UID, EXECUTOR, DATA, (1 << doubling_idx), vals_before);
+    device_read_uid(UID, EXECUTOR, DATA, BITMAP_BIT(doubling_idx), vals_before);
 
     // Write -1 to DOUBLING then wait (DOUBLING is read-only and should not change)
     param_val_t vals_to_write[dev->num_params];
     vals_to_write[doubling_idx].p_f = -1;
-    device_write_uid(UID, EXECUTOR, COMMAND, (1 << doubling_idx), vals_to_write);
+    device_write_uid(UID, EXECUTOR, COMMAND, BITMAP_BIT(doubling_idx), vals_to_write);
     sleep(1);  // Device values will change in this time
 
     // Verify DOUBLING changed as expected regardless of the write (write should not happen)
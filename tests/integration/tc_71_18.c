@@ -0,0 +1,111 @@
+/**
+ * Stress test for the command map in shared memory
+ * Many threads concurrently write commands to the same device while a single
+ * consumer (acting as dev handler's sender) claims them.
+ * Each writer waits for the consumer to see its latest value before writing the
+ * next one, so a command bit that is lost would stall that writer until it times out.
+ */
+#include "../test.h"
+
+#define UID 0x18
+#define NUM_WRITERS 8                                 // Number of concurrent writer threads
+#define PARAMS_PER_WRITER (MAX_PARAMS / NUM_WRITERS)  // Each writer owns a disjoint set of params
+#define NUM_ROUNDS 2000                               // Number of values each writer writes to each of its params
+#define CLAIM_TIMEOUT 1000                            // Milliseconds a writer waits for its command to be claimed
+
+int dev_ix = -1;                        // Index of the device in shared memory
+_Atomic int32_t last_seen[MAX_PARAMS];  // Latest value of each param claimed by the consumer
+_Atomic int lost_commands = 0;          // Number of commands that were never claimed
+_Atomic int writers_done = 0;           // Number of writers that have finished
+
+/**
+ * Repeatedly writes increasing values to the params owned by this writer
+ * and waits for the consumer to claim each one.
+ * Arguments:
+ *    args: pointer to the index of this writer
+ */
+static void* writer(void* args) {
+    int id = *((int*) args);
+    param_val_t params[MAX_PARAMS] = {0};
+    uint64_t start;
+
+    for (int32_t val = 1; val <= NUM_ROUNDS; val++) {
+        for (int j = 0; j < PARAMS_PER_WRITER; j++) {
+            int param = id + j * NUM_WRITERS;
+            params[param].p_i = val;
+            device_write(dev_ix, EXECUTOR, COMMAND, BITMAP_BIT(param), params);
+        }
+        for (int j = 0; j < PARAMS_PER_WRITER; j++) {
+            int param = id + j * NUM_WRITERS;
+            start = millis();
+            while (atomic_load(&last_seen[param]) < val) {
+                if (millis() - start >= CLAIM_TIMEOUT) {
+                    atomic_fetch_add(&lost_commands, 1);
+                    break;
+                }
+                sched_yield();
+            }
+        }
+    }
+    atomic_fetch_add(&writers_done, 1);
+    return NULL;
+}
+
+/**
+ * Claims commands for the device until all writers are done, like dev handler's sender would.
+ * Arguments:
+ *    args: unused
+ */
+static void* consumer(void* args) {
+    param_val_t params[MAX_PARAMS];
+    bitmap_t claimed;
+    uint32_t doorbell;
+
+    while (atomic_load(&writers_done) < NUM_WRITERS) {
+        doorbell = get_cmd_doorbell(dev_ix);
+        claimed = device_claim_commands(dev_ix, params);
+        for (int i = 0; i < MAX_PARAMS; i++) {
+            if (claimed & BITMAP_BIT(i)) {
+                atomic_store(&last_seen[i], params[i].p_i);
+            }
+        }
+        if (claimed == 0) {
+            wait_for_cmd(dev_ix, doorbell, 10);
+        }
+    }
+    return NULL;
+}
+
+int main() {
+    // Setup
+    start_test("Concurrent command writes", "", NO_REGEX);
+
+    // Connect a device directly to shared memory; dev handler doesn't know about it and won't consume its commands
+    dev_id_t dev_id = {.type = device_name_to_type("GeneralTestDevice"), .year = 0, .uid = UID};
+    device_connect(&dev_id, &dev_ix);
+    if (dev_ix == -1) {
+        printf("Couldn't connect device to shared memory\n");
+        exit(1);
+    }
+
+    // Start the consumer and all writers
+    pthread_t consumer_tid;
+    pthread_t writer_tids[NUM_WRITERS];
+    int writer_ids[NUM_WRITERS];
+    pthread_create(&consumer_tid, NULL, consumer, NULL);
+    for (int i = 0; i < NUM_WRITERS; i++) {
+        writer_ids[i] = i;
+        pthread_create(&writer_tids[i], NULL, writer, &writer_ids[i]);
+    }
+    for (int i = 0; i < NUM_WRITERS; i++) {
+        pthread_join(writer_tids[i], NULL);
+    }
+    pthread_join(consumer_tid, NULL);
+    device_disconnect(dev_ix);
+
+    // Every command should have been claimed
+    printf("Lost commands: %d\n", atomic_load(&lost_commands));
+    add_ordered_string_output("Lost commands: 0\n");
+
+    return 0;
+}
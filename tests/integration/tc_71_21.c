@@ -0,0 +1,87 @@
+/**
+ * Tests reading only the params of a device that changed since a previous read,
+ * and the time of the last update of a device's streams.
+ */
+#include "../test.h"
+
+#define UID 0x21
+
+int dev_ix = -1;  // Index of the device in shared memory
+
+/**
+ * Reads the DATA params of the device that changed since a version, and prints them.
+ * Arguments:
+ *    since_version: version returned by the previous read
+ * Returns the current version of the DATA stream.
+ */
+static uint32_t print_changed(uint32_t since_version) {
+    param_val_t params[MAX_PARAMS];
+    bitmap_t changed;
+    uint32_t version;
+
+    device_read_changed(dev_ix, DATA, since_version, &changed, &version, params);
+    printf("Changed:");
+    for (int i = 0; i < MAX_PARAMS; i++) {
+        if (changed & BITMAP_BIT(i)) {
+            printf(" %d=%d", i, params[i].p_i);
+        }
+    }
+    printf("\n");
+    return version;
+}
+
+int main() {
+    // Setup
+    start_test("Read changed params", "", NO_REGEX);
+
+    // Connect a device directly to shared memory; dev handler doesn't know about it
+    dev_id_t dev_id = {.type = device_name_to_type("GeneralTestDevice"), .year = 0, .uid = UID};
+    device_connect(&dev_id, &dev_ix);
+    if (dev_ix == -1) {
+        printf("Couldn't connect device to shared memory\n");
+        exit(1);
+    }
+    param_val_t params[MAX_PARAMS] = {0};
+
+    // Every param reads as changed the first time; nothing has been written yet
+    printf("Last update set: %d\n", device_last_update(dev_ix, DATA) != 0);
+    uint32_t version = print_changed(0);
+
+    // Only params whose values change are reported
+    params[0].p_i = 5;
+    params[1].p_i = 0;  // unchanged from 0
+    params[2].p_i = 7;
+    device_write(dev_ix, DEV_HANDLER, DATA, 0x7, params);
+    printf("Last update set: %d\n", device_last_update(dev_ix, DATA) != 0);
+    version = print_changed(version);
+
+    // Writing the same values again changes nothing
+    device_write(dev_ix, DEV_HANDLER, DATA, 0x7, params);
+    version = print_changed(version);
+
+    // Changes from several writes are combined
+    params[2].p_i = 8;
+    device_write(dev_ix, DEV_HANDLER, DATA, 0x4, params);
+    params[3].p_i = 9;
+    device_write(dev_ix, DEV_HANDLER, DATA, 0x8, params);
+    print_changed(version);
+    print_changed(version);  // reading doesn't consume changes
+
+    device_disconnect(dev_ix);
+
+    // Check outputs
+    char all_changed[256] = "Changed:";
+    for (int i = 0; i < MAX_PARAMS; i++) {
+        sprintf(all_changed + strlen(all_changed), " %d=0", i);
+    }
+    strcat(all_changed, "\n");
+    add_ordered_string_output("Last update set: 0\n");
+    add_ordered_string_output(all_changed);
+    add_ordered_string_output("Last update set: 1\n");
+    add_ordered_string_output("Changed: 0=5 2=7\n");
+    add_ordered_string_output("Changed:\n");
+    add_ordered_string_output("Changed: 2=8 3=9\n");
+    add_ordered_string_output("Changed: 2=8 3=9\n");
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * Tests the history ring of a device's DATA stream:
+ * every write is kept as a sample until DEV_HISTORY_LEN newer samples overwrite it,
+ * a cursor returns only samples that are newer than the last read,
+ * and a newly connected device doesn't see the samples of the previous device at its index.
+ */
+#include "../test.h"
+
+#define UID 0x22
+#define NUM_WRITES 10  // Number of writes before the first read; less than DEV_HISTORY_LEN
+
+int dev_ix = -1;                         // Index of the device in shared memory
+dev_sample_t samples[DEV_HISTORY_LEN];  // Samples read from the history ring
+
+/**
+ * Writes increasing values to param 0 of the device.
+ * Arguments:
+ *    first: value of the first write
+ *    num_writes: number of writes
+ */
+static void write_values(int32_t first, int num_writes) {
+    param_val_t params[MAX_PARAMS] = {0};
+    for (int i = 0; i < num_writes; i++) {
+        params[0].p_i = first + i;
+        device_write(dev_ix, DEV_HANDLER, DATA, 1, params);
+    }
+}
+
+/**
+ * Reads the history of the device from the cursor and prints a summary of the samples.
+ * Arguments:
+ *    cursor: cursor to read from; is updated by the read
+ */
+static void print_history(uint32_t* cursor) {
+    int num_samples = device_read_history(dev_ix, cursor, samples, DEV_HISTORY_LEN);
+    int consecutive = 1;  // whether the values of param 0 increase by 1 from sample to sample
+    for (int i = 1; i < num_samples; i++) {
+        if (samples[i].params[0].p_i != samples[i - 1].params[0].p_i + 1 || samples[i].timestamp < samples[i - 1].timestamp) {
+            consecutive = 0;
+        }
+    }
+    if (num_samples > 0) {
+        printf("Samples: %d, first value: %d, last value: %d, consecutive: %d\n", num_samples, samples[0].params[0].p_i,
+               samples[num_samples - 1].params[0].p_i, consecutive);
+    } else {
+        printf("Samples: %d\n", num_samples);
+    }
+}
+
+int main() {
+    // Setup
+    start_test("Device history ring", "", NO_REGEX);
+
+    // Connect a device directly to shared memory; dev handler doesn't know about it
+    dev_id_t dev_id = {.type = device_name_to_type("GeneralTestDevice"), .year = 0, .uid = UID};
+    device_connect(&dev_id, &dev_ix);
+    if (dev_ix == -1) {
+        printf("Couldn't connect device to shared memory\n");
+        exit(1);
+    }
+    uint32_t cursor = 0;
+
+    // Every write is a sample
+    write_values(1, NUM_WRITES);
+    print_history(&cursor);
+
+    // Nothing new
+    print_history(&cursor);
+
+    // Only the last DEV_HISTORY_LEN samples are kept
+    write_values(NUM_WRITES + 1, 2 * DEV_HISTORY_LEN);
+    print_history(&cursor);
+
+    // A new device at the same index starts with an empty history
+    device_disconnect(dev_ix);
+    device_connect(&dev_id, &dev_ix);
+    cursor = 0;
+    print_history(&cursor);
+    write_values(100, 1);
+    print_history(&cursor);
+    device_disconnect(dev_ix);
+
+    // Check outputs
+    char expected[128];
+    add_ordered_string_output("Samples: 10, first value: 1, last value: 10, consecutive: 1\n");
+    add_ordered_string_output("Samples: 0\n");
+    sprintf(expected, "Samples: %d, first value: %d, last value: %d, consecutive: 1\n", DEV_HISTORY_LEN,
+            NUM_WRITES + DEV_HISTORY_LEN + 1, NUM_WRITES + 2 * DEV_HISTORY_LEN);
+    add_ordered_string_output(expected);
+    add_ordered_string_output("Samples: 0\n");
+    add_ordered_string_output("Samples: 1, first value: 100, last value: 100, consecutive: 1\n");
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * Tests waiting on changes to the robot description.
+ * A waiting thread should wake up as soon as the field it waits on changes,
+ * but not when the field is rewritten with the same value or another field changes.
+ */
+#include "../test.h"
+
+#define CHANGE_DELAY 50     // Milliseconds the main thread waits before changing the field
+#define WAIT_TIMEOUT 500    // Milliseconds the waiting thread waits for each change
+#define MAX_WAKE_LATENCY 5  // Milliseconds within which the waiting thread should wake up after a change
+
+uint64_t change_time = 0;  // Time at which the main thread last changed START_POS
+
+/**
+ * Waits for START_POS to change twice, and prints how each wait ended.
+ * Arguments:
+ *    args: unused
+ */
+static void* waiter(void* args) {
+    uint32_t seq = 0;
+    int ret;
+
+    // Catch up on changes made before we started waiting
+    while (robot_desc_wait(START_POS, &seq, 0) == 0) {
+    }
+
+    for (int i = 0; i < 2; i++) {
+        ret = robot_desc_wait(START_POS, &seq, WAIT_TIMEOUT);
+        printf("Woke up: %s, start pos: %s, in time: %d\n", (ret == 0) ? "change" : "timeout",
+               (robot_desc_read(START_POS) == LEFT) ? "left" : "right", millis() - change_time <= MAX_WAKE_LATENCY);
+    }
+
+    // Nothing changes anymore
+    ret = robot_desc_wait(START_POS, &seq, CHANGE_DELAY);
+    printf("Woke up: %s\n", (ret == 0) ? "change" : "timeout");
+    return NULL;
+}
+
+int main() {
+    // Setup
+    start_test("Wait on robot description", "", NO_REGEX);
+    robot_desc_write(START_POS, LEFT);
+
+    pthread_t tid;
+    pthread_create(&tid, NULL, waiter, NULL);
+    usleep(CHANGE_DELAY * 1000);
+
+    // Neither of these should wake the waiter
+    robot_desc_write(START_POS, LEFT);
+    robot_desc_write(HYPOTHERMIA, ACTIVE);
+    robot_desc_write(HYPOTHERMIA, INACTIVE);
+    usleep(CHANGE_DELAY * 1000);
+
+    // Each of these should
+    change_time = millis();
+    robot_desc_write(START_POS, RIGHT);
+    usleep(CHANGE_DELAY * 1000);
+    change_time = millis();
+    robot_desc_write(START_POS, LEFT);
+
+    pthread_join(tid, NULL);
+
+    // Check outputs
+    add_ordered_string_output("Woke up: change, start pos: right, in time: 1\n");
+    add_ordered_string_output("Woke up: change, start pos: left, in time: 1\n");
+    add_ordered_string_output("Woke up: timeout\n");
+
+    return 0;
+}
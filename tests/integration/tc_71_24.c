@@ -0,0 +1,81 @@
+/**
+ * Tests lock-free reads of the gamepad input.
+ * A writer thread writes gamepad states whose buttons and joysticks encode the same counter, while
+ * the main thread reads them; every read must see buttons and joysticks from the same write,
+ * and the sequence number of the input must tell whether it is new since the last read.
+ */
+#include "../test.h"
+
+#define NUM_WRITES 100000  // Number of gamepad states the writer writes
+
+_Atomic int writer_done = 0;  // Whether the writer has finished
+
+/**
+ * Writes NUM_WRITES gamepad states, each with all joysticks set to the number of the write
+ * and the buttons set to the same number.
+ * Arguments:
+ *    args: unused
+ */
+static void* writer(void* args) {
+    float joystick_vals[4];
+    for (int i = 1; i <= NUM_WRITES; i++) {
+        for (int j = 0; j < 4; j++) {
+            joystick_vals[j] = (float) i;
+        }
+        input_write((uint64_t) i, joystick_vals, GAMEPAD);
+    }
+    atomic_store(&writer_done, 1);
+    return NULL;
+}
+
+int main() {
+    // Setup
+    start_test("Lock-free input reads", "", NO_REGEX);
+    robot_desc_write(GAMEPAD, CONNECTED);
+
+    uint64_t buttons;
+    float joystick_vals[4];
+    uint32_t seq, last_seq;
+    uint64_t timestamp;
+
+    // Nothing is new if nothing was written
+    input_read_seq(&buttons, joystick_vals, GAMEPAD, &last_seq, &timestamp);
+    input_read_seq(&buttons, joystick_vals, GAMEPAD, &seq, &timestamp);
+    printf("New input: %d\n", seq != last_seq);
+
+    // Every write is new
+    input_write(1, joystick_vals, GAMEPAD);
+    input_read_seq(&buttons, joystick_vals, GAMEPAD, &seq, &timestamp);
+    printf("New input: %d\n", seq != last_seq);
+
+    // Read concurrently with the writer; no read may mix two writes
+    int torn = 0;
+    pthread_t tid;
+    pthread_create(&tid, NULL, writer, NULL);
+    while (!atomic_load(&writer_done)) {
+        input_read_seq(&buttons, joystick_vals, GAMEPAD, &seq, &timestamp);
+        for (int j = 0; j < 4; j++) {
+            if (joystick_vals[j] != (float) buttons) {
+                torn++;
+                break;
+            }
+        }
+    }
+    pthread_join(tid, NULL);
+    printf("Torn reads: %d\n", torn);
+
+    // The last write is read, and the sequence number counts every write
+    input_read_seq(&buttons, joystick_vals, GAMEPAD, &seq, &timestamp);
+    printf("Buttons: %d, writes: %u\n", (int) buttons, seq - last_seq);
+    robot_desc_write(GAMEPAD, DISCONNECTED);
+
+    // Check outputs
+    char expected[64];
+    add_ordered_string_output("New input: 0\n");
+    add_ordered_string_output("New input: 1\n");
+    add_ordered_string_output("Torn reads: 0\n");
+    sprintf(expected, "Buttons: %d, writes: %d\n", NUM_WRITES, NUM_WRITES + 1);
+    add_ordered_string_output(expected);
+
+    return 0;
+}
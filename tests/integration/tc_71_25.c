@@ -0,0 +1,79 @@
+/**
+ * Tests the custom log data block:
+ * keys are found again after many keys were added, a caller's copy is updated with only what changed,
+ * and errors (too many keys, too long key) don't leave the log data semaphore held.
+ */
+#include "../test.h"
+
+// The caller's copy of the log data
+uint8_t num_params = 0;
+char names[UCHAR_MAX][LOG_KEY_LENGTH];
+param_type_t types[UCHAR_MAX];
+param_val_t values[UCHAR_MAX];
+uint32_t names_version = 0;
+uint32_t values_version = 0;
+
+/**
+ * Updates the copy of the log data and prints what happened.
+ */
+static void update_copy() {
+    uint32_t old_names_version = names_version;
+    bool changed = log_data_read_changed(&names_version, &values_version, &num_params, names, types, values);
+    printf("Changed: %d, names changed: %d, num params: %d\n", changed, names_version != old_names_version, num_params);
+}
+
+int main() {
+    // Setup
+    start_test("Log data index", "", NO_REGEX);
+
+    char key[LOG_KEY_LENGTH];
+    param_val_t value;
+
+    // Fill every key, then rewrite each of them with a new value
+    for (int i = 0; i < UCHAR_MAX; i++) {
+        sprintf(key, "key_%d", i);
+        value.p_i = i;
+        log_data_write(key, INT, value);
+    }
+    update_copy();
+    for (int i = 0; i < UCHAR_MAX; i++) {
+        sprintf(key, "key_%d", i);
+        value.p_i = 1000 + i;
+        log_data_write(key, INT, value);
+    }
+    update_copy();
+
+    // Every key is still in its place with its latest value
+    int wrong = 0;
+    for (int i = 0; i < UCHAR_MAX; i++) {
+        sprintf(key, "key_%d", i);
+        if (strcmp(names[i], key) != 0 || values[i].p_i != 1000 + i) {
+            wrong++;
+        }
+    }
+    printf("Wrong keys: %d\n", wrong);
+
+    // Nothing changed since the last update
+    update_copy();
+
+    // Errors release the semaphore; otherwise the write after them would block forever
+    printf("Too many keys: %d\n", log_data_write("one_too_many", INT, value));
+    printf("Too long key: %d\n", log_data_write("this_key_is_much_too_long_to_fit_in_the_log_data_block_of_shared_memory", INT, value));
+    value.p_f = 0.5;
+    printf("Change type: %d\n", log_data_write("key_7", FLOAT, value));
+    update_copy();
+    printf("key_7: %.1f\n", values[7].p_f);
+
+    // Check outputs
+    add_ordered_string_output("Changed: 1, names changed: 1, num params: 255\n");
+    add_ordered_string_output("Changed: 1, names changed: 0, num params: 255\n");
+    add_ordered_string_output("Wrong keys: 0\n");
+    add_ordered_string_output("Changed: 0, names changed: 0, num params: 255\n");
+    add_ordered_string_output("Too many keys: -1\n");
+    add_ordered_string_output("Too long key: -2\n");
+    add_ordered_string_output("Change type: 0\n");
+    add_ordered_string_output("Changed: 1, names changed: 1, num params: 255\n");
+    add_ordered_string_output("key_7: 0.5\n");
+
+    return 0;
+}
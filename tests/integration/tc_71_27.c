@@ -0,0 +1,90 @@
+/**
+ * Tests lock statistics:
+ * nothing is counted while they are off, every acquisition and hold is counted while they are on,
+ * and an acquisition that has to wait for another holder is counted as contended along with how long it waited.
+ */
+#include "../test.h"
+
+#define UID 0x27
+#define NUM_WRITES 10  // Number of uncontended writes
+#define HOLD_TIME 20   // Milliseconds the main thread holds the command lock while another thread waits for it
+
+int dev_ix = -1;  // Index of the device in shared memory
+
+/**
+ * Writes a command to param 0 of the device.
+ * Arguments:
+ *    args: unused
+ */
+static void* writer(void* args) {
+    param_val_t params[MAX_PARAMS] = {0};
+    params[0].p_i = 1;
+    device_write(dev_ix, EXECUTOR, COMMAND, BITMAP_BIT(0), params);
+    return NULL;
+}
+
+/**
+ * Prints the statistics of the device's command lock.
+ * Arguments:
+ *    label: what is being checked
+ */
+static void print_stats(char* label) {
+    sem_stats_t stats;
+    uint64_t holds = 0;
+    sem_stats_read(SHM_LOCK_COMMAND(dev_ix), &stats);
+    for (int i = 0; i < SEM_STATS_BUCKETS; i++) {
+        holds += stats.hold_hist[i];
+    }
+    printf("%s: acquisitions %d, contended %d, holds %d, waited long enough: %d\n", label, (int) stats.acquisitions, (int) stats.contended,
+           (int) holds, stats.wait_ns >= (HOLD_TIME / 2) * 1000000ULL);
+}
+
+int main() {
+    // Setup
+    start_test("Lock statistics", "", NO_REGEX);
+
+    // Connect a device directly to shared memory; dev handler doesn't know about it
+    dev_id_t dev_id = {.type = device_name_to_type("GeneralTestDevice"), .year = 0, .uid = UID};
+    device_connect(&dev_id, &dev_ix);
+    if (dev_ix == -1) {
+        printf("Couldn't connect device to shared memory\n");
+        exit(1);
+    }
+
+    // Nothing is counted while statistics are off
+    sem_stats_reset();
+    for (int i = 0; i < NUM_WRITES; i++) {
+        writer(NULL);
+    }
+    print_stats("Off");
+
+    // Every acquisition is counted, and none of them had to wait
+    sem_stats_enable(true);
+    for (int i = 0; i < NUM_WRITES; i++) {
+        writer(NULL);
+    }
+    print_stats("Uncontended");
+
+    // Hold the lock (without counting it) while another thread tries to acquire it
+    pthread_t tid;
+    pthread_mutex_lock(&shm_ptr->locks[SHM_LOCK_COMMAND(dev_ix)].mutex);
+    pthread_create(&tid, NULL, writer, NULL);
+    usleep(HOLD_TIME * 1000);
+    pthread_mutex_unlock(&shm_ptr->locks[SHM_LOCK_COMMAND(dev_ix)].mutex);
+    pthread_join(tid, NULL);
+    print_stats("Contended");
+
+    // Turned off again
+    sem_stats_enable(false);
+    writer(NULL);
+    print_stats("Off again");
+    device_disconnect(dev_ix);
+
+    // Check outputs
+    add_ordered_string_output("Off: acquisitions 0, contended 0, holds 0, waited long enough: 0\n");
+    add_ordered_string_output("Uncontended: acquisitions 10, contended 0, holds 10, waited long enough: 0\n");
+    add_ordered_string_output("Contended: acquisitions 11, contended 1, holds 11, waited long enough: 1\n");
+    add_ordered_string_output("Off again: acquisitions 11, contended 1, holds 11, waited long enough: 1\n");
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * Tests that a lock whose holder died is recovered:
+ * a child process takes a device's data lock, starts a write, and exits without finishing it,
+ * and the next write and the lock-free reads after it still go through and see the new value.
+ */
+#include <sys/wait.h>
+
+#include "../test.h"
+
+#define UID 0x28
+
+int main() {
+    // Setup
+    start_test("Lock recovery", "", NO_REGEX);
+
+    // Connect a device directly to shared memory; dev handler doesn't know about it
+    int dev_ix = -1;
+    dev_id_t dev_id = {.type = device_name_to_type("GeneralTestDevice"), .year = 0, .uid = UID};
+    device_connect(&dev_id, &dev_ix);
+    if (dev_ix == -1) {
+        printf("Couldn't connect device to shared memory\n");
+        exit(1);
+    }
+
+    // The child dies in the middle of a write, holding the data lock with the sequence counter odd
+    pid_t pid = fork();
+    if (pid == 0) {
+        pthread_mutex_lock(&shm_ptr->locks[SHM_LOCK_DATA(dev_ix)].mutex);
+        atomic_fetch_add(&dev_shm_ptr->streams[DATA][dev_ix].seq, 1);
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+    printf("Sequence counter odd: %d\n", atomic_load(&dev_shm_ptr->streams[DATA][dev_ix].seq) % 2);
+
+    // The next write recovers the lock instead of blocking forever
+    param_val_t params[MAX_PARAMS] = {0};
+    params[0].p_i = 28;
+    device_write(dev_ix, DEV_HANDLER, DATA, BITMAP_BIT(0), params);
+    printf("Sequence counter odd: %d\n", atomic_load(&dev_shm_ptr->streams[DATA][dev_ix].seq) % 2);
+
+    // Lock-free readers see the write
+    params[0].p_i = 0;
+    device_read(dev_ix, EXECUTOR, DATA, BITMAP_BIT(0), params);
+    printf("Read value: %d\n", params[0].p_i);
+    dev_sample_t samples[DEV_HISTORY_LEN];
+    uint32_t cursor = 0;
+    int num_samples = device_read_history(dev_ix, &cursor, samples, DEV_HISTORY_LEN);
+    printf("Last sample value: %d\n", (num_samples == 0) ? -1 : samples[num_samples - 1].params[0].p_i);
+
+    // The lock works normally again
+    params[0].p_i = 29;
+    device_write(dev_ix, DEV_HANDLER, DATA, BITMAP_BIT(0), params);
+    device_read(dev_ix, EXECUTOR, DATA, BITMAP_BIT(0), params);
+    printf("Read value: %d\n", params[0].p_i);
+    device_disconnect(dev_ix);
+
+    // Check outputs
+    add_ordered_string_output("Sequence counter odd: 1\n");
+    add_ordered_string_output("Sequence counter odd: 0\n");
+    add_ordered_string_output("Read value: 28\n");
+    add_ordered_string_output("Last sample value: 28\n");
+    add_ordered_string_output("Read value: 29\n");
+
+    return 0;
+}
@@ -0,0 +1,241 @@
+/**
+ * Checks the word-at-a-time cobs codec and the checksums of dev handler messages against the byte-at-a-time
+ * versions that they replaced (ref_cobs_encode(), ref_cobs_decode(), and ref_xor() in test.h), over a deterministic
+ * corpus of byte arrays and messages.
+ * The encoder must produce exactly the same bytes as before, so that devices that haven't been updated still
+ * decode them; the decoder must give back what was encoded. Messages must round trip with each kind of checksum,
+ * and the CRCs must catch every one- and two-bit error in a short message, many of which the XOR misses.
+ */
+#include "../test.h"
+#include "dev_handler_message.h"
+
+#define NUM_ARRAYS 4000   // Number of random byte arrays in the corpus
+#define MAX_ARRAY_LEN 600  // Longest byte array in the corpus (several max-length cobs blocks)
+#define FLIP_PAYLOAD 12    // Payload length of the message that bits are flipped in (short enough for CRC-8 to catch two-bit errors)
+
+// ********************************* CORPUS ********************************* //
+
+static uint64_t rng_state = 0x71330001;
+
+/**
+ * Returns the next pseudorandom number (xorshift64), so that the corpus is the same every run
+ */
+static uint64_t next_random() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/**
+ * Fills a byte array with random bytes, each of which is zero with probability 1 / ZERO_ODDS
+ * (or never if ZERO_ODDS is 0)
+ */
+static void fill_random(uint8_t* data, size_t len, int zero_odds) {
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t) (next_random() % 255 + 1);
+        if (zero_odds != 0 && next_random() % zero_odds == 0) {
+            data[i] = 0;
+        }
+    }
+}
+
+// ********************************* CHECKS ********************************* //
+
+/**
+ * Encodes and decodes a byte array with both codecs
+ * Returns:
+ *    0 if the encoded bytes are the same, the new decoder gives back SRC,
+ *    and the old decoder agrees with it (when it can handle SRC), or
+ *    1 otherwise
+ */
+static int check_codec(const uint8_t* src, size_t len) {
+    uint8_t ref_encoded[MAX_ARRAY_LEN * 2], encoded[MAX_ARRAY_LEN * 2];
+    uint8_t ref_decoded[MAX_ARRAY_LEN * 2], decoded[MAX_ARRAY_LEN * 2];
+    ssize_t ref_encoded_len = ref_cobs_encode(ref_encoded, src, len);
+    ssize_t encoded_len = cobs_encode(encoded, src, len);
+    if (encoded_len != ref_encoded_len || memcmp(encoded, ref_encoded, encoded_len) != 0) {
+        return 1;
+    }
+    ssize_t decoded_len = cobs_decode(decoded, encoded, encoded_len);
+    if (decoded_len != (ssize_t) len || memcmp(decoded, src, len) != 0) {
+        return 1;
+    }
+    if (len < 0xFE) {
+        ssize_t ref_decoded_len = ref_cobs_decode(ref_decoded, encoded, encoded_len);
+        if (ref_decoded_len != decoded_len || memcmp(ref_decoded, decoded, decoded_len) != 0) {
+            return 1;
+        }
+    }
+    // Decoding in place, like parse_message() does, gives the same result
+    if (cobs_decode(encoded, encoded, encoded_len) != decoded_len || memcmp(encoded, src, len) != 0) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Serializes a message with each kind of checksum and parses it back
+ * Returns:
+ *    0 if the message round trips with every checksum and its XOR serialization is the same as before, or
+ *    1 otherwise
+ */
+static int check_message(message_t* msg) {
+    uint8_t data[MAX_COBS_MSG_LENGTH];
+    message_t* parsed = make_empty(MAX_PAYLOAD_SIZE);
+    int failures = 0;
+    for (checksum_t checksum = CHECKSUM_XOR; checksum < NUM_CHECKSUMS; checksum++) {
+        ssize_t len = message_to_bytes(msg, data, MAX_COBS_MSG_LENGTH, checksum);
+        if (checksum == CHECKSUM_XOR) {
+            // Build it the old way: [delimiter][cobs length][cobs([message id][payload length][payload][XOR])]
+            uint8_t raw[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + 1], ref[MAX_COBS_MSG_LENGTH];
+            size_t raw_len = MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + msg->payload_length;
+            raw[0] = msg->message_id;
+            raw[1] = msg->payload_length;
+            memcpy(&raw[2], msg->payload, msg->payload_length);
+            raw[raw_len] = ref_xor(raw, raw_len);
+            ref[0] = 0x00;
+            ref[1] = ref_cobs_encode(&ref[2], raw, raw_len + 1);
+            if (len != DELIMITER_SIZE + COBS_LENGTH_SIZE + ref[1] || memcmp(data, ref, len) != 0) {
+                failures = 1;
+            }
+        }
+        if (len < 0 || parse_message(data, parsed, checksum) != 0 || parsed->message_id != msg->message_id
+            || parsed->payload_length != msg->payload_length || memcmp(parsed->payload, msg->payload, msg->payload_length) != 0) {
+            failures = 1;
+        }
+    }
+    destroy_message(parsed);
+    return failures;
+}
+
+/**
+ * Flips every bit and every pair of bits in a short serialized message (including its checksum)
+ * Arguments:
+ *    checksum: The kind of checksum to end the message with
+ * Returns:
+ *    The number of flipped messages whose checksum still matches
+ */
+static int missed_bit_flips(checksum_t checksum) {
+    uint8_t frame[MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + FLIP_PAYLOAD + MAX_CHECKSUM_SIZE];
+    size_t data_len = MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + FLIP_PAYLOAD;
+    size_t frame_len = data_len + CHECKSUM_SIZE(checksum);
+    frame[0] = DEVICE_DATA;
+    frame[1] = FLIP_PAYLOAD;
+    fill_random(&frame[2], FLIP_PAYLOAD, 8);
+    uint16_t chk = compute_checksum(checksum, frame, data_len);
+    memcpy(&frame[data_len], &chk, CHECKSUM_SIZE(checksum));
+
+    int missed = 0;
+    for (size_t i = 0; i < frame_len * 8; i++) {
+        for (size_t j = i; j < frame_len * 8; j++) {
+            frame[i / 8] ^= 1 << (i % 8);
+            if (j != i) {
+                frame[j / 8] ^= 1 << (j % 8);
+            }
+            uint16_t received = 0;
+            memcpy(&received, &frame[data_len], CHECKSUM_SIZE(checksum));
+            if (compute_checksum(checksum, frame, data_len) == received) {
+                missed++;
+            }
+            frame[i / 8] ^= 1 << (i % 8);
+            if (j != i) {
+                frame[j / 8] ^= 1 << (j % 8);
+            }
+        }
+    }
+    return missed;
+}
+
+int main() {
+    // Setup
+    start_test("Cobs codec and checksums match the byte-at-a-time versions", "", NO_REGEX);
+
+    // Byte arrays of every length up to a few blocks, of all zeros, no zeros, and in between
+    uint8_t src[MAX_ARRAY_LEN];
+    int codec_mismatches = 0;
+    int zero_odds[] = {0, 1, 2, 8, 64, 300};
+    for (size_t len = 0; len <= MAX_ARRAY_LEN; len++) {
+        for (int z = 0; z < sizeof(zero_odds) / sizeof(int); z++) {
+            fill_random(src, len, zero_odds[z]);
+            codec_mismatches += check_codec(src, len);
+        }
+    }
+    for (int i = 0; i < NUM_ARRAYS; i++) {
+        size_t len = next_random() % (MAX_ARRAY_LEN + 1);
+        fill_random(src, len, zero_odds[next_random() % (sizeof(zero_odds) / sizeof(int))]);
+        codec_mismatches += check_codec(src, len);
+    }
+    printf("Cobs mismatches: %d\n", codec_mismatches);
+    add_ordered_string_output("Cobs mismatches: 0\n");
+
+    // The word-at-a-time XOR gives the same checksum at every length and alignment
+    int xor_mismatches = 0;
+    fill_random(src, MAX_ARRAY_LEN, 8);
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t len = 0; len + offset <= MAX_ARRAY_LEN; len++) {
+            xor_mismatches += compute_checksum(CHECKSUM_XOR, &src[offset], len) != ref_xor(&src[offset], len);
+        }
+    }
+    printf("XOR mismatches: %d\n", xor_mismatches);
+    add_ordered_string_output("XOR mismatches: 0\n");
+
+    // The CRCs give the standard check values
+    uint8_t check[] = "123456789";
+    printf("CRC-8 check value: 0x%02X\n", compute_checksum(CHECKSUM_CRC8, check, 9));
+    add_ordered_string_output("CRC-8 check value: 0xF4\n");
+    printf("CRC-16 check value: 0x%04X\n", compute_checksum(CHECKSUM_CRC16, check, 9));
+    add_ordered_string_output("CRC-16 check value: 0x29B1\n");
+
+    // Messages of every type dev handler sends, and random payloads of every length, round trip
+    int message_failures = 0;
+    uint8_t dev_type = device_name_to_type("GeneralTestDevice");
+    param_val_t vals[MAX_PARAMS] = {0};
+    uint16_t periods[MAX_PARAMS] = {0};
+    message_t* msg = make_ping();
+    message_failures += check_message(msg);
+    destroy_message(msg);
+    msg = make_rst();
+    message_failures += check_message(msg);
+    destroy_message(msg);
+    msg = make_device_write(dev_type, ALL_PARAMS, vals);
+    message_failures += check_message(msg);
+    destroy_message(msg);
+    for (int i = 0; i < MAX_PARAMS; i++) {
+        vals[i].p_i = (int32_t) next_random();
+        periods[i] = (uint16_t) next_random();
+    }
+    msg = make_device_write(dev_type, ALL_PARAMS, vals);
+    message_failures += check_message(msg);
+    destroy_message(msg);
+    msg = make_empty(MAX_PAYLOAD_SIZE);
+    fill_checksum_offer(msg);
+    message_failures += check_message(msg);
+    fill_set_baud(msg, HIGH_BAUD_RATE);
+    message_failures += check_message(msg);
+    fill_subscribe(msg, 0x5, periods);
+    message_failures += check_message(msg);
+    fill_subscribe(msg, ALL_PARAMS, periods);
+    message_failures += check_message(msg);
+    msg->message_id = DEVICE_DATA;
+    for (size_t len = 0; len <= MAX_PAYLOAD_SIZE; len++) {
+        for (int z = 0; z < sizeof(zero_odds) / sizeof(int); z++) {
+            fill_random(msg->payload, len, zero_odds[z]);
+            msg->payload_length = len;
+            message_failures += check_message(msg);
+        }
+    }
+    destroy_message(msg);
+    printf("Message round trip failures: %d\n", message_failures);
+    add_ordered_string_output("Message round trip failures: 0\n");
+
+    // The CRCs catch every one- and two-bit error in a short message; the XOR doesn't
+    printf("XOR misses bit errors: %d\n", missed_bit_flips(CHECKSUM_XOR) > 0);
+    add_ordered_string_output("XOR misses bit errors: 1\n");
+    printf("CRC-8 missed bit errors: %d\n", missed_bit_flips(CHECKSUM_CRC8));
+    add_ordered_string_output("CRC-8 missed bit errors: 0\n");
+    printf("CRC-16 missed bit errors: %d\n", missed_bit_flips(CHECKSUM_CRC16));
+    add_ordered_string_output("CRC-16 missed bit errors: 0\n");
+
+    return 0;
+}
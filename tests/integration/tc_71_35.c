@@ -0,0 +1,58 @@
+/**
+ * Tests the link statistics that dev handler keeps for each device in shared memory:
+ * once a device has been connected for a few seconds, they count the messages and bytes sent both ways,
+ * show messages arriving every second, have a handshake round trip time, and count no dropped messages or skipped bytes.
+ * Net handler sends them to Dawn in a LinkStats entry with the uid of the device, after the devices and CustomData.
+ */
+#include "../test.h"
+
+#define UID 0x35
+#define WAIT_TIME 3                        // Seconds to let the device run for; dev handler updates the statistics every second
+#define LINK_STATS_TYPE (MAX_DEVICES + 1)  // Device type of the LinkStats entries in DevData
+
+int main() {
+    // Setup
+    start_test("Device link statistics", "", NO_REGEX);
+
+    // Send gamepad state so net_handler starts sending device data packets
+    float joystick_vals[] = {0.0, 0.0, 0.0, 0.0};
+    send_user_input(0, joystick_vals, GAMEPAD);
+    connect_virtual_device("SimpleTestDevice", UID);
+    sleep(WAIT_TIME);
+
+    dev_link_stats_t stats;
+    if (device_read_link_stats(get_dev_ix_from_uid(UID), &stats) != 0) {
+        printf("Couldn't read link statistics\n");
+        exit(1);
+    }
+    printf("Messages received: %d\n", stats.frames_in > 0 && stats.bytes_in > stats.frames_in);
+    printf("Messages sent: %d\n", stats.frames_out > 0 && stats.bytes_out > stats.frames_out);
+    printf("Receiving messages every second: %d\n", stats.frames_in_per_sec > 0 && stats.bytes_in_per_sec > 0);
+    printf("Round trip timed: %d\n", stats.handshake_rtt_us > 0);
+    printf("Updated in the last 2 seconds: %d\n", monotonic_millis() - stats.updated_at < 2000);
+    printf("Dropped messages: %u\n", stats.decode_errors + stats.checksum_errors);
+    printf("Skipped bytes: %llu\n", (unsigned long long) stats.resync_bytes);
+
+    // Net handler sends the statistics as read-only params of a LinkStats entry, not with the params of the device
+    DevData* dev_data = get_next_dev_data();
+    param_val_t zero = {.p_i = 0};
+    check_device_sent(dev_data, 0, device_name_to_type("SimpleTestDevice"), UID);
+    printf("Device has only its own params: %d\n", dev_data->devices[0]->n_params == get_device(device_name_to_type("SimpleTestDevice"))->num_params);
+    check_device_sent(dev_data, 2, LINK_STATS_TYPE, UID);
+    check_device_param_sent(dev_data, 2, "decode_errors", INT, &zero, 1);
+    check_device_param_sent(dev_data, 2, "checksum_errors", INT, &zero, 1);
+    check_device_param_sent(dev_data, 2, "resync_bytes", INT, &zero, 1);
+    dev_data__free_unpacked(dev_data, NULL);
+
+    // Check outputs
+    add_ordered_string_output("Messages received: 1\n");
+    add_ordered_string_output("Messages sent: 1\n");
+    add_ordered_string_output("Receiving messages every second: 1\n");
+    add_ordered_string_output("Round trip timed: 1\n");
+    add_ordered_string_output("Updated in the last 2 seconds: 1\n");
+    add_ordered_string_output("Dropped messages: 0\n");
+    add_ordered_string_output("Skipped bytes: 0\n");
+    add_ordered_string_output("Device has only its own params: 1\n");
+
+    return 0;
+}
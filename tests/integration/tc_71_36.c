@@ -0,0 +1,73 @@
+/**
+ * Hotplugging in event loop mode
+ * Runs the hotplugging scenarios of tc_71_5, tc_71_7, tc_71_8, and tc_71_9 with dev handler started as "dev_handler epoll",
+ * which must handle devices the same way as with three threads per device:
+ *  - A lowcar device is connected, and disconnected when it goes away
+ *  - Its port is reused by the next device once it's cleaned up
+ *  - Devices that don't answer with an ACKNOWLEDGEMENT (UnresponsiveTestDevice, ForeignTestDevice) are rejected
+ *  - A device that stops sending (UnstableTestDevice) is timed out and disconnected
+ *  - A device that is timed out while it still listens (MuteTestDevice) is sent a RST
+ * A SimpleTestDevice stays connected throughout, since all of these devices share one event loop.
+ */
+#include "../test.h"
+
+#define STEADY_UID 0x100
+#define UID 0x123
+#define REUSE_UID 0x124
+#define UNRESPONSIVE_UID 0x125
+#define FOREIGN_UID 0x126
+#define UNSTABLE_UID 0x127
+#define MUTE_UID 0x128
+
+int main() {
+    // Setup
+    set_dev_handler_mode("epoll");
+    start_test("Hotplug in epoll mode", "", NO_REGEX);
+    connect_virtual_device("SimpleTestDevice", STEADY_UID);
+    sleep(1);
+    check_device_connected(STEADY_UID);
+
+    // Connect a device then disconnect it
+    check_device_not_connected(UID);
+    int socket_num = connect_virtual_device("SimpleTestDevice", UID);
+    sleep(1);
+    check_device_connected(UID);
+    disconnect_virtual_device(socket_num);
+    sleep(1);
+    check_device_not_connected(UID);
+
+    // The next device gets the same port, which dev handler must have released
+    int reused_socket_num = connect_virtual_device("SimpleTestDevice", REUSE_UID);
+    printf("Port reused: %d\n", reused_socket_num == socket_num);
+    add_ordered_string_output("Port reused: 1\n");
+    sleep(1);
+    check_device_connected(REUSE_UID);
+    disconnect_virtual_device(reused_socket_num);
+    sleep(1);
+    check_device_not_connected(REUSE_UID);
+
+    // Devices that don't send an ACKNOWLEDGEMENT are rejected
+    connect_virtual_device("UnresponsiveTestDevice", UNRESPONSIVE_UID);
+    connect_virtual_device("ForeignTestDevice", FOREIGN_UID);
+    sleep(2);
+    check_device_not_connected(UNRESPONSIVE_UID);
+    check_device_not_connected(FOREIGN_UID);
+
+    // A device that stops sending times out
+    connect_virtual_device("UnstableTestDevice", UNSTABLE_UID);
+    sleep(1);
+    check_device_connected(UNSTABLE_UID);
+    sleep(5);  // UnstableTestDevice will time out
+    check_device_not_connected(UNSTABLE_UID);
+
+    // A device that never sends after its ACKNOWLEDGEMENT times out and gets a RST
+    connect_virtual_device("MuteTestDevice", MUTE_UID);
+    sleep(3);
+    check_device_not_connected(MUTE_UID);
+    add_ordered_string_output("MuteTestDevice (0x128): Received a RST\n");
+
+    // The first device was unaffected
+    check_device_connected(STEADY_UID);
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+/**
+ * Resync after line noise
+ * A NoisyTestDevice writes NUM_BURSTS bursts of BURST_SIZE bytes of noise between its messages. Each burst is more than
+ * dev handler buffers, so it takes several reads to skip, but dev handler should warn about each one only once, when it
+ * finds the next delimiter. The device must stay connected, and its link statistics must count every byte skipped.
+ * Also reports how many read() calls dev handler made per message received. Messages that arrive one at a time take a
+ * read each and batches take fewer, so there must be no more reads than messages, besides those that skip the bursts.
+ */
+#include "../test.h"
+
+#define UID 0x137
+#define NUM_BURSTS 5     // Bursts of noise written by NoisyTestDevice
+#define BURST_SIZE 2000  // Bytes in each burst
+#define BURST_READS 3    // Reads that skipping a burst may take (dev handler buffers 1024 bytes at a time)
+
+int main() {
+    // Setup
+    start_test("Resync after line noise", "", NO_REGEX);
+
+    // Connect the device and wait for all of its bursts (one per second), plus a link statistics update
+    connect_virtual_device("NoisyTestDevice", UID);
+    sleep(NUM_BURSTS + 3);
+    check_device_connected(UID);
+
+    // One warning per burst, each for the whole burst
+    for (int i = 0; i < NUM_BURSTS; i++) {
+        add_ordered_string_output("skipped 2000 bytes from");
+    }
+
+    // Every byte of noise was skipped, and no more
+    dev_link_stats_t stats;
+    device_read_link_stats(get_dev_ix_from_uid(UID), &stats);
+    printf("Bytes skipped: %llu\n", (unsigned long long) stats.resync_bytes);
+    char expected_output[64];
+    sprintf(expected_output, "Bytes skipped: %d\n", NUM_BURSTS * BURST_SIZE);
+    add_ordered_string_output(expected_output);
+
+    // Report reads per message
+    printf("Reads per message: %.2f\n", (double) stats.reads / stats.frames_in);
+    printf("At most one read per message: %d\n", stats.reads <= stats.frames_in + NUM_BURSTS * BURST_READS);
+    add_ordered_string_output("At most one read per message: 1\n");
+
+    return 0;
+}
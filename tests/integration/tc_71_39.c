@@ -0,0 +1,101 @@
+/**
+ * Snapshots of all devices while devices connect and disconnect
+ * A reader thread takes snapshots with device_read_all() while NUM_DEVICES SimpleTestDevices are connected and
+ * disconnected NUM_CYCLES times. Every snapshot must be consistent: its generation is even,
+ * every device in its catalog has the type and one of the UIDs of those devices, no UID appears twice, and params
+ * that aren't readable are left untouched. The generation must count every connect and disconnect.
+ */
+#include "../test.h"
+
+#define UID_BASE 0x390    // UID of the first device; the others follow it
+#define NUM_DEVICES 4     // Devices connected at once
+#define NUM_CYCLES 5      // Times the devices are connected and disconnected
+#define UNREADABLE 4      // A param past the last one of a SimpleTestDevice
+#define UNTOUCHED -3939   // Value of UNREADABLE in every snapshot
+#define READ_INTERVAL 50  // Microseconds between snapshots
+
+_Atomic int reader_done = 0;  // Whether the reader should stop
+int num_snapshots = 0;        // Snapshots taken by the reader
+int num_inconsistent = 0;     // Snapshots that failed a check
+int num_full = 0;             // Snapshots with all devices connected
+int num_empty = 0;            // Snapshots with no devices connected
+
+/**
+ * Takes snapshots until reader_done is set, and checks each of them
+ * Arguments:
+ *    args: unused
+ */
+static void* reader(void* args) {
+    static dev_snapshot_t snapshot;
+    uint8_t type = device_name_to_type("SimpleTestDevice");
+    while (!atomic_load(&reader_done)) {
+        for (int i = 0; i < MAX_DEVICES; i++) {
+            snapshot.params[i][UNREADABLE].p_i = UNTOUCHED;
+        }
+        device_read_all(TEST, &snapshot);
+        num_snapshots++;
+
+        int consistent = !(snapshot.generation & 1);
+        int num_connected = 0;
+        uint32_t seen_uids = 0;
+        for (bitmap_t rest = snapshot.catalog; rest != 0; num_connected++) {
+            int i = bitmap_pop(&rest);
+            uint64_t uid = snapshot.dev_ids[i].uid;
+            if (snapshot.dev_ids[i].type != type || uid < UID_BASE || uid >= UID_BASE + NUM_DEVICES
+                || (seen_uids & (1 << (uid - UID_BASE))) || snapshot.params[i][UNREADABLE].p_i != UNTOUCHED) {
+                consistent = 0;
+                continue;
+            }
+            seen_uids |= 1 << (uid - UID_BASE);
+        }
+        num_inconsistent += !consistent;
+        num_full += num_connected == NUM_DEVICES;
+        num_empty += num_connected == 0;
+        usleep(READ_INTERVAL);  // Leave time for dev handler and the devices on a single core
+    }
+    return NULL;
+}
+
+int main() {
+    // Setup
+    start_test("Snapshots during hotplug", "", NO_REGEX);
+    static dev_snapshot_t snapshot;
+    device_read_all(TEST, &snapshot);
+    uint32_t start_generation = snapshot.generation;
+
+    // Connect and disconnect the devices while the reader takes snapshots
+    pthread_t tid;
+    pthread_create(&tid, NULL, reader, NULL);
+    int socket_nums[NUM_DEVICES];
+    for (int cycle = 0; cycle < NUM_CYCLES; cycle++) {
+        for (int i = 0; i < NUM_DEVICES; i++) {
+            socket_nums[i] = connect_virtual_device("SimpleTestDevice", UID_BASE + i);
+        }
+        sleep(1);
+        for (int i = 0; i < NUM_DEVICES; i++) {
+            check_device_connected(UID_BASE + i);
+            disconnect_virtual_device(socket_nums[i]);
+        }
+        sleep(1);
+        for (int i = 0; i < NUM_DEVICES; i++) {
+            check_device_not_connected(UID_BASE + i);
+        }
+    }
+    atomic_store(&reader_done, 1);
+    pthread_join(tid, NULL);
+
+    // Every snapshot was consistent, and the reader saw the devices both connected and gone
+    printf("Inconsistent snapshots: %d out of %d\n", num_inconsistent, num_snapshots);
+    printf("Saw all devices: %d, saw none: %d\n", num_full > 0, num_empty > 0);
+    add_ordered_string_output("Inconsistent snapshots: 0 out of");
+    add_ordered_string_output("Saw all devices: 1, saw none: 1\n");
+
+    // Each connect and each disconnect moved the generation on by two
+    device_read_all(TEST, &snapshot);
+    printf("Catalog changes: %u\n", (snapshot.generation - start_generation) / 2);
+    char expected[64];
+    sprintf(expected, "Catalog changes: %d\n", 2 * NUM_DEVICES * NUM_CYCLES);
+    add_ordered_string_output(expected);
+
+    return 0;
+}
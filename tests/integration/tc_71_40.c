@@ -0,0 +1,98 @@
+/**
+ * Tests lock-free reads of device data.
+ * A writer thread writes the DATA stream of a device, setting every param to the number of the write, while
+ * NUM_READERS reader threads read it with device_read(). Every read must see all params from the same write,
+ * no reader may see an older write after a newer one, and the last write must be read once the writer is done.
+ */
+#include "../test.h"
+
+#define UID 0x40
+#define NUM_WRITES 200000  // Number of writes the writer does
+#define NUM_READERS 2      // Number of concurrent reader threads
+
+int dev_ix;                   // Index in shared memory of the device
+_Atomic int writer_done = 0;  // Whether the writer has finished
+int torn[NUM_READERS];        // Reads by each reader that mixed two writes
+int went_back[NUM_READERS];   // Reads by each reader that were older than its previous read
+
+/**
+ * Writes NUM_WRITES values to every param of the device, each time the number of the write
+ * Arguments:
+ *    args: unused
+ */
+static void* writer(void* args) {
+    param_val_t params[MAX_PARAMS];
+    for (int32_t val = 1; val <= NUM_WRITES; val++) {
+        for (int j = 0; j < MAX_PARAMS; j++) {
+            params[j].p_i = val;
+        }
+        device_write(dev_ix, DEV_HANDLER, DATA, ALL_PARAMS, params);
+    }
+    atomic_store(&writer_done, 1);
+    return NULL;
+}
+
+/**
+ * Reads every param of the device until the writer is done, and counts the reads that are torn or go back
+ * Arguments:
+ *    args: pointer to the index of this reader
+ */
+static void* reader(void* args) {
+    int id = *((int*) args);
+    param_val_t params[MAX_PARAMS];
+    int32_t last = 0;
+    while (!atomic_load(&writer_done)) {
+        device_read(dev_ix, TEST, DATA, ALL_PARAMS, params);
+        for (int j = 1; j < MAX_PARAMS; j++) {
+            if (params[j].p_i != params[0].p_i) {
+                torn[id]++;
+                break;
+            }
+        }
+        if (params[0].p_i < last) {
+            went_back[id]++;
+        }
+        last = params[0].p_i;
+    }
+    return NULL;
+}
+
+int main() {
+    // Setup
+    start_test("Lock-free device data reads", "", NO_REGEX);
+
+    // Connect the device directly to shared memory; dev handler doesn't know about it
+    dev_id_t dev_id = {.type = device_name_to_type("GeneralTestDevice"), .year = 0, .uid = UID};
+    device_connect(&dev_id, &dev_ix);
+
+    // Read concurrently with the writer; no read may mix two writes or go back to an older one
+    pthread_t writer_tid, reader_tids[NUM_READERS];
+    int ids[NUM_READERS];
+    pthread_create(&writer_tid, NULL, writer, NULL);
+    for (int i = 0; i < NUM_READERS; i++) {
+        ids[i] = i;
+        pthread_create(&reader_tids[i], NULL, reader, &ids[i]);
+    }
+    pthread_join(writer_tid, NULL);
+    int num_torn = 0, num_went_back = 0;
+    for (int i = 0; i < NUM_READERS; i++) {
+        pthread_join(reader_tids[i], NULL);
+        num_torn += torn[i];
+        num_went_back += went_back[i];
+    }
+    printf("Torn reads: %d\n", num_torn);
+    printf("Reads older than the one before: %d\n", num_went_back);
+
+    // The last write is read
+    param_val_t params[MAX_PARAMS];
+    device_read(dev_ix, TEST, DATA, ALL_PARAMS, params);
+    printf("Last write read: %d\n", params[0].p_i == NUM_WRITES && params[MAX_PARAMS - 1].p_i == NUM_WRITES);
+    device_disconnect(dev_ix);
+
+    // Check outputs
+    add_ordered_string_output("Torn reads: 0\n");
+    add_ordered_string_output("Reads older than the one before: 0\n");
+    add_ordered_string_output("Last write read: 1\n");
+
+    return 0;
+}
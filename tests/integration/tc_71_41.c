@@ -0,0 +1,44 @@
+/**
+ * Partial DEVICE_DATA
+ * A TruncatedTestDevice sends every param once, then only INCREASING, then a DEVICE_DATA whose payload is cut in
+ * the middle of the params in its bitmap. The params it stopped sending must keep their values in shared memory,
+ * only the params before the cut must be taken from the cut frame, and the device must stay connected.
+ */
+#include "../test.h"
+
+#define UID 0x141
+#define NUM_DELTAS 3  // Frames with only INCREASING that TruncatedTestDevice sends
+
+// SimpleTestDevice params
+enum {
+    INCREASING,
+    DOUBLING,
+    FLIP_FLOP,
+    MY_INT
+};
+
+int main() {
+    // Setup
+    start_test("Partial DEVICE_DATA", "", NO_REGEX);
+
+    // Connect the device and wait for it to go through its script (one DEVICE_DATA per DEVICE_PING from dev handler)
+    connect_virtual_device("TruncatedTestDevice", UID);
+    sleep(3);
+    check_device_connected(UID);
+    add_ordered_string_output("DEVICE_DATA from SimpleTestDevice is too short for its param bitmap");
+
+    param_val_t vals[MAX_PARAMS];
+    device_read_uid(UID, EXECUTOR, DATA, BITMAP_LOW(4), vals);
+
+    // The params that stopped changing kept the values from the first frame
+    printf("DOUBLING: %.1f, FLIP_FLOP: %d, MY_INT: %d\n", vals[DOUBLING].p_f, vals[FLIP_FLOP].p_b, vals[MY_INT].p_i);
+    add_ordered_string_output("DOUBLING: 1.5, FLIP_FLOP: 1, MY_INT: 7\n");
+
+    // INCREASING came before the cut, so it was taken from the cut frame
+    printf("INCREASING: %d\n", vals[INCREASING].p_i);
+    char expected[32];
+    sprintf(expected, "INCREASING: %d\n", NUM_DELTAS + 2);
+    add_ordered_string_output(expected);
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * Performance test.
+ * Compares the time it takes to find a device's index in shared memory from its uid
+ * using the uid index against a linear scan of the catalog (how it used to be done).
+ * Shared memory is filled with MAX_DEVICES devices so that the linear scan is at its worst.
+ * Also checks that the uid index stays correct as devices connect and disconnect.
+ */
+#include <time.h>
+
+#include "../test.h"
+
+#define FIRST_UID 0x1000000000  // uid of the first device; the rest are consecutive
+#define NUM_LOOKUPS 1000000     // Number of lookups timed for each method
+
+/**
+ * Returns the number of nanoseconds on the monotonic clock.
+ */
+static uint64_t nanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * The old implementation of get_dev_ix_from_uid(), which scans the catalog under the catalog lock.
+ * Arguments:
+ *    dev_uid: 64-bit unique ID of the device
+ * Returns: device index in shared memory of the specified device, -1 if specified device is not in shared memory
+ */
+static int linear_dev_ix_from_uid(uint64_t dev_uid) {
+    int dev_ix = -1;
+
+    pthread_mutex_lock(&shm_ptr->locks[SHM_LOCK_CATALOG].mutex);
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if ((dev_shm_ptr->catalog & BITMAP_BIT(i)) && (dev_shm_ptr->dev_ids[i].uid == dev_uid)) {
+            dev_ix = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shm_ptr->locks[SHM_LOCK_CATALOG].mutex);
+    return dev_ix;
+}
+
+int main() {
+    // Setup
+    start_test("UID lookup benchmark", "", NO_REGEX);
+
+    // Fill shared memory with devices directly; dev handler doesn't know about them
+    int dev_ixs[MAX_DEVICES];
+    dev_id_t dev_id = {.type = device_name_to_type("GeneralTestDevice"), .year = 0};
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        dev_id.uid = FIRST_UID + i;
+        device_connect(&dev_id, &dev_ixs[i]);
+    }
+
+    // Every device should be found at the index it was assigned, by both methods
+    int mismatches = 0;
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (get_dev_ix_from_uid(FIRST_UID + i) != dev_ixs[i] || linear_dev_ix_from_uid(FIRST_UID + i) != dev_ixs[i]) {
+            mismatches++;
+        }
+    }
+    if (get_dev_ix_from_uid(FIRST_UID + MAX_DEVICES) != -1) {
+        mismatches++;
+    }
+
+    // Time lookups of every device (the last one is the worst case for the linear scan)
+    volatile int sink = 0;
+    uint64_t start = nanos();
+    for (int i = 0; i < NUM_LOOKUPS; i++) {
+        sink += get_dev_ix_from_uid(FIRST_UID + (i % MAX_DEVICES));
+    }
+    uint64_t indexed_ns = nanos() - start;
+    start = nanos();
+    for (int i = 0; i < NUM_LOOKUPS; i++) {
+        sink += linear_dev_ix_from_uid(FIRST_UID + (i % MAX_DEVICES));
+    }
+    uint64_t linear_ns = nanos() - start;
+    printf("Indexed lookup: %.1f ns\n", (double) indexed_ns / NUM_LOOKUPS);
+    printf("Linear lookup: %.1f ns\n", (double) linear_ns / NUM_LOOKUPS);
+
+    // Disconnect every other device and check that the rest can still be found
+    for (int i = 0; i < MAX_DEVICES; i += 2) {
+        device_disconnect(dev_ixs[i]);
+    }
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (get_dev_ix_from_uid(FIRST_UID + i) != ((i % 2 == 0) ? -1 : dev_ixs[i])) {
+            mismatches++;
+        }
+    }
+    for (int i = 1; i < MAX_DEVICES; i += 2) {
+        device_disconnect(dev_ixs[i]);
+    }
+
+    printf("Lookup mismatches: %d\n", mismatches);
+    add_ordered_string_output("Lookup mismatches: 0\n");
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * Performance test.
+ * Measures the throughput of concurrent DATA writes to different devices, one writer thread per device
+ * (like dev handler's receiver threads), to show the effect of false sharing in the device shm block.
+ * The same seqlock-protected writes are timed on private copies of the old packed layout, where the
+ * sequence counters of all devices share a cache line and each device's params straddle cache lines
+ * with its neighbours', and of the new cache-line-aligned layout; then through device_write() on shm.
+ * Finally checks that every device ended up with exactly the values its writer wrote.
+ */
+#include <time.h>
+
+#include "../test.h"
+
+#define FIRST_UID 0x2000   // uid of the first device; the rest are consecutive
+#define NUM_WRITERS 4      // Number of concurrent writer threads (one per core on the Pi)
+#define NUM_WRITES 200000  // Number of writes each writer does
+
+// The old layout of the start of dev_shm_t, with params beginning in the middle of a cache line
+typedef struct {
+    uint32_t catalog;
+    _Atomic uint32_t catalog_gen;
+    _Atomic uint32_t data_seq[MAX_DEVICES];
+    _Atomic uint32_t cmd_map[MAX_DEVICES + 1];
+    param_val_t params[MAX_DEVICES][MAX_PARAMS];
+} __attribute__((aligned(CACHE_LINE_SIZE))) packed_shm_t;
+
+packed_shm_t packed;                     // Private copy of the old layout
+dev_stream_t aligned_data[MAX_DEVICES];  // Private copy of the new layout of the DATA streams
+int dev_ixs[NUM_WRITERS];                // Index in shared memory of each writer's device
+
+/**
+ * Returns the number of nanoseconds on the monotonic clock.
+ */
+static uint64_t nanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Does NUM_WRITES seqlock-protected writes of two params, the way device_write() writes the DATA stream.
+ * Arguments:
+ *    seq: the sequence counter of the device
+ *    params: the params of the device
+ */
+static void seqlock_writes(_Atomic uint32_t* seq, volatile param_val_t* params) {
+    for (int32_t val = 1; val <= NUM_WRITES; val++) {
+        atomic_store_explicit(seq, atomic_load_explicit(seq, memory_order_relaxed) + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        params[0].p_i = val;
+        params[MAX_PARAMS - 1].p_i = val;
+        atomic_store_explicit(seq, atomic_load_explicit(seq, memory_order_relaxed) + 1, memory_order_release);
+    }
+}
+
+/**
+ * Writes to one device in the private copy of the old packed layout.
+ * Arguments:
+ *    args: pointer to the index of this writer
+ */
+static void* packed_writer(void* args) {
+    int dev = *((int*) args);
+    seqlock_writes(&packed.data_seq[dev], packed.params[dev]);
+    return NULL;
+}
+
+/**
+ * Writes to one device in the private copy of the new aligned layout.
+ * Arguments:
+ *    args: pointer to the index of this writer
+ */
+static void* aligned_writer(void* args) {
+    int dev = *((int*) args);
+    seqlock_writes(&aligned_data[dev].seq, aligned_data[dev].params);
+    return NULL;
+}
+
+/**
+ * Does NUM_WRITES writes of two params to one device in shared memory through device_write().
+ * Arguments:
+ *    args: pointer to the index of this writer
+ */
+static void* shm_writer(void* args) {
+    int dev_ix = dev_ixs[*((int*) args)];
+    param_val_t params[MAX_PARAMS] = {0};
+
+    for (int32_t val = 1; val <= NUM_WRITES; val++) {
+        params[0].p_i = val;
+        params[MAX_PARAMS - 1].p_i = val;
+        device_write(dev_ix, DEV_HANDLER, DATA, BITMAP_BIT(0) | BITMAP_BIT(MAX_PARAMS - 1), params);
+    }
+    return NULL;
+}
+
+/**
+ * Runs NUM_WRITERS copies of a writer concurrently.
+ * Arguments:
+ *    writer: the function each writer thread runs
+ * Returns the number of writes per second across all writers.
+ */
+static double run_writers(void* (*writer)(void*)) {
+    pthread_t tids[NUM_WRITERS];
+    int ids[NUM_WRITERS];
+
+    uint64_t start = nanos();
+    for (int i = 0; i < NUM_WRITERS; i++) {
+        ids[i] = i;
+        pthread_create(&tids[i], NULL, writer, &ids[i]);
+    }
+    for (int i = 0; i < NUM_WRITERS; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    return (double) NUM_WRITERS * NUM_WRITES * 1e9 / (nanos() - start);
+}
+
+int main() {
+    // Setup
+    start_test("Multi-device write throughput", "", NO_REGEX);
+
+    // Connect the devices directly to shared memory; dev handler doesn't know about them
+    dev_id_t dev_id = {.type = device_name_to_type("GeneralTestDevice"), .year = 0};
+    for (int i = 0; i < NUM_WRITERS; i++) {
+        dev_id.uid = FIRST_UID + i;
+        device_connect(&dev_id, &dev_ixs[i]);
+    }
+
+    // Time both layouts
+    printf("Packed layout: %.0f writes/s\n", run_writers(packed_writer));
+    printf("Aligned layout: %.0f writes/s\n", run_writers(aligned_writer));
+    printf("device_write: %.0f writes/s\n", run_writers(shm_writer));
+
+    // Each device should hold the last values its writer wrote, and no other device's
+    param_val_t params[MAX_PARAMS];
+    int wrong = 0;
+    for (int i = 0; i < NUM_WRITERS; i++) {
+        device_read(dev_ixs[i], TEST, DATA, BITMAP_BIT(0) | BITMAP_BIT(MAX_PARAMS - 1), params);
+        if (params[0].p_i != NUM_WRITES || params[MAX_PARAMS - 1].p_i != NUM_WRITES) {
+            wrong++;
+        }
+        device_disconnect(dev_ixs[i]);
+    }
+    printf("Devices with wrong data: %d\n", wrong);
+    add_ordered_string_output("Devices with wrong data: 0\n");
+
+    return 0;
+}
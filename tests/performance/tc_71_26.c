@@ -0,0 +1,127 @@
+/**
+ * Performance test.
+ * Compares iterating over the params of a bitmap with bitmap_pop() (one step per param that is on)
+ * against testing every bit from 0 to MAX_PARAMS (how it used to be done), for a sparse and a full bitmap.
+ * Also times device_read() of a single param, which iterates over the bitmap the same way,
+ * and checks that both kinds of iteration visit exactly the same params.
+ */
+#include <time.h>
+
+#include "../test.h"
+
+#define UID 0x26
+#define NUM_ITERATIONS 1000000  // Number of times each kind of iteration is timed
+
+volatile param_val_t src[MAX_PARAMS];  // Params copied from; volatile so that the copies aren't optimized out
+param_val_t dst[MAX_PARAMS];           // Params copied into
+
+/**
+ * Returns the number of nanoseconds on the monotonic clock.
+ */
+static uint64_t nanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Copies the params that are on in a bitmap by testing every bit.
+ * Arguments:
+ *    bitmap: bitmap of the params to copy
+ * Returns: number of params copied
+ */
+static int copy_bit_test(bitmap_t bitmap) {
+    int copied = 0;
+    for (int i = 0; i < MAX_PARAMS; i++) {
+        if (bitmap & BITMAP_BIT(i)) {
+            dst[i].p_i = src[i].p_i;
+            copied++;
+        }
+    }
+    return copied;
+}
+
+/**
+ * Copies the params that are on in a bitmap by popping the lowest bit until none are left.
+ * Arguments:
+ *    bitmap: bitmap of the params to copy
+ * Returns: number of params copied
+ */
+static int copy_pop(bitmap_t bitmap) {
+    int copied = 0;
+    for (bitmap_t rest = bitmap; rest != 0;) {
+        int i = bitmap_pop(&rest);
+        dst[i].p_i = src[i].p_i;
+        copied++;
+    }
+    return copied;
+}
+
+/**
+ * Times both kinds of iteration over a bitmap and prints the time each one takes.
+ * Arguments:
+ *    name: name of the bitmap to print
+ *    bitmap: bitmap to iterate over
+ */
+static void time_bitmap(char* name, bitmap_t bitmap) {
+    volatile int sink = 0;
+    uint64_t start = nanos();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        sink += copy_bit_test(bitmap);
+    }
+    uint64_t bit_test_ns = nanos() - start;
+    start = nanos();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        sink += copy_pop(bitmap);
+    }
+    uint64_t pop_ns = nanos() - start;
+    printf("%s bitmap: bit test %.1f ns, pop %.1f ns\n", name, (double) bit_test_ns / NUM_ITERATIONS, (double) pop_ns / NUM_ITERATIONS);
+}
+
+int main() {
+    // Setup
+    start_test("Bitmap iteration benchmark", "", NO_REGEX);
+
+    // Both kinds of iteration visit the same params, including the highest one
+    int mismatches = 0;
+    for (int i = 0; i < MAX_PARAMS; i++) {
+        src[i].p_i = i + 1;
+    }
+    bitmap_t bitmaps[] = {0, BITMAP_BIT(0), BITMAP_BIT(MAX_PARAMS - 1), BITMAP_BIT(3) | BITMAP_BIT(17), 0x55555555 & ALL_PARAMS, ALL_PARAMS};
+    for (int b = 0; b < sizeof(bitmaps) / sizeof(bitmap_t); b++) {
+        param_val_t bit_test_dst[MAX_PARAMS];
+        memset(dst, 0, sizeof(dst));
+        int bit_test_copied = copy_bit_test(bitmaps[b]);
+        memcpy(bit_test_dst, dst, sizeof(dst));
+        memset(dst, 0, sizeof(dst));
+        if (copy_pop(bitmaps[b]) != bit_test_copied || memcmp(bit_test_dst, dst, sizeof(dst)) != 0) {
+            mismatches++;
+        }
+    }
+
+    // Time the iterations; a single param is what the executor reads and writes for every student API call
+    time_bitmap("Single param", BITMAP_BIT(MAX_PARAMS - 1));
+    time_bitmap("Two params", BITMAP_BIT(3) | BITMAP_BIT(17));
+    time_bitmap("Full", ALL_PARAMS);
+
+    // Time reading a single param of a device through shared memory
+    int dev_ix = -1;
+    dev_id_t dev_id = {.type = device_name_to_type("GeneralTestDevice"), .year = 0, .uid = UID};
+    device_connect(&dev_id, &dev_ix);
+    if (dev_ix == -1) {
+        printf("Couldn't connect device to shared memory\n");
+        exit(1);
+    }
+    param_val_t params[MAX_PARAMS];
+    uint64_t start = nanos();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        device_read(dev_ix, TEST, DATA, BITMAP_BIT(MAX_PARAMS - 1), params);
+    }
+    printf("device_read of a single param: %.1f ns\n", (double) (nanos() - start) / NUM_ITERATIONS);
+    device_disconnect(dev_ix);
+
+    printf("Iteration mismatches: %d\n", mismatches);
+    add_ordered_string_output("Iteration mismatches: 0\n");
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * Performance test.
+ * Same as tc_71_10, but under synthetic CPU load and repeated to find the worst (tail) latency:
+ * one busy-looping process per CPU competes with Runtime while "A" is pressed over and over.
+ * TimeTestDevice only populates its "TIMESTAMP" param once, so it is reconnected for every sample.
+ * Run with REALTIME turned on and off in runtime_util/realtime.config to compare the real-time profile against the default.
+ * The worst latency must be under UPPER_BOUND_LATENCY only with the real-time profile on; without it, every press just has to get through.
+ */
+#include <sys/prctl.h>  // for prctl(), to kill the load if the test dies
+#include <sys/wait.h>
+
+#include "../test.h"
+#include "realtime.h"
+
+#define TIME_DEV_UID 123        // must match the student code
+#define NUM_SAMPLES 10          // Number of times "A" is pressed
+#define UPPER_BOUND_LATENCY 20  // Milliseconds the worst latency must be under with the real-time profile on, even under load
+#define MAX_LOAD_PROCESSES 64   // Maximum number of busy-looping processes
+
+int main() {
+    // Setup
+    start_test("Latency Test under CPU load", "runtime_latency", NO_REGEX);
+
+    // Start one busy-looping process per CPU
+    pid_t load[MAX_LOAD_PROCESSES];
+    int num_load = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_load > MAX_LOAD_PROCESSES) {
+        num_load = MAX_LOAD_PROCESSES;
+    }
+    pid_t test_pid = getpid();
+    for (int i = 0; i < num_load; i++) {
+        if ((load[i] = fork()) == 0) {
+            // Die with the test, even if it aborts before stopping the load
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != test_pid) {
+                exit(1);
+            }
+            while (1) {
+            }
+        }
+    }
+
+    // Connect gamepad
+    uint32_t buttons = 0;
+    float joystick_vals[4] = {0};
+    send_user_input(buttons, joystick_vals, GAMEPAD);
+
+    // Start teleop mode
+    send_run_mode(SHEPHERD, TELEOP);
+
+    uint8_t dev_type = device_name_to_type("TimeTestDevice");
+    int8_t param_idx = get_param_idx(dev_type, "TIMESTAMP");
+    param_val_t vals[MAX_PARAMS];
+    int32_t worst = 0;
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        // Connect a fresh TimeTestDevice
+        int socket_num = connect_virtual_device("TimeTestDevice", TIME_DEV_UID);
+        sleep(1);  // Let it connect
+
+        // Start the timer and press A, then unpress it
+        uint64_t start = millis();
+        buttons = get_button_bit("button_a");
+        send_user_input(buttons, joystick_vals, GAMEPAD);
+        usleep(500000);
+        buttons = 0;
+        send_user_input(buttons, joystick_vals, GAMEPAD);
+
+        // Record the latency between the button press and its change to TIMESTAMP
+        device_read_uid(TIME_DEV_UID, EXECUTOR, DATA, BITMAP_BIT(param_idx), vals);
+        int32_t elapsed = vals[param_idx].p_i - (int32_t) (start % 1000000000);
+        printf("Sample %d: %d ms\n", i, elapsed);
+        if (elapsed > worst || elapsed < 0) {
+            worst = (elapsed < 0) ? INT32_MAX : elapsed;
+        }
+        disconnect_virtual_device(socket_num);
+        sleep(1);  // Let it disconnect
+    }
+
+    // Stop the load
+    for (int i = 0; i < num_load; i++) {
+        kill(load[i], SIGKILL);
+        waitpid(load[i], NULL, 0);
+    }
+
+    printf("Worst latency: %d ms\n", worst);
+    printf("Every press got through: %d\n", worst != INT32_MAX);
+    add_ordered_string_output("Every press got through: 1\n");
+    if (realtime_configured()) {
+        printf("Worst latency under bound: %d\n", worst < UPPER_BOUND_LATENCY);
+        add_ordered_string_output("Worst latency under bound: 1\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+/**
+ * Performance test.
+ * Measures how long dev handler takes to notice a newly connected device, from the moment its
+ * port is created until the device shows up in shared memory.
+ * Dev handler is told about new ports by inotify, so this should take a few milliseconds instead
+ * of up to a full scan interval.
+ */
+#include "../test.h"
+
+#define UID 0x30
+#define NUM_SAMPLES 10               // Number of times the device is connected
+#define UPPER_BOUND_CONNECT_TIME 50  // Milliseconds the worst connection time must be under
+#define MAX_CONNECT_TIME 5000        // Milliseconds to wait for the device before giving up on a sample
+
+int main() {
+    // Setup
+    start_test("Device connection latency", "", NO_REGEX);
+
+    uint64_t worst = 0, total = 0;
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        // Connect the device and wait for it to show up in shared memory
+        uint64_t start = millis();
+        int socket_num = connect_virtual_device("SimpleTestDevice", UID);
+        while (get_dev_ix_from_uid(UID) == -1 && millis() - start < MAX_CONNECT_TIME) {
+            usleep(1000);
+        }
+        uint64_t elapsed = millis() - start;
+        printf("Sample %d: %llu ms\n", i, (unsigned long long) elapsed);
+        total += elapsed;
+        if (elapsed > worst) {
+            worst = elapsed;
+        }
+        disconnect_virtual_device(socket_num);
+        sleep(1);  // Let it disconnect
+    }
+
+    printf("Average connection time: %llu ms\n", (unsigned long long) (total / NUM_SAMPLES));
+    printf("Worst connection time: %llu ms\n", (unsigned long long) worst);
+    printf("Worst connection time under bound: %d\n", worst < UPPER_BOUND_CONNECT_TIME);
+    add_ordered_string_output("Worst connection time under bound: 1\n");
+
+    return 0;
+}
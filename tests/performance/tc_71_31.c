@@ -0,0 +1,38 @@
+/**
+ * Performance test.
+ * Measures how many DEVICE_DATA messages per second a device on a serial port gets through to shared memory.
+ * SerialTestDevice emulates the timing of a serial line: at 115200 baud, its DEVICE_DATA (the read-only params of a
+ * GeneralTestDevice, which change every time) can get through at most about LOW_BAUD_MAX_RATE times per second. After
+ * the ACKNOWLEDGEMENT, dev handler and the device negotiate 1000000 baud, so many more should get through.
+ * All of those params are read, so that dev handler keeps the device subscribed to them.
+ */
+#include "../test.h"
+
+#define UID 0x31
+#define INCREASING_ODD 0                 // SerialTestDevice increases this param by 2 with each DEVICE_DATA sent
+#define READ_ONLY_PARAMS BITMAP_LOW(16)  // The read-only params of a GeneralTestDevice
+#define LOW_BAUD_MAX_RATE 177            // DEVICE_DATA per second that fit in 115200 baud (65 bytes of 10 bits each)
+#define NUM_SECONDS 3                    // Number of seconds to count DEVICE_DATA over
+
+int main() {
+    // Setup
+    start_test("Serial link throughput", "", NO_REGEX);
+
+    // Connect the device and let it negotiate the baud rate
+    connect_virtual_serial_device("SerialTestDevice", UID, 1000000);
+    sleep(2);
+
+    // Count the DEVICE_DATA received over NUM_SECONDS seconds
+    param_val_t vals[MAX_PARAMS];
+    device_read_uid(UID, EXECUTOR, DATA, READ_ONLY_PARAMS, vals);
+    int32_t start = vals[INCREASING_ODD].p_i;
+    sleep(NUM_SECONDS);
+    device_read_uid(UID, EXECUTOR, DATA, READ_ONLY_PARAMS, vals);
+    int32_t rate = (vals[INCREASING_ODD].p_i - start) / 2 / NUM_SECONDS;
+
+    printf("DEVICE_DATA per second: %d\n", rate);
+    printf("DEVICE_DATA per second over what 115200 baud fits: %d\n", rate > 2 * LOW_BAUD_MAX_RATE);
+    add_ordered_string_output("DEVICE_DATA per second over what 115200 baud fits: 1\n");
+
+    return 0;
+}
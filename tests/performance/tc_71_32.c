@@ -0,0 +1,57 @@
+/**
+ * Performance test.
+ * Measures how often a param of a device on a slow serial link is updated in shared memory, first while all of the
+ * device's read-only params are read, then while only that param is read.
+ * SerialTestDevice stays at 115200 baud here, where its DEVICE_DATA with all of those params (which change every time)
+ * fill the link. Dev handler subscribes the device to just the params that are read, so once the other params haven't
+ * been read for a while, each DEVICE_DATA is much shorter and the param that is still read is updated much more often.
+ */
+#include "../test.h"
+
+#define UID 0x32
+#define INCREASING_ODD 0                 // SerialTestDevice increases this param by 2 with each DEVICE_DATA sent
+#define READ_ONLY_PARAMS BITMAP_LOW(16)  // The read-only params of a GeneralTestDevice
+#define UNSUBSCRIBE_TIME 6               // Seconds to stop reading params for before dev handler unsubscribes from them
+#define NUM_SECONDS 3                    // Number of seconds to count updates over
+
+/**
+ * Reads some params of the device every millisecond (like student code in a loop) and returns how many times per
+ * second INCREASING_ODD was updated over the last NUM_SECONDS seconds
+ * Arguments:
+ *    params_to_read: The params to read
+ *    warmup: Number of seconds to read them for before counting
+ * Returns:
+ *    updates of INCREASING_ODD per second
+ */
+int32_t update_rate(bitmap_t params_to_read, int warmup) {
+    param_val_t vals[MAX_PARAMS];
+    int32_t start = 0;
+    uint64_t start_time = millis();
+    while (millis() - start_time < (warmup + NUM_SECONDS) * 1000) {
+        device_read_uid(UID, EXECUTOR, DATA, params_to_read, vals);
+        if (millis() - start_time < warmup * 1000) {
+            start = vals[INCREASING_ODD].p_i;
+        }
+        usleep(1000);
+    }
+    return (vals[INCREASING_ODD].p_i - start) / 2 / NUM_SECONDS;
+}
+
+int main() {
+    // Setup
+    start_test("Subscribed param update rate", "", NO_REGEX);
+
+    // Connect the device and keep it at 115200 baud
+    connect_virtual_serial_device("SerialTestDevice", UID, 115200);
+    sleep(1);
+
+    int32_t all_rate = update_rate(READ_ONLY_PARAMS, 1);
+    int32_t one_rate = update_rate(BITMAP_BIT(INCREASING_ODD), UNSUBSCRIBE_TIME);
+
+    printf("Updates per second while reading all params: %d\n", all_rate);
+    printf("Updates per second while reading one param: %d\n", one_rate);
+    printf("Reading one param more than doubles its update rate: %d\n", one_rate > 2 * all_rate);
+    add_ordered_string_output("Reading one param more than doubles its update rate: 1\n");
+
+    return 0;
+}
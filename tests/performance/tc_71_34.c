@@ -0,0 +1,117 @@
+/**
+ * Performance test.
+ * Compares the throughput of the word-at-a-time cobs codec and XOR checksum that dev handler uses against the
+ * byte-at-a-time versions that they replaced (the ones in test.h, which tc_71_33 checks them against), on
+ * DEVICE_DATA-sized messages that are mostly nonzero (like float params) and on ones that are about half zeros (like
+ * small ints and bools). Also times the CRCs that devices can pick instead of the XOR, and checks that both codecs
+ * produced the same bytes.
+ */
+#include <time.h>
+
+#include "../test.h"
+#include "dev_handler_message.h"
+
+#define MSG_LEN (MESSAGE_ID_SIZE + PAYLOAD_LENGTH_SIZE + MAX_PAYLOAD_SIZE + 1)  // Length of the largest message before encoding
+#define NUM_ITERATIONS 200000                                                 // Number of times each function is timed
+
+/**
+ * Returns the number of nanoseconds on the monotonic clock.
+ */
+static uint64_t nanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Prints the throughput of a function that was run NUM_ITERATIONS times over MSG_LEN bytes
+ * Arguments:
+ *    name: name of the function to print
+ *    ns: nanoseconds that the runs took altogether
+ */
+static void print_rate(char* name, uint64_t ns) {
+    printf("%s: %.1f MB/s\n", name, (double) MSG_LEN * NUM_ITERATIONS * 1000 / ns);
+}
+
+/**
+ * Times encoding, decoding, and checksumming a message with the old and new versions
+ * Arguments:
+ *    name: name of the message to print
+ *    msg: the message before encoding, MSG_LEN bytes
+ * Returns: the number of times the two codecs produced different bytes
+ */
+static int time_codec(char* name, uint8_t* msg) {
+    uint8_t encoded[MAX_COBS_MSG_LENGTH], byte_encoded[MAX_COBS_MSG_LENGTH];
+    uint8_t decoded[MAX_COBS_MSG_LENGTH], byte_decoded[MAX_COBS_MSG_LENGTH];
+    volatile ssize_t sink = 0;
+    printf("%s:\n", name);
+
+    uint64_t start = nanos();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        sink += ref_cobs_encode(byte_encoded, msg, MSG_LEN);
+    }
+    print_rate("  byte-at-a-time encode", nanos() - start);
+    start = nanos();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        sink += cobs_encode(encoded, msg, MSG_LEN);
+    }
+    print_rate("  word-at-a-time encode", nanos() - start);
+
+    ssize_t encoded_len = cobs_encode(encoded, msg, MSG_LEN);
+    start = nanos();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        sink += ref_cobs_decode(byte_decoded, encoded, encoded_len);
+    }
+    print_rate("  byte-at-a-time decode", nanos() - start);
+    start = nanos();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        sink += cobs_decode(decoded, encoded, encoded_len);
+    }
+    print_rate("  block-at-a-time decode", nanos() - start);
+
+    start = nanos();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        sink += ref_xor(msg, MSG_LEN);
+    }
+    print_rate("  byte-at-a-time XOR", nanos() - start);
+    char* checksum_names[NUM_CHECKSUMS] = {"  word-at-a-time XOR", "  CRC-8", "  CRC-16"};
+    for (checksum_t checksum = CHECKSUM_XOR; checksum < NUM_CHECKSUMS; checksum++) {
+        start = nanos();
+        for (int i = 0; i < NUM_ITERATIONS; i++) {
+            sink += compute_checksum(checksum, msg, MSG_LEN);
+        }
+        print_rate(checksum_names[checksum], nanos() - start);
+    }
+
+    int mismatches = 0;
+    mismatches += ref_cobs_encode(byte_encoded, msg, MSG_LEN) != encoded_len || memcmp(byte_encoded, encoded, encoded_len) != 0;
+    mismatches += ref_cobs_decode(byte_decoded, encoded, encoded_len) != MSG_LEN || memcmp(byte_decoded, msg, MSG_LEN) != 0;
+    mismatches += cobs_decode(decoded, encoded, encoded_len) != MSG_LEN || memcmp(decoded, msg, MSG_LEN) != 0;
+    mismatches += compute_checksum(CHECKSUM_XOR, msg, MSG_LEN) != ref_xor(msg, MSG_LEN);
+    return mismatches;
+}
+
+int main() {
+    // Setup
+    start_test("Cobs codec and checksum benchmark", "", NO_REGEX);
+
+    uint8_t msg[MSG_LEN];
+    int mismatches = 0;
+
+    // Mostly nonzero, with a zero every 40 bytes or so
+    for (int i = 0; i < MSG_LEN; i++) {
+        msg[i] = (i % 40 == 39) ? 0 : (uint8_t) (i * 37 + 11) | 1;
+    }
+    mismatches += time_codec("Mostly nonzero message", msg);
+
+    // About half zeros, in short runs
+    for (int i = 0; i < MSG_LEN; i++) {
+        msg[i] = (i % 4 < 2) ? (uint8_t) (i * 37 + 11) | 1 : 0;
+    }
+    mismatches += time_codec("Half zero message", msg);
+
+    printf("Codec mismatches: %d\n", mismatches);
+    add_ordered_string_output("Codec mismatches: 0\n");
+
+    return 0;
+}
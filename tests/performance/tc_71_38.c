@@ -0,0 +1,67 @@
+/**
+ * Performance test.
+ * Checks that dev handler doesn't allocate memory while it relays a connected device's data and commands.
+ * Dev handler runs with the malloc counter preloaded. Once a SimpleTestDevice has connected and settled, executor
+ * writes its MY_INT and reads its params every COMMAND_INTERVAL milliseconds for NUM_SECONDS seconds, and the
+ * count of dev handler's allocations must not grow. This is done with each device on its own threads, then again
+ * with dev handler restarted as "dev_handler epoll".
+ */
+#include "../test.h"
+
+#define UID 0x38
+#define MY_INT 3             // The read and write param of a SimpleTestDevice
+#define SETTLE_TIME 3        // Seconds for the device to connect and be subscribed before counting
+#define NUM_SECONDS 60       // Seconds to count allocations over in each mode
+#define COMMAND_INTERVAL 20  // Milliseconds between commands to the device
+
+/**
+ * Connects a SimpleTestDevice, sends it commands for NUM_SECONDS seconds, and disconnects it
+ * Returns:
+ *    the number of times dev handler allocated memory while it sent the commands
+ */
+static uint64_t count_steady_state_mallocs() {
+    int socket_num = connect_virtual_device("SimpleTestDevice", UID);
+    sleep(SETTLE_TIME);
+    check_device_connected(UID);
+
+    param_val_t vals[MAX_PARAMS];
+    uint64_t start = dev_handler_mallocs();
+    for (int i = 0; i < NUM_SECONDS * 1000 / COMMAND_INTERVAL; i++) {
+        vals[MY_INT].p_i = i;
+        device_write_uid(UID, EXECUTOR, COMMAND, BITMAP_BIT(MY_INT), vals);
+        device_read_uid(UID, EXECUTOR, DATA, ALL_PARAMS, vals);
+        usleep(COMMAND_INTERVAL * 1000);
+    }
+    uint64_t mallocs = dev_handler_mallocs() - start;
+
+    // The commands got through
+    check_device_connected(UID);
+    device_read_uid(UID, EXECUTOR, DATA, BITMAP_BIT(MY_INT), vals);
+    printf("Last command received: %d\n", vals[MY_INT].p_i == NUM_SECONDS * 1000 / COMMAND_INTERVAL - 1);
+
+    disconnect_virtual_device(socket_num);
+    sleep(1);
+    return mallocs;
+}
+
+int main() {
+    // Setup
+    count_dev_handler_mallocs();
+    start_test("No allocations while relaying a device", "", NO_REGEX);
+
+    // Each device on its own threads
+    printf("Allocations after connecting: %llu\n", (unsigned long long) count_steady_state_mallocs());
+    add_ordered_string_output("Last command received: 1\n");
+    add_ordered_string_output("Allocations after connecting: 0\n");
+
+    // Every device on an event loop
+    stop_dev_handler();
+    set_dev_handler_mode("epoll");
+    start_dev_handler();
+    sleep(1);
+    printf("Allocations after connecting in epoll mode: %llu\n", (unsigned long long) count_steady_state_mallocs());
+    add_ordered_string_output("Last command received: 1\n");
+    add_ordered_string_output("Allocations after connecting in epoll mode: 0\n");
+
+    return 0;
+}
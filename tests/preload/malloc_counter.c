@@ -0,0 +1,81 @@
+/**
+ * A library to preload (with LD_PRELOAD) into a process to count the memory it allocates.
+ * Every call to malloc(), calloc(), realloc(), posix_memalign(), and aligned_alloc() adds one to a counter kept in
+ * the file named by the environment variable MALLOC_COUNTER_FILE, which the process that starts the counted one
+ * creates and maps to read it (see count_dev_handler_mallocs() in client/dev_handler_client.h).
+ * The allocations themselves are passed on to glibc.
+ */
+#include <errno.h>     // for ENOMEM
+#include <fcntl.h>     // for open()
+#include <stdint.h>    // for uint64_t
+#include <stdlib.h>    // for getenv()
+#include <sys/mman.h>  // for mmap()
+#include <unistd.h>    // for close()
+
+// glibc's own allocator, which the counted functions pass through to
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t num, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+
+// The counter in the shared file, or NULL before it's mapped (or if there's no file to map)
+static uint64_t* counter = NULL;
+
+/**
+ * Maps the counter file when the library is loaded, before main() of the counted process
+ * Allocations made before this are not counted
+ */
+__attribute__((constructor)) static void map_counter() {
+    char* path = getenv("MALLOC_COUNTER_FILE");
+    if (path == NULL) {
+        return;
+    }
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return;
+    }
+    void* mapped = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped != MAP_FAILED) {
+        counter = (uint64_t*) mapped;
+    }
+}
+
+/**
+ * Adds one to the counter, if it's mapped
+ */
+static void count() {
+    if (counter != NULL) {
+        __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void* malloc(size_t size) {
+    count();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size) {
+    count();
+    return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    count();
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    count();
+    void* mem = __libc_memalign(alignment, size);
+    if (mem == NULL) {
+        return ENOMEM;
+    }
+    *ptr = mem;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    count();
+    return __libc_memalign(alignment, size);
+}
@@ -453,7 +453,7 @@ void add_unordered_string_output(char* output) {
 static void print_bitmap(uint64_t bitmap) {
     uint8_t bit;
     for (int i = 0; i < 64; i++) {
-        bit = ((bitmap & (1 << i)) == 0) ? 0 : 1;
+        bit = ((bitmap & (((uint64_t) 1) << i)) == 0) ? 0 : 1;
         fprintf(stderr, "%d", bit);
     }
     fprintf(stderr, "\n");
@@ -680,21 +680,17 @@ void check_game_state(robot_desc_field_t game_state, robot_desc_val_t expected_v
  */
 static int check_device_helper(uint64_t dev_uid) {
     dev_id_t dev_ids[MAX_DEVICES];
-    uint32_t catalog;
+    bitmap_t catalog;
 
     get_device_identifiers(dev_ids);
     get_catalog(&catalog);
 
-    // There are devices connected
-    if (catalog != 0) {
-        // Iterate through devices
-        for (int i = 0; i < MAX_DEVICES; i++) {
-            if (catalog & (1 << i)) {  // Connected device at index i
-                if (dev_ids[i].uid == dev_uid) {
-                    // Device is connected!
-                    return 1;
-                }
-            }
+    // Iterate through connected devices
+    for (bitmap_t rest = catalog; rest != 0;) {
+        int i = bitmap_pop(&rest);  // Connected device at index i
+        if (dev_ids[i].uid == dev_uid) {
+            // Device is connected!
+            return 1;
         }
     }
     return 0;
@@ -751,7 +747,7 @@ void check_param_range(char* dev_name, uint64_t uid, char* param_name, param_typ
 
     param_val_t vals_after[dev->num_params];
     uint32_t param_idx = (uint32_t) get_param_idx(dev_type, param_name);
-    int success = device_read_uid(uid, EXECUTOR, DATA, (1 << param_idx), vals_after);
+    int success = device_read_uid(uid, EXECUTOR, DATA, BITMAP_BIT(param_idx), vals_after);
     if (success < 0) {
         fprintf(stderr, "Error reading device with UID: %llu", uid);
     }
@@ -811,7 +807,7 @@ void check_latency(uint64_t uid, int32_t upper_bound_latency, uint64_t start_tim
         fprintf(stderr, "Could not find param_idx\n");
         fail_test();
     }
-    int success = device_read_uid(uid, EXECUTOR, DATA, (1 << param_idx), vals_after);
+    int success = device_read_uid(uid, EXECUTOR, DATA, BITMAP_BIT(param_idx), vals_after);
     if (success < 0) {
         fprintf(stderr, "Error reading device with UID: %llu", uid);
     }
@@ -840,3 +836,56 @@ void check_latency(uint64_t uid, int32_t upper_bound_latency, uint64_t start_tim
     }
     print_pass();
 }
+
+// ************************ REFERENCE IMPLEMENTATIONS *********************** //
+
+ssize_t ref_cobs_encode(uint8_t* dst, const uint8_t* src, size_t src_len) {
+    const uint8_t* end = src + src_len;
+    uint8_t* block = dst++;
+    size_t block_len = 1;
+    ssize_t dst_len = 1;
+    while (src < end) {
+        if (*src != 0) {
+            *dst++ = *src;
+            block_len++;
+            dst_len++;
+        }
+        if (*src == 0 || block_len == 0xFF) {
+            *block = (uint8_t) block_len;
+            block = dst++;
+            block_len = 1;
+            dst_len++;
+        }
+        src++;
+    }
+    *block = (uint8_t) block_len;
+    return dst_len;
+}
+
+ssize_t ref_cobs_decode(uint8_t* dst, const uint8_t* src, size_t src_len) {
+    const uint8_t* end = src + src_len;
+    ssize_t out_len = 0;
+    while (src < end) {
+        int num_bytes_to_copy = *src++;
+        for (int i = 1; i < num_bytes_to_copy; i++) {
+            if (src >= end) {
+                return 0;
+            }
+            *dst++ = *src++;
+            out_len++;
+        }
+        if (src != end) {
+            *dst++ = 0;
+            out_len++;
+        }
+    }
+    return out_len;
+}
+
+uint8_t ref_xor(const uint8_t* data, size_t len) {
+    uint8_t chk = 0;
+    for (size_t i = 0; i < len; i++) {
+        chk ^= data[i];
+    }
+    return chk;
+}
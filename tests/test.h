@@ -199,4 +199,43 @@ void check_param_range(char* dev_name, uint64_t uid, char* param_name, param_typ
  *    start_time: The start of a timer provided by the test case(in ms), usually a call to the millis() function
  */
 void check_latency(uint64_t uid, int32_t upper_bound_latency, uint64_t start_time);
+
+// ************************ REFERENCE IMPLEMENTATIONS *********************** //
+
+/**
+ * Cobs encodes a byte array one byte at a time, like dev handler used to,
+ * for tests that compare dev handler's cobs_encode() against it
+ * Arguments:
+ *    dst: buffer to write the encoded data to
+ *    src: byte array to encode
+ *    src_len: number of bytes in SRC
+ * Returns:
+ *    The size of the encoded data, DST
+ */
+ssize_t ref_cobs_encode(uint8_t* dst, const uint8_t* src, size_t src_len);
+
+/**
+ * Cobs decodes a byte array one byte at a time, like dev handler used to
+ * (for data without runs of 254 nonzero bytes, which it didn't handle),
+ * for tests that compare dev handler's cobs_decode() against it
+ * Arguments:
+ *    dst: buffer to write the decoded data to
+ *    src: cobs encoded byte array
+ *    src_len: number of bytes in SRC
+ * Returns:
+ *    The size of the decoded data, DST, or
+ *    0 if SRC ends in the middle of a block
+ */
+ssize_t ref_cobs_decode(uint8_t* dst, const uint8_t* src, size_t src_len);
+
+/**
+ * Computes the XOR of every byte one byte at a time, like dev handler used to,
+ * for tests that compare the CHECKSUM_XOR of compute_checksum() against it
+ * Arguments:
+ *    data: byte array to checksum
+ *    len: number of bytes in DATA
+ * Returns:
+ *    The XOR of the bytes
+ */
+uint8_t ref_xor(const uint8_t* data, size_t len);
 #endif